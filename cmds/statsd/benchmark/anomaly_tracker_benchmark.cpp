@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vector>
+
+#include "HashableDimensionKey.h"
+#include "anomaly/AnomalyTracker.h"
+#include "benchmark/benchmark.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::vector;
+
+static const int kNumDimensions = 10000;
+static const int kNumBuckets = 24;
+
+static vector<MetricDimensionKey> createDimensionKeys() {
+    vector<MetricDimensionKey> keys;
+    int pos[] = {1, 0, 0};
+    for (int i = 0; i < kNumDimensions; i++) {
+        HashableDimensionKey dim;
+        dim.addValue(FieldValue(Field(1, pos, 0), Value(i)));
+        keys.push_back(MetricDimensionKey(dim, DEFAULT_DIMENSION_KEY));
+    }
+    return keys;
+}
+
+// Each iteration closes one bucket in which state.range(0) of the 10k dimensions have a count,
+// then checks those dimensions against the threshold, like CountMetricProducer does.
+static void BM_AnomalyTrackerBucketRollover(benchmark::State& state) {
+    const vector<MetricDimensionKey> keys = createDimensionKeys();
+    const int changedDimensions = state.range(0);
+    Alert alert;
+    alert.set_num_buckets(kNumBuckets);
+    alert.set_trigger_if_sum_gt(1000000);
+    AnomalyTracker tracker(alert, ConfigKey(0, 12345));
+
+    // Fill the window so that every dimension has past data.
+    int64_t bucketNum = 0;
+    for (; bucketNum < kNumBuckets; bucketNum++) {
+        auto bucket = std::make_shared<DimToValMap>();
+        for (const auto& key : keys) {
+            (*bucket)[key] = 1;
+        }
+        tracker.addPastBucket(bucket, bucketNum);
+    }
+
+    int next = 0;
+    while (state.KeepRunning()) {
+        auto bucket = std::make_shared<DimToValMap>();
+        for (int i = 0; i < changedDimensions; i++) {
+            (*bucket)[keys[(next + i) % kNumDimensions]] = 1;
+        }
+        next = (next + changedDimensions) % kNumDimensions;
+        tracker.addPastBucket(bucket, bucketNum);
+        bucketNum++;
+        for (const auto& keyValuePair : *bucket) {
+            benchmark::DoNotOptimize(
+                    tracker.detectAnomaly(bucketNum, keyValuePair.first, keyValuePair.second));
+        }
+    }
+}
+BENCHMARK(BM_AnomalyTrackerBucketRollover)->Arg(100)->Arg(kNumDimensions);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
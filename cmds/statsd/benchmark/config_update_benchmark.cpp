@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+#include "guardrail/StatsdStats.h"
+#include "metric_util.h"
+#include "metrics/MetricsManager.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::base::StringPrintf;
+
+// kMaxMetricCountPerConfig caps a config at 1000 metrics.
+static const int kNumMetrics = StatsdStats::kMaxMetricCountPerConfig;
+
+static StatsdConfig CreateManyMetricsConfig() {
+    StatsdConfig config;
+    config.set_id(12345);
+    config.add_allowed_log_source("AID_ROOT");
+    *config.add_atom_matcher() = CreateScreenTurnedOnAtomMatcher();
+    *config.add_atom_matcher() = CreateScreenTurnedOffAtomMatcher();
+    for (int i = 0; i < kNumMetrics; i++) {
+        auto metric = config.add_count_metric();
+        metric->set_id(StringToId(StringPrintf("ScreenCount%d", i)));
+        metric->set_what(config.atom_matcher(i % 2).id());
+        metric->set_bucket(FIVE_MINUTES);
+    }
+    return config;
+}
+
+// Edits one metric, alternating between two versions of it.
+static void EditOneMetric(StatsdConfig* config, int iteration) {
+    config->mutable_count_metric(0)->set_bucket(iteration % 2 ? ONE_HOUR : FIVE_MINUTES);
+}
+
+static void BM_ConfigUpdateFullRebuild(benchmark::State& state) {
+    ConfigKey key(0, 12345);
+    sp<UidMap> uidMap = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+    StatsdConfig config = CreateManyMetricsConfig();
+    const int64_t timeBaseNs = 1000 * NS_PER_SEC;
+    sp<MetricsManager> metricsManager =
+            new MetricsManager(key, config, timeBaseNs, timeBaseNs, uidMap, pullerManager,
+                               anomalyAlarmMonitor, periodicAlarmMonitor);
+    metricsManager->init();
+    int iteration = 0;
+    while (state.KeepRunning()) {
+        EditOneMetric(&config, ++iteration);
+        metricsManager = new MetricsManager(key, config, timeBaseNs, timeBaseNs + iteration,
+                                            uidMap, pullerManager, anomalyAlarmMonitor,
+                                            periodicAlarmMonitor);
+        metricsManager->init();
+    }
+}
+BENCHMARK(BM_ConfigUpdateFullRebuild);
+
+static void BM_ConfigUpdateInPlace(benchmark::State& state) {
+    ConfigKey key(0, 12345);
+    sp<UidMap> uidMap = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+    StatsdConfig config = CreateManyMetricsConfig();
+    const int64_t timeBaseNs = 1000 * NS_PER_SEC;
+    sp<MetricsManager> metricsManager =
+            new MetricsManager(key, config, timeBaseNs, timeBaseNs, uidMap, pullerManager,
+                               anomalyAlarmMonitor, periodicAlarmMonitor);
+    metricsManager->init();
+    int iteration = 0;
+    while (state.KeepRunning()) {
+        EditOneMetric(&config, ++iteration);
+        if (!metricsManager->updateConfig(config, timeBaseNs, timeBaseNs + iteration,
+                                          anomalyAlarmMonitor)) {
+            state.SkipWithError("Config was not updated in place");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_ConfigUpdateInPlace);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+#include "metric_util.h"
+#include "stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::base::StringPrintf;
+using std::vector;
+
+// 100 metrics x 800 dimensions (the per-metric hard limit) with unhashed ~40 byte names produce
+// a ConfigMetricsReport of roughly 5 MB.
+static const int kNumMetrics = 100;
+static const int kNumDimensions = 800;
+
+static StatsdConfig CreateLargeReportConfig() {
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");
+    config.set_hash_strings_in_metric_report(false);
+    *config.add_atom_matcher() = CreateSyncStartAtomMatcher();
+    for (int i = 0; i < kNumMetrics; i++) {
+        auto metric = config.add_count_metric();
+        metric->set_id(StringToId(StringPrintf("SyncCount%d", i)));
+        metric->set_what(config.atom_matcher(0).id());
+        metric->set_bucket(FIVE_MINUTES);
+        *metric->mutable_dimensions_in_what() =
+                CreateAttributionUidAndTagDimensions(android::util::SYNC_STATE_CHANGED,
+                                                     {Position::FIRST});
+        metric->mutable_dimensions_in_what()->add_child()->set_field(2 /* name field */);
+    }
+    return config;
+}
+
+static sp<StatsLogProcessor> CreateLargeReportProcessor(const ConfigKey& key) {
+    const int64_t bucketStartTimeNs = 10000000000;
+    auto processor =
+            CreateStatsLogProcessor(bucketStartTimeNs / NS_PER_SEC, CreateLargeReportConfig(), key);
+    for (int i = 0; i < kNumDimensions; i++) {
+        auto event = CreateSyncStartEvent(
+                bucketStartTimeNs + i + 1, {1000 + i}, {"GMSCoreModule"},
+                StringPrintf("com.google.android.benchmark.sync.adapter.%05d", i));
+        processor->OnLogEvent(event.get());
+    }
+    return processor;
+}
+
+// ru_maxrss is a process-wide high-water mark, so run each benchmark in its own process with
+// --benchmark_filter to compare the peak memory of the two dump paths.
+static void reportPeakRss(benchmark::State& state) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        state.counters["peak_rss_kb"] = usage.ru_maxrss;
+    }
+}
+
+static void BM_DumpReportToBuffer(benchmark::State& state) {
+    ConfigKey cfgKey;
+    auto processor = CreateLargeReportProcessor(cfgKey);
+    int64_t dumpTimeNs = getElapsedRealtimeNs();
+    size_t reportSize = 0;
+    while (state.KeepRunning()) {
+        vector<uint8_t> bytes;
+        processor->onDumpReport(cfgKey, ++dumpTimeNs, false /* include_current_bucket */,
+                                false /* erase_data */, ADB_DUMP, FAST, &bytes);
+        reportSize = bytes.size();
+    }
+    state.counters["report_bytes"] = reportSize;
+    reportPeakRss(state);
+}
+BENCHMARK(BM_DumpReportToBuffer);
+
+static void BM_DumpReportToFd(benchmark::State& state) {
+    ConfigKey cfgKey;
+    auto processor = CreateLargeReportProcessor(cfgKey);
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    int64_t dumpTimeNs = getElapsedRealtimeNs();
+    while (state.KeepRunning()) {
+        processor->onDumpReport(cfgKey, ++dumpTimeNs, false /* include_current_bucket */,
+                                false /* erase_data */, ADB_DUMP, FAST, fd);
+    }
+    close(fd);
+    reportPeakRss(state);
+}
+BENCHMARK(BM_DumpReportToFd);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
@@ -18,6 +18,7 @@
 #include "FieldValue.h"
 #include "HashableDimensionKey.h"
 #include "benchmark/benchmark.h"
+#include "condition/SimpleConditionTracker.h"
 #include "logd/LogEvent.h"
 #include "metric_util.h"
 #include "stats_event.h"
@@ -27,6 +28,7 @@ namespace android {
 namespace os {
 namespace statsd {
 
+using std::unordered_map;
 using std::vector;
 
 static void createLogEventAndLink(LogEvent* event, Metric2Condition *link) {
@@ -71,6 +73,87 @@ static void BM_GetDimensionInCondition(benchmark::State& state) {
 
 BENCHMARK(BM_GetDimensionInCondition);
 
+// Builds a SimpleConditionTracker sliced by the first attribution uid with numSlices true slices.
+// numSlices must not exceed StatsdStats::kDimensionKeySizeHardLimit, or the extra slices are
+// dropped by the guardrail.
+static sp<SimpleConditionTracker> createSlicedConditionTracker(int numSlices) {
+    SimplePredicate simplePredicate;
+    simplePredicate.set_start(StringToId("WAKE_LOCK_ACQUIRE"));
+    simplePredicate.set_stop(StringToId("WAKE_LOCK_RELEASE"));
+    simplePredicate.set_count_nesting(true);
+    simplePredicate.set_initial_value(SimplePredicate_InitialValue_FALSE);
+    *simplePredicate.mutable_dimensions() =
+            CreateAttributionUidDimensions(1 /* atomId */, {Position::FIRST});
+
+    unordered_map<int64_t, int> trackerNameIndexMap;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_ACQUIRE")] = 0;
+    trackerNameIndexMap[StringToId("WAKE_LOCK_RELEASE")] = 1;
+    sp<SimpleConditionTracker> tracker =
+            new SimpleConditionTracker(ConfigKey(), StringToId("WL_HELD_BY_UID"), 0 /* index */,
+                                       simplePredicate, trackerNameIndexMap);
+
+    vector<sp<ConditionTracker>> allConditions;
+    vector<MatchingState> matcherState = {MatchingState::kMatched, MatchingState::kNotMatched};
+    for (int i = 0; i < numSlices; i++) {
+        AStatsEvent* statsEvent = AStatsEvent_obtain();
+        AStatsEvent_setAtomId(statsEvent, 1);
+        AStatsEvent_overwriteTimestamp(statsEvent, 100000 + i);
+        writeAttribution(statsEvent, {10000 + i}, {"wakelock"});
+        LogEvent event(/*uid=*/0, /*pid=*/0);
+        parseStatsEventToLogEvent(statsEvent, &event);
+
+        vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+        vector<bool> changedCache(1, false);
+        tracker->evaluateCondition(event, matcherState, allConditions, conditionCache,
+                                   changedCache);
+    }
+    return tracker;
+}
+
+static void BM_SlicedConditionQuery(benchmark::State& state) {
+    const int numSlices = state.range(0);
+    sp<SimpleConditionTracker> tracker = createSlicedConditionTracker(numSlices);
+    vector<sp<ConditionTracker>> allConditions = {tracker};
+
+    int pos[] = {1, 1, 1};
+    Field field(1 /* atomId */, pos, 2 /* depth */);
+    vector<ConditionKey> queryKeys(numSlices);
+    for (int i = 0; i < numSlices; i++) {
+        HashableDimensionKey key;
+        key.addValue(FieldValue(field, Value((int32_t)(10000 + i))));
+        queryKeys[i][StringToId("WL_HELD_BY_UID")] = key;
+    }
+
+    int i = 0;
+    while (state.KeepRunning()) {
+        vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+        tracker->isConditionMet(queryKeys[i], allConditions, false /* isPartialLink */,
+                                conditionCache);
+        benchmark::DoNotOptimize(conditionCache[0]);
+        i = (i + 1) % numSlices;
+    }
+}
+
+BENCHMARK(BM_SlicedConditionQuery)->Arg(10)->Arg(100)->Arg(800);
+
+static void BM_SlicedConditionUnmatchedEvent(benchmark::State& state) {
+    sp<SimpleConditionTracker> tracker = createSlicedConditionTracker(state.range(0));
+    vector<sp<ConditionTracker>> allConditions = {tracker};
+    vector<MatchingState> matcherState = {MatchingState::kNotMatched,
+                                          MatchingState::kNotMatched};
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+
+    while (state.KeepRunning()) {
+        // An event that matches neither start nor stop reports whether any slice is true.
+        vector<ConditionState> conditionCache(1, ConditionState::kNotEvaluated);
+        vector<bool> changedCache(1, false);
+        tracker->evaluateCondition(event, matcherState, allConditions, conditionCache,
+                                   changedCache);
+        benchmark::DoNotOptimize(conditionCache[0]);
+    }
+}
+
+BENCHMARK(BM_SlicedConditionUnmatchedEvent)->Arg(10)->Arg(100)->Arg(800);
 
 }  //  namespace statsd
 }  //  namespace os
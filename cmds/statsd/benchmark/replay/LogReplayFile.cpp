@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "LogReplayFile.h"
+
+#include <string.h>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::string;
+using std::vector;
+
+static const char kMagic[8] = {'S', 'T', 'A', 'T', 'S', 'R', 'P', 'L'};
+static const uint32_t kVersion = 1;
+
+// Larger than any message the statsd socket accepts (LOGGER_ENTRY_MAX_PAYLOAD).
+static const uint32_t kMaxPayloadSize = 64 * 1024;
+
+LogReplayWriter::~LogReplayWriter() {
+    close();
+}
+
+bool LogReplayWriter::open(const string& path) {
+    mFile = fopen(path.c_str(), "we");
+    if (mFile == nullptr) {
+        return false;
+    }
+    return fwrite(kMagic, sizeof(kMagic), 1, mFile) == 1 &&
+           fwrite(&kVersion, sizeof(kVersion), 1, mFile) == 1;
+}
+
+bool LogReplayWriter::write(int64_t receiveElapsedNs, uint32_t uid, uint32_t pid,
+                            const uint8_t* payload, uint32_t len) {
+    if (mFile == nullptr) {
+        return false;
+    }
+    return fwrite(&receiveElapsedNs, sizeof(receiveElapsedNs), 1, mFile) == 1 &&
+           fwrite(&uid, sizeof(uid), 1, mFile) == 1 && fwrite(&pid, sizeof(pid), 1, mFile) == 1 &&
+           fwrite(&len, sizeof(len), 1, mFile) == 1 && fwrite(payload, 1, len, mFile) == len;
+}
+
+bool LogReplayWriter::close() {
+    if (mFile == nullptr) {
+        return true;
+    }
+    bool success = fclose(mFile) == 0;
+    mFile = nullptr;
+    return success;
+}
+
+LogReplayReader::~LogReplayReader() {
+    if (mFile != nullptr) {
+        fclose(mFile);
+    }
+}
+
+bool LogReplayReader::open(const string& path) {
+    mFile = fopen(path.c_str(), "re");
+    if (mFile == nullptr) {
+        return false;
+    }
+    char magic[sizeof(kMagic)];
+    uint32_t version;
+    return fread(magic, sizeof(magic), 1, mFile) == 1 &&
+           memcmp(magic, kMagic, sizeof(kMagic)) == 0 &&
+           fread(&version, sizeof(version), 1, mFile) == 1 && version == kVersion;
+}
+
+bool LogReplayReader::next(LogReplayRecord* record) {
+    if (mFile == nullptr) {
+        return false;
+    }
+    uint32_t len;
+    if (fread(&record->receiveElapsedNs, sizeof(record->receiveElapsedNs), 1, mFile) != 1 ||
+        fread(&record->uid, sizeof(record->uid), 1, mFile) != 1 ||
+        fread(&record->pid, sizeof(record->pid), 1, mFile) != 1 ||
+        fread(&len, sizeof(len), 1, mFile) != 1 || len > kMaxPayloadSize) {
+        return false;
+    }
+    record->payload.resize(len);
+    return fread(record->payload.data(), 1, len, mFile) == len;
+}
+
+bool readLogReplayFile(const string& path, vector<LogReplayRecord>* records) {
+    LogReplayReader reader;
+    if (!reader.open(path)) {
+        return false;
+    }
+    LogReplayRecord record;
+    while (reader.next(&record)) {
+        records->push_back(std::move(record));
+    }
+    return true;
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * One message received on the statsd socket, as captured by statsd_record.
+ *
+ * payload holds the bytes that follow the android_log_header_t, i.e. exactly what
+ * StatsSocketListener::processMessage() consumes.
+ */
+struct LogReplayRecord {
+    // elapsedRealtime on the device when the message was received.
+    int64_t receiveElapsedNs;
+    uint32_t uid;
+    uint32_t pid;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * File format shared by statsd_record and statsd_replay:
+ *
+ *   "STATSRPL" | uint32 version
+ *   repeated: int64 receiveElapsedNs | uint32 uid | uint32 pid | uint32 len | len bytes
+ *
+ * All integers are little endian, which is the byte order of every device statsd runs on.
+ */
+class LogReplayWriter {
+public:
+    LogReplayWriter() : mFile(nullptr) {
+    }
+
+    ~LogReplayWriter();
+
+    bool open(const std::string& path);
+
+    bool write(int64_t receiveElapsedNs, uint32_t uid, uint32_t pid, const uint8_t* payload,
+               uint32_t len);
+
+    bool close();
+
+private:
+    FILE* mFile;
+};
+
+class LogReplayReader {
+public:
+    LogReplayReader() : mFile(nullptr) {
+    }
+
+    ~LogReplayReader();
+
+    bool open(const std::string& path);
+
+    // Reads the next record into record. Returns false at the end of the file or if the file is
+    // truncated or corrupt.
+    bool next(LogReplayRecord* record);
+
+private:
+    FILE* mFile;
+};
+
+// Reads every record of path into records. Returns false if the file cannot be opened.
+bool readLogReplayFile(const std::string& path, std::vector<LogReplayRecord>* records);
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Captures the traffic of the statsd socket into a file that statsd_replay can replay.
+ *
+ * statsd must not be running, since this binds the statsdw socket in its place:
+ *
+ *   adb root && adb shell stop statsd
+ *   adb shell statsd_record /data/local/tmp/atoms.rpl 60   # record for 60 seconds
+ *   adb shell start statsd
+ *
+ * Recording stops after the given number of seconds (or never, if omitted) or on SIGINT/SIGTERM.
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cutils/sockets.h>
+#include <log/log_event_list.h>
+#include <utils/SystemClock.h>
+
+#include "LogReplayFile.h"
+
+using android::os::statsd::LogReplayWriter;
+
+static volatile sig_atomic_t gStop = 0;
+
+static void onSignal(int) {
+    gStop = 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s OUTPUT_FILE [DURATION_SEC]\n", argv[0]);
+        return 1;
+    }
+    const int64_t durationNs = argc == 3 ? atoll(argv[2]) * 1000000000LL : 0;
+
+    int sock = socket_local_server("statsdw", ANDROID_SOCKET_NAMESPACE_RESERVED, SOCK_DGRAM);
+    if (sock < 0) {
+        fprintf(stderr, "cannot bind statsdw (is statsd still running?): %s\n", strerror(errno));
+        return 1;
+    }
+    int on = 1;
+    if (setsockopt(sock, SOL_SOCKET, SO_PASSCRED, &on, sizeof(on))) {
+        fprintf(stderr, "cannot set SO_PASSCRED: %s\n", strerror(errno));
+        return 1;
+    }
+    // Wake up periodically so that the duration and signals are honored on an idle socket.
+    struct timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    LogReplayWriter writer;
+    if (!writer.open(argv[1])) {
+        fprintf(stderr, "cannot open %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // Same receive path as StatsSocketListener::onDataAvailable().
+    char buffer[sizeof(android_log_header_t) + LOGGER_ENTRY_MAX_PAYLOAD + 1];
+    alignas(4) char control[CMSG_SPACE(sizeof(struct ucred))];
+    const int64_t startNs = android::elapsedRealtimeNano();
+    size_t recorded = 0;
+    while (!gStop && (durationNs == 0 || android::elapsedRealtimeNano() - startNs < durationNs)) {
+        struct iovec iov = {buffer, sizeof(buffer) - 1};
+        struct msghdr hdr = {
+                NULL, 0, &iov, 1, control, sizeof(control), 0,
+        };
+        ssize_t n = recvmsg(sock, &hdr, 0);
+        if (n <= (ssize_t)(sizeof(android_log_header_t))) {
+            continue;
+        }
+        const int64_t receiveElapsedNs = android::elapsedRealtimeNano();
+
+        struct ucred* cred = NULL;
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_CREDENTIALS) {
+                cred = (struct ucred*)CMSG_DATA(cmsg);
+                break;
+            }
+        }
+        const uint32_t uid = cred == NULL ? 65534 /* DEFAULT_OVERFLOWUID */ : cred->uid;
+        const uint32_t pid = cred == NULL ? 0 : cred->pid;
+
+        if (!writer.write(receiveElapsedNs, uid, pid,
+                          (uint8_t*)buffer + sizeof(android_log_header_t),
+                          n - sizeof(android_log_header_t))) {
+            fprintf(stderr, "write failed: %s\n", strerror(errno));
+            break;
+        }
+        recorded++;
+    }
+
+    close(sock);
+    if (!writer.close()) {
+        fprintf(stderr, "cannot close %s: %s\n", argv[1], strerror(errno));
+        return 1;
+    }
+    fprintf(stderr, "recorded %zu messages to %s\n", recorded, argv[1]);
+    return 0;
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Replays a stream captured by statsd_record through the same pipeline statsd runs live:
+ * StatsSocketListener parsing -> LogEventQueue -> StatsLogProcessor, with the parsing on one
+ * thread and the processing on another, like the socket listener and StatsService::readLogs().
+ *
+ *   statsd_replay --config config.pb --events atoms.rpl [--realtime] [--queue-size N]
+ *                 [--dump-every N] [--config-uid UID]
+ *
+ * config.pb is a serialized StatsdConfig, as accepted by "cmd stats config update". The uid map
+ * is empty and pullers are not registered, so package based matchers and pulled atoms see no
+ * data. By default the stream is replayed as fast as possible; --realtime preserves the
+ * original spacing of the messages.
+ *
+ * Reported per-stage latencies:
+ *   parse:    StatsSocketListener::processMessage(), i.e. LogEvent parsing and the queue push.
+ *   dequeue:  from the start of parsing until the processing thread pops the event.
+ *   process:  StatsLogProcessor::OnLogEvent().
+ *   total:    from the start of parsing until OnLogEvent() returns.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <android-base/file.h>
+
+#include "LogReplayFile.h"
+#include "src/StatsLogProcessor.h"
+#include "src/anomaly/AlarmMonitor.h"
+#include "src/external/StatsPullerManager.h"
+#include "src/logd/LogEventQueue.h"
+#include "src/packages/UidMap.h"
+#include "src/socket/StatsSocketListener.h"
+#include "src/stats_log_util.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using std::deque;
+using std::lock_guard;
+using std::mutex;
+using std::string;
+using std::vector;
+
+struct ReplayOptions {
+    string configPath;
+    string eventsPath;
+    bool realtime = false;
+    size_t queueSize = 2000;  // Same limit as statsd's main().
+    size_t dumpEvery = 0;
+    int configUid = 0;
+};
+
+struct ReplayResults {
+    size_t messages = 0;
+    size_t processed = 0;
+    // Messages that did not yield a queued event: queue overflows and lost-event reports.
+    size_t dropped = 0;
+    int64_t wallNs = 0;
+    vector<int64_t> parseNs;
+    vector<int64_t> dequeueNs;
+    vector<int64_t> processNs;
+    vector<int64_t> totalNs;
+    vector<int64_t> dumpNs;
+    vector<size_t> dumpBytes;
+};
+
+static int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+}
+
+static bool parseOptions(int argc, char** argv, ReplayOptions* options) {
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--config") && hasValue) {
+            options->configPath = argv[++i];
+        } else if (!strcmp(argv[i], "--events") && hasValue) {
+            options->eventsPath = argv[++i];
+        } else if (!strcmp(argv[i], "--realtime")) {
+            options->realtime = true;
+        } else if (!strcmp(argv[i], "--queue-size") && hasValue) {
+            options->queueSize = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--dump-every") && hasValue) {
+            options->dumpEvery = strtoul(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "--config-uid") && hasValue) {
+            options->configUid = atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return !options->configPath.empty() && !options->eventsPath.empty() &&
+           options->queueSize > 0;
+}
+
+static void dumpReport(const sp<StatsLogProcessor>& processor, const ConfigKey& key,
+                       int64_t dumpTimeNs, ReplayResults* results) {
+    vector<uint8_t> output;
+    const int64_t startNs = nowNs();
+    processor->onDumpReport(key, dumpTimeNs, true /* include_current_partial_bucket */,
+                            true /* erase_data */, ADB_DUMP, FAST, &output);
+    results->dumpNs.push_back(nowNs() - startNs);
+    results->dumpBytes.push_back(output.size());
+}
+
+static void replay(const ReplayOptions& options, const StatsdConfig& config,
+                   vector<LogReplayRecord>& records, ReplayResults* results) {
+    const int64_t timeBaseNs = records.empty() ? 0 : records[0].receiveElapsedNs;
+    const ConfigKey key(options.configUid, config.id());
+    sp<UidMap> uidMap = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+    sp<StatsLogProcessor> processor = new StatsLogProcessor(
+            uidMap, pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor, timeBaseNs,
+            [](const ConfigKey&) { return true; },
+            [](const int&, const vector<int64_t>&) { return true; });
+    processor->OnConfigUpdated(timeBaseNs, key, config);
+
+    LogEventQueue queue(options.queueSize);
+
+    // Parse start times of the events that are in the queue, oldest first. The queue is FIFO, so
+    // the processing thread matches each popped event with the front entry.
+    mutex startTimesMutex;
+    deque<int64_t> startTimes;
+
+    results->messages = records.size();
+    results->parseNs.reserve(records.size());
+    const int64_t replayStartNs = nowNs();
+
+    std::thread producer([&] {
+        for (LogReplayRecord& record : records) {
+            if (options.realtime) {
+                const int64_t dueNs = replayStartNs + record.receiveElapsedNs - timeBaseNs;
+                const int64_t waitNs = dueNs - nowNs();
+                if (waitNs > 0) {
+                    std::this_thread::sleep_for(std::chrono::nanoseconds(waitNs));
+                }
+            }
+            const int64_t startNs = nowNs();
+            {
+                lock_guard<mutex> lock(startTimesMutex);
+                startTimes.push_back(startNs);
+            }
+            // The event cannot have been popped if the push failed, so its entry is still last.
+            if (!StatsSocketListener::processMessage(record.payload.data(),
+                                                     record.payload.size(), record.uid,
+                                                     record.pid, &queue)) {
+                lock_guard<mutex> lock(startTimesMutex);
+                startTimes.pop_back();
+                results->dropped++;
+            }
+            results->parseNs.push_back(nowNs() - startNs);
+        }
+        // An empty event tells the processing thread that the stream is over.
+        int64_t oldestTimestampNs;
+        while (!queue.push(nullptr, &oldestTimestampNs)) {
+            std::this_thread::yield();
+        }
+    });
+
+    int64_t lastEventNs = timeBaseNs;
+    while (true) {
+        std::unique_ptr<LogEvent> event = queue.waitPop();
+        if (event == nullptr) {
+            break;
+        }
+        const int64_t popNs = nowNs();
+        int64_t startNs;
+        {
+            lock_guard<mutex> lock(startTimesMutex);
+            startNs = startTimes.front();
+            startTimes.pop_front();
+        }
+        processor->OnLogEvent(event.get());
+        const int64_t doneNs = nowNs();
+        results->dequeueNs.push_back(popNs - startNs);
+        results->processNs.push_back(doneNs - popNs);
+        results->totalNs.push_back(doneNs - startNs);
+        lastEventNs = std::max(lastEventNs, event->GetElapsedTimestampNs());
+
+        results->processed++;
+        if (options.dumpEvery > 0 && results->processed % options.dumpEvery == 0) {
+            dumpReport(processor, key, lastEventNs, results);
+        }
+    }
+    producer.join();
+    results->wallNs = nowNs() - replayStartNs;
+    dumpReport(processor, key, lastEventNs + 1, results);
+}
+
+static void printLatencies(const char* stage, vector<int64_t> samples) {
+    if (samples.empty()) {
+        printf("%-8s n/a\n", stage);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    auto percentile = [&samples](double p) {
+        return samples[std::min(samples.size() - 1, (size_t)(p * samples.size()))] / 1000.0;
+    };
+    printf("%-8s p50 %9.1f  p90 %9.1f  p99 %9.1f  p99.9 %9.1f  max %9.1f us\n", stage,
+           percentile(0.5), percentile(0.9), percentile(0.99), percentile(0.999),
+           samples.back() / 1000.0);
+}
+
+static void printResults(const ReplayResults& results) {
+    const double seconds = results.wallNs / 1e9;
+    printf("messages %zu, processed %zu, dropped %zu, %.3f s, %.0f events/s\n", results.messages,
+           results.processed, results.dropped, seconds,
+           seconds > 0 ? results.processed / seconds : 0);
+    printLatencies("parse", results.parseNs);
+    printLatencies("dequeue", results.dequeueNs);
+    printLatencies("process", results.processNs);
+    printLatencies("total", results.totalNs);
+    printLatencies("dump", results.dumpNs);
+
+    size_t totalDumpBytes = 0;
+    size_t maxDumpBytes = 0;
+    for (size_t bytes : results.dumpBytes) {
+        totalDumpBytes += bytes;
+        maxDumpBytes = std::max(maxDumpBytes, bytes);
+    }
+    printf("dumps %zu, total %zu bytes, largest %zu bytes\n", results.dumpBytes.size(),
+           totalDumpBytes, maxDumpBytes);
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        printf("peak rss %ld kB\n", usage.ru_maxrss);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
+
+using namespace android::os::statsd;
+
+int main(int argc, char** argv) {
+    ReplayOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        fprintf(stderr,
+                "usage: %s --config CONFIG --events EVENTS [--realtime] [--queue-size N] "
+                "[--dump-every N] [--config-uid UID]\n",
+                argv[0]);
+        return 1;
+    }
+
+    string serializedConfig;
+    StatsdConfig config;
+    if (!android::base::ReadFileToString(options.configPath, &serializedConfig) ||
+        !config.ParseFromString(serializedConfig)) {
+        fprintf(stderr, "cannot read a StatsdConfig from %s\n", options.configPath.c_str());
+        return 1;
+    }
+
+    std::vector<LogReplayRecord> records;
+    if (!readLogReplayFile(options.eventsPath, &records)) {
+        fprintf(stderr, "cannot read %s\n", options.eventsPath.c_str());
+        return 1;
+    }
+
+    ReplayResults results;
+    replay(options, config, records, &results);
+    printResults(results);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include <vector>
+
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+#include "logd/LogEvent.h"
+#include "matchers/PackageUidIndex.h"
+#include "matchers/matcher_util.h"
+#include "metric_util.h"
+#include "stats_event.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+using android::base::StringPrintf;
+using std::vector;
+
+static const int kAtomId = 1;
+static const int kNumPackages = 500;
+static const int kFirstAppUid = 10000;
+
+static void createUidMap(UidMap* uidMap) {
+    vector<int32_t> uids;
+    vector<int64_t> versions;
+    vector<String16> versionStrings;
+    vector<String16> packageNames;
+    vector<String16> installers;
+    for (int i = 0; i < kNumPackages; i++) {
+        uids.push_back(kFirstAppUid + i);
+        versions.push_back(1);
+        versionStrings.push_back(String16("v1"));
+        packageNames.push_back(String16(StringPrintf("com.android.package%d", i).c_str()));
+        installers.push_back(String16(""));
+    }
+    uidMap->updateMap(1, uids, versions, versionStrings, packageNames, installers);
+}
+
+static void createUidEvent(LogEvent* event, int32_t uid) {
+    AStatsEvent* statsEvent = AStatsEvent_obtain();
+    AStatsEvent_setAtomId(statsEvent, kAtomId);
+    AStatsEvent_writeInt32(statsEvent, uid);
+    AStatsEvent_addBoolAnnotation(statsEvent, ANNOTATION_ID_IS_UID, true);
+    parseStatsEventToLogEvent(statsEvent, event);
+}
+
+// Matches the uid field against 5 package names, none of which the uid belongs to, so every name
+// has to be checked.
+static SimpleAtomMatcher createUidMatcher() {
+    SimpleAtomMatcher matcher;
+    matcher.set_atom_id(kAtomId);
+    auto fieldValueMatcher = matcher.add_field_value_matcher();
+    fieldValueMatcher->set_field(1);
+    for (int i = 0; i < 5; i++) {
+        fieldValueMatcher->mutable_eq_any_string()->add_str_value(
+                StringPrintf("com.android.package%d", i));
+    }
+    return matcher;
+}
+
+static void BM_MatchUidFieldWithUidMap(benchmark::State& state) {
+    UidMap uidMap;
+    createUidMap(&uidMap);
+    SimpleAtomMatcher matcher = createUidMatcher();
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    createUidEvent(&event, kFirstAppUid + kNumPackages - 1);
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(matchesSimple(uidMap, matcher, event));
+    }
+}
+BENCHMARK(BM_MatchUidFieldWithUidMap);
+
+static void BM_MatchUidFieldWithPackageUidIndex(benchmark::State& state) {
+    UidMap uidMap;
+    createUidMap(&uidMap);
+    SimpleAtomMatcher matcher = createUidMatcher();
+    PackageUidIndex packageUids;
+    packageUids.addNamesFromMatcher(matcher);
+    packageUids.rebuild(uidMap);
+    LogEvent event(/*uid=*/0, /*pid=*/0);
+    createUidEvent(&event, kFirstAppUid + kNumPackages - 1);
+
+    while (state.KeepRunning()) {
+        benchmark::DoNotOptimize(matchesSimple(uidMap, matcher, event, &packageUids));
+    }
+}
+BENCHMARK(BM_MatchUidFieldWithPackageUidIndex);
+
+}  //  namespace statsd
+}  //  namespace os
+}  //  namespace android
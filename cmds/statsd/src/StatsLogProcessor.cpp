@@ -511,13 +511,26 @@ void StatsLogProcessor::GetActiveConfigsLocked(const int uid, vector<int64_t>& o
 void StatsLogProcessor::OnConfigUpdated(const int64_t timestampNs, const ConfigKey& key,
                                         const StatsdConfig& config) {
     std::lock_guard<std::mutex> lock(mMetricsMutex);
-    WriteDataToDiskLocked(key, timestampNs, CONFIG_UPDATED, NO_TIME_CONSTRAINTS);
-    OnConfigUpdatedLocked(timestampNs, key, config);
+    OnConfigUpdatedLocked(timestampNs, key, config, true /* modularUpdate */);
 }
 
-void StatsLogProcessor::OnConfigUpdatedLocked(
-        const int64_t timestampNs, const ConfigKey& key, const StatsdConfig& config) {
+void StatsLogProcessor::OnConfigUpdatedLocked(const int64_t timestampNs, const ConfigKey& key,
+                                              const StatsdConfig& config, bool modularUpdate) {
     VLOG("Updated configuration for key %s", key.ToString().c_str());
+    auto it = mMetricsManagers.find(key);
+    if (modularUpdate && it != mMetricsManagers.end()) {
+        if (it->second->updateConfig(config, mTimeBaseNs, timestampNs, mAnomalyAlarmMonitor)) {
+            // The kept metrics continue their buckets. Only the data of the metrics that were
+            // removed or replaced is written out.
+            WriteDataToDiskLocked(key, timestampNs, CONFIG_UPDATED, NO_TIME_CONSTRAINTS,
+                                  true /* removedMetricsOnly */);
+            mUidMap->OnConfigUpdated(key);
+            it->second->refreshTtl(timestampNs);
+            VLOG("StatsdConfig updated in place");
+            return;
+        }
+        WriteDataToDiskLocked(key, timestampNs, CONFIG_UPDATED, NO_TIME_CONSTRAINTS);
+    }
     sp<MetricsManager> newMetricsManager =
             new MetricsManager(key, config, mTimeBaseNs, timestampNs, mUidMap, mPullerManager,
                                mAnomalyAlarmMonitor, mPeriodicAlarmMonitor);
@@ -559,6 +572,13 @@ void StatsLogProcessor::dumpStates(int out, bool verbose) {
     fclose(fout);
 }
 
+static void writeConfigKey(const ConfigKey& key, ProtoOutputStream* proto) {
+    uint64_t configKeyToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
+    proto->write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
+    proto->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
+    proto->end(configKeyToken);
+}
+
 /*
  * onDumpReport dumps serialized ConfigMetricsReportList into proto.
  */
@@ -571,10 +591,7 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
     std::lock_guard<std::mutex> lock(mMetricsMutex);
 
     // Start of ConfigKey.
-    uint64_t configKeyToken = proto->start(FIELD_TYPE_MESSAGE | FIELD_ID_CONFIG_KEY);
-    proto->write(FIELD_TYPE_INT32 | FIELD_ID_UID, key.GetUid());
-    proto->write(FIELD_TYPE_INT64 | FIELD_ID_ID, (long long)key.GetId());
-    proto->end(configKeyToken);
+    writeConfigKey(key, proto);
     // End of ConfigKey.
 
     bool keepFile = false;
@@ -626,6 +643,72 @@ void StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTim
     StatsdStats::getInstance().noteMetricsReportSent(key, proto.size());
 }
 
+/*
+ * onDumpReport streams serialized ConfigMetricsReportList into outFd.
+ *
+ * Each ConfigMetricsReport is a length-delimited field of the list, so the reports can be written
+ * back to back without ever building the enclosing ConfigMetricsReportList in memory.
+ */
+bool StatsLogProcessor::onDumpReport(const ConfigKey& key, const int64_t dumpTimeStampNs,
+                                     const bool include_current_partial_bucket,
+                                     const bool erase_data,
+                                     const DumpReportReason dumpReportReason,
+                                     const DumpLatency dumpLatency,
+                                     int outFd) {
+    std::lock_guard<std::mutex> lock(mMetricsMutex);
+
+    ProtoOutputStream configKeyProto;
+    writeConfigKey(key, &configKeyProto);
+    size_t bytesWritten = configKeyProto.size();
+    if (!configKeyProto.flush(outFd)) {
+        ALOGE("Failed to stream report of %s", key.ToString().c_str());
+        return false;
+    }
+
+    bool keepFile = false;
+    auto it = mMetricsManagers.find(key);
+    if (it != mMetricsManagers.end() && it->second->shouldPersistLocalHistory()) {
+        keepFile = true;
+    }
+
+    // Reports from previous shutdowns are copied straight from disk to outFd.
+    ssize_t onDiskBytes = StorageManager::appendConfigMetricsReport(
+            key, outFd, erase_data && !keepFile /* should remove file after appending it */,
+            dumpReportReason == ADB_DUMP /*if caller is adb*/);
+    if (onDiskBytes < 0) {
+        ALOGE("Failed to stream on-disk reports of %s", key.ToString().c_str());
+        return false;
+    }
+    bytesWritten += onDiskBytes;
+
+    bool success = true;
+    if (it != mMetricsManagers.end()) {
+        // This allows another broadcast to be sent within the rate-limit period if we get close to
+        // filling the buffer again soon.
+        mLastBroadcastTimes.erase(key);
+
+        ProtoOutputStream reportProto;
+        onConfigMetricsReportLocked(key, dumpTimeStampNs, include_current_partial_bucket,
+                                    erase_data, dumpReportReason, dumpLatency,
+                                    false /* is this data going to be saved on disk */,
+                                    &reportProto);
+        const size_t reportSize = reportProto.size();
+        ssize_t headerSize = writeLengthDelimitedHeaderToFd(outFd, FIELD_ID_REPORTS, reportSize);
+        success = headerSize >= 0 && reportProto.flush(outFd);
+        if (success) {
+            bytesWritten += headerSize + reportSize;
+        } else {
+            ALOGE("Failed to stream current report of %s", key.ToString().c_str());
+        }
+    } else {
+        ALOGW("Config source %s does not exist", key.ToString().c_str());
+    }
+
+    VLOG("streamed data size %zu", bytesWritten);
+    StatsdStats::getInstance().noteMetricsReportSent(key, bytesWritten);
+    return success;
+}
+
 /*
  * onConfigMetricsReportLocked dumps serialized ConfigMetricsReport into outData.
  */
@@ -634,6 +717,20 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
         const bool include_current_partial_bucket, const bool erase_data,
         const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
         const bool dataSavedOnDisk, vector<uint8_t>* buffer) {
+    ProtoOutputStream tempProto;
+    onConfigMetricsReportLocked(key, dumpTimeStampNs, include_current_partial_bucket, erase_data,
+                                dumpReportReason, dumpLatency, dataSavedOnDisk, &tempProto);
+    flushProtoToBuffer(tempProto, buffer);
+}
+
+/*
+ * onConfigMetricsReportLocked dumps serialized ConfigMetricsReport into tempProto.
+ */
+void StatsLogProcessor::onConfigMetricsReportLocked(
+        const ConfigKey& key, const int64_t dumpTimeStampNs,
+        const bool include_current_partial_bucket, const bool erase_data,
+        const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+        const bool dataSavedOnDisk, ProtoOutputStream* tempProto, const bool removedMetricsOnly) {
     // We already checked whether key exists in mMetricsManagers in
     // WriteDataToDisk.
     auto it = mMetricsManagers.find(key);
@@ -645,46 +742,45 @@ void StatsLogProcessor::onConfigMetricsReportLocked(
 
     std::set<string> str_set;
 
-    ProtoOutputStream tempProto;
     // First, fill in ConfigMetricsReport using current data on memory, which
     // starts from filling in StatsLogReport's.
-    it->second->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
-                             dumpLatency, &str_set, &tempProto);
+    if (removedMetricsOnly) {
+        it->second->onDumpRemovedMetricsReport(dumpTimeStampNs, dumpLatency, &str_set, tempProto);
+    } else {
+        it->second->onDumpReport(dumpTimeStampNs, include_current_partial_bucket, erase_data,
+                                 dumpLatency, &str_set, tempProto);
+    }
 
     // Fill in UidMap if there is at least one metric to report.
     // This skips the uid map if it's an empty config.
-    if (it->second->getNumMetrics() > 0) {
-        uint64_t uidMapToken = tempProto.start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
+    if (it->second->getNumMetrics() > 0 || removedMetricsOnly) {
+        uint64_t uidMapToken = tempProto->start(FIELD_TYPE_MESSAGE | FIELD_ID_UID_MAP);
         mUidMap->appendUidMap(
                 dumpTimeStampNs, key, it->second->hashStringInReport() ? &str_set : nullptr,
-                it->second->versionStringsInReport(), it->second->installerInReport(), &tempProto);
-        tempProto.end(uidMapToken);
+                it->second->versionStringsInReport(), it->second->installerInReport(), tempProto);
+        tempProto->end(uidMapToken);
     }
 
     // Fill in the timestamps.
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
-                    (long long)lastReportTimeNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
-                    (long long)dumpTimeStampNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
-                    (long long)lastReportWallClockNs);
-    tempProto.write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
-                    (long long)getWallClockNs());
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_ELAPSED_NANOS,
+                     (long long)lastReportTimeNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_ELAPSED_NANOS,
+                     (long long)dumpTimeStampNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_LAST_REPORT_WALL_CLOCK_NANOS,
+                     (long long)lastReportWallClockNs);
+    tempProto->write(FIELD_TYPE_INT64 | FIELD_ID_CURRENT_REPORT_WALL_CLOCK_NANOS,
+                     (long long)getWallClockNs());
     // Dump report reason
-    tempProto.write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
+    tempProto->write(FIELD_TYPE_INT32 | FIELD_ID_DUMP_REPORT_REASON, dumpReportReason);
 
     for (const auto& str : str_set) {
-        tempProto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
+        tempProto->write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | FIELD_ID_STRINGS, str);
     }
 
-    flushProtoToBuffer(tempProto, buffer);
-
-    // save buffer to disk if needed
+    // save report to disk if needed
     if (erase_data && !dataSavedOnDisk && it->second->shouldPersistLocalHistory()) {
         VLOG("save history to disk");
-        string file_name = StorageManager::getDataHistoryFileName((long)getWallClockSec(),
-                                                                  key.GetUid(), key.GetId());
-        StorageManager::writeFile(file_name.c_str(), buffer->data(), buffer->size());
+        StorageManager::writeConfigMetricsReport(key, tempProto, true /* isHistory */);
     }
 }
 
@@ -693,7 +789,7 @@ void StatsLogProcessor::resetConfigsLocked(const int64_t timestampNs,
     for (const auto& key : configs) {
         StatsdConfig config;
         if (StorageManager::readConfigFromDisk(key, &config)) {
-            OnConfigUpdatedLocked(timestampNs, key, config);
+            OnConfigUpdatedLocked(timestampNs, key, config, false /* modularUpdate */);
             StatsdStats::getInstance().noteConfigReset(key);
         } else {
             ALOGE("Failed to read backup config from disk for : %s", key.ToString().c_str());
@@ -797,18 +893,19 @@ void StatsLogProcessor::flushIfNecessaryLocked(const ConfigKey& key,
 void StatsLogProcessor::WriteDataToDiskLocked(const ConfigKey& key,
                                               const int64_t timestampNs,
                                               const DumpReportReason dumpReportReason,
-                                              const DumpLatency dumpLatency) {
-    if (mMetricsManagers.find(key) == mMetricsManagers.end() ||
-        !mMetricsManagers.find(key)->second->shouldWriteToDisk()) {
+                                              const DumpLatency dumpLatency,
+                                              const bool removedMetricsOnly) {
+    auto it = mMetricsManagers.find(key);
+    if (it == mMetricsManagers.end() ||
+        !(removedMetricsOnly ? it->second->hasRemovedMetrics()
+                             : it->second->shouldWriteToDisk())) {
         return;
     }
-    vector<uint8_t> buffer;
+    ProtoOutputStream proto;
     onConfigMetricsReportLocked(key, timestampNs, true /* include_current_partial_bucket*/,
                                 true /* erase_data */, dumpReportReason, dumpLatency, true,
-                                &buffer);
-    string file_name =
-            StorageManager::getDataFileName((long)getWallClockSec(), key.GetUid(), key.GetId());
-    StorageManager::writeFile(file_name.c_str(), buffer.data(), buffer.size());
+                                &proto, removedMetricsOnly);
+    StorageManager::writeConfigMetricsReport(key, &proto, false /* isHistory */);
 
     // We were able to write the ConfigMetricsReport to disk, so we should trigger collection ASAP.
     mOnDiskDataConfigs.insert(key);
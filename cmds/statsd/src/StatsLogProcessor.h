@@ -66,6 +66,18 @@ public:
                       const DumpLatency dumpLatency,
                       ProtoOutputStream* proto);
 
+    /*
+     * Streams the serialized ConfigMetricsReportList to outFd one ConfigMetricsReport at a time.
+     * The wire output is identical to the other onDumpReport variants, but at most one report is
+     * held in memory at once and reports saved on disk are copied through a fixed-size buffer.
+     * Returns false if writing to outFd failed.
+     */
+    bool onDumpReport(const ConfigKey& key, const int64_t dumpTimeNs,
+                      const bool include_current_partial_bucket, const bool erase_data,
+                      const DumpReportReason dumpReportReason,
+                      const DumpLatency dumpLatency,
+                      int outFd);
+
     /* Tells MetricsManager that the alarms in alarmSet have fired. Modifies anomaly alarmSet. */
     void onAnomalyAlarmFired(
             const int64_t& timestampNs,
@@ -185,8 +197,10 @@ private:
 
     void resetIfConfigTtlExpiredLocked(const int64_t timestampNs);
 
-    void OnConfigUpdatedLocked(
-        const int64_t currentTimestampNs, const ConfigKey& key, const StatsdConfig& config);
+    // If modularUpdate is true and the config already exists, the parts of the config that did
+    // not change keep their state. Otherwise, the config is rebuilt from scratch.
+    void OnConfigUpdatedLocked(const int64_t currentTimestampNs, const ConfigKey& key,
+                               const StatsdConfig& config, bool modularUpdate);
 
     void GetActiveConfigsLocked(const int uid, vector<int64_t>& outActiveConfigs);
 
@@ -207,9 +221,12 @@ private:
     void WriteDataToDiskLocked(const DumpReportReason dumpReportReason,
                                const DumpLatency dumpLatency);
 
+    // If removedMetricsOnly is true, only the metrics that the last in-place config update
+    // removed or replaced are written.
     void WriteDataToDiskLocked(const ConfigKey& key, const int64_t timestampNs,
                                const DumpReportReason dumpReportReason,
-                               const DumpLatency dumpLatency);
+                               const DumpLatency dumpLatency,
+                               const bool removedMetricsOnly = false);
 
     void onConfigMetricsReportLocked(
             const ConfigKey& key, const int64_t dumpTimeStampNs,
@@ -219,6 +236,13 @@ private:
              (e.g., before reboot). So no need to further persist local history.*/
             const bool dataSavedToDisk, vector<uint8_t>* proto);
 
+    void onConfigMetricsReportLocked(
+            const ConfigKey& key, const int64_t dumpTimeStampNs,
+            const bool include_current_partial_bucket, const bool erase_data,
+            const DumpReportReason dumpReportReason, const DumpLatency dumpLatency,
+            const bool dataSavedToDisk, ProtoOutputStream* proto,
+            const bool removedMetricsOnly = false);
+
     /* Check if we should send a broadcast if approaching memory limits and if we're over, we
      * actually delete the data. */
     void flushIfNecessaryLocked(const ConfigKey& key, MetricsManager& metricsManager);
@@ -682,16 +682,18 @@ status_t StatsService::cmd_dump_report(int out, const Vector<String8>& args) {
             name.assign(args[2].c_str(), args[2].size());
         }
         if (good) {
-            vector<uint8_t> data;
-            mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
-                                     includeCurrentBucket, eraseData, ADB_DUMP,
-                                     NO_TIME_CONSTRAINTS,
-                                     &data);
             if (proto) {
-                for (size_t i = 0; i < data.size(); i ++) {
-                    dprintf(out, "%c", data[i]);
-                }
+                // Stream the report straight to the shell so that it never needs to be held in
+                // memory as a whole.
+                mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
+                                         includeCurrentBucket, eraseData, ADB_DUMP,
+                                         NO_TIME_CONSTRAINTS, out);
             } else {
+                vector<uint8_t> data;
+                mProcessor->onDumpReport(ConfigKey(uid, StrToInt64(name)), getElapsedRealtimeNs(),
+                                         includeCurrentBucket, eraseData, ADB_DUMP,
+                                         NO_TIME_CONSTRAINTS,
+                                         &data);
                 dprintf(out, "Non-proto stats data dump not currently supported.\n");
             }
             return android::OK;
@@ -1085,6 +1087,10 @@ void StatsService::Terminate() {
     }
 }
 
+void StatsService::setPullCoalesceToleranceMillis(int64_t toleranceMillis) {
+    mPullerManager->SetPullCoalesceToleranceNs(MillisToNano(toleranceMillis));
+}
+
 // Test only interface!!!
 void StatsService::OnLogEvent(LogEvent* event) {
     mProcessor->OnLogEvent(event);
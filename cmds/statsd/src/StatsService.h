@@ -86,6 +86,11 @@ public:
      */
     void Terminate();
 
+    /**
+     * Sets how long scheduled pulls may be postponed to share an alarm with later ones.
+     */
+    void setPullCoalesceToleranceMillis(int64_t toleranceMillis);
+
     /**
      * Test ONLY interface. In real world, StatsService reads from LogEventQueue.
      */
@@ -26,6 +26,7 @@
 #include "subscriber/IncidentdReporter.h"
 #include "subscriber/SubscriberReporter.h"
 
+#include <algorithm>
 #include <inttypes.h>
 #include <statslog_statsd.h>
 #include <time.h>
@@ -54,10 +55,8 @@ AnomalyTracker::~AnomalyTracker() {
 
 void AnomalyTracker::resetStorage() {
     VLOG("resetStorage() called.");
-    mPastBuckets.clear();
-    // Excludes the current bucket.
-    mPastBuckets.resize(mNumOfPastBuckets);
-    mSumOverPastBuckets.clear();
+    mPastBucketWindows.clear();
+    mLastSweepBucketNum = mMostRecentBucketNum;
 }
 
 size_t AnomalyTracker::index(int64_t bucketNum) const {
@@ -79,18 +78,85 @@ void AnomalyTracker::advanceMostRecentBucketTo(const int64_t& bucketNum) {
     }
     // If in the future (i.e. buckets are ancient), just empty out all past info.
     if (bucketNum >= mMostRecentBucketNum + mNumOfPastBuckets) {
-        resetStorage();
         mMostRecentBucketNum = bucketNum;
+        resetStorage();
         return;
     }
 
-    // Clear out space by emptying out old mPastBuckets[i] values and update mSumOverPastBuckets.
-    for (int64_t i = mMostRecentBucketNum + 1; i <= bucketNum; i++) {
-        const int idx = index(i);
-        subtractBucketFromSum(mPastBuckets[idx]);
-        mPastBuckets[idx] = nullptr;  // release (but not clear) the old bucket.
-    }
+    // The windows drop the buckets that are now too old when they are next written or read.
     mMostRecentBucketNum = bucketNum;
+    if (mMostRecentBucketNum - mLastSweepBucketNum >= mNumOfPastBuckets) {
+        sweepExpiredWindows();
+    }
+}
+
+void AnomalyTracker::sweepExpiredWindows() {
+    for (auto it = mPastBucketWindows.begin(); it != mPastBucketWindows.end();) {
+        if (it->second.mLastNonZeroBucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
+            it = mPastBucketWindows.erase(it);
+        } else {
+            it++;
+        }
+    }
+    mLastSweepBucketNum = mMostRecentBucketNum;
+}
+
+void AnomalyTracker::syncWindow(PastBucketWindow* window) const {
+    if (mMostRecentBucketNum - window->mSyncedBucketNum >= mNumOfPastBuckets) {
+        std::fill(window->mValues.begin(), window->mValues.end(), 0);
+        window->mSum = 0;
+        window->mNumNonZeroValues = 0;
+    } else {
+        for (int64_t i = window->mSyncedBucketNum + 1; i <= mMostRecentBucketNum; i++) {
+            int64_t& value = window->mValues[index(i)];
+            window->mSum -= value;
+            window->mNumNonZeroValues -= value != 0;
+            value = 0;
+        }
+    }
+    window->mSyncedBucketNum = mMostRecentBucketNum;
+}
+
+int64_t AnomalyTracker::getSyncedSum(const PastBucketWindow& window) const {
+    if (window.mLastNonZeroBucketNum <= mMostRecentBucketNum - mNumOfPastBuckets) {
+        return 0;
+    }
+    int64_t sum = window.mSum;
+    for (int64_t i = window.mSyncedBucketNum + 1; i <= mMostRecentBucketNum; i++) {
+        sum -= window.mValues[index(i)];
+    }
+    return sum;
+}
+
+void AnomalyTracker::setPastBucketValue(const MetricDimensionKey& key,
+                                        const int64_t& bucketValue,
+                                        const int64_t& bucketNum) {
+    auto it = mPastBucketWindows.find(key);
+    if (it == mPastBucketWindows.end()) {
+        if (bucketValue == 0) {
+            return;
+        }
+        PastBucketWindow window;
+        window.mValues.resize(mNumOfPastBuckets);
+        window.mSyncedBucketNum = mMostRecentBucketNum;
+        window.mLastNonZeroBucketNum = bucketNum;
+        window.mSum = 0;
+        window.mNumNonZeroValues = 0;
+        it = mPastBucketWindows.insert({key, std::move(window)}).first;
+    }
+    PastBucketWindow& window = it->second;
+    syncWindow(&window);
+
+    int64_t& value = window.mValues[index(bucketNum)];
+    window.mSum += bucketValue - value;
+    window.mNumNonZeroValues += (bucketValue != 0) - (value != 0);
+    value = bucketValue;
+    if (bucketValue != 0) {
+        window.mLastNonZeroBucketNum = std::max(window.mLastNonZeroBucketNum, bucketNum);
+    }
+    if (window.mNumNonZeroValues == 0) {
+        mPastBucketWindows.erase(it);
+    }
 }
 
 void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
@@ -102,25 +168,11 @@ void AnomalyTracker::addPastBucket(const MetricDimensionKey& key,
         return;
     }
 
-    const int bucketIndex = index(bucketNum);
-    if (bucketNum <= mMostRecentBucketNum && (mPastBuckets[bucketIndex] != nullptr)) {
-        // We need to insert into an already existing past bucket.
-        std::shared_ptr<DimToValMap>& bucket = mPastBuckets[bucketIndex];
-        auto itr = bucket->find(key);
-        if (itr != bucket->end()) {
-            // Old entry already exists; update it.
-            subtractValueFromSum(key, itr->second);
-            itr->second = bucketValue;
-        } else {
-            bucket->insert({key, bucketValue});
-        }
-        mSumOverPastBuckets[key] += bucketValue;
-    } else {
-        // Bucket does not exist yet (in future or was never made), so we must make it.
-        std::shared_ptr<DimToValMap> bucket = std::make_shared<DimToValMap>();
-        bucket->insert({key, bucketValue});
-        addPastBucket(bucket, bucketNum);
+    if (bucketNum > mMostRecentBucketNum) {
+        // Clear space for the new bucket to be at bucketNum.
+        advanceMostRecentBucketTo(bucketNum);
     }
+    setPastBucketValue(key, bucketValue, bucketNum);
 }
 
 void AnomalyTracker::addPastBucket(std::shared_ptr<DimToValMap> bucket,
@@ -132,45 +184,24 @@ void AnomalyTracker::addPastBucket(std::shared_ptr<DimToValMap> bucket,
     }
 
     if (bucketNum <= mMostRecentBucketNum) {
-        // We are updating an old bucket, not adding a new one.
-        subtractBucketFromSum(mPastBuckets[index(bucketNum)]);
+        // We are updating an old bucket, not adding a new one. This is rare, so just look for
+        // the dimensions that are no longer in it across all windows.
+        std::vector<MetricDimensionKey> removedKeys;
+        for (const auto& pair : mPastBucketWindows) {
+            if (bucket->find(pair.first) == bucket->end() &&
+                getPastBucketValue(pair.first, bucketNum) != 0) {
+                removedKeys.push_back(pair.first);
+            }
+        }
+        for (const MetricDimensionKey& key : removedKeys) {
+            setPastBucketValue(key, 0, bucketNum);
+        }
     } else {
         // Clear space for the new bucket to be at bucketNum.
         advanceMostRecentBucketTo(bucketNum);
     }
-    mPastBuckets[index(bucketNum)] = bucket;
-    addBucketToSum(bucket);
-}
-
-void AnomalyTracker::subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket) {
-    if (bucket == nullptr) {
-        return;
-    }
-    for (const auto& keyValuePair : *bucket) {
-        subtractValueFromSum(keyValuePair.first, keyValuePair.second);
-    }
-}
-
-
-void AnomalyTracker::subtractValueFromSum(const MetricDimensionKey& key,
-                                          const int64_t& bucketValue) {
-    auto itr = mSumOverPastBuckets.find(key);
-    if (itr == mSumOverPastBuckets.end()) {
-        return;
-    }
-    itr->second -= bucketValue;
-    if (itr->second == 0) {
-        mSumOverPastBuckets.erase(itr);
-    }
-}
-
-void AnomalyTracker::addBucketToSum(const shared_ptr<DimToValMap>& bucket) {
-    if (bucket == nullptr) {
-        return;
-    }
-    // For each dimension present in the bucket, add its value to its corresponding sum.
     for (const auto& keyValuePair : *bucket) {
-        mSumOverPastBuckets[keyValuePair.first] += keyValuePair.second;
+        setPastBucketValue(keyValuePair.first, keyValuePair.second, bucketNum);
     }
 }
 
@@ -182,22 +213,32 @@ int64_t AnomalyTracker::getPastBucketValue(const MetricDimensionKey& key,
         return 0;
     }
 
-    const auto& bucket = mPastBuckets[index(bucketNum)];
-    if (bucket == nullptr) {
+    const auto& itr = mPastBucketWindows.find(key);
+    // Buckets after mSyncedBucketNum have not been written since the window last caught up.
+    if (itr == mPastBucketWindows.end() || bucketNum > itr->second.mSyncedBucketNum) {
         return 0;
     }
-    const auto& itr = bucket->find(key);
-    return itr == bucket->end() ? 0 : itr->second;
+    return itr->second.mValues[index(bucketNum)];
 }
 
 int64_t AnomalyTracker::getSumOverPastBuckets(const MetricDimensionKey& key) const {
-    const auto& itr = mSumOverPastBuckets.find(key);
-    if (itr != mSumOverPastBuckets.end()) {
-        return itr->second;
+    const auto& itr = mPastBucketWindows.find(key);
+    if (itr != mPastBucketWindows.end()) {
+        return getSyncedSum(itr->second);
     }
     return 0;
 }
 
+size_t AnomalyTracker::getNumOfDimensionsWithPastData() const {
+    size_t count = 0;
+    for (const auto& pair : mPastBucketWindows) {
+        if (getSyncedSum(pair.second) != 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
 bool AnomalyTracker::detectAnomaly(const int64_t& currentBucketNum,
                                    const MetricDimensionKey& key,
                                    const int64_t& currentBucketValue) {
@@ -145,17 +145,38 @@ protected:
     // for the anomaly detection (since the current bucket is not in the past).
     const int mNumOfPastBuckets;
 
-    // Values for each of the past mNumOfPastBuckets buckets. Always of size mNumOfPastBuckets.
-    // mPastBuckets[i] can be null, meaning that no data is present in that bucket.
-    std::vector<shared_ptr<DimToValMap>> mPastBuckets;
+    // The past bucket values of one dimension.
+    struct PastBucketWindow {
+        // Circular array of mNumOfPastBuckets values, indexed by index(bucketNum). Holds the
+        // buckets (mSyncedBucketNum - mNumOfPastBuckets, mSyncedBucketNum].
+        std::vector<int64_t> mValues;
 
-    // Cached sum over all existing buckets in mPastBuckets.
-    // Its buckets never contain entries of 0.
-    DimToValMap mSumOverPastBuckets;
+        // The mMostRecentBucketNum that mValues and mSum were last brought up to. Buckets that
+        // have fallen out of the window since then are cleared on the next write.
+        int64_t mSyncedBucketNum;
+
+        // The most recent bucket with a non-zero value. The window holds no data once this is
+        // out of it.
+        int64_t mLastNonZeroBucketNum;
+
+        // Sum of mValues.
+        int64_t mSum;
+
+        // Number of non-zero entries in mValues. Values of mixed sign can sum up to zero, so the
+        // window is only dropped once this is zero.
+        int mNumNonZeroValues;
+    };
+
+    // The past buckets of each dimension that had a non-zero value in one of them. Advancing to
+    // a new bucket does not touch the windows; each one catches up when it is next written.
+    unordered_map<MetricDimensionKey, PastBucketWindow> mPastBucketWindows;
 
     // The bucket number of the last added bucket.
     int64_t mMostRecentBucketNum = -1;
 
+    // mMostRecentBucketNum when windows without data were last removed.
+    int64_t mLastSweepBucketNum = -1;
+
     // Map from each dimension to the timestamp that its refractory period (if this anomaly was
     // declared for that dimension) ends, in seconds. From this moment and onwards, anomalies
     // can be declared again.
@@ -167,15 +188,26 @@ protected:
     //   [mMostRecentBucketNum - mNumOfPastBuckets + 1, bucketNum - mNumOfPastBuckets].
     void advanceMostRecentBucketTo(const int64_t& bucketNum);
 
-    // Add the information in the given bucket to mSumOverPastBuckets.
-    void addBucketToSum(const shared_ptr<DimToValMap>& bucket);
+    // Sets the value of key in bucketNum, which must be within the window ending at
+    // mMostRecentBucketNum. Removes the window of key if it no longer holds any data.
+    void setPastBucketValue(const MetricDimensionKey& key, const int64_t& bucketValue,
+                            const int64_t& bucketNum);
+
+    // Clears the buckets of window that are older than the window ending at
+    // mMostRecentBucketNum.
+    void syncWindow(PastBucketWindow* window) const;
+
+    // Returns the sum of window over the window ending at mMostRecentBucketNum, without
+    // modifying it.
+    int64_t getSyncedSum(const PastBucketWindow& window) const;
 
-    // Subtract the information in the given bucket from mSumOverPastBuckets
-    // and remove any items with value 0.
-    void subtractBucketFromSum(const shared_ptr<DimToValMap>& bucket);
+    // Removes the windows whose data has all become too old. Runs at most once every
+    // mNumOfPastBuckets buckets, so the cost per bucket stays proportional to the number of
+    // dimensions written rather than to the number of dimensions tracked.
+    void sweepExpiredWindows();
 
-    // From mSumOverPastBuckets[key], subtracts bucketValue, removing it if it is now 0.
-    void subtractValueFromSum(const MetricDimensionKey& key, const int64_t& bucketValue);
+    // For testing only. Returns the number of dimensions with a non-zero sum over past buckets.
+    size_t getNumOfDimensionsWithPastData() const;
 
     // Returns true if in the refractory period, else false.
     bool isInRefractoryPeriod(const int64_t& timestampNs, const MetricDimensionKey& key) const;
@@ -192,6 +224,8 @@ protected:
 
     FRIEND_TEST(AnomalyTrackerTest, TestConsecutiveBuckets);
     FRIEND_TEST(AnomalyTrackerTest, TestSparseBuckets);
+    FRIEND_TEST(AnomalyTrackerTest, TestPartiallySkippedBuckets);
+    FRIEND_TEST(AnomalyTrackerTest, TestMixedSignBuckets);
     FRIEND_TEST(GaugeMetricProducerTest, TestAnomalyDetection);
     FRIEND_TEST(CountMetricProducerTest, TestAnomalyDetectionUnSliced);
     FRIEND_TEST(AnomalyDetectionE2eTest, TestDurationMetric_SUM_single_bucket);
@@ -125,6 +125,19 @@ void CombinationConditionTracker::isConditionMet(
             evaluateCombinationCondition(mChildren, mLogicalOperation, conditionCache);
 }
 
+void CombinationConditionTracker::getOverallCondition(
+        const vector<sp<ConditionTracker>>& allConditions,
+        vector<ConditionState>& conditionCache) const {
+    if (conditionCache[mIndex] != ConditionState::kNotEvaluated) {
+        return;
+    }
+    for (const int childIndex : mChildren) {
+        allConditions[childIndex]->getOverallCondition(allConditions, conditionCache);
+    }
+    conditionCache[mIndex] =
+            evaluateCombinationCondition(mChildren, mLogicalOperation, conditionCache);
+}
+
 void CombinationConditionTracker::evaluateCondition(
         const LogEvent& event, const std::vector<MatchingState>& eventMatcherValues,
         const std::vector<sp<ConditionTracker>>& mAllConditions,
@@ -46,6 +46,9 @@ public:
                         const bool isPartialLink,
                         std::vector<ConditionState>& conditionCache) const override;
 
+    void getOverallCondition(const std::vector<sp<ConditionTracker>>& allConditions,
+                             std::vector<ConditionState>& conditionCache) const override;
+
     // Only one child predicate can have dimension.
     const std::set<HashableDimensionKey>* getChangedToTrueDimensions(
             const std::vector<sp<ConditionTracker>>& allConditions) const override {
@@ -88,6 +88,13 @@ public:
             const bool isPartialLink,
             std::vector<ConditionState>& conditionCache) const = 0;
 
+    // Query the overall condition, the value evaluateCondition() puts in the cache for an event
+    // that does not change it. A sliced condition is true if any of its slices is true.
+    // [allConditions]: all condition trackers, as the evaluation is done recursively.
+    // [conditionCache]: the cache holding the condition evaluation values.
+    virtual void getOverallCondition(const std::vector<sp<ConditionTracker>>& allConditions,
+                                     std::vector<ConditionState>& conditionCache) const = 0;
+
     // return the list of LogMatchingTracker index that this ConditionTracker uses.
     virtual const std::set<int>& getLogTrackerIndex() const {
         return mTrackerIndex;
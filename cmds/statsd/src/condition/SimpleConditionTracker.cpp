@@ -105,9 +105,9 @@ bool SimpleConditionTracker::init(const vector<Predicate>& allConditionConfig,
 
 void SimpleConditionTracker::dumpState() {
     VLOG("%lld DUMP:", (long long)mConditionId);
-    for (const auto& pair : mSlicedConditionState) {
-        VLOG("\t%s : %d", pair.first.toString().c_str(), pair.second);
-    }
+    mSlicedConditionState.forEach([](const HashableDimensionKey& key, int startedCount) {
+        VLOG("\t%s : %d", key.toString().c_str(), startedCount);
+    });
 
     VLOG("Changed to true keys: \n");
     for (const auto& key : mLastChangedToTrueDimensions) {
@@ -127,11 +127,11 @@ void SimpleConditionTracker::handleStopAll(std::vector<ConditionState>& conditio
             (mInitialValue == ConditionState::kFalse && mSlicedConditionState.empty()) ? false
                                                                                            : true;
 
-    for (const auto& cond : mSlicedConditionState) {
-        if (cond.second > 0) {
-            mLastChangedToFalseDimensions.insert(cond.first);
+    mSlicedConditionState.forEach([this](const HashableDimensionKey& key, int startedCount) {
+        if (startedCount > 0) {
+            mLastChangedToFalseDimensions.insert(key);
         }
-    }
+    });
 
     // After StopAll, we know everything has stopped. From now on, default condition is false.
     mInitialValue = ConditionState::kFalse;
@@ -140,7 +140,7 @@ void SimpleConditionTracker::handleStopAll(std::vector<ConditionState>& conditio
 }
 
 bool SimpleConditionTracker::hitGuardRail(const HashableDimensionKey& newKey) {
-    if (!mSliced || mSlicedConditionState.find(newKey) != mSlicedConditionState.end()) {
+    if (!mSliced || mSlicedConditionState.find(newKey) != SlicedConditionState::kNoSlot) {
         // if the condition is not sliced or the key is not new, we are good!
         return false;
     }
@@ -162,31 +162,31 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
                                                   bool matchStart, ConditionState* conditionCache,
                                                   bool* conditionChangedCache) {
     bool changed = false;
-    auto outputIt = mSlicedConditionState.find(outputKey);
+    const int slot = mSlicedConditionState.find(outputKey);
     ConditionState newCondition;
-    if (hitGuardRail(outputKey)) {
+    if (slot == SlicedConditionState::kNoSlot && hitGuardRail(outputKey)) {
         (*conditionChangedCache) = false;
         // Tells the caller it's evaluated.
         (*conditionCache) = ConditionState::kUnknown;
         return;
     }
-    if (outputIt == mSlicedConditionState.end()) {
+    if (slot == SlicedConditionState::kNoSlot) {
         // We get a new output key.
         newCondition = matchStart ? ConditionState::kTrue : ConditionState::kFalse;
         if (matchStart && mInitialValue != ConditionState::kTrue) {
-            mSlicedConditionState[outputKey] = 1;
+            mSlicedConditionState.insert(outputKey, 1);
             changed = true;
             mLastChangedToTrueDimensions.insert(outputKey);
         } else if (mInitialValue != ConditionState::kFalse) {
             // it's a stop and we don't have history about it.
             // If the default condition is not false, it means this stop is valuable to us.
-            mSlicedConditionState[outputKey] = 0;
+            mSlicedConditionState.insert(outputKey, 0);
             mLastChangedToFalseDimensions.insert(outputKey);
             changed = true;
         }
     } else {
         // we have history about this output key.
-        auto& startedCount = outputIt->second;
+        int startedCount = mSlicedConditionState.startedCount(slot);
         // assign the old value first.
         newCondition = startedCount > 0 ? ConditionState::kTrue : ConditionState::kFalse;
         if (matchStart) {
@@ -199,6 +199,7 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
             // it's ok to do ++ here, even if we don't count nesting. The >1 counts will be treated
             // as 1 if not counting nesting.
             startedCount++;
+            mSlicedConditionState.setStartedCount(slot, startedCount);
             newCondition = ConditionState::kTrue;
         } else {
             // This is a stop event.
@@ -222,8 +223,10 @@ void SimpleConditionTracker::handleConditionEvent(const HashableDimensionKey& ou
 
             // if default condition is false, it means we don't need to keep the false values.
             if (mInitialValue == ConditionState::kFalse && startedCount == 0) {
-                mSlicedConditionState.erase(outputIt);
+                mSlicedConditionState.erase(slot);
                 VLOG("erase key %s", outputKey.toString().c_str());
+            } else {
+                mSlicedConditionState.setStartedCount(slot, startedCount);
             }
         }
     }
@@ -277,28 +280,7 @@ void SimpleConditionTracker::evaluateCondition(
     if (matchedState < 0) {
         // The event doesn't match this condition. So we just report existing condition values.
         conditionChangedCache[mIndex] = false;
-        if (mSliced) {
-            // if the condition result is sliced. The overall condition is true if any of the sliced
-            // condition is true
-            conditionCache[mIndex] = mInitialValue;
-            for (const auto& slicedCondition : mSlicedConditionState) {
-                if (slicedCondition.second > 0) {
-                    conditionCache[mIndex] = ConditionState::kTrue;
-                    break;
-                }
-            }
-        } else {
-            const auto& itr = mSlicedConditionState.find(DEFAULT_DIMENSION_KEY);
-            if (itr == mSlicedConditionState.end()) {
-                // condition not sliced, but we haven't seen the matched start or stop yet. so
-                // return initial value.
-                conditionCache[mIndex] = mInitialValue;
-            } else {
-                // return the cached condition.
-                conditionCache[mIndex] =
-                        itr->second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
-            }
-        }
+        getOverallCondition(mAllConditions, conditionCache);
         return;
     }
 
@@ -326,6 +308,32 @@ void SimpleConditionTracker::evaluateCondition(
     conditionChangedCache[mIndex] = overallChanged;
 }
 
+void SimpleConditionTracker::getOverallCondition(
+        const vector<sp<ConditionTracker>>& allConditions,
+        vector<ConditionState>& conditionCache) const {
+    if (conditionCache[mIndex] != ConditionState::kNotEvaluated) {
+        return;
+    }
+    if (mSliced) {
+        // if the condition result is sliced. The overall condition is true if any of the sliced
+        // condition is true
+        conditionCache[mIndex] =
+                mSlicedConditionState.anyTrue() ? ConditionState::kTrue : mInitialValue;
+    } else {
+        const int slot = mSlicedConditionState.find(DEFAULT_DIMENSION_KEY);
+        if (slot == SlicedConditionState::kNoSlot) {
+            // condition not sliced, but we haven't seen the matched start or stop yet. so
+            // return initial value.
+            conditionCache[mIndex] = mInitialValue;
+        } else {
+            // return the cached condition.
+            conditionCache[mIndex] = mSlicedConditionState.startedCount(slot) > 0
+                                             ? ConditionState::kTrue
+                                             : ConditionState::kFalse;
+        }
+    }
+}
+
 void SimpleConditionTracker::isConditionMet(
         const ConditionKey& conditionParameters, const vector<sp<ConditionTracker>>& allConditions,
         const bool isPartialLink,
@@ -343,10 +351,11 @@ void SimpleConditionTracker::isConditionMet(
         ConditionState conditionState = ConditionState::kNotEvaluated;
         conditionState = conditionState | mInitialValue;
         if (!mSliced) {
-            const auto& itr = mSlicedConditionState.find(DEFAULT_DIMENSION_KEY);
-            if (itr != mSlicedConditionState.end()) {
-                ConditionState sliceState =
-                    itr->second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
+            const int slot = mSlicedConditionState.find(DEFAULT_DIMENSION_KEY);
+            if (slot != SlicedConditionState::kNoSlot) {
+                ConditionState sliceState = mSlicedConditionState.startedCount(slot) > 0
+                                                    ? ConditionState::kTrue
+                                                    : ConditionState::kFalse;
                 conditionState = conditionState | sliceState;
             }
         }
@@ -360,22 +369,24 @@ void SimpleConditionTracker::isConditionMet(
         // For unseen key, check whether the require dimensions are subset of sliced condition
         // output.
         conditionState = conditionState | mInitialValue;
-        for (const auto& slice : mSlicedConditionState) {
-            ConditionState sliceState =
-                slice.second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
-            if (slice.first.contains(key)) {
-                conditionState = conditionState | sliceState;
-            }
-        }
+        mSlicedConditionState.forEach(
+                [&key, &conditionState](const HashableDimensionKey& sliceKey, int startedCount) {
+                    if (sliceKey.contains(key)) {
+                        conditionState = conditionState | (startedCount > 0
+                                                                   ? ConditionState::kTrue
+                                                                   : ConditionState::kFalse);
+                    }
+                });
     } else {
-        auto startedCountIt = mSlicedConditionState.find(key);
+        // Full links are answered with a single hash probe.
+        const int slot = mSlicedConditionState.find(key);
         conditionState = conditionState | mInitialValue;
-        if (startedCountIt != mSlicedConditionState.end()) {
-            ConditionState sliceState =
-                startedCountIt->second > 0 ? ConditionState::kTrue : ConditionState::kFalse;
+        if (slot != SlicedConditionState::kNoSlot) {
+            ConditionState sliceState = mSlicedConditionState.startedCount(slot) > 0
+                                                ? ConditionState::kTrue
+                                                : ConditionState::kFalse;
             conditionState = conditionState | sliceState;
         }
-
     }
     conditionCache[mIndex] = conditionState;
     VLOG("Predicate %lld return %d", (long long)mConditionId, conditionCache[mIndex]);
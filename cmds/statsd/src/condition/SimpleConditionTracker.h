@@ -19,6 +19,7 @@
 
 #include <gtest/gtest_prod.h>
 #include "ConditionTracker.h"
+#include "SlicedConditionState.h"
 #include "config/ConfigKey.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "stats_util.h"
@@ -51,6 +52,9 @@ public:
                         const bool isPartialLink,
                         std::vector<ConditionState>& conditionCache) const override;
 
+    void getOverallCondition(const std::vector<sp<ConditionTracker>>& allConditions,
+                             std::vector<ConditionState>& conditionCache) const override;
+
     virtual const std::set<HashableDimensionKey>* getChangedToTrueDimensions(
             const std::vector<sp<ConditionTracker>>& allConditions) const {
         if (mSliced) {
@@ -72,11 +76,12 @@ public:
     void getTrueSlicedDimensions(
             const std::vector<sp<ConditionTracker>>& allConditions,
             std::set<HashableDimensionKey>* dimensions) const override {
-        for (const auto& itr : mSlicedConditionState) {
-            if (itr.second > 0) {
-                dimensions->insert(itr.first);
-            }
-        }
+        mSlicedConditionState.forEach(
+                [dimensions](const HashableDimensionKey& key, int startedCount) {
+                    if (startedCount > 0) {
+                        dimensions->insert(key);
+                    }
+                });
     }
 
     bool IsChangedDimensionTrackable() const  override { return true; }
@@ -114,7 +119,7 @@ private:
 
     int mDimensionTag;
 
-    std::map<HashableDimensionKey, int> mSlicedConditionState;
+    SlicedConditionState mSlicedConditionState;
 
     void handleStopAll(std::vector<ConditionState>& conditionCache,
                        std::vector<bool>& changedCache);
@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "HashableDimensionKey.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * Started counts of the slices of a sliced SimpleConditionTracker.
+ *
+ * Each dimension key is interned once into a slot. The started counts live in a dense array
+ * indexed by slot, so looking up a slice is a single hash probe and walking all slices touches
+ * contiguous memory. The number of slices whose count is positive is maintained incrementally,
+ * so "is any slice true" does not need to scan the slices at all. Slots of erased slices are
+ * recycled.
+ *
+ * This class is *NOT* thread safe. Caller is responsible for thread safety.
+ */
+class SlicedConditionState {
+public:
+    static const int kNoSlot = -1;
+
+    // Returns the slot of key, or kNoSlot if the key has not been seen.
+    int find(const HashableDimensionKey& key) const {
+        const auto it = mSlots.find(key);
+        return it == mSlots.end() ? kNoSlot : it->second;
+    }
+
+    // Adds a new slice and returns its slot. The key must not already be present.
+    int insert(const HashableDimensionKey& key, int startedCount) {
+        int slot;
+        if (mFreeSlots.empty()) {
+            slot = mKeys.size();
+            mKeys.push_back(key);
+            mStartedCounts.push_back(0);
+        } else {
+            slot = mFreeSlots.back();
+            mFreeSlots.pop_back();
+            mKeys[slot] = key;
+            mStartedCounts[slot] = 0;
+        }
+        mSlots[key] = slot;
+        setStartedCount(slot, startedCount);
+        return slot;
+    }
+
+    void erase(int slot) {
+        setStartedCount(slot, 0);
+        mSlots.erase(mKeys[slot]);
+        mKeys[slot] = HashableDimensionKey();
+        mStartedCounts[slot] = kFreeSlotCount;
+        mFreeSlots.push_back(slot);
+    }
+
+    void clear() {
+        mSlots.clear();
+        mKeys.clear();
+        mStartedCounts.clear();
+        mFreeSlots.clear();
+        mTrueSliceCount = 0;
+    }
+
+    inline const HashableDimensionKey& key(int slot) const {
+        return mKeys[slot];
+    }
+
+    inline int startedCount(int slot) const {
+        return mStartedCounts[slot];
+    }
+
+    void setStartedCount(int slot, int startedCount) {
+        const bool wasTrue = mStartedCounts[slot] > 0;
+        const bool isTrue = startedCount > 0;
+        mStartedCounts[slot] = startedCount;
+        if (wasTrue != isTrue) {
+            mTrueSliceCount += isTrue ? 1 : -1;
+        }
+    }
+
+    // Returns true if at least one slice has a positive started count.
+    inline bool anyTrue() const {
+        return mTrueSliceCount > 0;
+    }
+
+    inline size_t size() const {
+        return mSlots.size();
+    }
+
+    inline bool empty() const {
+        return mSlots.empty();
+    }
+
+    // Calls f(key, startedCount) for every live slice, in slot order.
+    template <typename F>
+    void forEach(F f) const {
+        for (size_t slot = 0; slot < mStartedCounts.size(); slot++) {
+            if (mStartedCounts[slot] != kFreeSlotCount) {
+                f(mKeys[slot], mStartedCounts[slot]);
+            }
+        }
+    }
+
+private:
+    // Marks a recycled slot in mStartedCounts. Started counts are never negative otherwise.
+    static const int kFreeSlotCount = -1;
+
+    std::unordered_map<HashableDimensionKey, int> mSlots;
+
+    std::vector<HashableDimensionKey> mKeys;
+
+    std::vector<int> mStartedCounts;
+
+    std::vector<int> mFreeSlots;
+
+    int mTrueSliceCount = 0;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
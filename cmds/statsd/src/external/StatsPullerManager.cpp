@@ -24,7 +24,9 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <thread>
 
 #include "../StatsService.h"
 #include "../logd/LogEvent.h"
@@ -88,6 +90,7 @@ StatsPullerManager::StatsPullerManager()
               {{.atomTag = util::TRAIN_INFO, .uid = AID_STATSD}, new TrainInfoPuller()},
       }),
       mNextPullTimeNs(NO_ALARM_UPDATE),
+      mPullCoalesceToleranceNs(kDefaultPullCoalesceToleranceNs),
       mPullAtomCallbackDeathRecipient(AIBinder_DeathRecipient_new(pullAtomCallbackDied)) {
 }
 
@@ -106,6 +109,37 @@ bool StatsPullerManager::Pull(int tagId, const vector<int32_t>& uids, const int6
 bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
                                     const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
                                     bool useUids) {
+    VLOG("Initiating pulling %d", tagId);
+    sp<StatsPuller> puller = findPullerLocked(tagId, configKey, useUids);
+    if (puller == nullptr) {
+        return false;
+    }
+    bool ret = puller->Pull(eventTimeNs, data);
+    VLOG("pulled %zu items", data->size());
+    if (!ret) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    return ret;
+}
+
+bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
+                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
+                                    bool useUids) {
+    VLOG("Initiating pulling %d", tagId);
+    sp<StatsPuller> puller = findPullerLocked(tagId, uids, useUids);
+    if (puller == nullptr) {
+        return false;
+    }
+    bool ret = puller->Pull(eventTimeNs, data);
+    VLOG("pulled %zu items", data->size());
+    if (!ret) {
+        StatsdStats::getInstance().notePullFailed(tagId);
+    }
+    return ret;
+}
+
+sp<StatsPuller> StatsPullerManager::findPullerLocked(int tagId, const ConfigKey& configKey,
+                                                     bool useUids) {
     vector<int32_t> uids;
     if (useUids) {
         auto uidProviderIt = mPullUidProviders.find(configKey);
@@ -113,53 +147,41 @@ bool StatsPullerManager::PullLocked(int tagId, const ConfigKey& configKey,
             ALOGE("Error pulling tag %d. No pull uid provider for config key %s", tagId,
                   configKey.ToString().c_str());
             StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-            return false;
+            return nullptr;
         }
         sp<PullUidProvider> pullUidProvider = uidProviderIt->second.promote();
         if (pullUidProvider == nullptr) {
             ALOGE("Error pulling tag %d, pull uid provider for config %s is gone.", tagId,
                   configKey.ToString().c_str());
             StatsdStats::getInstance().notePullUidProviderNotFound(tagId);
-            return false;
+            return nullptr;
         }
         uids = pullUidProvider->getPullAtomUids(tagId);
     }
-    return PullLocked(tagId, uids, eventTimeNs, data, useUids);
+    return findPullerLocked(tagId, uids, useUids);
 }
 
-bool StatsPullerManager::PullLocked(int tagId, const vector<int32_t>& uids,
-                                    const int64_t eventTimeNs, vector<shared_ptr<LogEvent>>* data,
-                                    bool useUids) {
-    VLOG("Initiating pulling %d", tagId);
+sp<StatsPuller> StatsPullerManager::findPullerLocked(int tagId, const vector<int32_t>& uids,
+                                                     bool useUids) {
     if (useUids) {
         for (int32_t uid : uids) {
             PullerKey key = {.atomTag = tagId, .uid = uid};
             auto pullerIt = kAllPullAtomInfo.find(key);
             if (pullerIt != kAllPullAtomInfo.end()) {
-                bool ret = pullerIt->second->Pull(eventTimeNs, data);
-                VLOG("pulled %zu items", data->size());
-                if (!ret) {
-                    StatsdStats::getInstance().notePullFailed(tagId);
-                }
-                return ret;
+                return pullerIt->second;
             }
         }
         StatsdStats::getInstance().notePullerNotFound(tagId);
         ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-        return false;  // Return early since we don't know what to pull.
+        return nullptr;  // Return early since we don't know what to pull.
     } else {
         PullerKey key = {.atomTag = tagId, .uid = -1};
         auto pullerIt = kAllPullAtomInfo.find(key);
         if (pullerIt != kAllPullAtomInfo.end()) {
-            bool ret = pullerIt->second->Pull(eventTimeNs, data);
-            VLOG("pulled %zu items", data->size());
-            if (!ret) {
-                StatsdStats::getInstance().notePullFailed(tagId);
-            }
-            return ret;
+            return pullerIt->second;
         }
         ALOGW("StatsPullerManager: Unknown tagId %d", tagId);
-        return false;  // Return early since we don't know what to pull.
+        return nullptr;  // Return early since we don't know what to pull.
     }
 }
 
@@ -197,6 +219,23 @@ void StatsPullerManager::SetStatsCompanionService(
     }
 }
 
+void StatsPullerManager::SetPullCoalesceToleranceNs(int64_t toleranceNs) {
+    std::lock_guard<std::mutex> _l(mLock);
+    mPullCoalesceToleranceNs = std::max<int64_t>(toleranceNs, 0);
+}
+
+int64_t StatsPullerManager::coalescePullTimesLocked(vector<int64_t>& nextPullTimesNs) const {
+    if (nextPullTimesNs.empty()) {
+        return NO_ALARM_UPDATE;
+    }
+    std::sort(nextPullTimesNs.begin(), nextPullTimesNs.end());
+    // Only extend the window from the earliest pull time, so that no pull is ever postponed by
+    // more than the tolerance.
+    const int64_t latestAllowedNs = nextPullTimesNs.front() + mPullCoalesceToleranceNs;
+    auto it = std::upper_bound(nextPullTimesNs.begin(), nextPullTimesNs.end(), latestAllowedNs);
+    return *(it - 1);
+}
+
 void StatsPullerManager::RegisterReceiver(int tagId, const ConfigKey& configKey,
                                           wp<PullDataReceiver> receiver, int64_t nextPullTimeNs,
                                           int64_t intervalNs) {
@@ -225,9 +264,17 @@ void StatsPullerManager::RegisterReceiver(int tagId, const ConfigKey& configKey,
     receivers.push_back(receiverInfo);
 
     // There is only one alarm for all pulled events. So only set it to the smallest denom.
-    if (nextPullTimeNs < mNextPullTimeNs) {
-        VLOG("Updating next pull time %lld", (long long)mNextPullTimeNs);
-        mNextPullTimeNs = nextPullTimeNs;
+    // Pulls due within the coalesce tolerance after it share the alarm.
+    vector<int64_t> nextPullTimesNs;
+    for (const auto& pair : mReceivers) {
+        for (const ReceiverInfo& info : pair.second) {
+            nextPullTimesNs.push_back(info.nextPullTimeNs);
+        }
+    }
+    const int64_t alarmTimeNs = coalescePullTimesLocked(nextPullTimesNs);
+    if (alarmTimeNs != mNextPullTimeNs) {
+        VLOG("Updating next pull time %lld", (long long)alarmTimeNs);
+        mNextPullTimeNs = alarmTimeNs;
         updateAlarmLocked();
     }
     VLOG("Puller for tagId %d registered of %d", tagId, (int)receivers.size());
@@ -267,34 +314,77 @@ void StatsPullerManager::UnregisterPullUidProvider(const ConfigKey& configKey,
 }
 
 void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
-    std::lock_guard<std::mutex> _l(mLock);
+    // Alarms are handled one at a time, so that the receivers that are due are pulled once.
+    std::lock_guard<std::mutex> alarmLock(mAlarmLock);
     int64_t wallClockNs = getWallClockNs();
 
-    int64_t minNextPullTimeNs = NO_ALARM_UPDATE;
-
-    vector<pair<const ReceiverKey*, vector<ReceiverInfo*>>> needToPull;
-    for (auto& pair : mReceivers) {
-        vector<ReceiverInfo*> receivers;
-        if (pair.second.size() != 0) {
-            for (ReceiverInfo& receiverInfo : pair.second) {
-                if (receiverInfo.nextPullTimeNs <= elapsedTimeNs) {
-                    receivers.push_back(&receiverInfo);
-                } else {
-                    if (receiverInfo.nextPullTimeNs < minNextPullTimeNs) {
-                        minNextPullTimeNs = receiverInfo.nextPullTimeNs;
+    // Configs pulling the same atom usually resolve to the same puller. Pull each puller once and
+    // fan the data out to every receiver of it.
+    struct PullTask {
+        sp<StatsPuller> puller;
+        int tagId;
+        vector<shared_ptr<LogEvent>> data;
+        bool success = false;
+    };
+    vector<PullTask> tasks;
+    // The receiver keys with receivers that are due, and the index of the task pulling for them,
+    // or -1 if there is no puller for them.
+    vector<pair<ReceiverKey, int>> needToPull;
+    {
+        std::lock_guard<std::mutex> _l(mLock);
+        for (const auto& pair : mReceivers) {
+            bool due = false;
+            for (const ReceiverInfo& receiverInfo : pair.second) {
+                due |= receiverInfo.nextPullTimeNs <= elapsedTimeNs;
+            }
+            if (!due) {
+                continue;
+            }
+
+            int taskIndex = -1;
+            sp<StatsPuller> puller = findPullerLocked(pair.first.atomTag, pair.first.configKey,
+                                                      /*useUids=*/true);
+            if (puller != nullptr) {
+                for (size_t j = 0; j < tasks.size(); j++) {
+                    if (tasks[j].puller == puller) {
+                        taskIndex = j;
+                        break;
                     }
                 }
+                if (taskIndex < 0) {
+                    taskIndex = tasks.size();
+                    tasks.push_back({.puller = puller, .tagId = pair.first.atomTag});
+                }
             }
-            if (receivers.size() > 0) {
-                needToPull.push_back(make_pair(&pair.first, receivers));
-            }
+            needToPull.push_back(make_pair(pair.first, taskIndex));
         }
     }
-    for (const auto& pullInfo : needToPull) {
-        vector<shared_ptr<LogEvent>> data;
-        bool pullSuccess = PullLocked(pullInfo.first->atomTag, pullInfo.first->configKey,
-                                      elapsedTimeNs, &data);
-        if (!pullSuccess) {
+
+    // The pulls run without holding mLock, so that slow pullers do not block on-demand pulls and
+    // receiver registration. Different pullers are independent, so up to kMaxConcurrentPulls of
+    // them run at once. Each StatsPuller serializes its own pulls and cache.
+    std::atomic<size_t> nextTask(0);
+    auto runTasks = [&tasks, &nextTask, elapsedTimeNs]() {
+        for (size_t i = nextTask++; i < tasks.size(); i = nextTask++) {
+            PullTask& task = tasks[i];
+            VLOG("Initiating pulling %d", task.tagId);
+            task.success = task.puller->Pull(elapsedTimeNs, &task.data);
+            VLOG("pulled %zu items", task.data.size());
+        }
+    };
+    const size_t maxConcurrentPulls = kMaxConcurrentPulls;
+    vector<std::thread> workers;
+    for (size_t i = 1; i < std::min(tasks.size(), maxConcurrentPulls); i++) {
+        workers.emplace_back(runTasks);
+    }
+    runTasks();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+
+    for (PullTask& task : tasks) {
+        if (!task.success) {
+            StatsdStats::getInstance().notePullFailed(task.tagId);
             VLOG("pull failed at %lld, will try again later", (long long)elapsedTimeNs);
         }
 
@@ -305,28 +395,50 @@ void StatsPullerManager::OnAlarmFired(int64_t elapsedTimeNs) {
         // Here the triggering event is alarm fired from AlarmManager.
         // In ValueMetricProducer and GaugeMetricProducer we do same thing
         // when pull on condition change, etc.
-        for (auto& event : data) {
+        for (auto& event : task.data) {
             event->setElapsedTimestampNs(elapsedTimeNs);
             event->setLogdWallClockTimestampNs(wallClockNs);
         }
+    }
 
-        for (const auto& receiverInfo : pullInfo.second) {
-            sp<PullDataReceiver> receiverPtr = receiverInfo->receiver.promote();
+    std::lock_guard<std::mutex> _l(mLock);
+    static const vector<shared_ptr<LogEvent>> kNoData;
+    for (const auto& keyAndTask : needToPull) {
+        // The receivers may have changed while pulling. Only the ones still registered get data.
+        auto receiversIt = mReceivers.find(keyAndTask.first);
+        if (receiversIt == mReceivers.end()) {
+            continue;
+        }
+        const PullTask* task = keyAndTask.second >= 0 ? &tasks[keyAndTask.second] : nullptr;
+        const vector<shared_ptr<LogEvent>>& data = task != nullptr ? task->data : kNoData;
+        const bool pullSuccess = task != nullptr && task->success;
+        for (ReceiverInfo& receiverInfo : receiversIt->second) {
+            if (receiverInfo.nextPullTimeNs > elapsedTimeNs) {
+                continue;
+            }
+            sp<PullDataReceiver> receiverPtr = receiverInfo.receiver.promote();
             if (receiverPtr != nullptr) {
                 receiverPtr->onDataPulled(data, pullSuccess, elapsedTimeNs);
                 // We may have just come out of a coma, compute next pull time.
                 int numBucketsAhead =
-                        (elapsedTimeNs - receiverInfo->nextPullTimeNs) / receiverInfo->intervalNs;
-                receiverInfo->nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo->intervalNs;
-                if (receiverInfo->nextPullTimeNs < minNextPullTimeNs) {
-                    minNextPullTimeNs = receiverInfo->nextPullTimeNs;
-                }
+                        (elapsedTimeNs - receiverInfo.nextPullTimeNs) / receiverInfo.intervalNs;
+                receiverInfo.nextPullTimeNs += (numBucketsAhead + 1) * receiverInfo.intervalNs;
             } else {
                 VLOG("receiver already gone.");
             }
         }
     }
 
+    // Receivers that are gone keep their past pull time, and are left out of the next alarm.
+    vector<int64_t> nextPullTimesNs;
+    for (const auto& pair : mReceivers) {
+        for (const ReceiverInfo& receiverInfo : pair.second) {
+            if (receiverInfo.nextPullTimeNs > elapsedTimeNs) {
+                nextPullTimesNs.push_back(receiverInfo.nextPullTimeNs);
+            }
+        }
+    }
+    const int64_t minNextPullTimeNs = coalescePullTimesLocked(nextPullTimesNs);
     VLOG("mNextPullTimeNs: %lld updated to %lld", (long long)mNextPullTimeNs,
          (long long)minNextPullTimeNs);
     mNextPullTimeNs = minNextPullTimeNs;
@@ -116,6 +116,12 @@ public:
 
     void SetStatsCompanionService(shared_ptr<IStatsCompanionService> statsCompanionService);
 
+    // Sets how long a scheduled pull may be postponed so that it is served by the same alarm, and
+    // the same pull, as other receivers that are due shortly after it. Pulls are only ever
+    // delayed, never run ahead of their bucket boundary, so that metrics still snap the data to
+    // the right bucket. Coalescing is off (0) unless it is set.
+    void SetPullCoalesceToleranceNs(int64_t toleranceNs);
+
     void RegisterPullAtomCallback(const int uid, const int32_t atomTag, const int64_t coolDownNs,
                                   const int64_t timeoutNs, const vector<int32_t>& additiveFields,
                                   const shared_ptr<IPullAtomCallback>& callback,
@@ -128,6 +134,9 @@ public:
 private:
     const static int64_t kMinCoolDownNs = NS_PER_SEC;
     const static int64_t kMaxTimeoutNs = 10 * NS_PER_SEC;
+    const static int64_t kDefaultPullCoalesceToleranceNs = 0;
+    // Max number of distinct pullers that are pulled concurrently when an alarm fires.
+    const static size_t kMaxConcurrentPulls = 4;
     shared_ptr<IStatsCompanionService> mStatsCompanionService = nullptr;
 
     // A struct containing an atom id and a Config Key
@@ -158,13 +167,28 @@ private:
     bool PullLocked(int tagId, const vector<int32_t>& uids, const int64_t eventTimeNs,
                     vector<std::shared_ptr<LogEvent>>* data, bool useUids);
 
+    // Returns the puller that serves tagId for the config, or nullptr if there is none.
+    sp<StatsPuller> findPullerLocked(int tagId, const ConfigKey& configKey, bool useUids);
+
+    // Returns the puller that serves tagId for the first matching uid, or nullptr if there is none.
+    sp<StatsPuller> findPullerLocked(int tagId, const vector<int32_t>& uids, bool useUids);
+
     // locks for data receiver and StatsCompanionService changes
     std::mutex mLock;
 
+    // Serializes OnAlarmFired, which releases mLock while it pulls.
+    std::mutex mAlarmLock;
+
     void updateAlarmLocked();
 
+    // Returns the time for the next alarm given the pull times of all pending receivers. This is
+    // the latest pull time that is within the coalesce tolerance of the earliest one.
+    int64_t coalescePullTimesLocked(vector<int64_t>& nextPullTimesNs) const;
+
     int64_t mNextPullTimeNs;
 
+    int64_t mPullCoalesceToleranceNs;
+
     // Death recipient that is triggered when the process holding the IPullAtomCallback has died.
     ::ndk::ScopedAIBinder_DeathRecipient mPullAtomCallbackDeathRecipient;
 
@@ -183,6 +207,7 @@ private:
     FRIEND_TEST(ValueMetricE2eTest, TestPulledEvents_WithActivation);
 
     FRIEND_TEST(StatsLogProcessorTest, TestPullUidProviderSetOnConfigUpdate);
+    FRIEND_TEST(StatsPullerManagerTest, TestAlarmCoalescesPullsWithinTolerance);
 };
 
 }  // namespace statsd
@@ -420,6 +420,12 @@ void StatsdStats::notePullTime(int pullAtomId, int64_t pullTimeNs) {
     pullStats.avgPullTimeNs = (pullStats.avgPullTimeNs * pullStats.numPullTime + pullTimeNs) /
                               (pullStats.numPullTime + 1);
     pullStats.numPullTime += 1;
+    const int64_t pullTimeMillis = pullTimeNs / 1000000;
+    int bucket = 0;
+    while (bucket < kNumPullTimeHistogramBuckets - 1 && pullTimeMillis >= (1LL << bucket)) {
+        bucket++;
+    }
+    pullStats.pullTimeHistogram[bucket]++;
 }
 
 void StatsdStats::notePullDelay(int pullAtomId, int64_t pullDelayNs) {
@@ -644,6 +650,7 @@ void StatsdStats::resetInternalLocked() {
         pullStats.second.atomErrorCount = 0;
         pullStats.second.binderCallFailCount = 0;
         pullStats.second.pullTimeoutMetadata.clear();
+        pullStats.second.pullTimeHistogram.fill(0);
     }
     mAtomMetricStats.clear();
     mActivationBroadcastGuardrailStats.clear();
@@ -814,6 +821,15 @@ void StatsdStats::dumpStats(int out) const {
             dprintf(out, "%s", uptimeMillis.c_str());
             dprintf(out, "%s", pullTimeoutMillis.c_str());
         }
+        if (pair.second.numPullTime > 0) {
+            string histogram = "  (pull time histogram, <2^i millis) ";
+            for (long count : pair.second.pullTimeHistogram) {
+                histogram.append(to_string(count)).append(",");
+            }
+            histogram.pop_back();
+            histogram.push_back('\n');
+            dprintf(out, "%s", histogram.c_str());
+        }
     }
 
     if (mAnomalyAlarmRegisteredStats > 0) {
@@ -19,6 +19,7 @@
 
 #include <gtest/gtest_prod.h>
 #include <log/log_time.h>
+#include <array>
 #include <list>
 #include <mutex>
 #include <string>
@@ -120,6 +121,10 @@ public:
 
     const static int kMaxPullAtomPackages = 100;
 
+    // Number of buckets of the per-atom pull time histogram. Bucket i counts the pulls that took
+    // less than 2^i milliseconds, and the last bucket counts everything slower than that.
+    const static int kNumPullTimeHistogramBuckets = 16;
+
     // Max memory allowed for storing metrics per configuration. If this limit is exceeded, statsd
     // drops the metrics data in memory.
     static const size_t kMaxMetricsBytesPerConfig = 2 * 1024 * 1024;
@@ -528,6 +533,7 @@ public:
         int32_t atomErrorCount = 0;
         long binderCallFailCount = 0;
         std::list<PullTimeoutMetadata> pullTimeoutMetadata;
+        std::array<long, kNumPullTimeHistogramBuckets> pullTimeHistogram = {};
     } PulledAtomStats;
 
     typedef struct {
@@ -19,7 +19,9 @@
 
 #include "StatsService.h"
 #include "socket/StatsSocketListener.h"
+#include "storage/StorageManager.h"
 
+#include <android-base/properties.h>
 #include <android/binder_interface_utils.h>
 #include <android/binder_process.h>
 #include <android/binder_manager.h>
@@ -75,11 +77,16 @@ int main(int /*argc*/, char** /*argv*/) {
     ABinderProcess_setThreadPoolMaxThreadCount(9);
     ABinderProcess_startThreadPool();
 
+    StorageManager::setReportRecordsEnabled(
+            android::base::GetBoolProperty("persist.statsd.report_records", false));
+
     std::shared_ptr<LogEventQueue> eventQueue =
             std::make_shared<LogEventQueue>(2000 /*buffer limit. Buffer is NOT pre-allocated*/);
 
     // Create the service
     gStatsService = SharedRefBase::make<StatsService>(looper, eventQueue);
+    gStatsService->setPullCoalesceToleranceMillis(
+            android::base::GetIntProperty<int64_t>("persist.statsd.pull_coalesce_tolerance_ms", 0));
     // TODO(b/149582373): Set DUMP_FLAG_PROTO once libbinder_ndk supports
     // setting dumpsys priorities.
     binder_status_t status = AServiceManager_addService(gStatsService->asBinder().get(), "stats");
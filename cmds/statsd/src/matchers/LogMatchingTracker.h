@@ -62,6 +62,14 @@ public:
                             const std::vector<sp<LogMatchingTracker>>& allTrackers,
                             std::vector<MatchingState>& matcherResults) = 0;
 
+    // Called when the app with apk name and uid has been installed, upgraded or removed.
+    virtual void onAppChanged(const std::string& apk, const int uid) {
+    }
+
+    // Called when a new snapshot of the uid map has been received.
+    virtual void onUidMapReceived() {
+    }
+
     // Get the tagIds that this matcher cares about. The combined collection is stored
     // in MetricMananger, so that we can pass any LogEvents that are not interest of us. It uses
     // some memory but hopefully it can save us much CPU time when there is flood of events.
@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#define DEBUG false  // STOPSHIP if true
+#include "Log.h"
+
+#include "matchers/PackageUidIndex.h"
+
+using std::set;
+using std::string;
+
+namespace android {
+namespace os {
+namespace statsd {
+
+void PackageUidIndex::addNamesFromMatcher(const SimpleAtomMatcher& matcher) {
+    for (const FieldValueMatcher& fieldValueMatcher : matcher.field_value_matcher()) {
+        addNamesFromMatcher(fieldValueMatcher);
+    }
+}
+
+void PackageUidIndex::addNamesFromMatcher(const FieldValueMatcher& matcher) {
+    switch (matcher.value_matcher_case()) {
+        case FieldValueMatcher::ValueMatcherCase::kMatchesTuple:
+            for (const auto& subMatcher : matcher.matches_tuple().field_value_matcher()) {
+                addNamesFromMatcher(subMatcher);
+            }
+            break;
+        case FieldValueMatcher::ValueMatcherCase::kEqString:
+            addName(matcher.eq_string());
+            break;
+        case FieldValueMatcher::ValueMatcherCase::kEqAnyString:
+            for (const string& name : matcher.eq_any_string().str_value()) {
+                addName(name);
+            }
+            break;
+        case FieldValueMatcher::ValueMatcherCase::kNeqAnyString:
+            for (const string& name : matcher.neq_any_string().str_value()) {
+                addName(name);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void PackageUidIndex::addName(const string& name) {
+    if (mNameToUids.find(name) != mNameToUids.end()) {
+        return;
+    }
+    Uids& entry = mNameToUids[name];
+    auto aidIt = UidMap::sAidToUidMapping.find(name);
+    if (aidIt != UidMap::sAidToUidMapping.end()) {
+        entry.isAid = true;
+        entry.uids.insert(aidIt->second);
+    }
+}
+
+void PackageUidIndex::rebuild(const UidMap& uidMap) {
+    for (auto& it : mNameToUids) {
+        if (it.second.isAid) {
+            continue;
+        }
+        const set<int32_t> uids = uidMap.getAppUidsFromNormalizedName(it.first);
+        it.second.uids = std::unordered_set<int32_t>(uids.begin(), uids.end());
+    }
+    VLOG("Rebuilt uids of %zu package names", mNameToUids.size());
+}
+
+void PackageUidIndex::onAppChanged(const UidMap& uidMap, const string& apk, int uid) {
+    auto it = mNameToUids.find(UidMap::normalizeAppName(apk));
+    if (it == mNameToUids.end() || it->second.isAid) {
+        return;
+    }
+    // The uid may still belong to the name through another package, e.g. after the removal of
+    // one of two packages whose names only differ in case. Ask the uid map for the final answer.
+    const set<string> names = uidMap.getAppNamesFromUid(uid, true /* normalize */);
+    if (names.find(it->first) != names.end()) {
+        it->second.uids.insert(uid);
+    } else {
+        it->second.uids.erase(uid);
+    }
+}
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
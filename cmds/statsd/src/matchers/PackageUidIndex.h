@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
+#include "packages/UidMap.h"
+
+namespace android {
+namespace os {
+namespace statsd {
+
+/**
+ * The uids of the package names that a SimpleAtomMatcher compares uid fields against.
+ *
+ * The names are collected once when the matcher is created, and the uids of each name are kept
+ * up to date from UidMap's package change notifications. Matching a uid field against a name is
+ * then a hash probe on integers, without taking the UidMap lock or building any strings.
+ *
+ * This class is *NOT* thread safe. Caller is responsible for thread safety.
+ */
+class PackageUidIndex {
+public:
+    // Collects the strings of all eq_string, eq_any_string and neq_any_string matchers.
+    void addNamesFromMatcher(const SimpleAtomMatcher& matcher);
+
+    // Recomputes the uids of every name from the current uid map snapshot.
+    void rebuild(const UidMap& uidMap);
+
+    // Updates the uids of the name of apk after apk was installed, upgraded or removed.
+    void onAppChanged(const UidMap& uidMap, const std::string& apk, int uid);
+
+    // Returns the uids that name maps to, or nullptr if name is not in this index.
+    inline const std::unordered_set<int32_t>* findUids(const std::string& name) const {
+        const auto it = mNameToUids.find(name);
+        return it == mNameToUids.end() ? nullptr : &it->second.uids;
+    }
+
+    inline bool empty() const {
+        return mNameToUids.empty();
+    }
+
+private:
+    void addNamesFromMatcher(const FieldValueMatcher& matcher);
+
+    void addName(const std::string& name);
+
+    struct Uids {
+        // AID names, such as AID_SYSTEM, always map to their fixed uid and are never updated.
+        bool isAid = false;
+        std::unordered_set<int32_t> uids;
+    };
+
+    // Keyed by the name as written in the matcher. Package names are matched after being
+    // normalized by the UidMap, so a name that is not in normalized form never has any uids.
+    std::unordered_map<std::string, Uids> mNameToUids;
+};
+
+}  // namespace statsd
+}  // namespace os
+}  // namespace android
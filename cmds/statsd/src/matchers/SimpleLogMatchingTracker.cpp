@@ -23,6 +23,7 @@ namespace android {
 namespace os {
 namespace statsd {
 
+using std::string;
 using std::unordered_map;
 using std::vector;
 
@@ -37,6 +38,10 @@ SimpleLogMatchingTracker::SimpleLogMatchingTracker(const int64_t& id, const int
         mAtomIds.insert(matcher.atom_id());
         mInitialized = true;
     }
+    mPackageUids.addNamesFromMatcher(matcher);
+    if (!mPackageUids.empty()) {
+        mPackageUids.rebuild(uidMap);
+    }
 }
 
 SimpleLogMatchingTracker::~SimpleLogMatchingTracker() {
@@ -63,11 +68,23 @@ void SimpleLogMatchingTracker::onLogEvent(const LogEvent& event,
         return;
     }
 
-    bool matched = matchesSimple(mUidMap, mMatcher, event);
+    bool matched = matchesSimple(mUidMap, mMatcher, event, &mPackageUids);
     matcherResults[mIndex] = matched ? MatchingState::kMatched : MatchingState::kNotMatched;
     VLOG("Stats SimpleLogMatcher %lld matched? %d", (long long)mId, matched);
 }
 
+void SimpleLogMatchingTracker::onAppChanged(const string& apk, const int uid) {
+    if (!mPackageUids.empty()) {
+        mPackageUids.onAppChanged(mUidMap, apk, uid);
+    }
+}
+
+void SimpleLogMatchingTracker::onUidMapReceived() {
+    if (!mPackageUids.empty()) {
+        mPackageUids.rebuild(mUidMap);
+    }
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
@@ -20,6 +20,7 @@
 #include <unordered_map>
 #include <vector>
 #include "LogMatchingTracker.h"
+#include "PackageUidIndex.h"
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
 #include "packages/UidMap.h"
 
@@ -44,9 +45,17 @@ public:
                     const std::vector<sp<LogMatchingTracker>>& allTrackers,
                     std::vector<MatchingState>& matcherResults) override;
 
+    void onAppChanged(const std::string& apk, const int uid) override;
+
+    void onUidMapReceived() override;
+
 private:
     const SimpleAtomMatcher mMatcher;
     const UidMap& mUidMap;
+
+    // Uids of the package names used in mMatcher, so that matching a uid field does not need to
+    // look up the package names of the uid in mUidMap for every event.
+    PackageUidIndex mPackageUids;
 };
 
 }  // namespace statsd
@@ -81,9 +81,16 @@ bool combinationMatch(const vector<int>& children, const LogicalOperation& opera
     return matched;
 }
 
-bool tryMatchString(const UidMap& uidMap, const FieldValue& fieldValue, const string& str_match) {
+bool tryMatchString(const UidMap& uidMap, const PackageUidIndex* packageUids,
+                    const FieldValue& fieldValue, const string& str_match) {
     if (isAttributionUidField(fieldValue) || isUidField(fieldValue)) {
         int uid = fieldValue.mValue.int_value;
+        if (packageUids != nullptr) {
+            const auto* uids = packageUids->findUids(str_match);
+            if (uids != nullptr) {
+                return uids->find(uid) != uids->end();
+            }
+        }
         auto aidIt = UidMap::sAidToUidMapping.find(str_match);
         if (aidIt != UidMap::sAidToUidMapping.end()) {
             return ((int)aidIt->second) == uid;
@@ -96,8 +103,9 @@ bool tryMatchString(const UidMap& uidMap, const FieldValue& fieldValue, const st
     return false;
 }
 
-bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
-                   const vector<FieldValue>& values, int start, int end, int depth) {
+bool matchesSimple(const UidMap& uidMap, const PackageUidIndex* packageUids,
+                   const FieldValueMatcher& matcher, const vector<FieldValue>& values, int start,
+                   int end, int depth) {
     if (depth > 2) {
         ALOGE("Depth > 3 not supported");
         return false;
@@ -201,8 +209,8 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
             for (const auto& range : ranges) {
                 bool matched = true;
                 for (const auto& subMatcher : matcher.matches_tuple().field_value_matcher()) {
-                    if (!matchesSimple(uidMap, subMatcher, values, range.first, range.second,
-                                       depth)) {
+                    if (!matchesSimple(uidMap, packageUids, subMatcher, values, range.first,
+                                       range.second, depth)) {
                         matched = false;
                         break;
                     }
@@ -227,7 +235,7 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
         }
         case FieldValueMatcher::ValueMatcherCase::kEqString: {
             for (int i = start; i < end; i++) {
-                if (tryMatchString(uidMap, values[i], matcher.eq_string())) {
+                if (tryMatchString(uidMap, packageUids, values[i], matcher.eq_string())) {
                     return true;
                 }
             }
@@ -238,7 +246,7 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
             for (int i = start; i < end; i++) {
                 bool notEqAll = true;
                 for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
+                    if (tryMatchString(uidMap, packageUids, values[i], str)) {
                         notEqAll = false;
                         break;
                     }
@@ -253,7 +261,7 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
             const auto& str_list = matcher.eq_any_string();
             for (int i = start; i < end; i++) {
                 for (const auto& str : str_list.str_value()) {
-                    if (tryMatchString(uidMap, values[i], str)) {
+                    if (tryMatchString(uidMap, packageUids, values[i], str)) {
                         return true;
                     }
                 }
@@ -354,13 +362,14 @@ bool matchesSimple(const UidMap& uidMap, const FieldValueMatcher& matcher,
 }
 
 bool matchesSimple(const UidMap& uidMap, const SimpleAtomMatcher& simpleMatcher,
-                   const LogEvent& event) {
+                   const LogEvent& event, const PackageUidIndex* packageUids) {
     if (event.GetTagId() != simpleMatcher.atom_id()) {
         return false;
     }
 
     for (const auto& matcher : simpleMatcher.field_value_matcher()) {
-        if (!matchesSimple(uidMap, matcher, event.getValues(), 0, event.getValues().size(), 0)) {
+        if (!matchesSimple(uidMap, packageUids, matcher, event.getValues(), 0,
+                           event.getValues().size(), 0)) {
             return false;
         }
     }
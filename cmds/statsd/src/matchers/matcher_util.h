@@ -20,6 +20,7 @@
 
 #include <vector>
 #include "frameworks/base/cmds/statsd/src/statsd_config.pb.h"
+#include "matchers/PackageUidIndex.h"
 #include "packages/UidMap.h"
 #include "stats_util.h"
 
@@ -36,8 +37,11 @@ enum MatchingState {
 bool combinationMatch(const std::vector<int>& children, const LogicalOperation& operation,
                       const std::vector<MatchingState>& matcherResults);
 
+// packageUids, if set, resolves the package names of simpleMatcher without querying uidMap. It
+// must have been built from simpleMatcher.
 bool matchesSimple(const UidMap& uidMap,
-    const SimpleAtomMatcher& simpleMatcher, const LogEvent& wrapper);
+    const SimpleAtomMatcher& simpleMatcher, const LogEvent& wrapper,
+    const PackageUidIndex* packageUids = nullptr);
 
 }  // namespace statsd
 }  // namespace os
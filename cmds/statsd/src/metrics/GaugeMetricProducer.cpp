@@ -148,6 +148,10 @@ GaugeMetricProducer::GaugeMetricProducer(
 
 GaugeMetricProducer::~GaugeMetricProducer() {
     VLOG("~GaugeMetricProducer() called");
+    unregisterPulls();
+}
+
+void GaugeMetricProducer::unregisterPulls() {
     if (mIsPulled && mSamplingType == GaugeMetric::RANDOM_ONE_SAMPLE) {
         mPullerManager->UnRegisterReceiver(mPullTagId, mConfigKey, this);
     }
@@ -69,6 +69,8 @@ public:
 
     virtual ~GaugeMetricProducer();
 
+    void unregisterPulls() override;
+
     // Handles when the pulled data arrives.
     void onDataPulled(const std::vector<std::shared_ptr<LogEvent>>& data,
                       bool pullSuccess, int64_t originalPullTimeNs) override;
@@ -212,6 +212,10 @@ public:
         prepareFirstBucketLocked();
     }
 
+    // Stops the scheduled pulls of a metric that was removed from its config. Does not take
+    // mMutex, since the puller manager holds its own lock while it delivers pulled data.
+    virtual void unregisterPulls(){};
+
     // Returns the memory in bytes currently used to store this metric's data. Does not change
     // state.
     size_t byteSize() const {
@@ -500,6 +504,7 @@ protected:
     FRIEND_TEST(ValueMetricE2eTest, TestInitialConditionChanges);
 
     FRIEND_TEST(MetricsManagerTest, TestInitialConditions);
+    FRIEND_TEST(MetricsManagerTest, TestUpdateConfigWithTrueSlicedCondition);
 };
 
 }  // namespace statsd
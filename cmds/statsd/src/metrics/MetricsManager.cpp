@@ -18,6 +18,7 @@
 
 #include "MetricsManager.h"
 
+#include <inttypes.h>
 #include <private/android_filesystem_config.h>
 
 #include "CountMetricProducer.h"
@@ -84,6 +85,11 @@ MetricsManager::MetricsManager(const ConfigKey& key, const StatsdConfig& config,
             mActivationAtomTrackerToMetricMap, mDeactivationAtomTrackerToMetricMap,
             mAlertTrackerMap, mMetricIndexesWithActivation, mNoReportMetricIds);
 
+    if (mConfigValid) {
+        mNonMetricConfigHash = computeNonMetricConfigHash(config);
+        computeMetricDefinitionHashes(config, mMetricHashes);
+    }
+
     mHashStringsInReport = config.hash_strings_in_metric_report();
     mVersionStringsInReport = config.version_strings_in_metric_report();
     mInstallerInReport = config.installer_in_metric_report();
@@ -231,6 +237,10 @@ bool MetricsManager::isConfigValid() const {
 
 void MetricsManager::notifyAppUpgrade(const int64_t& eventTimeNs, const string& apk, const int uid,
                                       const int64_t version) {
+    // Inform all matchers, so that the package names they match map to the new uids.
+    for (const auto& it : mAllAtomMatchers) {
+        it->onAppChanged(apk, uid);
+    }
     // Inform all metric producers.
     for (const auto& it : mAllMetricProducers) {
         it->notifyAppUpgrade(eventTimeNs);
@@ -252,6 +262,9 @@ void MetricsManager::notifyAppUpgrade(const int64_t& eventTimeNs, const string&
 
 void MetricsManager::notifyAppRemoved(const int64_t& eventTimeNs, const string& apk,
                                       const int uid) {
+    for (const auto& it : mAllAtomMatchers) {
+        it->onAppChanged(apk, uid);
+    }
     // Inform all metric producers.
     for (const auto& it : mAllMetricProducers) {
         it->notifyAppRemoved(eventTimeNs);
@@ -275,6 +288,9 @@ void MetricsManager::onUidMapReceived(const int64_t& eventTimeNs) {
     // Purposefully don't inform metric producers on a new snapshot
     // because we don't need to flush partial buckets.
     // This occurs if a new user is added/removed or statsd crashes.
+    for (const auto& it : mAllAtomMatchers) {
+        it->onUidMapReceived();
+    }
     initPullAtomSources();
 
     if (mAllowedPkg.size() == 0) {
@@ -296,6 +312,264 @@ void MetricsManager::init() {
     }
 }
 
+// Copies the metric indexes in "from" into "to", translated by newIndexes. Metrics whose new index
+// is negative are dropped.
+static void remapMetricIndexes(const unordered_map<int, vector<int>>& from,
+                               const vector<int>& newIndexes, unordered_map<int, vector<int>>& to) {
+    for (const auto& it : from) {
+        for (const int metricIndex : it.second) {
+            if (newIndexes[metricIndex] >= 0) {
+                to[it.first].push_back(newIndexes[metricIndex]);
+            }
+        }
+    }
+}
+
+static void remapMetricIndexes(const vector<int>& from, const vector<int>& newIndexes,
+                               vector<int>& to) {
+    for (const int metricIndex : from) {
+        if (newIndexes[metricIndex] >= 0) {
+            to.push_back(newIndexes[metricIndex]);
+        }
+    }
+}
+
+template <typename T>
+static void addChangedMetrics(const google::protobuf::RepeatedPtrField<T>& metrics,
+                              const unordered_map<int64_t, int>& reusedMetrics,
+                              google::protobuf::RepeatedPtrField<T>* changedMetrics,
+                              vector<int64_t>& metricIds) {
+    for (const T& metric : metrics) {
+        metricIds.push_back(metric.id());
+        if (reusedMetrics.find(metric.id()) == reusedMetrics.end()) {
+            *changedMetrics->Add() = metric;
+        }
+    }
+}
+
+static void unregisterStateListeners(const vector<sp<MetricProducer>>& producers) {
+    for (const auto& producer : producers) {
+        for (int atomId : producer->getSlicedStateAtoms()) {
+            StateManager::getInstance().unregisterListener(atomId, producer);
+        }
+    }
+}
+
+bool MetricsManager::updateConfig(const StatsdConfig& config, const int64_t timeBaseNs,
+                                  const int64_t currentTimeNs,
+                                  const sp<AlarmMonitor>& anomalyAlarmMonitor) {
+    if (!mConfigValid || computeNonMetricConfigHash(config) != mNonMetricConfigHash) {
+        return false;
+    }
+
+    // Matchers, conditions, states and alarms are unchanged, so the existing trackers are kept
+    // with their indexes. Metrics with an unchanged definition keep their producer.
+    unordered_map<int64_t, uint64_t> metricHashes;
+    computeMetricDefinitionHashes(config, metricHashes);
+    unordered_map<int64_t, int> reusedMetrics;  // metric id -> old index.
+    for (size_t i = 0; i < mAllMetricProducers.size(); i++) {
+        const int64_t metricId = mAllMetricProducers[i]->getMetricId();
+        const auto& oldHashIt = mMetricHashes.find(metricId);
+        const auto& newHashIt = metricHashes.find(metricId);
+        if (oldHashIt != mMetricHashes.end() && newHashIt != metricHashes.end() &&
+            oldHashIt->second == newHashIt->second) {
+            reusedMetrics[metricId] = i;
+        }
+    }
+
+    // Build producers for the new and changed metrics only. initMetrics() creates them in the
+    // same order as the metrics appear in the config, and so do we for the merged list below.
+    StatsdConfig changedConfig(config);
+    changedConfig.clear_count_metric();
+    changedConfig.clear_duration_metric();
+    changedConfig.clear_event_metric();
+    changedConfig.clear_gauge_metric();
+    changedConfig.clear_value_metric();
+    changedConfig.clear_no_report_metric();
+    vector<int64_t> metricIds;
+    addChangedMetrics(config.count_metric(), reusedMetrics,
+                      changedConfig.mutable_count_metric(), metricIds);
+    addChangedMetrics(config.duration_metric(), reusedMetrics,
+                      changedConfig.mutable_duration_metric(), metricIds);
+    addChangedMetrics(config.event_metric(), reusedMetrics,
+                      changedConfig.mutable_event_metric(), metricIds);
+    addChangedMetrics(config.gauge_metric(), reusedMetrics,
+                      changedConfig.mutable_gauge_metric(), metricIds);
+    addChangedMetrics(config.value_metric(), reusedMetrics,
+                      changedConfig.mutable_value_metric(), metricIds);
+
+    unordered_map<int64_t, int> logTrackerMap;
+    for (size_t i = 0; i < mAllAtomMatchers.size(); i++) {
+        logTrackerMap[mAllAtomMatchers[i]->getId()] = i;
+    }
+    unordered_map<int64_t, int> conditionTrackerMap;
+    for (size_t i = 0; i < mAllConditionTrackers.size(); i++) {
+        conditionTrackerMap[mAllConditionTrackers[i]->getConditionId()] = i;
+    }
+    // New metrics start from the current conditions, not from the initial ones. A sliced
+    // condition is true while any of its slices is true, as in onLogEvent().
+    vector<ConditionState> conditionCache(mAllConditionTrackers.size(),
+                                          ConditionState::kNotEvaluated);
+    for (const auto& conditionTracker : mAllConditionTrackers) {
+        conditionTracker->getOverallCondition(mAllConditionTrackers, conditionCache);
+    }
+    unordered_map<int64_t, int> stateAtomIdMap;
+    unordered_map<int64_t, unordered_map<int, int64_t>> allStateGroupMaps;
+    if (!initStates(config, stateAtomIdMap, allStateGroupMaps)) {
+        return false;
+    }
+
+    vector<sp<MetricProducer>> changedProducers;
+    unordered_map<int, vector<int>> changedConditionToMetricMap;
+    unordered_map<int, vector<int>> changedTrackerToMetricMap;
+    unordered_map<int64_t, int> changedMetricMap;
+    set<int64_t> unusedNoReportMetricIds;
+    unordered_map<int, vector<int>> changedActivationAtomTrackerToMetricMap;
+    unordered_map<int, vector<int>> changedDeactivationAtomTrackerToMetricMap;
+    vector<int> changedMetricsWithActivation;
+    if (!initMetrics(mConfigKey, changedConfig, timeBaseNs, currentTimeNs, mPullerManager,
+                     logTrackerMap, conditionTrackerMap, mAllAtomMatchers, stateAtomIdMap,
+                     allStateGroupMaps, mAllConditionTrackers, conditionCache, changedProducers,
+                     changedConditionToMetricMap, changedTrackerToMetricMap, changedMetricMap,
+                     unusedNoReportMetricIds, changedActivationAtomTrackerToMetricMap,
+                     changedDeactivationAtomTrackerToMetricMap, changedMetricsWithActivation)) {
+        ALOGE("initMetricProducers failed for config update");
+        unregisterStateListeners(changedProducers);
+        return false;
+    }
+
+    // Merge the kept and the new producers, and translate the indexes of both.
+    vector<sp<MetricProducer>> allMetricProducers;
+    allMetricProducers.reserve(metricIds.size());
+    unordered_map<int64_t, int> metricProducerMap;
+    vector<int> oldToNewIndex(mAllMetricProducers.size(), -1);
+    vector<int> changedToNewIndex(changedProducers.size(), -1);
+    for (const int64_t metricId : metricIds) {
+        const int newIndex = allMetricProducers.size();
+        metricProducerMap[metricId] = newIndex;
+        const auto& reusedIt = reusedMetrics.find(metricId);
+        if (reusedIt != reusedMetrics.end()) {
+            oldToNewIndex[reusedIt->second] = newIndex;
+            allMetricProducers.push_back(mAllMetricProducers[reusedIt->second]);
+        } else {
+            const int changedIndex = changedMetricMap[metricId];
+            changedToNewIndex[changedIndex] = newIndex;
+            allMetricProducers.push_back(changedProducers[changedIndex]);
+        }
+    }
+
+    unordered_map<int, vector<int>> conditionToMetricMap;
+    remapMetricIndexes(mConditionToMetricMap, oldToNewIndex, conditionToMetricMap);
+    remapMetricIndexes(changedConditionToMetricMap, changedToNewIndex, conditionToMetricMap);
+    unordered_map<int, vector<int>> trackerToMetricMap;
+    remapMetricIndexes(mTrackerToMetricMap, oldToNewIndex, trackerToMetricMap);
+    remapMetricIndexes(changedTrackerToMetricMap, changedToNewIndex, trackerToMetricMap);
+    unordered_map<int, vector<int>> activationAtomTrackerToMetricMap;
+    remapMetricIndexes(mActivationAtomTrackerToMetricMap, oldToNewIndex,
+                       activationAtomTrackerToMetricMap);
+    remapMetricIndexes(changedActivationAtomTrackerToMetricMap, changedToNewIndex,
+                       activationAtomTrackerToMetricMap);
+    unordered_map<int, vector<int>> deactivationAtomTrackerToMetricMap;
+    remapMetricIndexes(mDeactivationAtomTrackerToMetricMap, oldToNewIndex,
+                       deactivationAtomTrackerToMetricMap);
+    remapMetricIndexes(changedDeactivationAtomTrackerToMetricMap, changedToNewIndex,
+                       deactivationAtomTrackerToMetricMap);
+    // Keep the metrics in config order, as a full initialization would.
+    for (auto* metricMap : {&conditionToMetricMap, &trackerToMetricMap,
+                            &activationAtomTrackerToMetricMap,
+                            &deactivationAtomTrackerToMetricMap}) {
+        for (auto& it : *metricMap) {
+            std::sort(it.second.begin(), it.second.end());
+        }
+    }
+    vector<int> metricsWithActivation;
+    remapMetricIndexes(mMetricIndexesWithActivation, oldToNewIndex, metricsWithActivation);
+    remapMetricIndexes(changedMetricsWithActivation, changedToNewIndex, metricsWithActivation);
+    std::sort(metricsWithActivation.begin(), metricsWithActivation.end());
+
+    set<int64_t> noReportMetricIds;
+    for (const int64_t noReportMetric : config.no_report_metric()) {
+        if (metricProducerMap.find(noReportMetric) == metricProducerMap.end()) {
+            ALOGW("no_report_metric %" PRId64 " not exist", noReportMetric);
+            unregisterStateListeners(changedProducers);
+            return false;
+        }
+        noReportMetricIds.insert(noReportMetric);
+    }
+
+    // The alerts of a kept metric are part of its definition, so they are all kept as well.
+    unordered_map<int64_t, sp<AnomalyTracker>> reusedAnomalyTrackers;
+    for (const Alert& alert : config.alert()) {
+        const auto& alertIt = mAlertTrackerMap.find(alert.id());
+        if (reusedMetrics.find(alert.metric_id()) != reusedMetrics.end() &&
+            alertIt != mAlertTrackerMap.end()) {
+            reusedAnomalyTrackers[alert.id()] = mAllAnomalyTrackers[alertIt->second];
+        }
+    }
+    unordered_map<int64_t, int> alertTrackerMap;
+    vector<sp<AnomalyTracker>> allAnomalyTrackers;
+    if (!initAlerts(config, metricProducerMap, alertTrackerMap, anomalyAlarmMonitor,
+                    allMetricProducers, allAnomalyTrackers, reusedAnomalyTrackers)) {
+        ALOGE("initAlerts failed for config update");
+        unregisterStateListeners(changedProducers);
+        return false;
+    }
+
+    if (allMetricProducers.size() > StatsdStats::kMaxMetricCountPerConfig ||
+        allAnomalyTrackers.size() > StatsdStats::kMaxAlertCountPerConfig) {
+        ALOGE("This config is too big! Reject!");
+        unregisterStateListeners(changedProducers);
+        return false;
+    }
+
+    vector<sp<MetricProducer>> removedProducers;
+    for (size_t i = 0; i < mAllMetricProducers.size(); i++) {
+        if (oldToNewIndex[i] < 0) {
+            removedProducers.push_back(mAllMetricProducers[i]);
+            if (mNoReportMetricIds.find(mAllMetricProducers[i]->getMetricId()) ==
+                mNoReportMetricIds.end()) {
+                mRemovedMetricProducers.push_back(mAllMetricProducers[i]);
+            }
+        }
+    }
+    unregisterStateListeners(removedProducers);
+    // A removed metric is only kept for its last report, so it needs no more scheduled pulls.
+    for (const auto& producer : removedProducers) {
+        producer->unregisterPulls();
+    }
+
+    mAllMetricProducers.swap(allMetricProducers);
+    mAllAnomalyTrackers.swap(allAnomalyTrackers);
+    mConditionToMetricMap.swap(conditionToMetricMap);
+    mTrackerToMetricMap.swap(trackerToMetricMap);
+    mActivationAtomTrackerToMetricMap.swap(activationAtomTrackerToMetricMap);
+    mDeactivationAtomTrackerToMetricMap.swap(deactivationAtomTrackerToMetricMap);
+    mAlertTrackerMap.swap(alertTrackerMap);
+    mMetricIndexesWithActivation.swap(metricsWithActivation);
+    mNoReportMetricIds.swap(noReportMetricIds);
+    mMetricHashes.swap(metricHashes);
+
+    for (const auto& producer : changedProducers) {
+        producer->prepareFirstBucket();
+    }
+
+    mIsAlwaysActive = (mMetricIndexesWithActivation.size() != mAllMetricProducers.size()) ||
+            (mAllMetricProducers.size() == 0);
+    bool isActive = mIsAlwaysActive;
+    for (int metric : mMetricIndexesWithActivation) {
+        isActive |= mAllMetricProducers[metric]->isActive();
+    }
+    mIsActive = isActive;
+
+    StatsdStats::getInstance().noteConfigReceived(
+            mConfigKey, mAllMetricProducers.size(), mAllConditionTrackers.size(),
+            mAllAtomMatchers.size(), mAllAnomalyTrackers.size(), mAnnotations, mConfigValid);
+    VLOG("Updated config %s in place: kept %zu metrics, created %zu, removed %zu",
+         mConfigKey.ToString().c_str(), reusedMetrics.size(), changedProducers.size(),
+         removedProducers.size());
+    return true;
+}
+
 vector<int32_t> MetricsManager::getPullAtomUids(int32_t atomId) {
     std::lock_guard<std::mutex> lock(mAllowedLogSourcesMutex);
     vector<int32_t> uids;
@@ -369,6 +643,21 @@ void MetricsManager::onDumpReport(const int64_t dumpTimeStampNs,
     VLOG("=========================Metric Reports End==========================");
 }
 
+void MetricsManager::onDumpRemovedMetricsReport(const int64_t dumpTimeNs,
+                                                const DumpLatency dumpLatency,
+                                                std::set<string>* str_set,
+                                                ProtoOutputStream* protoOutput) {
+    for (const auto& producer : mRemovedMetricProducers) {
+        uint64_t token = protoOutput->start(
+                FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_METRICS);
+        producer->onDumpReport(dumpTimeNs, true /* include_current_partial_bucket */,
+                               true /* erase_data */, dumpLatency,
+                               mHashStringsInReport ? str_set : nullptr, protoOutput);
+        protoOutput->end(token);
+    }
+    mRemovedMetricProducers.clear();
+}
+
 
 bool MetricsManager::checkLogCredentials(const LogEvent& event) {
     if (mWhitelistedAtomIds.find(event.GetTagId()) != mWhitelistedAtomIds.end()) {
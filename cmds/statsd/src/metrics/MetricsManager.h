@@ -74,6 +74,14 @@ public:
 
     void init();
 
+    // Applies a new version of the config in place, keeping the state of every atom matcher,
+    // condition, metric and alert whose definition did not change. Only the metrics that were
+    // added or changed are created anew. This is only possible if nothing but metrics, metric
+    // activations, alerts and their subscriptions changed. Returns false if the config can't be
+    // updated in place, in which case this MetricsManager is left untouched.
+    bool updateConfig(const StatsdConfig& config, const int64_t timeBaseNs,
+                      const int64_t currentTimeNs, const sp<AlarmMonitor>& anomalyAlarmMonitor);
+
     vector<int32_t> getPullAtomUids(int32_t atomId) override;
 
     bool shouldWriteToDisk() const {
@@ -131,6 +139,16 @@ public:
                               std::set<string> *str_set,
                               android::util::ProtoOutputStream* protoOutput);
 
+    // Dumps the reported metrics that the last updateConfig() removed or replaced, with their
+    // current partial bucket, and then releases them.
+    void onDumpRemovedMetricsReport(const int64_t dumpTimeNs, const DumpLatency dumpLatency,
+                                    std::set<string>* str_set,
+                                    android::util::ProtoOutputStream* protoOutput);
+
+    inline bool hasRemovedMetrics() const {
+        return !mRemovedMetricProducers.empty();
+    }
+
     // Computes the total byte size of all metrics managed by a single config source.
     // Does not change the state.
     virtual size_t byteSize();
@@ -276,6 +294,16 @@ private:
     // The metrics that don't need to be uploaded or even reported.
     std::set<int64_t> mNoReportMetricIds;
 
+    // Hash of the parts of the config other than the metrics. See computeNonMetricConfigHash().
+    uint64_t mNonMetricConfigHash = 0;
+
+    // Definition hash of each metric, keyed by metric id. See computeMetricDefinitionHashes().
+    std::unordered_map<int64_t, uint64_t> mMetricHashes;
+
+    // The reported metrics that updateConfig() removed or replaced, and that still hold data for
+    // the next report.
+    std::vector<sp<MetricProducer>> mRemovedMetricProducers;
+
    // The config is active if any metric in the config is active.
     bool mIsActive;
 
@@ -311,6 +339,9 @@ private:
     FRIEND_TEST(MetricActivationE2eTest, TestCountMetricWithTwoMetricsTwoDeactivations);
 
     FRIEND_TEST(MetricsManagerTest, TestLogSources);
+    FRIEND_TEST(MetricsManagerTest, TestUpdateConfigPreservesUnchangedMetrics);
+    FRIEND_TEST(MetricsManagerTest, TestUpdateConfigWithTrueSlicedCondition);
+    FRIEND_TEST(MetricsManagerTest, TestUpdateConfigUnregistersRemovedPulls);
 
     FRIEND_TEST(StatsLogProcessorTest, TestActiveConfigMetricDiskWriteRead);
     FRIEND_TEST(StatsLogProcessorTest, TestActivationOnBoot);
@@ -178,6 +178,10 @@ ValueMetricProducer::ValueMetricProducer(
 
 ValueMetricProducer::~ValueMetricProducer() {
     VLOG("~ValueMetricProducer() called");
+    unregisterPulls();
+}
+
+void ValueMetricProducer::unregisterPulls() {
     if (mIsPulled) {
         mPullerManager->UnRegisterReceiver(mPullTagId, mConfigKey, this);
     }
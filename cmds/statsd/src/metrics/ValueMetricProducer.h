@@ -65,6 +65,8 @@ public:
 
     virtual ~ValueMetricProducer();
 
+    void unregisterPulls() override;
+
     // Process data pulled on bucket boundary.
     void onDataPulled(const std::vector<std::shared_ptr<LogEvent>>& data,
                       bool pullSuccess, int64_t originalPullTimeNs) override;
@@ -22,6 +22,7 @@
 #include <inttypes.h>
 
 #include "FieldValue.h"
+#include "hash.h"
 #include "MetricProducer.h"
 #include "condition/CombinationConditionTracker.h"
 #include "condition/SimpleConditionTracker.h"
@@ -38,6 +39,7 @@
 #include "stats_util.h"
 
 using std::set;
+using std::string;
 using std::unordered_map;
 using std::vector;
 
@@ -818,7 +820,8 @@ bool initAlerts(const StatsdConfig& config,
                 unordered_map<int64_t, int>& alertTrackerMap,
                 const sp<AlarmMonitor>& anomalyAlarmMonitor,
                 vector<sp<MetricProducer>>& allMetricProducers,
-                vector<sp<AnomalyTracker>>& allAnomalyTrackers) {
+                vector<sp<AnomalyTracker>>& allAnomalyTrackers,
+                const unordered_map<int64_t, sp<AnomalyTracker>>& reusedAnomalyTrackers) {
     for (int i = 0; i < config.alert_size(); i++) {
         const Alert& alert = config.alert(i);
         const auto& itr = metricProducerMap.find(alert.metric_id());
@@ -827,6 +830,12 @@ bool initAlerts(const StatsdConfig& config,
                   (long long)alert.metric_id());
             return false;
         }
+        const auto& reusedIt = reusedAnomalyTrackers.find(alert.id());
+        if (reusedIt != reusedAnomalyTrackers.end()) {
+            alertTrackerMap.insert(std::make_pair(alert.id(), allAnomalyTrackers.size()));
+            allAnomalyTrackers.push_back(reusedIt->second);
+            continue;
+        }
         if (!alert.has_trigger_if_sum_gt()) {
             ALOGW("invalid alert: missing threshold");
             return false;
@@ -848,7 +857,8 @@ bool initAlerts(const StatsdConfig& config,
     }
     for (int i = 0; i < config.subscription_size(); ++i) {
         const Subscription& subscription = config.subscription(i);
-        if (subscription.rule_type() != Subscription::ALERT) {
+        if (subscription.rule_type() != Subscription::ALERT ||
+            reusedAnomalyTrackers.find(subscription.rule_id()) != reusedAnomalyTrackers.end()) {
             continue;
         }
         if (subscription.subscriber_information_case() ==
@@ -914,6 +924,86 @@ bool initAlarms(const StatsdConfig& config, const ConfigKey& key,
     return true;
 }
 
+static void appendSerialized(const google::protobuf::MessageLite& message, string* out) {
+    const string serialized = message.SerializeAsString();
+    // Length-prefix each part, so that the concatenation of different parts cannot collide.
+    out->append(std::to_string(serialized.size()));
+    out->push_back(':');
+    out->append(serialized);
+}
+
+void computeMetricDefinitionHashes(const StatsdConfig& config,
+                                   unordered_map<int64_t, uint64_t>& metricHashes) {
+    unordered_map<int64_t, const MetricActivation*> activations;
+    for (const MetricActivation& activation : config.metric_activation()) {
+        activations[activation.metric_id()] = &activation;
+    }
+    unordered_map<int64_t, vector<const Subscription*>> alertSubscriptions;
+    for (const Subscription& subscription : config.subscription()) {
+        if (subscription.rule_type() == Subscription::ALERT) {
+            alertSubscriptions[subscription.rule_id()].push_back(&subscription);
+        }
+    }
+    unordered_map<int64_t, vector<const Alert*>> metricAlerts;
+    for (const Alert& alert : config.alert()) {
+        metricAlerts[alert.metric_id()].push_back(&alert);
+    }
+
+    auto addMetric = [&](const char type, const google::protobuf::MessageLite& metric,
+                         const int64_t metricId) {
+        string definition(1, type);
+        appendSerialized(metric, &definition);
+        const auto& activationIt = activations.find(metricId);
+        if (activationIt != activations.end()) {
+            appendSerialized(*activationIt->second, &definition);
+        }
+        const auto& alertsIt = metricAlerts.find(metricId);
+        if (alertsIt != metricAlerts.end()) {
+            for (const Alert* alert : alertsIt->second) {
+                appendSerialized(*alert, &definition);
+                for (const Subscription* subscription : alertSubscriptions[alert->id()]) {
+                    appendSerialized(*subscription, &definition);
+                }
+            }
+        }
+        metricHashes[metricId] = Hash64(definition);
+    };
+    for (const CountMetric& metric : config.count_metric()) {
+        addMetric('c', metric, metric.id());
+    }
+    for (const DurationMetric& metric : config.duration_metric()) {
+        addMetric('d', metric, metric.id());
+    }
+    for (const EventMetric& metric : config.event_metric()) {
+        addMetric('e', metric, metric.id());
+    }
+    for (const GaugeMetric& metric : config.gauge_metric()) {
+        addMetric('g', metric, metric.id());
+    }
+    for (const ValueMetric& metric : config.value_metric()) {
+        addMetric('v', metric, metric.id());
+    }
+}
+
+uint64_t computeNonMetricConfigHash(const StatsdConfig& config) {
+    StatsdConfig nonMetricConfig(config);
+    nonMetricConfig.clear_count_metric();
+    nonMetricConfig.clear_duration_metric();
+    nonMetricConfig.clear_event_metric();
+    nonMetricConfig.clear_gauge_metric();
+    nonMetricConfig.clear_value_metric();
+    nonMetricConfig.clear_metric_activation();
+    nonMetricConfig.clear_no_report_metric();
+    nonMetricConfig.clear_alert();
+    nonMetricConfig.clear_subscription();
+    for (const Subscription& subscription : config.subscription()) {
+        if (subscription.rule_type() != Subscription::ALERT) {
+            *nonMetricConfig.add_subscription() = subscription;
+        }
+    }
+    return Hash64(nonMetricConfig.SerializeAsString());
+}
+
 bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap& uidMap,
                       const sp<StatsPullerManager>& pullerManager,
                       const sp<AlarmMonitor>& anomalyAlarmMonitor,
@@ -97,11 +97,10 @@ bool initStates(const StatsdConfig& config, unordered_map<int64_t, int>& stateAt
 // [trackerToMetricMap]: contains the mapping from log tracker to MetricProducer index.
 bool initMetrics(
         const ConfigKey& key, const StatsdConfig& config, const int64_t timeBaseTimeNs,
-        const int64_t currentTimeNs, UidMap& uidMap, const sp<StatsPullerManager>& pullerManager,
+        const int64_t currentTimeNs, const sp<StatsPullerManager>& pullerManager,
         const std::unordered_map<int64_t, int>& logTrackerMap,
         const std::unordered_map<int64_t, int>& conditionTrackerMap,
-        const std::unordered_map<int, std::vector<MetricConditionLink>>& eventConditionLinks,
-        const vector<sp<LogMatchingTracker>>& allAtomMatchers,
+        const std::vector<sp<LogMatchingTracker>>& allAtomMatchers,
         const unordered_map<int64_t, int>& stateAtomIdMap,
         const unordered_map<int64_t, unordered_map<int, int64_t>>& allStateGroupMaps,
         vector<sp<ConditionTracker>>& allConditionTrackers,
@@ -109,11 +108,40 @@ bool initMetrics(
         std::vector<sp<MetricProducer>>& allMetricProducers,
         std::unordered_map<int, std::vector<int>>& conditionToMetricMap,
         std::unordered_map<int, std::vector<int>>& trackerToMetricMap,
-        std::set<int64_t>& noReportMetricIds,
+        std::unordered_map<int64_t, int>& metricMap, std::set<int64_t>& noReportMetricIds,
         std::unordered_map<int, std::vector<int>>& activationAtomTrackerToMetricMap,
         std::unordered_map<int, std::vector<int>>& deactivationAtomTrackerToMetricMap,
         std::vector<int>& metricsWithActivation);
 
+// Initialize AnomalyTrackers.
+// input:
+// [config]: the input config
+// [metricProducerMap]: metric id to index mapping
+// [reusedAnomalyTrackers]: trackers of a previous version of the config, keyed by alert id, that
+//                          are kept as is, with their subscriptions. Their metrics must already
+//                          own them.
+// output:
+// [alertTrackerMap]: alert id to index mapping
+// [allAnomalyTrackers]: stores the sp to all the AnomalyTrackers
+bool initAlerts(const StatsdConfig& config,
+                const std::unordered_map<int64_t, int>& metricProducerMap,
+                std::unordered_map<int64_t, int>& alertTrackerMap,
+                const sp<AlarmMonitor>& anomalyAlarmMonitor,
+                std::vector<sp<MetricProducer>>& allMetricProducers,
+                std::vector<sp<AnomalyTracker>>& allAnomalyTrackers,
+                const std::unordered_map<int64_t, sp<AnomalyTracker>>& reusedAnomalyTrackers = {});
+
+// Computes the definition hash of every metric in config, keyed by metric id. The hash covers the
+// metric, its activation, and the alerts on it together with their subscriptions, i.e. everything
+// that is baked into the MetricProducer when it is created.
+void computeMetricDefinitionHashes(const StatsdConfig& config,
+                                   std::unordered_map<int64_t, uint64_t>& metricHashes);
+
+// Computes the hash of everything in config that is not covered by the metric definition hashes.
+// Two configs with the same hash have the same atom matchers, predicates, states and alarms, so
+// their LogMatchingTrackers and ConditionTrackers are interchangeable, index for index.
+uint64_t computeNonMetricConfigHash(const StatsdConfig& config);
+
 // Initialize MetricsManager from StatsdConfig.
 // Parameters are the members of MetricsManager. See MetricsManager for declaration.
 bool initStatsdConfig(const ConfigKey& key, const StatsdConfig& config, UidMap& uidMap,
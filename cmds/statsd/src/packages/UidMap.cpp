@@ -81,7 +81,7 @@ bool UidMap::hasApp(int uid, const string& packageName) const {
     return it != mMap.end() && !it->second.deleted;
 }
 
-string UidMap::normalizeAppName(const string& appName) const {
+string UidMap::normalizeAppName(const string& appName) {
     string normalizedName = appName;
     std::transform(normalizedName.begin(), normalizedName.end(), normalizedName.begin(), ::tolower);
     return normalizedName;
@@ -469,6 +469,18 @@ set<int32_t> UidMap::getAppUid(const string& package) const {
     return results;
 }
 
+set<int32_t> UidMap::getAppUidsFromNormalizedName(const string& normalizedName) const {
+    lock_guard<mutex> lock(mMutex);
+
+    set<int32_t> results;
+    for (const auto& kv : mMap) {
+        if (!kv.second.deleted && normalizeAppName(kv.first.second) == normalizedName) {
+            results.insert(kv.first.first);
+        }
+    }
+    return results;
+}
+
 // Note not all the following AIDs are used as uids. Some are used only for gids.
 // It's ok to leave them in the map, but we won't ever see them in the log's uid field.
 // App's uid starts from 10000, and will not overlap with the following AIDs.
@@ -151,6 +151,12 @@ public:
 
     virtual std::set<int32_t> getAppUid(const string& package) const;
 
+    // Returns the uids of all installed packages whose normalized name is normalizedName.
+    std::set<int32_t> getAppUidsFromNormalizedName(const string& normalizedName) const;
+
+    // Package names are matched case-insensitively by converting them to lower case.
+    static string normalizeAppName(const string& appName);
+
     // Write current PackageInfoSnapshot to ProtoOutputStream.
     // interestingUids: If not empty, only write the package info for these uids. If empty, write
     //                  package info for all uids.
@@ -162,7 +168,6 @@ public:
 
 private:
     std::set<string> getAppNamesFromUidLocked(const int32_t& uid, bool returnNormalized) const;
-    string normalizeAppName(const string& appName) const;
 
     void writeUidMapSnapshotLocked(int64_t timestamp, bool includeVersionStrings,
                                    bool includeInstaller, const std::set<int32_t>& interestingUids,
@@ -19,6 +19,10 @@
 #include "ShellSubscriber.h"
 
 #include <android-base/file.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "matchers/matcher_util.h"
 #include "stats_log_util.h"
@@ -35,26 +39,43 @@ void ShellSubscriber::startNewSubscription(int in, int out, int timeoutSec) {
     int myToken = claimToken();
     VLOG("ShellSubscriber: new subscription %d has come in", myToken);
     mSubscriptionShouldEnd.notify_one();
+    mWriterWakeup.notify_all();
 
     shared_ptr<SubscriptionInfo> mySubscriptionInfo = make_shared<SubscriptionInfo>(in, out);
     if (!readConfig(mySubscriptionInfo)) return;
 
+    // The writer thread must never block indefinitely on a reader that stopped reading, or it
+    // could not notice that the subscription has ended.
+    const int outFlags = fcntl(out, F_GETFL);
+    if (outFlags == -1 || fcntl(out, F_SETFL, outFlags | O_NONBLOCK) == -1) {
+        ALOGW("ShellSubscriber: failed to make output non-blocking: %s", strerror(errno));
+    }
+
+    std::thread writer;
     {
         std::unique_lock<std::mutex> lock(mMutex);
         mSubscriptionInfo = mySubscriptionInfo;
-        spawnHelperThread(myToken);
+        writer = std::thread([this, myToken, mySubscriptionInfo] {
+            writeAtomsAndPull(myToken, mySubscriptionInfo);
+        });
         waitForSubscriptionToEndLocked(mySubscriptionInfo, myToken, lock, timeoutSec);
 
         if (mSubscriptionInfo == mySubscriptionInfo) {
             mSubscriptionInfo = nullptr;
         }
+        mWriterWakeup.notify_all();
+    }
 
+    // The caller closes the fds once we return, so wait for the writer to stop using them.
+    writer.join();
+    if (outFlags != -1) {
+        fcntl(out, F_SETFL, outFlags);
     }
-}
 
-void ShellSubscriber::spawnHelperThread(int myToken) {
-    std::thread t([this, myToken] { pullAndSendHeartbeats(myToken); });
-    t.detach();
+    if (mySubscriptionInfo->mDroppedAtoms > 0) {
+        ALOGW("ShellSubscriber: subscription %d dropped %lld atoms because the reader was too slow",
+              myToken, (long long)mySubscriptionInfo->mDroppedAtoms);
+    }
 }
 
 void ShellSubscriber::waitForSubscriptionToEndLocked(shared_ptr<SubscriptionInfo> myInfo,
@@ -124,56 +145,119 @@ bool ShellSubscriber::readConfig(shared_ptr<SubscriptionInfo> subscriptionInfo)
     return true;
 }
 
-void ShellSubscriber::pullAndSendHeartbeats(int myToken) {
-    VLOG("ShellSubscriber: helper thread %d starting", myToken);
-    while (true) {
-        int64_t sleepTimeMs = INT_MAX;
-        {
-            std::lock_guard<std::mutex> lock(mMutex);
-            if (!mSubscriptionInfo || mToken != myToken) {
-                VLOG("ShellSubscriber: helper thread %d done!", myToken);
-                return;
-            }
+bool ShellSubscriber::isSubscriptionActiveLocked(int myToken,
+                                                 const shared_ptr<SubscriptionInfo>& myInfo) const {
+    return mToken == myToken && mSubscriptionInfo == myInfo && myInfo->mClientAlive;
+}
 
-            int64_t nowMillis = getElapsedRealtimeMillis();
+void ShellSubscriber::writeAtomsAndPull(int myToken, shared_ptr<SubscriptionInfo> myInfo) {
+    VLOG("ShellSubscriber: writer thread %d starting", myToken);
+    vector<uint8_t> frame;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (isSubscriptionActiveLocked(myToken, myInfo)) {
+        int64_t nowMillis = getElapsedRealtimeMillis();
+
+        // Pull the atoms that are due. The lock is released while pulling so that pushed atoms
+        // keep being buffered; only this thread touches mPulledInfo.
+        vector<PullInfo*> duePulls;
+        for (PullInfo& pullInfo : myInfo->mPulledInfo) {
+            if (pullInfo.mPrevPullElapsedRealtimeMs + pullInfo.mInterval <= nowMillis) {
+                duePulls.push_back(&pullInfo);
+            }
+        }
+        if (!duePulls.empty()) {
+            lock.unlock();
             int64_t nowNanos = getElapsedRealtimeNs();
-            for (PullInfo& pullInfo : mSubscriptionInfo->mPulledInfo) {
-                if (pullInfo.mPrevPullElapsedRealtimeMs + pullInfo.mInterval >= nowMillis) {
-                    continue;
-                }
-
+            vector<vector<std::shared_ptr<LogEvent>>> pulledData(duePulls.size());
+            for (size_t i = 0; i < duePulls.size(); i++) {
                 vector<int32_t> uids;
-                getUidsForPullAtom(&uids, pullInfo);
-
-                vector<std::shared_ptr<LogEvent>> data;
-                mPullerMgr->Pull(pullInfo.mPullerMatcher.atom_id(), uids, nowNanos, &data);
-                VLOG("Pulled %zu atoms with id %d", data.size(), pullInfo.mPullerMatcher.atom_id());
-                writePulledAtomsLocked(data, pullInfo.mPullerMatcher);
-
-                pullInfo.mPrevPullElapsedRealtimeMs = nowMillis;
+                getUidsForPullAtom(&uids, *duePulls[i]);
+                mPullerMgr->Pull(duePulls[i]->mPullerMatcher.atom_id(), uids, nowNanos,
+                                 &pulledData[i]);
+                VLOG("Pulled %zu atoms with id %d", pulledData[i].size(),
+                     duePulls[i]->mPullerMatcher.atom_id());
             }
-
-            // Send a heartbeat, consisting of a data size of 0, if perfd hasn't recently received
-            // data from statsd. When it receives the data size of 0, perfd will not expect any
-            // atoms and recheck whether the subscription should end.
-            if (nowMillis - mLastWriteMs > kMsBetweenHeartbeats) {
-                attemptWriteToPipeLocked(/*dataSize=*/0);
+            lock.lock();
+            if (!isSubscriptionActiveLocked(myToken, myInfo)) break;
+            for (size_t i = 0; i < duePulls.size(); i++) {
+                writePulledAtomsLocked(pulledData[i], duePulls[i]->mPullerMatcher);
+                duePulls[i]->mPrevPullElapsedRealtimeMs = nowMillis;
             }
+        }
 
-            // Determine how long to sleep before doing more work.
-            for (PullInfo& pullInfo : mSubscriptionInfo->mPulledInfo) {
-                int64_t nextPullTime = pullInfo.mPrevPullElapsedRealtimeMs + pullInfo.mInterval;
-                int64_t timeBeforePull = nextPullTime - nowMillis; // guaranteed to be non-negative
-                if (timeBeforePull < sleepTimeMs) sleepTimeMs = timeBeforePull;
+        // Send everything buffered so far as a single ShellData. Send a heartbeat, consisting of
+        // a data size of 0, if perfd hasn't recently received data from statsd. When it receives
+        // the data size of 0, perfd will not expect any atoms and recheck whether the
+        // subscription should end.
+        if (!myInfo->mPendingAtoms.empty() || nowMillis - mLastWriteMs >= kMsBetweenHeartbeats) {
+            size_t dataSize = myInfo->mPendingAtoms.size();
+            frame.resize(sizeof(dataSize));
+            memcpy(frame.data(), &dataSize, sizeof(dataSize));
+            frame.insert(frame.end(), myInfo->mPendingAtoms.begin(), myInfo->mPendingAtoms.end());
+            myInfo->mPendingAtoms.clear();
+
+            lock.unlock();
+            const bool written = writeFrame(myToken, myInfo, frame);
+            lock.lock();
+            if (!written) {
+                myInfo->mClientAlive = false;
+                mSubscriptionShouldEnd.notify_one();
+                break;
             }
-            int64_t timeBeforeHeartbeat = (mLastWriteMs + kMsBetweenHeartbeats) - nowMillis;
-            if (timeBeforeHeartbeat < sleepTimeMs) sleepTimeMs = timeBeforeHeartbeat;
+            mLastWriteMs = getElapsedRealtimeMillis();
+            continue;
+        }
+
+        // Sleep until the next pull or heartbeat is due, or until atoms are buffered.
+        int64_t wakeUpMillis = mLastWriteMs + kMsBetweenHeartbeats;
+        for (const PullInfo& pullInfo : myInfo->mPulledInfo) {
+            wakeUpMillis = std::min(wakeUpMillis,
+                                    pullInfo.mPrevPullElapsedRealtimeMs + pullInfo.mInterval);
+        }
+        VLOG("ShellSubscriber: writer thread %d sleeping for %lld ms", myToken,
+             (long long)(wakeUpMillis - nowMillis));
+        mWriterWakeup.wait_for(lock, std::chrono::milliseconds(wakeUpMillis - nowMillis),
+                               [this, myToken, &myInfo] {
+                                   return !myInfo->mPendingAtoms.empty() ||
+                                          !isSubscriptionActiveLocked(myToken, myInfo);
+                               });
+    }
+    VLOG("ShellSubscriber: writer thread %d done!", myToken);
+}
+
+bool ShellSubscriber::writeFrame(int myToken, const shared_ptr<SubscriptionInfo>& myInfo,
+                                 const vector<uint8_t>& frame) {
+    size_t written = 0;
+    while (written < frame.size()) {
+        ssize_t n = write(myInfo->mOutputFd, frame.data() + written, frame.size() - written);
+        if (n > 0) {
+            written += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+            return false;
+        }
+
+        // The reader is lagging. Atoms keep being buffered, and dropped once the buffer is full.
+        struct pollfd pfd = {myInfo->mOutputFd, POLLOUT, 0};
+        int ret = poll(&pfd, 1, kWritePollTimeoutMs);
+        if (ret < 0 && errno != EINTR) {
+            return false;
+        }
+        if (ret > 0 && (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))) {
+            return false;
         }
 
-        VLOG("ShellSubscriber: helper thread %d sleeping for %lld ms", myToken,
-             (long long)sleepTimeMs);
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleepTimeMs));
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!isSubscriptionActiveLocked(myToken, myInfo)) {
+            // Nobody is going to read the rest of the frame.
+            return true;
+        }
     }
+    return true;
 }
 
 void ShellSubscriber::getUidsForPullAtom(vector<int32_t>* uids, const PullInfo& pullInfo) {
@@ -188,56 +272,44 @@ void ShellSubscriber::getUidsForPullAtom(vector<int32_t>* uids, const PullInfo&
 
 void ShellSubscriber::writePulledAtomsLocked(const vector<std::shared_ptr<LogEvent>>& data,
                                              const SimpleAtomMatcher& matcher) {
-    mProto.clear();
-    int count = 0;
     for (const auto& event : data) {
         if (matchesSimple(*mUidMap, matcher, *event)) {
-            count++;
-            uint64_t atomToken = mProto.start(util::FIELD_TYPE_MESSAGE |
-                                              util::FIELD_COUNT_REPEATED | FIELD_ID_ATOM);
-            event->ToProto(mProto);
-            mProto.end(atomToken);
+            appendAtomLocked(*event);
         }
     }
-
-    if (count > 0) attemptWriteToPipeLocked(mProto.size());
 }
 
 void ShellSubscriber::onLogEvent(const LogEvent& event) {
     std::lock_guard<std::mutex> lock(mMutex);
     if (!mSubscriptionInfo) return;
 
-    mProto.clear();
     for (const auto& matcher : mSubscriptionInfo->mPushedMatchers) {
         if (matchesSimple(*mUidMap, matcher, event)) {
-            uint64_t atomToken = mProto.start(util::FIELD_TYPE_MESSAGE |
-                                              util::FIELD_COUNT_REPEATED | FIELD_ID_ATOM);
-            event.ToProto(mProto);
-            mProto.end(atomToken);
-            attemptWriteToPipeLocked(mProto.size());
+            appendAtomLocked(event);
         }
     }
 }
 
-// Tries to write the atom encoded in mProto to the pipe. If the write fails
-// because the read end of the pipe has closed, signals to other threads that
-// the subscription should end.
-void ShellSubscriber::attemptWriteToPipeLocked(size_t dataSize) {
-    // First, write the payload size.
-    if (!android::base::WriteFully(mSubscriptionInfo->mOutputFd, &dataSize, sizeof(dataSize))) {
-        mSubscriptionInfo->mClientAlive = false;
-        mSubscriptionShouldEnd.notify_one();
+// Serializes event as a ShellData.atom field and appends it to the atoms waiting for the
+// writer thread. Concatenated atom fields form a valid ShellData, so the writer can send the
+// whole buffer as one message.
+void ShellSubscriber::appendAtomLocked(const LogEvent& event) {
+    mProto.clear();
+    uint64_t atomToken =
+            mProto.start(util::FIELD_TYPE_MESSAGE | util::FIELD_COUNT_REPEATED | FIELD_ID_ATOM);
+    event.ToProto(mProto);
+    mProto.end(atomToken);
+
+    vector<uint8_t>& pending = mSubscriptionInfo->mPendingAtoms;
+    if (pending.size() + mProto.size() > kMaxPendingAtomBytes) {
+        mSubscriptionInfo->mDroppedAtoms++;
         return;
     }
-
-    // Then, write the payload if this is not just a heartbeat.
-    if (dataSize > 0 && !mProto.flush(mSubscriptionInfo->mOutputFd)) {
-        mSubscriptionInfo->mClientAlive = false;
-        mSubscriptionShouldEnd.notify_one();
-        return;
+    const bool wasEmpty = pending.empty();
+    mProto.serializeToVector(&pending);
+    if (wasEmpty) {
+        mWriterWakeup.notify_all();
     }
-
-    mLastWriteMs = getElapsedRealtimeMillis();
 }
 
 }  // namespace statsd
@@ -17,6 +17,7 @@
 #pragma once
 
 #include <android/util/ProtoOutputStream.h>
+#include <gtest/gtest_prod.h>
 #include <private/android_filesystem_config.h>
 
 #include <condition_variable>
@@ -54,6 +55,11 @@ namespace statsd {
  * The stream would be in the following format:
  * |size_t|shellData proto|size_t|shellData proto|....
  *
+ * Matching atoms are appended to a bounded per-subscription buffer, and a dedicated writer
+ * thread sends everything buffered so far as one ShellData message, so that a slow reader never
+ * blocks the thread that processes log events. Atoms that do not fit in the buffer are dropped
+ * and counted. The writer thread also performs the pulls the subscription asked for.
+ *
  * Only one shell subscriber is allowed at a time because each shell subscriber blocks one thread
  * until it exits.
  */
@@ -85,7 +91,7 @@ private:
 
     struct SubscriptionInfo {
         SubscriptionInfo(const int& inputFd, const int& outputFd)
-            : mInputFd(inputFd), mOutputFd(outputFd), mClientAlive(true) {
+            : mInputFd(inputFd), mOutputFd(outputFd), mClientAlive(true), mDroppedAtoms(0) {
         }
 
         int mInputFd;
@@ -93,31 +99,44 @@ private:
         std::vector<SimpleAtomMatcher> mPushedMatchers;
         std::vector<PullInfo> mPulledInfo;
         bool mClientAlive;
+        // Serialized ShellData.atom fields waiting for the writer thread.
+        std::vector<uint8_t> mPendingAtoms;
+        // Number of atoms dropped because mPendingAtoms was full.
+        int64_t mDroppedAtoms;
     };
 
     int claimToken();
 
     bool readConfig(std::shared_ptr<SubscriptionInfo> subscriptionInfo);
 
-    void spawnHelperThread(int myToken);
-
     void waitForSubscriptionToEndLocked(std::shared_ptr<SubscriptionInfo> myInfo,
                                         int myToken,
                                         std::unique_lock<std::mutex>& lock,
                                         int timeoutSec);
 
-    // Helper thread that pulls atoms at a regular frequency and sends
-    // heartbeats to perfd if statsd hasn't recently sent any data. Statsd must
-    // send heartbeats for perfd to escape a blocking read call and recheck if
-    // the user has terminated the subscription.
-    void pullAndSendHeartbeats(int myToken);
+    // Writer thread of a subscription. Sends the buffered atoms, pulls atoms at a regular
+    // frequency and sends heartbeats to perfd if statsd hasn't recently sent any data. Statsd
+    // must send heartbeats for perfd to escape a blocking read call and recheck if the user has
+    // terminated the subscription. Sleeps on mWriterWakeup until there is work to do.
+    void writeAtomsAndPull(int myToken, std::shared_ptr<SubscriptionInfo> myInfo);
+
+    // Returns true while myInfo is the current subscription and has not ended.
+    bool isSubscriptionActiveLocked(int myToken,
+                                    const std::shared_ptr<SubscriptionInfo>& myInfo) const;
+
+    // Writes frame to the non-blocking output fd, waiting for the reader as needed. Called
+    // without holding mMutex. Gives up early if the subscription ends. Returns false if the
+    // reader has gone away.
+    bool writeFrame(int myToken, const std::shared_ptr<SubscriptionInfo>& myInfo,
+                    const std::vector<uint8_t>& frame);
 
     void writePulledAtomsLocked(const vector<std::shared_ptr<LogEvent>>& data,
                                 const SimpleAtomMatcher& matcher);
 
     void getUidsForPullAtom(vector<int32_t>* uids, const PullInfo& pullInfo);
 
-    void attemptWriteToPipeLocked(size_t dataSize);
+    // Appends event to the pending atoms of the subscription, or drops it if the buffer is full.
+    void appendAtomLocked(const LogEvent& event);
 
     sp<UidMap> mUidMap;
 
@@ -129,6 +148,9 @@ private:
 
     std::condition_variable mSubscriptionShouldEnd;
 
+    // Wakes up the writer thread when atoms are buffered or the subscription ends.
+    std::condition_variable mWriterWakeup;
+
     std::shared_ptr<SubscriptionInfo> mSubscriptionInfo = nullptr;
 
     int mToken = 0;
@@ -139,6 +161,15 @@ private:
     // when next to send a heartbeat.
     int64_t mLastWriteMs = 0;
     const int64_t kMsBetweenHeartbeats = 1000;
+
+    // Maximum size of the atoms buffered for the writer thread.
+    const size_t kMaxPendingAtomBytes = 1024 * 1024;
+
+    // How long the writer thread waits for the reader at a time before checking whether the
+    // subscription is still active.
+    const int kWritePollTimeoutMs = 100;
+
+    FRIEND_TEST(ShellSubscriberTest, testSlowReaderDropsAtoms);
 };
 
 }  // namespace statsd
@@ -93,6 +93,12 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
     uint8_t* ptr = ((uint8_t*)buffer) + sizeof(android_log_header_t);
     n -= sizeof(android_log_header_t);
 
+    processMessage(ptr, n, cred->uid, cred->pid, mQueue.get());
+    return true;
+}
+
+bool StatsSocketListener::processMessage(uint8_t* ptr, uint32_t n, uint32_t uid, uint32_t pid,
+                                         LogEventQueue* queue) {
     // When a log failed to write to statsd socket (e.g., due ot EBUSY), a special message would
     // be sent to statsd when the socket communication becomes available again.
     // The format is android_log_event_int_t with a single integer in the payload indicating the
@@ -111,28 +117,25 @@ bool StatsSocketListener::onDataAvailable(SocketClient* cli) {
             int32_t last_atom_tag = (int32_t)((0xffffffff00000000 & (uint64_t)composed_long) >> 32);
 
             ALOGE("Found dropped events: %d error %d last atom tag %d from uid %d", dropped_count,
-                  long_event->header.tag, last_atom_tag, cred->uid);
+                  long_event->header.tag, last_atom_tag, uid);
             StatsdStats::getInstance().noteLogLost((int32_t)getWallClockSec(), dropped_count,
-                                                   long_event->header.tag, last_atom_tag, cred->uid,
-                                                   cred->pid);
-            return true;
+                                                   long_event->header.tag, last_atom_tag, uid, pid);
+            return false;
         }
     }
 
     // move past the 4-byte StatsEventTag
     uint8_t* msg = ptr + sizeof(uint32_t);
     uint32_t len = n - sizeof(uint32_t);
-    uint32_t uid = cred->uid;
-    uint32_t pid = cred->pid;
 
     int64_t oldestTimestamp;
     std::unique_ptr<LogEvent> logEvent = std::make_unique<LogEvent>(uid, pid);
     logEvent->parseBuffer(msg, len);
 
-    if (!mQueue->push(std::move(logEvent), &oldestTimestamp)) {
+    if (!queue->push(std::move(logEvent), &oldestTimestamp)) {
         StatsdStats::getInstance().noteEventQueueOverflow(oldestTimestamp);
+        return false;
     }
-
     return true;
 }
 
@@ -39,6 +39,16 @@ public:
 
     virtual ~StatsSocketListener();
 
+    /**
+     * Parses one message received on the statsd socket and pushes the resulting LogEvent to
+     * queue. ptr points just past the android_log_header_t and n is the number of bytes that
+     * follow it. Returns true if a LogEvent was pushed, false if the message reported lost events
+     * or the queue was full. Also used by the offline replay harness so that replayed traffic
+     * takes exactly the same parsing path as live traffic.
+     */
+    static bool processMessage(uint8_t* ptr, uint32_t n, uint32_t uid, uint32_t pid,
+                               LogEventQueue* queue);
+
 protected:
     virtual bool onDataAvailable(SocketClient* cli);
 
@@ -46,8 +46,8 @@ void StateManager::onLogEvent(const LogEvent& event) {
     // Whitelisted AIDs are AID_ROOT and all AIDs in [1000, 2000)
     if (event.GetUid() == AID_ROOT || (event.GetUid() >= 1000 && event.GetUid() < 2000) ||
         mAllowedLogSources.find(event.GetUid()) != mAllowedLogSources.end()) {
-        if (mStateTrackers.find(event.GetTagId()) != mStateTrackers.end()) {
-            mStateTrackers[event.GetTagId()]->onLogEvent(event);
+        if (auto it = mStateTrackers.find(event.GetTagId()); it != mStateTrackers.end()) {
+            it->second->onLogEvent(event);
         }
     }
 }
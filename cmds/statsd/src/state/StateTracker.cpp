@@ -29,8 +29,11 @@ StateTracker::StateTracker(const int32_t atomId) : mField(atomId, 0) {
 }
 
 void StateTracker::onLogEvent(const LogEvent& event) {
-    const int64_t eventTimeNs = event.GetElapsedTimestampNs();
+    updateStateForEvent(event);
+    notifyListeners(event.GetElapsedTimestampNs());
+}
 
+void StateTracker::updateStateForEvent(const LogEvent& event) {
     // Parse event for primary field values i.e. primary key.
     HashableDimensionKey primaryKey;
     filterPrimaryKey(event.getValues(), &primaryKey);
@@ -38,7 +41,7 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     FieldValue newState;
     if (!getStateFieldValueFromLogEvent(event, &newState)) {
         ALOGE("StateTracker error extracting state from log event. Missing exclusive state field.");
-        clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        clearStateForPrimaryKey(primaryKey);
         return;
     }
 
@@ -47,35 +50,51 @@ void StateTracker::onLogEvent(const LogEvent& event) {
     if (newState.mValue.getType() != INT) {
         ALOGE("StateTracker error extracting state from log event. Type: %d",
               newState.mValue.getType());
-        clearStateForPrimaryKey(eventTimeNs, primaryKey);
+        clearStateForPrimaryKey(primaryKey);
         return;
     }
 
     if (int resetState = event.getResetState(); resetState != -1) {
         VLOG("StateTracker new reset state: %d", resetState);
-        const FieldValue resetStateFieldValue(mField, Value(resetState));
-        handleReset(eventTimeNs, resetStateFieldValue);
+        handleReset(resetState);
+        return;
+    }
+
+    const int32_t newStateValue = newState.mValue.int_value;
+    if (kStateUnknown == newStateValue) {
+        clearStateForPrimaryKey(primaryKey);
         return;
     }
 
     const bool nested = newState.mAnnotations.isNested();
-    StateValueInfo* stateValueInfo = &mStateMap[primaryKey];
-    updateStateForPrimaryKey(eventTimeNs, primaryKey, newState, nested, stateValueInfo);
+    updateStateForSlot(findOrInsertSlot(primaryKey), newStateValue, nested);
 }
 
 void StateTracker::registerListener(wp<StateListener> listener) {
     mListeners.insert(listener);
+    rebuildListenerSnapshot();
 }
 
 void StateTracker::unregisterListener(wp<StateListener> listener) {
     mListeners.erase(listener);
+    rebuildListenerSnapshot();
+}
+
+void StateTracker::rebuildListenerSnapshot() {
+    mListenerSnapshot.clear();
+    for (const auto& l : mListeners) {
+        sp<StateListener> sl = l.promote();
+        if (sl != nullptr) {
+            mListenerSnapshot.push_back(sl);
+        }
+    }
 }
 
 bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValue* output) const {
     output->mField = mField;
 
-    if (const auto it = mStateMap.find(queryKey); it != mStateMap.end()) {
-        output->mValue = it->second.state;
+    if (const auto it = mSlots.find(queryKey); it != mSlots.end()) {
+        output->mValue = mStateValues[it->second].state;
         return true;
     }
 
@@ -84,43 +103,61 @@ bool StateTracker::getStateValue(const HashableDimensionKey& queryKey, FieldValu
     return false;
 }
 
-void StateTracker::handleReset(const int64_t eventTimeNs, const FieldValue& newState) {
+void StateTracker::handleReset(const int32_t newStateValue) {
     VLOG("StateTracker handle reset");
-    for (auto& [primaryKey, stateValueInfo] : mStateMap) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, newState,
-                                 false /* nested; treat this state change as not nested */,
-                                 &stateValueInfo);
+    for (size_t slot = 0; slot < mStateValues.size(); slot++) {
+        if (mStateValues[slot].state != kStateUnknown) {
+            updateStateForSlot(slot, newStateValue,
+                               false /* nested; treat this state change as not nested */);
+        }
     }
 }
 
-void StateTracker::clearStateForPrimaryKey(const int64_t eventTimeNs,
-                                           const HashableDimensionKey& primaryKey) {
+void StateTracker::clearStateForPrimaryKey(const HashableDimensionKey& primaryKey) {
     VLOG("StateTracker clear state for primary key");
-    const std::unordered_map<HashableDimensionKey, StateValueInfo>::iterator it =
-            mStateMap.find(primaryKey);
+    // If there is no entry for the primaryKey, then the state is already kStateUnknown.
+    if (const auto it = mSlots.find(primaryKey); it != mSlots.end()) {
+        updateStateForSlot(it->second, kStateUnknown,
+                           false /* nested; treat this state change as not nested */);
+    }
+}
+
+int StateTracker::findOrInsertSlot(const HashableDimensionKey& primaryKey) {
+    if (const auto it = mSlots.find(primaryKey); it != mSlots.end()) {
+        return it->second;
+    }
 
-    // If there is no entry for the primaryKey in mStateMap, then the state is already
-    // kStateUnknown.
-    const FieldValue state(mField, Value(kStateUnknown));
-    if (it != mStateMap.end()) {
-        updateStateForPrimaryKey(eventTimeNs, primaryKey, state,
-                                 false /* nested; treat this state change as not nested */,
-                                 &it->second);
+    int slot;
+    if (mFreeSlots.empty()) {
+        slot = mStateValues.size();
+        mPrimaryKeys.push_back(primaryKey);
+        mStateValues.emplace_back();
+    } else {
+        slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+        mPrimaryKeys[slot] = primaryKey;
+        mStateValues[slot] = StateValueInfo();
     }
+    mSlots[primaryKey] = slot;
+    return slot;
 }
 
-void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
-                                            const HashableDimensionKey& primaryKey,
-                                            const FieldValue& newState, const bool nested,
-                                            StateValueInfo* stateValueInfo) {
-    FieldValue oldState;
-    oldState.mField = mField;
-    oldState.mValue.setInt(stateValueInfo->state);
+void StateTracker::updateStateForSlot(const int slot, const int32_t newStateValue,
+                                      const bool nested) {
+    StateValueInfo* stateValueInfo = &mStateValues[slot];
     const int32_t oldStateValue = stateValueInfo->state;
-    const int32_t newStateValue = newState.mValue.int_value;
 
+    // An unknown state removes the primary key, whether or not the state is nested. The slot is
+    // freed once the listeners have been notified.
     if (kStateUnknown == newStateValue) {
-        mStateMap.erase(primaryKey);
+        mSlots.erase(mPrimaryKeys[slot]);
+        stateValueInfo->state = kStateUnknown;
+        stateValueInfo->count = 0;
+        mClearedSlots.push_back(slot);
+        if (kStateUnknown != oldStateValue) {
+            mPendingChanges.push_back({slot, oldStateValue, newStateValue});
+        }
+        return;
     }
 
     // Update state map for non-nested counting case.
@@ -131,7 +168,7 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
 
         // Notify listeners if state has changed.
         if (oldStateValue != newStateValue) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+            mPendingChanges.push_back({slot, oldStateValue, newStateValue});
         }
         return;
     }
@@ -146,32 +183,39 @@ void StateTracker::updateStateForPrimaryKey(const int64_t eventTimeNs,
     // In atoms.proto, a state atom with nested counting enabled
     // must only have 2 states. There is no enforcemnt here of this requirement.
     // The atom must be logged correctly.
-    if (kStateUnknown == newStateValue) {
-        if (kStateUnknown != oldStateValue) {
-            notifyListeners(eventTimeNs, primaryKey, oldState, newState);
-        }
-    } else if (oldStateValue == kStateUnknown) {
+    if (oldStateValue == kStateUnknown) {
         stateValueInfo->state = newStateValue;
         stateValueInfo->count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        mPendingChanges.push_back({slot, oldStateValue, newStateValue});
     } else if (oldStateValue == newStateValue) {
         stateValueInfo->count++;
     } else if (--stateValueInfo->count == 0) {
         stateValueInfo->state = newStateValue;
         stateValueInfo->count = 1;
-        notifyListeners(eventTimeNs, primaryKey, oldState, newState);
+        mPendingChanges.push_back({slot, oldStateValue, newStateValue});
     }
 }
 
-void StateTracker::notifyListeners(const int64_t eventTimeNs,
-                                   const HashableDimensionKey& primaryKey,
-                                   const FieldValue& oldState, const FieldValue& newState) {
-    for (auto l : mListeners) {
-        auto sl = l.promote();
-        if (sl != nullptr) {
-            sl->onStateChanged(eventTimeNs, mField.getTag(), primaryKey, oldState, newState);
+void StateTracker::notifyListeners(const int64_t eventTimeNs) {
+    if (!mPendingChanges.empty()) {
+        FieldValue oldState(mField, Value(kStateUnknown));
+        FieldValue newState(mField, Value(kStateUnknown));
+        for (const sp<StateListener>& listener : mListenerSnapshot) {
+            for (const StateChange& change : mPendingChanges) {
+                oldState.mValue.setInt(change.oldState);
+                newState.mValue.setInt(change.newState);
+                listener->onStateChanged(eventTimeNs, mField.getTag(), mPrimaryKeys[change.slot],
+                                         oldState, newState);
+            }
         }
+        mPendingChanges.clear();
+    }
+
+    for (const int slot : mClearedSlots) {
+        mPrimaryKeys[slot] = HashableDimensionKey();
+        mFreeSlots.push_back(slot);
     }
+    mClearedSlots.clear();
 }
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output) {
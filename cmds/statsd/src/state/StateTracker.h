@@ -21,7 +21,9 @@
 
 #include "state/StateListener.h"
 
+#include <set>
 #include <unordered_map>
+#include <vector>
 
 namespace android {
 namespace os {
@@ -35,7 +37,8 @@ public:
 
     // Updates state map and notifies all listeners if a state change occurs.
     // Checks if a state change has occurred by getting the state value from
-    // the log event and comparing the old and new states.
+    // the log event and comparing the old and new states. All the state changes
+    // caused by the event are sent once the event has been processed.
     void onLogEvent(const LogEvent& event);
 
     // Adds new listeners to set of StateListeners. If a listener is already
@@ -63,28 +66,60 @@ private:
         int count = 0;                  // nested count (only used for binary states)
     };
 
+    // A state change that has not been sent to the listeners yet.
+    struct StateChange {
+        int slot;
+        int32_t oldState;
+        int32_t newState;
+    };
+
     Field mField;
 
-    // Maps primary key to state value info
-    std::unordered_map<HashableDimensionKey, StateValueInfo> mStateMap;
+    // Interned primary keys. Maps each primary key that has a state to its slot in
+    // mPrimaryKeys and mStateValues.
+    std::unordered_map<HashableDimensionKey, int> mSlots;
+
+    // Primary key and state value info of each slot. Free slots have the state kStateUnknown
+    // and are reused for new primary keys.
+    std::vector<HashableDimensionKey> mPrimaryKeys;
+    std::vector<StateValueInfo> mStateValues;
+    std::vector<int> mFreeSlots;
+
+    // State changes caused by the event being processed.
+    std::vector<StateChange> mPendingChanges;
+
+    // Slots cleared by the event being processed. They are only freed once the listeners have
+    // been notified, so that the primary keys passed to the listeners stay valid.
+    std::vector<int> mClearedSlots;
 
     // Set of all StateListeners (objects listening for state changes)
     std::set<wp<StateListener>> mListeners;
 
+    // Strong references to the live listeners in mListeners, rebuilt whenever a listener
+    // registers or unregisters so that notifying does not promote weak pointers. Listeners must
+    // unregister before they can be destroyed.
+    std::vector<sp<StateListener>> mListenerSnapshot;
+
+    // Updates the state values for the event and records the resulting state changes.
+    void updateStateForEvent(const LogEvent& event);
+
     // Reset all state values in map to the given state.
-    void handleReset(const int64_t eventTimeNs, const FieldValue& newState);
+    void handleReset(const int32_t newStateValue);
 
     // Clears the state value mapped to the given primary key by setting it to kStateUnknown.
-    void clearStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey);
+    void clearStateForPrimaryKey(const HashableDimensionKey& primaryKey);
+
+    // Returns the slot of the primary key, assigning it one if needed.
+    int findOrInsertSlot(const HashableDimensionKey& primaryKey);
+
+    // Update the state of the slot based on the received state value.
+    void updateStateForSlot(const int slot, const int32_t newStateValue, const bool nested);
 
-    // Update the StateMap based on the received state value.
-    void updateStateForPrimaryKey(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
-                                  const FieldValue& newState, const bool nested,
-                                  StateValueInfo* stateValueInfo);
+    void rebuildListenerSnapshot();
 
-    // Notify registered state listeners of state change.
-    void notifyListeners(const int64_t eventTimeNs, const HashableDimensionKey& primaryKey,
-                         const FieldValue& oldState, const FieldValue& newState);
+    // Notify registered state listeners of the pending state changes, then free the slots that
+    // were cleared.
+    void notifyListeners(const int64_t eventTimeNs);
 };
 
 bool getStateFieldValueFromLogEvent(const LogEvent& event, FieldValue* output);
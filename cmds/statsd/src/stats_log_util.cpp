@@ -18,6 +18,8 @@
 #include "stats_log_util.h"
 
 #include <aidl/android/os/IStatsCompanionService.h>
+#include <android-base/file.h>
+#include <android/util/protobuf.h>
 #include <private/android_filesystem_config.h>
 #include <set>
 #include <utils/SystemClock.h>
@@ -84,6 +86,7 @@ const int FIELD_ID_PULLER_NOT_FOUND = 21;
 const int FIELD_ID_PULL_TIMEOUT_METADATA = 22;
 const int FIELD_ID_PULL_TIMEOUT_METADATA_UPTIME_MILLIS = 1;
 const int FIELD_ID_PULL_TIMEOUT_METADATA_ELAPSED_MILLIS = 2;
+const int FIELD_ID_PULL_TIME_HISTOGRAM = 23;
 
 // for AtomMetricStats proto
 const int FIELD_ID_ATOM_METRIC_STATS = 17;
@@ -510,6 +513,13 @@ void writePullerStatsToStream(const std::pair<int, StatsdStats::PulledAtomStats>
                            pullTimeoutMetadata.pullTimeoutElapsedMillis);
         protoOutput->end(timeoutMetadataToken);
     }
+    if (pair.second.numPullTime > 0) {
+        for (long count : pair.second.pullTimeHistogram) {
+            protoOutput->write(
+                    FIELD_TYPE_INT64 | FIELD_ID_PULL_TIME_HISTOGRAM | FIELD_COUNT_REPEATED,
+                    (long long)count);
+        }
+    }
     protoOutput->end(token);
 }
 
@@ -571,6 +581,17 @@ int64_t getWallClockMillis() {
     return time(nullptr) * MS_PER_SEC;
 }
 
+ssize_t writeLengthDelimitedHeaderToFd(int fd, uint32_t fieldId, size_t size) {
+    // A varint of the tag takes at most 5 bytes and a varint of the size at most 10 bytes.
+    uint8_t header[15];
+    const size_t headerSize =
+            android::util::write_length_delimited_tag_header(header, fieldId, size) - header;
+    if (!android::base::WriteFully(fd, header, headerSize)) {
+        return -1;
+    }
+    return headerSize;
+}
+
 int64_t truncateTimestampIfNecessary(const LogEvent& event) {
     if (event.shouldTruncateTimestamp() ||
         (event.GetTagId() >= StatsdStats::kTimestampTruncationStartTag &&
@@ -97,6 +97,11 @@ bool parseProtoOutputStream(ProtoOutputStream& protoOutput, T* message) {
     return message->ParseFromArray(pbBytes.c_str(), pbBytes.size());
 }
 
+// Writes the tag and length varints of a length-delimited field directly to fd, so that a
+// serialized message of the given size can be streamed after it. Returns the number of bytes
+// written, or -1 on write failure.
+ssize_t writeLengthDelimitedHeaderToFd(int fd, uint32_t fieldId, size_t size);
+
 // Checks the truncate timestamp annotation as well as the blacklisted range of 300,000 - 304,999.
 // Returns the truncated timestamp to the nearest 5 minutes if needed.
 int64_t truncateTimestampIfNecessary(const LogEvent& event);
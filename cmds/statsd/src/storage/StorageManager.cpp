@@ -24,6 +24,8 @@
 
 #include <android-base/file.h>
 #include <private/android_filesystem_config.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include <fstream>
 
 namespace android {
@@ -49,9 +51,40 @@ const uint32_t TRAIN_INFO_FILE_MAGIC = 0xfb7447bf;
 // for ConfigMetricsReportList
 const int FIELD_ID_REPORTS = 2;
 
+// Size of the buffer used to stream reports from disk.
+const size_t kStreamBufferSize = 64 * 1024;
+
+// A data file stops receiving appended reports once it is this old or this large, so that the
+// file timestamp used for trimming stays close to the age of the data in the file.
+const long kMaxReportFileAppendSec = 60 * 60;
+const int64_t kMaxReportFileAppendBytes = 1024 * 1024;
+
+// Number of later timestamps tried when the name of a new report file is taken.
+const int kMaxReportFileNameAttempts = 5;
+
+// Start of the report files written by writeConfigMetricsReport() when report records are
+// enabled. Files without it hold a single uncompressed ConfigMetricsReport. Serialized protos
+// never start with a zero byte, so the two formats cannot be confused.
+const uint8_t REPORT_FILE_MAGIC[4] = {0x00, 's', 'r', '1'};
+
+enum ReportEncoding : uint32_t {
+    REPORT_ENCODING_NONE = 0,
+    REPORT_ENCODING_DEFLATE = 1,
+};
+
+// Precedes every report in a report file.
+struct ReportRecordHeader {
+    uint32_t mRawSize;
+    uint32_t mStoredSize;
+    uint32_t mEncoding;
+};
+
 std::mutex StorageManager::sTrainInfoMutex;
+std::mutex StorageManager::sIndexMutex;
+std::atomic<bool> StorageManager::sReportRecordsEnabled(false);
 
 using android::base::StringPrintf;
+using android::util::ProtoReader;
 using std::unique_ptr;
 
 struct FileName {
@@ -123,14 +156,317 @@ static void parseFileName(char* name, FileName* output) {
     output->mIsHistory = (substr != nullptr && strcmp("history", substr) == 0);
 }
 
-void StorageManager::writeFile(const char* file, const void* buffer, int numBytes) {
+struct IndexedFile {
+    FileName mName;
+    int64_t mSizeBytes;
+    // Whether writeConfigMetricsReport() may append to the file. Only files it created in this
+    // process qualify, and only until they are read.
+    bool mAppendable;
+};
+
+// Files of a directory as last seen by statsd, so that trimming and lookups do not need to list
+// and stat the directory each time. Changes made behind statsd's back are picked up when the
+// directory mtime no longer matches the one recorded after statsd's own last change.
+struct DirIndex {
+    bool mLoaded = false;
+    struct timespec mDirMtime = {};
+    std::map<string, IndexedFile> mFiles;
+    int64_t mTotalBytes = 0;
+};
+
+// Keyed by directory. Guarded by StorageManager::sIndexMutex.
+static map<string, DirIndex> sDirIndexes;
+
+static bool isIndexedDir(const string& dir) {
+    return dir == STATS_DATA_DIR || dir == STATS_SERVICE_DIR;
+}
+
+static void splitPath(const string& path, string* dir, string* name) {
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) {
+        dir->clear();
+        *name = path;
+    } else {
+        *dir = path.substr(0, slash);
+        *name = path.substr(slash + 1);
+    }
+}
+
+static bool parseFileName(const string& name, FileName* output) {
+    string copy(name);
+    parseFileName(&copy[0], output);
+    return output->mTimestampSec != -1;
+}
+
+static void recordDirMtimeLocked(const string& dir, DirIndex* index) {
+    struct stat dirStat;
+    if (stat(dir.c_str(), &dirStat) == 0) {
+        index->mDirMtime = dirStat.st_mtim;
+    } else {
+        index->mLoaded = false;
+    }
+}
+
+static void loadIndexLocked(const string& dir, DirIndex* index) {
+    index->mFiles.clear();
+    index->mTotalBytes = 0;
+    index->mLoaded = false;
+    unique_ptr<DIR, decltype(&closedir)> dirp(opendir(dir.c_str()), closedir);
+    if (dirp == NULL) {
+        VLOG("Path %s does not exist", dir.c_str());
+        return;
+    }
+    dirent* de;
+    while ((de = readdir(dirp.get()))) {
+        string name(de->d_name);
+        if (name[0] == '.') continue;
+
+        IndexedFile file;
+        if (!parseFileName(name, &file.mName)) continue;
+        struct stat fileStat;
+        file.mSizeBytes = fstatat(dirfd(dirp.get()), name.c_str(), &fileStat, 0) == 0
+                                  ? fileStat.st_size
+                                  : 0;
+        file.mAppendable = false;
+        index->mTotalBytes += file.mSizeBytes;
+        index->mFiles[name] = file;
+    }
+    index->mLoaded = true;
+    recordDirMtimeLocked(dir, index);
+}
+
+// Returns the up to date index of dir, or nullptr if dir is not indexed.
+static DirIndex* getIndexLocked(const string& dir) {
+    if (!isIndexedDir(dir)) {
+        return nullptr;
+    }
+    DirIndex& index = sDirIndexes[dir];
+    struct stat dirStat;
+    if (!index.mLoaded || stat(dir.c_str(), &dirStat) != 0 ||
+        dirStat.st_mtim.tv_sec != index.mDirMtime.tv_sec ||
+        dirStat.st_mtim.tv_nsec != index.mDirMtime.tv_nsec) {
+        loadIndexLocked(dir, &index);
+    }
+    return &index;
+}
+
+// Returns the index of the directory of path if it is loaded, without checking it for changes
+// made behind statsd's back. Used to apply statsd's own changes.
+static DirIndex* getLoadedIndexLocked(const string& path, string* dir, string* name) {
+    splitPath(path, dir, name);
+    if (!isIndexedDir(*dir)) {
+        return nullptr;
+    }
+    auto it = sDirIndexes.find(*dir);
+    return it != sDirIndexes.end() && it->second.mLoaded ? &it->second : nullptr;
+}
+
+static void noteFileRemovedLocked(const string& path) {
+    string dir, name;
+    DirIndex* index = getLoadedIndexLocked(path, &dir, &name);
+    if (index == nullptr) {
+        return;
+    }
+    auto it = index->mFiles.find(name);
+    if (it != index->mFiles.end()) {
+        index->mTotalBytes -= it->second.mSizeBytes;
+        index->mFiles.erase(it);
+    }
+    recordDirMtimeLocked(dir, index);
+}
+
+static void noteFileWrittenLocked(const string& path, int64_t sizeBytes, bool appendable) {
+    string dir, name;
+    DirIndex* index = getLoadedIndexLocked(path, &dir, &name);
+    if (index == nullptr) {
+        return;
+    }
+    IndexedFile file;
+    if (parseFileName(name, &file.mName)) {
+        auto it = index->mFiles.find(name);
+        if (it != index->mFiles.end()) {
+            index->mTotalBytes -= it->second.mSizeBytes;
+        }
+        file.mSizeBytes = sizeBytes;
+        file.mAppendable = appendable;
+        index->mTotalBytes += sizeBytes;
+        index->mFiles[name] = file;
+    }
+    recordDirMtimeLocked(dir, index);
+}
+
+static void noteFileRenamedLocked(const string& from, const string& to) {
+    string dir, name;
+    DirIndex* index = getLoadedIndexLocked(from, &dir, &name);
+    if (index == nullptr) {
+        return;
+    }
+    auto it = index->mFiles.find(name);
+    int64_t sizeBytes = it != index->mFiles.end() ? it->second.mSizeBytes : 0;
+    noteFileRemovedLocked(from);
+    noteFileWrittenLocked(to, sizeBytes, false /* appendable */);
+}
+
+// Returns the name of the data file that the next report of key can be appended to, or an empty
+// string if a new file must be started.
+static string findAppendableReportFileLocked(const DirIndex& index, const ConfigKey& key,
+                                             long nowSec) {
+    for (const auto& pair : index.mFiles) {
+        const IndexedFile& file = pair.second;
+        if (file.mAppendable && !file.mName.mIsHistory && file.mName.mUid == key.GetUid() &&
+            file.mName.mConfigId == key.GetId() &&
+            nowSec - file.mName.mTimestampSec < kMaxReportFileAppendSec &&
+            file.mSizeBytes < kMaxReportFileAppendBytes) {
+            return pair.first;
+        }
+    }
+    return "";
+}
+
+static bool deflateProto(ProtoOutputStream* proto, size_t rawSize, vector<uint8_t>* output) {
+    z_stream stream = {};
+    if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+        return false;
+    }
+    output->resize(deflateBound(&stream, rawSize));
+    stream.next_out = output->data();
+    stream.avail_out = output->size();
+
+    bool success = true;
+    sp<ProtoReader> reader = proto->data();
+    while (success && reader->readBuffer() != nullptr) {
+        size_t toRead = reader->currentToRead();
+        stream.next_in = const_cast<uint8_t*>(reader->readBuffer());
+        stream.avail_in = toRead;
+        success = deflate(&stream, Z_NO_FLUSH) == Z_OK && stream.avail_in == 0;
+        reader->move(toRead);
+    }
+    success = success && deflate(&stream, Z_FINISH) == Z_STREAM_END;
+    output->resize(stream.total_out);
+    deflateEnd(&stream);
+    return success;
+}
+
+// Calls handler with the header of each report in a report file, with fd positioned at the
+// stored report. Stops at the first incomplete record, which a crash during an append can leave
+// behind, or when handler returns false.
+static void forEachReportRecord(int fd,
+                                const std::function<bool(const ReportRecordHeader&)>& handler) {
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        ALOGE("Failed to stat report file");
+        return;
+    }
+    uint8_t magic[sizeof(REPORT_FILE_MAGIC)];
+    if (fileStat.st_size < (off_t)sizeof(magic) ||
+        !android::base::ReadFully(fd, magic, sizeof(magic)) ||
+        memcmp(magic, REPORT_FILE_MAGIC, sizeof(magic)) != 0) {
+        lseek(fd, 0, SEEK_SET);
+        handler({(uint32_t)fileStat.st_size, (uint32_t)fileStat.st_size, REPORT_ENCODING_NONE});
+        return;
+    }
+
+    off_t offset = sizeof(magic);
+    ReportRecordHeader header;
+    while (fileStat.st_size - offset >= (off_t)sizeof(header) &&
+           android::base::ReadFully(fd, &header, sizeof(header))) {
+        offset += sizeof(header);
+        if (header.mStoredSize > fileStat.st_size - offset ||
+            (header.mEncoding != REPORT_ENCODING_DEFLATE &&
+             (header.mEncoding != REPORT_ENCODING_NONE ||
+              header.mStoredSize != header.mRawSize))) {
+            ALOGE("Corrupted report record");
+            return;
+        }
+        if (!handler(header)) {
+            return;
+        }
+        offset += header.mStoredSize;
+        if (lseek(fd, offset, SEEK_SET) != offset) {
+            return;
+        }
+    }
+}
+
+// Reads the stored report at the position of fd and passes the raw report to sink in chunks of
+// at most kStreamBufferSize bytes. Returns false if reading or inflating fails, if the report
+// does not inflate to exactly mRawSize bytes, or if sink returns false.
+static bool readReportRecord(int fd, const ReportRecordHeader& header,
+                             const std::function<bool(const uint8_t*, size_t)>& sink) {
+    unique_ptr<uint8_t[]> input(new uint8_t[kStreamBufferSize]);
+    size_t remaining = header.mStoredSize;
+    if (header.mEncoding == REPORT_ENCODING_NONE) {
+        while (remaining > 0) {
+            size_t toRead = std::min(remaining, kStreamBufferSize);
+            if (!android::base::ReadFully(fd, input.get(), toRead) || !sink(input.get(), toRead)) {
+                return false;
+            }
+            remaining -= toRead;
+        }
+        return true;
+    }
+
+    unique_ptr<uint8_t[]> output(new uint8_t[kStreamBufferSize]);
+    z_stream stream = {};
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    size_t produced = 0;
+    int result = Z_OK;
+    while (result == Z_OK) {
+        if (stream.avail_in == 0 && remaining > 0) {
+            size_t toRead = std::min(remaining, kStreamBufferSize);
+            if (!android::base::ReadFully(fd, input.get(), toRead)) {
+                break;
+            }
+            remaining -= toRead;
+            stream.next_in = input.get();
+            stream.avail_in = toRead;
+        }
+        stream.next_out = output.get();
+        stream.avail_out = kStreamBufferSize;
+        result = inflate(&stream, Z_NO_FLUSH);
+        size_t inflated = kStreamBufferSize - stream.avail_out;
+        if ((result != Z_OK && result != Z_STREAM_END) || produced + inflated > header.mRawSize ||
+            !sink(output.get(), inflated)) {
+            result = Z_DATA_ERROR;
+            break;
+        }
+        produced += inflated;
+    }
+    inflateEnd(&stream);
+    return result == Z_STREAM_END && produced == header.mRawSize;
+}
+
+int StorageManager::openFileForWrite(const char* file) {
     int fd = open(file, O_WRONLY | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
     if (fd == -1) {
         VLOG("Attempt to access %s but failed", file);
+        return -1;
+    }
+
+    int result = fchown(fd, AID_STATSD, AID_STATSD);
+    if (result) {
+        VLOG("Failed to chown %s to statsd", file);
+    }
+    return fd;
+}
+
+void StorageManager::onFileWritten(const char* file) {
+    struct stat fileStat;
+    int64_t sizeBytes = stat(file, &fileStat) == 0 ? fileStat.st_size : 0;
+
+    std::lock_guard<std::mutex> lock(sIndexMutex);
+    noteFileWrittenLocked(file, sizeBytes, false /* appendable */);
+    trimToFitLocked(STATS_SERVICE_DIR);
+    trimToFitLocked(STATS_DATA_DIR);
+}
+
+void StorageManager::writeFile(const char* file, const void* buffer, int numBytes) {
+    int fd = openFileForWrite(file);
+    if (fd == -1) {
         return;
     }
-    trimToFit(STATS_SERVICE_DIR);
-    trimToFit(STATS_DATA_DIR);
 
     if (android::base::WriteFully(fd, buffer, numBytes)) {
         VLOG("Successfully wrote %s", file);
@@ -138,12 +474,100 @@ void StorageManager::writeFile(const char* file, const void* buffer, int numByte
         ALOGE("Failed to write %s", file);
     }
 
-    int result = fchown(fd, AID_STATSD, AID_STATSD);
-    if (result) {
-        VLOG("Failed to chown %s to statsd", file);
+    close(fd);
+    onFileWritten(file);
+}
+
+void StorageManager::writeFile(const char* file, ProtoOutputStream* proto) {
+    int fd = openFileForWrite(file);
+    if (fd == -1) {
+        return;
+    }
+
+    if (proto->flush(fd)) {
+        VLOG("Successfully wrote %s", file);
+    } else {
+        ALOGE("Failed to write %s", file);
     }
 
     close(fd);
+    onFileWritten(file);
+}
+
+void StorageManager::setReportRecordsEnabled(bool enabled) {
+    sReportRecordsEnabled = enabled;
+}
+
+void StorageManager::writeConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
+                                              bool isHistory) {
+    // Older statsd builds read every data file as one raw ConfigMetricsReport. Unless records are
+    // enabled, reports are written that way, so that a rollback of statsd can still upload them.
+    const bool writeRecord = sReportRecordsEnabled;
+
+    // Compress before taking the lock. Keep the report raw if that does not make it smaller.
+    const size_t rawSize = proto->size();
+    vector<uint8_t> deflated;
+    ReportRecordHeader header = {(uint32_t)rawSize, (uint32_t)rawSize, REPORT_ENCODING_NONE};
+    if (writeRecord && deflateProto(proto, rawSize, &deflated) && deflated.size() < rawSize) {
+        header.mStoredSize = deflated.size();
+        header.mEncoding = REPORT_ENCODING_DEFLATE;
+    }
+
+    std::lock_guard<std::mutex> lock(sIndexMutex);
+    const long nowSec = getWallClockSec();
+    string fileName;
+    int fd = -1;
+    bool success = true;
+    if (writeRecord && !isHistory) {
+        DirIndex* index = getIndexLocked(STATS_DATA_DIR);
+        string name = findAppendableReportFileLocked(*index, key, nowSec);
+        if (!name.empty()) {
+            fileName = StringPrintf("%s/%s", STATS_DATA_DIR, name.c_str());
+            fd = open(fileName.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+        }
+    }
+    if (fd == -1) {
+        // Never append to a file that already exists: it may be in the middle of being read.
+        for (int i = 0; fd == -1 && i < kMaxReportFileNameAttempts; i++) {
+            fileName = isHistory ? getDataHistoryFileName(nowSec + i, key.GetUid(), key.GetId())
+                                 : getDataFileName(nowSec + i, key.GetUid(), key.GetId());
+            fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                      S_IRUSR | S_IWUSR);
+        }
+        if (fd == -1) {
+            ALOGE("Failed to create a report file for %s", key.ToString().c_str());
+            return;
+        }
+        if (fchown(fd, AID_STATSD, AID_STATSD)) {
+            VLOG("Failed to chown %s to statsd", fileName.c_str());
+        }
+        if (writeRecord) {
+            success = android::base::WriteFully(fd, REPORT_FILE_MAGIC, sizeof(REPORT_FILE_MAGIC));
+        }
+    }
+
+    if (writeRecord) {
+        success = success && android::base::WriteFully(fd, &header, sizeof(header));
+    }
+    if (success) {
+        success = header.mEncoding == REPORT_ENCODING_DEFLATE
+                          ? android::base::WriteFully(fd, deflated.data(), deflated.size())
+                          : proto->flush(fd);
+    }
+    if (success) {
+        VLOG("Successfully wrote %s", fileName.c_str());
+    } else {
+        ALOGE("Failed to write %s", fileName.c_str());
+    }
+
+    struct stat fileStat;
+    int64_t sizeBytes = fstat(fd, &fileStat) == 0 ? fileStat.st_size : 0;
+    close(fd);
+    // A failed write can leave an incomplete record at the end of the file. Readers stop there,
+    // so nothing may be appended after it.
+    noteFileWrittenLocked(fileName, sizeBytes, writeRecord && !isHistory && success);
+    trimToFitLocked(STATS_SERVICE_DIR);
+    trimToFitLocked(STATS_DATA_DIR);
 }
 
 bool StorageManager::writeTrainInfo(const InstallTrainInfo& trainInfo) {
@@ -413,11 +837,17 @@ vector<InstallTrainInfo> StorageManager::readAllTrainInfo() {
 }
 
 void StorageManager::deleteFile(const char* file) {
+    std::lock_guard<std::mutex> lock(sIndexMutex);
+    deleteFileLocked(file);
+}
+
+void StorageManager::deleteFileLocked(const char* file) {
     if (remove(file) != 0) {
         VLOG("Attempt to delete %s but is not found", file);
     } else {
         VLOG("Successfully deleted %s", file);
     }
+    noteFileRemovedLocked(file);
 }
 
 void StorageManager::deleteAllFiles(const char* path) {
@@ -478,81 +908,116 @@ void StorageManager::sendBroadcast(const char* path,
 }
 
 bool StorageManager::hasConfigMetricsReport(const ConfigKey& key) {
-    unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
-    if (dir == NULL) {
-        VLOG("Path %s does not exist", STATS_DATA_DIR);
-        return false;
-    }
-
-    string suffix = StringPrintf("%d_%lld", key.GetUid(), (long long)key.GetId());
-
-    dirent* de;
-    while ((de = readdir(dir.get()))) {
-        char* name = de->d_name;
-        if (name[0] == '.') continue;
-
-        size_t nameLen = strlen(name);
-        size_t suffixLen = suffix.length();
-        if (suffixLen <= nameLen &&
-            strncmp(name + nameLen - suffixLen, suffix.c_str(), suffixLen) == 0) {
-            // Check again that the file name is parseable.
-            FileName output;
-            parseFileName(name, &output);
-            if (output.mTimestampSec == -1 || output.mIsHistory) continue;
+    std::lock_guard<std::mutex> lock(sIndexMutex);
+    const DirIndex* index = getIndexLocked(STATS_DATA_DIR);
+    for (const auto& pair : index->mFiles) {
+        const FileName& name = pair.second.mName;
+        if (!name.mIsHistory && name.mUid == key.GetUid() && name.mConfigId == key.GetId()) {
             return true;
         }
     }
     return false;
 }
 
-void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
-                                               bool erase_data, bool isAdb) {
-    unique_ptr<DIR, decltype(&closedir)> dir(opendir(STATS_DATA_DIR), closedir);
-    if (dir == NULL) {
-        VLOG("Path %s does not exist", STATS_DATA_DIR);
-        return;
-    }
-
-    dirent* de;
-    while ((de = readdir(dir.get()))) {
-        char* name = de->d_name;
-        string fileName(name);
-        if (name[0] == '.') continue;
-        FileName output;
-        parseFileName(name, &output);
-
-        if (output.mTimestampSec == -1 || (output.mIsHistory && !isAdb) ||
-            output.mUid != key.GetUid() || output.mConfigId != key.GetId()) {
-            continue;
+void StorageManager::forEachConfigMetricsReportFile(const ConfigKey& key, bool erase_data,
+                                                    bool isAdb,
+                                                    const std::function<bool(int fd)>& handler) {
+    vector<std::pair<string, bool>> files;
+    {
+        std::lock_guard<std::mutex> lock(sIndexMutex);
+        DirIndex* index = getIndexLocked(STATS_DATA_DIR);
+        for (auto& pair : index->mFiles) {
+            const FileName& name = pair.second.mName;
+            if ((name.mIsHistory && !isAdb) || name.mUid != key.GetUid() ||
+                name.mConfigId != key.GetId()) {
+                continue;
+            }
+            // Reports written from now on start a new file, so none can be appended to a file
+            // that is about to be deleted or renamed.
+            pair.second.mAppendable = false;
+            files.emplace_back(pair.first, name.mIsHistory);
         }
+    }
 
-        auto fullPathName = StringPrintf("%s/%s", STATS_DATA_DIR, fileName.c_str());
+    // The handler may block on a slow reader, so the files are read without holding the lock.
+    for (const auto& file : files) {
+        auto fullPathName = StringPrintf("%s/%s", STATS_DATA_DIR, file.first.c_str());
         int fd = open(fullPathName.c_str(), O_RDONLY | O_CLOEXEC);
         if (fd != -1) {
-            string content;
-            if (android::base::ReadFdToString(fd, &content)) {
-                proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
-                             content.c_str(), content.size());
-            }
+            bool keepGoing = handler(fd);
             close(fd);
+            if (!keepGoing) {
+                // Leave the file on disk so that the data is not lost.
+                return;
+            }
         } else {
             ALOGE("file cannot be opened");
         }
 
+        std::lock_guard<std::mutex> lock(sIndexMutex);
         if (erase_data) {
-            remove(fullPathName.c_str());
-        } else if (!output.mIsHistory && !isAdb) {
+            deleteFileLocked(fullPathName.c_str());
+        } else if (!file.second && !isAdb) {
             // This means a real data owner has called to get this data. But the config says it
             // wants to keep a local history. So now this file must be renamed as a history file.
             // So that next time, when owner calls getData() again, this data won't be uploaded
             // again. rename returns 0 on success
             if (rename(fullPathName.c_str(), (fullPathName + "_history").c_str())) {
                 ALOGE("Failed to rename file %s", fullPathName.c_str());
+            } else {
+                noteFileRenamedLocked(fullPathName, fullPathName + "_history");
             }
         }
     }
 }
 
+void StorageManager::appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
+                                               bool erase_data, bool isAdb) {
+    forEachConfigMetricsReportFile(key, erase_data, isAdb, [proto](int fd) {
+        // Only one report is held in memory at a time.
+        forEachReportRecord(fd, [fd, proto](const ReportRecordHeader& header) {
+            string content;
+            content.reserve(header.mRawSize);
+            if (readReportRecord(fd, header, [&content](const uint8_t* data, size_t size) {
+                    content.append(reinterpret_cast<const char*>(data), size);
+                    return true;
+                })) {
+                proto->write(FIELD_TYPE_MESSAGE | FIELD_COUNT_REPEATED | FIELD_ID_REPORTS,
+                             content.c_str(), content.size());
+            }
+            return true;
+        });
+        return true;
+    });
+}
+
+ssize_t StorageManager::appendConfigMetricsReport(const ConfigKey& key, int outFd,
+                                                  bool erase_data, bool isAdb) {
+    ssize_t totalBytes = 0;
+    bool success = true;
+    forEachConfigMetricsReportFile(key, erase_data, isAdb, [&](int fd) {
+        forEachReportRecord(fd, [&](const ReportRecordHeader& header) {
+            ssize_t headerSize =
+                    writeLengthDelimitedHeaderToFd(outFd, FIELD_ID_REPORTS, header.mRawSize);
+            if (headerSize < 0) {
+                success = false;
+                return false;
+            }
+            totalBytes += headerSize;
+
+            // The header is already out, so anything short of exactly mRawSize bytes leaves the
+            // output malformed and fails the whole dump.
+            success = readReportRecord(fd, header, [&](const uint8_t* data, size_t size) {
+                totalBytes += size;
+                return android::base::WriteFully(outFd, data, size);
+            });
+            return success;
+        });
+        return success;
+    });
+    return success ? totalBytes : -1;
+}
+
 bool StorageManager::readFileToString(const char* file, string* content) {
     int fd = open(file, O_RDONLY | O_CLOEXEC);
     bool res = false;
@@ -676,6 +1141,11 @@ void StorageManager::sortFiles(vector<FileInfo>* fileNames) {
 }
 
 void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
+    if (!parseTimestampOnly && isIndexedDir(path)) {
+        std::lock_guard<std::mutex> lock(sIndexMutex);
+        trimToFitLocked(path);
+        return;
+    }
     unique_ptr<DIR, decltype(&closedir)> dir(opendir(path), closedir);
     if (dir == NULL) {
         VLOG("Path %s does not exist", path);
@@ -734,6 +1204,46 @@ void StorageManager::trimToFit(const char* path, bool parseTimestampOnly) {
     }
 }
 
+void StorageManager::trimToFitLocked(const char* path) {
+    DirIndex* index = getIndexLocked(path);
+    if (index == nullptr) {
+        return;
+    }
+    auto nowSec = getWallClockSec();
+    vector<string> expiredFiles;
+    for (const auto& pair : index->mFiles) {
+        const FileName& name = pair.second.mName;
+        // Check for timestamp and delete if it's too old.
+        long fileAge = nowSec - name.mTimestampSec;
+        if (fileAge > StatsdStats::kMaxAgeSecond ||
+            (name.mIsHistory && fileAge > StatsdStats::kMaxLocalHistoryAgeSecond)) {
+            expiredFiles.push_back(StringPrintf("%s/%s", path, pair.first.c_str()));
+        }
+    }
+    for (const string& file : expiredFiles) {
+        deleteFileLocked(file.c_str());
+    }
+
+    if (index->mFiles.size() <= StatsdStats::kMaxFileNumber &&
+        index->mTotalBytes <= StatsdStats::kMaxFileSize) {
+        return;
+    }
+    vector<FileInfo> fileNames;
+    for (const auto& pair : index->mFiles) {
+        fileNames.emplace_back(StringPrintf("%s/%s", path, pair.first.c_str()),
+                               pair.second.mName.mIsHistory, pair.second.mSizeBytes,
+                               nowSec - pair.second.mName.mTimestampSec);
+    }
+    sortFiles(&fileNames);
+
+    // Start removing files from oldest to be under the limit.
+    while (fileNames.size() > 0 && (index->mFiles.size() > StatsdStats::kMaxFileNumber ||
+                                    index->mTotalBytes > StatsdStats::kMaxFileSize)) {
+        deleteFileLocked(fileNames.back().mFileName.c_str());
+        fileNames.pop_back();
+    }
+}
+
 void StorageManager::printStats(int outFd) {
     printDirStats(outFd, STATS_SERVICE_DIR);
     printDirStats(outFd, STATS_DATA_DIR);
@@ -21,6 +21,8 @@
 #include <utils/Log.h>
 #include <utils/RefBase.h>
 
+#include <atomic>
+
 #include "packages/UidMap.h"
 
 namespace android {
@@ -49,6 +51,29 @@ public:
      */
     static void writeFile(const char* file, const void* buffer, int numBytes);
 
+    /**
+     * Writes the serialized proto as a file to the specified file path without first copying it
+     * into a contiguous buffer.
+     */
+    static void writeFile(const char* file, ProtoOutputStream* proto);
+
+    /**
+     * Persists a ConfigMetricsReport of the config in the stats-data directory. With report
+     * records enabled, data reports are appended to the config's current report file while that
+     * file is recent and small, so that frequent flushes do not create a file each. Local history
+     * reports always start a new file. Otherwise each report is written to a file of its own.
+     */
+    static void writeConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
+                                         bool isHistory);
+
+    /**
+     * Turns the record format of writeConfigMetricsReport on or off. Records may be appended and
+     * deflated, but statsd builds that predate the format can not read them. It is off by
+     * default so that a rollback keeps the data on disk readable. Reports already on disk stay
+     * readable either way.
+     */
+    static void setReportRecordsEnabled(bool enabled);
+
     /**
      * Writes train info.
      */
@@ -117,6 +142,15 @@ public:
     static void appendConfigMetricsReport(const ConfigKey& key, ProtoOutputStream* proto,
                                           bool erase_data, bool isAdb);
 
+    /**
+     * Same as above, but streams each ConfigMetricsReport found on disk to outFd as a
+     * ConfigMetricsReportList.reports field through a fixed-size buffer, so that the files are
+     * never read into memory as a whole. Returns the number of bytes written, or -1 if writing
+     * to outFd failed.
+     */
+    static ssize_t appendConfigMetricsReport(const ConfigKey& key, int outFd, bool erase_data,
+                                             bool isAdb);
+
     /**
      * Call to load the saved configs from disk.
      */
@@ -153,12 +187,40 @@ public:
     static void sortFiles(vector<FileInfo>* fileNames);
 
 private:
+    /**
+     * Opens a data file for writing. Returns -1 on failure.
+     */
+    static int openFileForWrite(const char* file);
+
+    /**
+     * Records the new size of a file written to disk in the index, then trims the statsd
+     * directories to fit.
+     */
+    static void onFileWritten(const char* file);
+
+    static void deleteFileLocked(const char* file);
+
+    static void trimToFitLocked(const char* dir);
+
+    /**
+     * Calls the handler with an open fd for each ConfigMetricsReport file on disk for the key,
+     * then deletes or renames the file as described in appendConfigMetricsReport. Stops early
+     * if the handler returns false.
+     */
+    static void forEachConfigMetricsReportFile(const ConfigKey& key, bool erase_data, bool isAdb,
+                                               const std::function<bool(int fd)>& handler);
+
     /**
      * Prints disk usage statistics about a directory related to statsd.
      */
     static void printDirStats(int out, const char* path);
 
     static std::mutex sTrainInfoMutex;
+
+    // Guards the in-memory index of the files in the stats-data and stats-service directories.
+    static std::mutex sIndexMutex;
+
+    static std::atomic<bool> sReportRecordsEnabled;
 };
 
 }  // namespace statsd
@@ -394,6 +394,58 @@ TEST(AtomMatcherTest, TestUidFieldMatcher) {
     EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event2));
 }
 
+TEST(AtomMatcherTest, TestUidFieldMatcherWithPackageUidIndex) {
+    UidMap uidMap;
+    uidMap.updateMap(
+            1, {1111, 1111, 2222, 3333, 3333} /* uid list */, {1, 1, 2, 1, 2} /* version list */,
+            {android::String16("v1"), android::String16("v1"), android::String16("v2"),
+             android::String16("v1"), android::String16("v2")},
+            {android::String16("pkg0"), android::String16("pkg1"), android::String16("pkg1"),
+             android::String16("Pkg2"), android::String16("PkG3")} /* package name list */,
+            {android::String16(""), android::String16(""), android::String16(""),
+             android::String16(""), android::String16("")});
+
+    // Set up matcher
+    AtomMatcher matcher;
+    auto simpleMatcher = matcher.mutable_simple_atom_matcher();
+    simpleMatcher->set_atom_id(TAG_ID_2);
+    auto fieldMatcher = simpleMatcher->add_field_value_matcher();
+    fieldMatcher->set_field(1);
+    fieldMatcher->mutable_eq_any_string()->add_str_value("pkg2");
+    fieldMatcher->mutable_eq_any_string()->add_str_value("pkg4");
+    fieldMatcher->mutable_eq_any_string()->add_str_value("AID_SYSTEM");
+
+    PackageUidIndex packageUids;
+    packageUids.addNamesFromMatcher(*simpleMatcher);
+    packageUids.rebuild(uidMap);
+
+    LogEvent event1(/*uid=*/0, /*pid=*/0);
+    makeIntWithBoolAnnotationLogEvent(&event1, TAG_ID_2, 3333, ANNOTATION_ID_IS_UID, true);
+    LogEvent event2(/*uid=*/0, /*pid=*/0);
+    makeIntWithBoolAnnotationLogEvent(&event2, TAG_ID_2, 4444, ANNOTATION_ID_IS_UID, true);
+    LogEvent event3(/*uid=*/0, /*pid=*/0);
+    makeIntWithBoolAnnotationLogEvent(&event3, TAG_ID_2, 1000, ANNOTATION_ID_IS_UID, true);
+
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event1, &packageUids));
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event2, &packageUids));
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event3, &packageUids));
+
+    // Install pkg4.
+    uidMap.updateApp(2, android::String16("pkg4"), 4444, 1, android::String16("v1"),
+                     android::String16(""));
+    packageUids.onAppChanged(uidMap, "pkg4", 4444);
+    EXPECT_TRUE(matchesSimple(uidMap, *simpleMatcher, event2, &packageUids));
+    EXPECT_EQ(matchesSimple(uidMap, *simpleMatcher, event2),
+              matchesSimple(uidMap, *simpleMatcher, event2, &packageUids));
+
+    // Remove Pkg2.
+    uidMap.removeApp(3, android::String16("Pkg2"), 3333);
+    packageUids.onAppChanged(uidMap, "Pkg2", 3333);
+    EXPECT_FALSE(matchesSimple(uidMap, *simpleMatcher, event1, &packageUids));
+    EXPECT_EQ(matchesSimple(uidMap, *simpleMatcher, event1),
+              matchesSimple(uidMap, *simpleMatcher, event1, &packageUids));
+}
+
 TEST(AtomMatcherTest, TestNeqAnyStringMatcher) {
     UidMap uidMap;
     uidMap.updateMap(
@@ -738,6 +738,167 @@ TEST(MetricsManagerTest, TestLogSources) {
     EXPECT_TRUE(isSubset(defaultPullUids, set<int32_t>(atom3Uids.begin(), atom3Uids.end())));
 }
 
+TEST(MetricsManagerTest, TestUpdateConfigPreservesUnchangedMetrics) {
+    sp<UidMap> uidMap = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+
+    StatsdConfig config = buildGoodConfig();
+    config.add_allowed_log_source("AID_SYSTEM");
+    CountMetric* metric = config.add_count_metric();
+    metric->set_id(4);
+    metric->set_what(StringToId("SCREEN_IS_OFF"));
+    metric->set_bucket(ONE_MINUTE);
+
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+    metricsManager.init();
+    ASSERT_EQ(2, metricsManager.mAllMetricProducers.size());
+    sp<MetricProducer> unchangedProducer = metricsManager.mAllMetricProducers[0];
+    sp<MetricProducer> changedProducer = metricsManager.mAllMetricProducers[1];
+    sp<LogMatchingTracker> matcher = metricsManager.mAllAtomMatchers[0];
+    ASSERT_EQ(1, metricsManager.mAllAnomalyTrackers.size());
+    sp<AnomalyTracker> anomalyTracker = metricsManager.mAllAnomalyTrackers[0];
+
+    // Change metric 4 and add metric 5. Metric 3 and its alert are untouched.
+    StatsdConfig newConfig = config;
+    newConfig.mutable_count_metric(1)->set_bucket(FIVE_MINUTES);
+    metric = newConfig.add_count_metric();
+    metric->set_id(5);
+    metric->set_what(StringToId("SCREEN_ON_OR_OFF"));
+    metric->set_bucket(ONE_MINUTE);
+
+    EXPECT_TRUE(metricsManager.updateConfig(newConfig, timeBaseSec, timeBaseSec + 10,
+                                            anomalyAlarmMonitor));
+    EXPECT_TRUE(metricsManager.isConfigValid());
+    ASSERT_EQ(3, metricsManager.mAllMetricProducers.size());
+    EXPECT_EQ(unchangedProducer, metricsManager.mAllMetricProducers[0]);
+    EXPECT_NE(changedProducer, metricsManager.mAllMetricProducers[1]);
+    EXPECT_EQ(4, metricsManager.mAllMetricProducers[1]->getMetricId());
+    EXPECT_EQ(5, metricsManager.mAllMetricProducers[2]->getMetricId());
+    EXPECT_EQ(matcher, metricsManager.mAllAtomMatchers[0]);
+    ASSERT_EQ(1, metricsManager.mAllAnomalyTrackers.size());
+    EXPECT_EQ(anomalyTracker, metricsManager.mAllAnomalyTrackers[0]);
+    EXPECT_EQ(set<int64_t>({3}), metricsManager.mNoReportMetricIds);
+
+    // The replaced producer of metric 4 is kept for one more report, then released.
+    ASSERT_EQ(1, metricsManager.mRemovedMetricProducers.size());
+    EXPECT_EQ(changedProducer, metricsManager.mRemovedMetricProducers[0]);
+    android::util::ProtoOutputStream output;
+    std::set<string> strSet;
+    metricsManager.onDumpRemovedMetricsReport(timeBaseSec + 10, FAST, &strSet, &output);
+    EXPECT_LT(0, output.size());
+    EXPECT_FALSE(metricsManager.hasRemovedMetrics());
+
+    // SCREEN_IS_ON feeds metric 3, SCREEN_IS_OFF metric 4, and their combination metric 5.
+    EXPECT_EQ(vector<int>({0}), metricsManager.mTrackerToMetricMap[0]);
+    EXPECT_EQ(vector<int>({1}), metricsManager.mTrackerToMetricMap[1]);
+    EXPECT_EQ(vector<int>({2}), metricsManager.mTrackerToMetricMap[2]);
+
+    // Remove metric 4. Metric 5 moves down and keeps its producer.
+    sp<MetricProducer> addedProducer = metricsManager.mAllMetricProducers[2];
+    StatsdConfig removedConfig = newConfig;
+    removedConfig.mutable_count_metric()->DeleteSubrange(1, 1);
+    EXPECT_TRUE(metricsManager.updateConfig(removedConfig, timeBaseSec, timeBaseSec + 20,
+                                            anomalyAlarmMonitor));
+    ASSERT_EQ(2, metricsManager.mAllMetricProducers.size());
+    EXPECT_EQ(unchangedProducer, metricsManager.mAllMetricProducers[0]);
+    EXPECT_EQ(addedProducer, metricsManager.mAllMetricProducers[1]);
+    EXPECT_EQ(0, metricsManager.mTrackerToMetricMap.count(1));
+    EXPECT_EQ(vector<int>({1}), metricsManager.mTrackerToMetricMap[2]);
+
+    // Changing a matcher requires a full rebuild.
+    StatsdConfig matcherConfig = removedConfig;
+    matcherConfig.mutable_atom_matcher(0)
+            ->mutable_simple_atom_matcher()
+            ->mutable_field_value_matcher(0)
+            ->set_eq_int(3);
+    EXPECT_FALSE(metricsManager.updateConfig(matcherConfig, timeBaseSec, timeBaseSec + 30,
+                                             anomalyAlarmMonitor));
+    EXPECT_EQ(unchangedProducer, metricsManager.mAllMetricProducers[0]);
+}
+
+TEST(MetricsManagerTest, TestUpdateConfigWithTrueSlicedCondition) {
+    sp<UidMap> uidMap = new UidMap();
+    sp<StatsPullerManager> pullerManager = new StatsPullerManager();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+
+    StatsdConfig config;
+    config.set_id(12345);
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+    *config.add_atom_matcher() = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = CreateReleaseWakelockAtomMatcher();
+    Predicate holdingWakelockPredicate = CreateHoldingWakelockPredicate();
+    *holdingWakelockPredicate.mutable_simple_predicate()->mutable_dimensions() =
+            CreateAttributionUidDimensions(util::WAKELOCK_STATE_CHANGED, {Position::FIRST});
+    *config.add_predicate() = holdingWakelockPredicate;
+    CountMetric* metric = config.add_count_metric();
+    metric->set_id(1);
+    metric->set_what(StringToId("AcquireWakelock"));
+    metric->set_condition(holdingWakelockPredicate.id());
+    metric->set_bucket(ONE_MINUTE);
+
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+    metricsManager.init();
+
+    // Only the slice of uid 111 is true, so the predicate is true overall.
+    std::unique_ptr<LogEvent> event =
+            CreateAcquireWakelockEvent(timeBaseSec + 5, {111}, {"App1"}, "wl1");
+    metricsManager.onLogEvent(*event);
+    EXPECT_EQ(ConditionState::kTrue, metricsManager.mAllMetricProducers[0]->mCondition);
+
+    StatsdConfig newConfig = config;
+    metric = newConfig.add_count_metric();
+    metric->set_id(2);
+    metric->set_what(StringToId("ReleaseWakelock"));
+    metric->set_condition(holdingWakelockPredicate.id());
+    metric->set_bucket(ONE_MINUTE);
+
+    EXPECT_TRUE(metricsManager.updateConfig(newConfig, timeBaseSec, timeBaseSec + 10,
+                                            anomalyAlarmMonitor));
+    ASSERT_EQ(2, metricsManager.mAllMetricProducers.size());
+    EXPECT_EQ(2, metricsManager.mAllMetricProducers[1]->getMetricId());
+    EXPECT_EQ(ConditionState::kTrue, metricsManager.mAllMetricProducers[1]->mCondition);
+}
+
+TEST(MetricsManagerTest, TestUpdateConfigUnregistersRemovedPulls) {
+    sp<UidMap> uidMap = new UidMap();
+    sp<MockStatsPullerManager> pullerManager = new NiceMock<MockStatsPullerManager>();
+    sp<AlarmMonitor> anomalyAlarmMonitor;
+    sp<AlarmMonitor> periodicAlarmMonitor;
+
+    StatsdConfig config;
+    config.set_id(12345);
+    AtomMatcher pulledAtomMatcher =
+            CreateSimpleAtomMatcher("SUBSYSTEM_SLEEP", util::SUBSYSTEM_SLEEP_STATE);
+    *config.add_atom_matcher() = pulledAtomMatcher;
+    GaugeMetric* metric = config.add_gauge_metric();
+    metric->set_id(1);
+    metric->set_what(pulledAtomMatcher.id());
+    metric->mutable_gauge_fields_filter()->set_include_all(true);
+    metric->set_bucket(ONE_MINUTE);
+
+    MetricsManager metricsManager(kConfigKey, config, timeBaseSec, timeBaseSec, uidMap,
+                                  pullerManager, anomalyAlarmMonitor, periodicAlarmMonitor);
+    ASSERT_TRUE(metricsManager.isConfigValid());
+    metricsManager.init();
+
+    // The removed metric is kept for one more report, but its pulls stop right away.
+    EXPECT_CALL(*pullerManager, UnRegisterReceiver(util::SUBSYSTEM_SLEEP_STATE, kConfigKey, _))
+            .Times(1);
+    StatsdConfig newConfig = config;
+    newConfig.clear_gauge_metric();
+    EXPECT_TRUE(metricsManager.updateConfig(newConfig, timeBaseSec, timeBaseSec + 10,
+                                            anomalyAlarmMonitor));
+    EXPECT_TRUE(metricsManager.hasRemovedMetrics());
+    EXPECT_TRUE(Mock::VerifyAndClearExpectations(pullerManager.get()));
+}
+
 TEST(MetricsManagerTest, TestCheckLogCredentialsWhitelistedAtom) {
     sp<UidMap> uidMap;
     sp<StatsPullerManager> pullerManager = new StatsPullerManager();
@@ -14,6 +14,7 @@
 
 #include "StatsLogProcessor.h"
 
+#include <android-base/file.h>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
@@ -300,6 +301,52 @@ TEST(StatsLogProcessorTest, TestOnDumpReportEraseData) {
     EXPECT_TRUE(noData);
 }
 
+TEST(StatsLogProcessorTest, TestOnDumpReportToFd) {
+    // Setup a simple config.
+    StatsdConfig config;
+    config.add_allowed_log_source("AID_ROOT");  // LogEvent defaults to UID of root.
+    auto wakelockAcquireMatcher = CreateAcquireWakelockAtomMatcher();
+    *config.add_atom_matcher() = wakelockAcquireMatcher;
+
+    auto countMetric = config.add_count_metric();
+    countMetric->set_id(123456);
+    countMetric->set_what(wakelockAcquireMatcher.id());
+    countMetric->set_bucket(FIVE_MINUTES);
+
+    ConfigKey cfgKey;
+    sp<StatsLogProcessor> processor = CreateStatsLogProcessor(1, 1, config, cfgKey);
+
+    std::vector<int> attributionUids = {111};
+    std::vector<string> attributionTags = {"App1"};
+    std::unique_ptr<LogEvent> event =
+            CreateAcquireWakelockEvent(2 /*timestamp*/, attributionUids, attributionTags, "wl1");
+    processor->OnLogEvent(event.get());
+
+    // Dump report WITHOUT erasing data into a buffer.
+    vector<uint8_t> bytes;
+    processor->onDumpReport(cfgKey, 3, true, false /* Do NOT erase data. */, ADB_DUMP, FAST,
+                            &bytes);
+    ConfigMetricsReportList bufferOutput;
+    ASSERT_TRUE(bufferOutput.ParseFromArray(bytes.data(), bytes.size()));
+
+    // Stream the same report into a file.
+    TemporaryFile tmp;
+    ASSERT_TRUE(processor->onDumpReport(cfgKey, 3, true, true /* DO erase data. */, ADB_DUMP,
+                                        FAST, tmp.fd));
+    string content;
+    ASSERT_TRUE(android::base::ReadFileToString(tmp.path, &content));
+    ConfigMetricsReportList fdOutput;
+    ASSERT_TRUE(fdOutput.ParseFromString(content));
+
+    EXPECT_EQ(bufferOutput.config_key().uid(), fdOutput.config_key().uid());
+    EXPECT_EQ(bufferOutput.config_key().id(), fdOutput.config_key().id());
+    ASSERT_EQ(1, fdOutput.reports_size());
+    ASSERT_EQ(1, fdOutput.reports(0).metrics_size());
+    EXPECT_EQ(bufferOutput.reports(0).metrics(0).SerializeAsString(),
+              fdOutput.reports(0).metrics(0).SerializeAsString());
+    EXPECT_EQ(3, fdOutput.reports(0).current_report_elapsed_nanos());
+}
+
 TEST(StatsLogProcessorTest, TestPullUidProviderSetOnConfigUpdate) {
     // Setup simple config key corresponding to empty config.
     sp<UidMap> m = new UidMap();
@@ -731,6 +731,49 @@ TEST(SimpleConditionTrackerTest, TestStopAll) {
     }
 }
 
+TEST(SimpleConditionTrackerTest, TestSlicedConditionStateRecyclesSlots) {
+    SlicedConditionState state;
+    const string conditionName = "WL_HELD_BY_UID";
+    HashableDimensionKey key1 = getWakeLockQueryKey(Position::FIRST, {111}, conditionName)
+            [StringToId(conditionName)];
+    HashableDimensionKey key2 = getWakeLockQueryKey(Position::FIRST, {222}, conditionName)
+            [StringToId(conditionName)];
+    HashableDimensionKey key3 = getWakeLockQueryKey(Position::FIRST, {333}, conditionName)
+            [StringToId(conditionName)];
+
+    EXPECT_EQ(SlicedConditionState::kNoSlot, state.find(key1));
+    EXPECT_FALSE(state.anyTrue());
+
+    int slot1 = state.insert(key1, 1);
+    int slot2 = state.insert(key2, 0);
+    EXPECT_EQ(slot1, state.find(key1));
+    EXPECT_EQ(slot2, state.find(key2));
+    EXPECT_EQ(2UL, state.size());
+    EXPECT_TRUE(state.anyTrue());
+
+    state.setStartedCount(slot1, 2);
+    EXPECT_TRUE(state.anyTrue());
+    state.setStartedCount(slot1, 0);
+    EXPECT_FALSE(state.anyTrue());
+
+    // Erased slots are handed out again to new keys.
+    state.erase(slot1);
+    EXPECT_EQ(SlicedConditionState::kNoSlot, state.find(key1));
+    EXPECT_EQ(1UL, state.size());
+    int slot3 = state.insert(key3, 1);
+    EXPECT_EQ(slot1, slot3);
+    EXPECT_EQ(key3, state.key(slot3));
+    EXPECT_TRUE(state.anyTrue());
+
+    int visited = 0;
+    state.forEach([&visited](const HashableDimensionKey&, int) { visited++; });
+    EXPECT_EQ(2, visited);
+
+    state.clear();
+    EXPECT_TRUE(state.empty());
+    EXPECT_FALSE(state.anyTrue());
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
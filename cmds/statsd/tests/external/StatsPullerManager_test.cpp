@@ -86,6 +86,19 @@ public:
     }
 };
 
+class FakePullDataReceiver : public PullDataReceiver {
+public:
+    void onDataPulled(const vector<shared_ptr<LogEvent>>& data, bool pullSuccess,
+                      int64_t originalPullTimeNs) override {
+        mNumPulls++;
+        mLastData = data;
+        mLastPullTimeNs = originalPullTimeNs;
+    }
+    int mNumPulls = 0;
+    vector<shared_ptr<LogEvent>> mLastData;
+    int64_t mLastPullTimeNs = 0;
+};
+
 sp<StatsPullerManager> createPullerManagerAndRegister() {
     sp<StatsPullerManager> pullerManager = new StatsPullerManager();
     shared_ptr<FakePullAtomCallback> cb1 = SharedRefBase::make<FakePullAtomCallback>(uid1);
@@ -145,6 +158,43 @@ TEST(StatsPullerManagerTest, TestPullConfigKeyNoPullerWithUid) {
     EXPECT_FALSE(pullerManager->Pull(pullTagId2, configKey, /*timestamp =*/1, &data, true));
 }
 
+TEST(StatsPullerManagerTest, TestAlarmCoalescesPullsWithinTolerance) {
+    sp<StatsPullerManager> pullerManager = createPullerManagerAndRegister();
+    pullerManager->SetPullCoalesceToleranceNs(5 * NS_PER_SEC);
+    ConfigKey configKey2(70, 23456);
+    sp<FakePullUidProvider> uidProvider = new FakePullUidProvider();
+    pullerManager->RegisterPullUidProvider(configKey, uidProvider);
+    pullerManager->RegisterPullUidProvider(configKey2, uidProvider);
+
+    const int64_t startTimeNs = 10 * NS_PER_SEC;
+    const int64_t intervalNs = 60 * NS_PER_SEC;
+    sp<FakePullDataReceiver> receiver1 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver2 = new FakePullDataReceiver();
+    sp<FakePullDataReceiver> receiver3 = new FakePullDataReceiver();
+    pullerManager->RegisterReceiver(pullTagId1, configKey, receiver1, startTimeNs, intervalNs);
+    // Due 3s later, so it shares the first alarm.
+    pullerManager->RegisterReceiver(pullTagId1, configKey2, receiver2,
+                                    startTimeNs + 3 * NS_PER_SEC, intervalNs);
+    // Due 30s later, outside of the tolerance.
+    pullerManager->RegisterReceiver(pullTagId1, configKey2, receiver3,
+                                    startTimeNs + 30 * NS_PER_SEC, intervalNs);
+
+    // The alarm is postponed to the latest pull in the window, never moved earlier.
+    EXPECT_EQ(startTimeNs + 3 * NS_PER_SEC, pullerManager->mNextPullTimeNs);
+
+    pullerManager->OnAlarmFired(pullerManager->mNextPullTimeNs);
+    EXPECT_EQ(1, receiver1->mNumPulls);
+    EXPECT_EQ(1, receiver2->mNumPulls);
+    EXPECT_EQ(0, receiver3->mNumPulls);
+    // Both configs were served by the same pull.
+    ASSERT_EQ(1, receiver1->mLastData.size());
+    ASSERT_EQ(1, receiver2->mLastData.size());
+    EXPECT_EQ(receiver1->mLastData[0], receiver2->mLastData[0]);
+    EXPECT_EQ(startTimeNs + 3 * NS_PER_SEC, receiver1->mLastPullTimeNs);
+
+    EXPECT_EQ(startTimeNs + 30 * NS_PER_SEC, pullerManager->mNextPullTimeNs);
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
\ No newline at end of file
@@ -60,7 +60,7 @@ void runShellTest(ShellSubscription config, sp<MockUidMap> uidMap,
     sp<ShellSubscriber> shellClient = new ShellSubscriber(uidMap, pullerManager);
 
     // mimic a binder thread that a shell subscriber runs on. it would block.
-    std::thread reader([&shellClient, &fds_config, &fds_data] {
+    std::thread reader([shellClient, &fds_config, &fds_data] {
         shellClient->startNewSubscription(fds_config[0], fds_data[1], /*timeoutSec=*/-1);
     });
     reader.detach();
@@ -142,6 +142,55 @@ TEST(ShellSubscriberTest, testPushedSubscription) {
     runShellTest(config, uidMap, pullerManager, pushedList, shellData);
 }
 
+TEST(ShellSubscriberTest, testSlowReaderDropsAtoms) {
+    sp<MockUidMap> uidMap = new NaggyMock<MockUidMap>();
+    sp<MockStatsPullerManager> pullerManager = new StrictMock<MockStatsPullerManager>();
+
+    ShellSubscription config;
+    config.add_pushed()->set_atom_id(29);
+
+    int fds_config[2];
+    ASSERT_EQ(0, pipe(fds_config));
+    int fds_data[2];
+    ASSERT_EQ(0, pipe(fds_data));
+
+    size_t bufferSize = config.ByteSize();
+    write(fds_config[1], &bufferSize, sizeof(bufferSize));
+    vector<uint8_t> buffer(bufferSize);
+    config.SerializeToArray(&buffer[0], bufferSize);
+    write(fds_config[1], buffer.data(), bufferSize);
+    close(fds_config[1]);
+
+    sp<ShellSubscriber> shellClient = new ShellSubscriber(uidMap, pullerManager);
+    std::thread subscription([shellClient, &fds_config, &fds_data] {
+        shellClient->startNewSubscription(fds_config[0], fds_data[1], /*timeoutSec=*/-1);
+    });
+    std::this_thread::sleep_for(100ms);
+
+    // Nobody reads the data pipe, so once it and the pending buffer are full, atoms are dropped
+    // instead of blocking onLogEvent().
+    std::unique_ptr<LogEvent> event = CreateScreenStateChangedEvent(
+            1000 /*timestamp*/, ::android::view::DisplayStateEnum::DISPLAY_STATE_ON);
+    const int numEvents = 2 * shellClient->kMaxPendingAtomBytes / 8;
+    for (int i = 0; i < numEvents; i++) {
+        shellClient->onLogEvent(*event);
+    }
+    {
+        std::lock_guard<std::mutex> lock(shellClient->mMutex);
+        ASSERT_NE(nullptr, shellClient->mSubscriptionInfo);
+        EXPECT_GT(shellClient->mSubscriptionInfo->mDroppedAtoms, 0);
+        EXPECT_LT(shellClient->mSubscriptionInfo->mDroppedAtoms, numEvents);
+        EXPECT_LE(shellClient->mSubscriptionInfo->mPendingAtoms.size(),
+                  shellClient->kMaxPendingAtomBytes);
+    }
+
+    // Closing the read end makes the writer notice that the client is gone.
+    close(fds_data[0]);
+    subscription.join();
+    close(fds_config[0]);
+    close(fds_data[1]);
+}
+
 namespace {
 
 int kUid1 = 1000;
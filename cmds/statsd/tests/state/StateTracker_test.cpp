@@ -330,6 +330,56 @@ TEST(StateTrackerTest, TestStateChangeReset) {
     }
 }
 
+/**
+ * Test that every listener receives all the state changes caused by a single
+ * reset event, and that the primary keys passed to the listeners are the ones
+ * that were tracked.
+ */
+TEST(StateTrackerTest, TestStateChangeResetNotifiesAllListeners) {
+    sp<TestStateListener> listener1 = new TestStateListener();
+    sp<TestStateListener> listener2 = new TestStateListener();
+    StateManager mgr;
+    mgr.registerListener(util::BLE_SCAN_STATE_CHANGED, listener1);
+    mgr.registerListener(util::BLE_SCAN_STATE_CHANGED, listener2);
+
+    std::vector<string> attributionTags = {"tag1"};
+    for (int uid = 1000; uid < 1003; uid++) {
+        std::unique_ptr<LogEvent> event =
+                CreateBleScanStateChangedEvent(timestampNs + uid, {uid}, attributionTags,
+                                               BleScanStateChanged::ON, false, false, false);
+        mgr.onLogEvent(*event);
+    }
+    ASSERT_EQ(3, listener1->updates.size());
+    ASSERT_EQ(3, listener2->updates.size());
+    listener1->updates.clear();
+    listener2->updates.clear();
+
+    std::unique_ptr<LogEvent> resetEvent =
+            CreateBleScanStateChangedEvent(timestampNs + 2000, {1000}, attributionTags,
+                                           BleScanStateChanged::RESET, false, false, false);
+    mgr.onLogEvent(*resetEvent);
+    ASSERT_EQ(3, listener1->updates.size());
+    ASSERT_EQ(3, listener2->updates.size());
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(BleScanStateChanged::OFF, listener1->updates[i].mState);
+        EXPECT_EQ(listener1->updates[i].mKey, listener2->updates[i].mKey);
+        EXPECT_EQ(listener1->updates[i].mState, listener2->updates[i].mState);
+        EXPECT_EQ(BleScanStateChanged::OFF,
+                  getStateInt(mgr, util::BLE_SCAN_STATE_CHANGED, listener1->updates[i].mKey));
+    }
+
+    // A listener that unregisters is no longer notified.
+    mgr.unregisterListener(util::BLE_SCAN_STATE_CHANGED, listener2);
+    listener1->updates.clear();
+    listener2->updates.clear();
+    std::unique_ptr<LogEvent> event =
+            CreateBleScanStateChangedEvent(timestampNs + 3000, {1000}, attributionTags,
+                                           BleScanStateChanged::ON, false, false, false);
+    mgr.onLogEvent(*event);
+    EXPECT_EQ(1, listener1->updates.size());
+    EXPECT_EQ(0, listener2->updates.size());
+}
+
 /**
  * Test StateManager's onLogEvent and StateListener's onStateChanged correctly
  * updates listener for states without primary keys.
@@ -16,6 +16,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include <stdio.h>
+#include "frameworks/base/cmds/statsd/src/stats_log.pb.h"
 #include "src/storage/StorageManager.h"
 
 #ifdef __ANDROID__
@@ -29,6 +30,9 @@ using std::make_shared;
 using std::shared_ptr;
 using std::vector;
 using testing::Contains;
+using android::util::FIELD_COUNT_REPEATED;
+using android::util::FIELD_TYPE_INT64;
+using android::util::FIELD_TYPE_STRING;
 
 TEST(StorageManagerTest, TrainInfoReadWriteTest) {
     InstallTrainInfo trainInfo;
@@ -196,6 +200,42 @@ TEST(StorageManagerTest, AppendConfigReportTest4) {
     clearLocalHistoryTestFiles();
 }
 
+TEST(StorageManagerTest, WriteConfigMetricsReportAppendsAndCompresses) {
+    const ConfigKey key(1066, 2);
+    StorageManager::deleteSuffixedFiles("/data/misc/stats-data", "_1066_2");
+    StorageManager::deleteSuffixedFiles("/data/misc/stats-data", "_1066_2_history");
+
+    // The first two reports are appended as records to one file, the first one raw and the second
+    // one deflated. The last one is written in the format of older builds, to a file of its own.
+    for (int i = 0; i < 3; i++) {
+        StorageManager::setReportRecordsEnabled(i < 2);
+        ProtoOutputStream proto;
+        proto.write(FIELD_TYPE_INT64 | 3 /* last_report_elapsed_nanos */, (long long)i);
+        for (int j = 0; j < (i == 0 ? 1 : 100); j++) {
+            proto.write(FIELD_TYPE_STRING | FIELD_COUNT_REPEATED | 9 /* strings */,
+                        string("a string that compresses well"));
+        }
+        StorageManager::writeConfigMetricsReport(key, &proto, false /* isHistory */);
+    }
+    StorageManager::setReportRecordsEnabled(false);
+    EXPECT_TRUE(StorageManager::hasConfigMetricsReport(key));
+
+    ProtoOutputStream out;
+    StorageManager::appendConfigMetricsReport(key, &out, true /*erase?*/, false /*isAdb?*/);
+    EXPECT_FALSE(StorageManager::hasConfigMetricsReport(key));
+
+    vector<uint8_t> bytes;
+    out.serializeToVector(&bytes);
+    ConfigMetricsReportList reports;
+    ASSERT_TRUE(reports.ParseFromArray(bytes.data(), bytes.size()));
+    ASSERT_EQ(3, reports.reports_size());
+    for (int i = 0; i < 3; i++) {
+        EXPECT_EQ(i, reports.reports(i).last_report_elapsed_nanos());
+        ASSERT_EQ(i == 0 ? 1 : 100, reports.reports(i).strings_size());
+        EXPECT_EQ("a string that compresses well", reports.reports(i).strings(0));
+    }
+}
+
 }  // namespace statsd
 }  // namespace os
 }  // namespace android
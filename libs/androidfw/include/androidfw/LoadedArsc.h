@@ -187,6 +187,12 @@ class LoadedPackage {
     return package_id_;
   }
 
+  // Returns the amount by which the type IDs of the resources in this package are offset from the
+  // IDs of their type specs.
+  inline int GetTypeIdOffset() const {
+    return type_id_offset_;
+  }
+
   // Returns true if this package is dynamic (shared library) and needs to have an ID assigned.
   inline bool IsDynamic() const {
     return (property_flags_ & PROPERTY_DYNAMIC) != 0;
@@ -20,6 +20,8 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "android-base/macros.h"
 #include "androidfw/StringPiece.h"
@@ -150,6 +152,30 @@ class SourcePathDiagnostics : public IDiagnostics {
   DISALLOW_COPY_AND_ASSIGN(SourcePathDiagnostics);
 };
 
+// Records messages so that they can be logged later to another IDiagnostics. Work done on other
+// threads logs to its own BufferedDiagnostics, which are then flushed in a deterministic order.
+class BufferedDiagnostics : public IDiagnostics {
+ public:
+  BufferedDiagnostics() = default;
+
+  void Log(Level level, DiagMessageActual& actual_msg) override {
+    messages_.push_back({level, actual_msg});
+  }
+
+  // Logs the recorded messages to diag, in the order they were recorded, and forgets them.
+  void FlushTo(IDiagnostics* diag) {
+    for (auto& [level, actual_msg] : messages_) {
+      diag->Log(level, actual_msg);
+    }
+    messages_.clear();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BufferedDiagnostics);
+
+  std::vector<std::pair<Level, DiagMessageActual>> messages_;
+};
+
 }  // namespace aapt
 
 #endif /* AAPT_DIAGNOSTICS_H */
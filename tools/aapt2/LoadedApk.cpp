@@ -292,8 +292,9 @@ bool LoadedApk::WriteToArchive(IAaptContext* context, ResourceTable* split_table
         return false;
       }
     } else {
+      io::SerializedOpenFile serialized_file(file, &open_mutex_);
       if (!io::CopyFileToArchivePreserveCompression(
-              context, file, output_path, writer)) {
+              context, &serialized_file, output_path, writer)) {
         return false;
       }
     }
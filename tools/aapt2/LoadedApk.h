@@ -17,6 +17,8 @@
 #ifndef AAPT_LOADEDAPK_H
 #define AAPT_LOADEDAPK_H
 
+#include <mutex>
+
 #include "androidfw/StringPiece.h"
 
 #include "ResourceTable.h"
@@ -70,6 +72,12 @@ class LoadedApk {
     return apk_.get();
   }
 
+  // Takes ownership of the file collection of the APK, so that its files can outlive the rest of
+  // the APK. The LoadedApk has no file collection afterwards.
+  std::unique_ptr<io::IFileCollection> ReleaseFileCollection() {
+    return std::move(apk_);
+  }
+
   ApkFormat GetApkFormat() {
     return format_;
   }
@@ -105,6 +113,8 @@ class LoadedApk {
    * If the manifest is also provided, it will be written to the new APK file, otherwise the
    * original manifest will be written. The manifest is only required if the contents of the new APK
    * have been modified in a way that require the AndroidManifest.xml to also be modified.
+   *
+   * May be called from several threads at once. The entries of the APK are opened one at a time.
    */
   virtual bool WriteToArchive(IAaptContext* context, ResourceTable* split_table,
                               const TableFlattenerOptions& options, FilterChain* filters,
@@ -118,6 +128,8 @@ class LoadedApk {
 
   Source source_;
   std::unique_ptr<io::IFileCollection> apk_;
+  // Serializes opening the entries of apk_, which share one archive handle.
+  std::mutex open_mutex_;
   std::unique_ptr<ResourceTable> table_;
   std::unique_ptr<xml::XmlResource> manifest_;
   ApkFormat format_;
@@ -21,6 +21,7 @@
 // clang-format on
 #endif
 
+#include <chrono>
 #include <iostream>
 #include <vector>
 
@@ -37,6 +38,7 @@
 #include "cmd/Link.h"
 #include "cmd/Optimize.h"
 #include "io/FileStream.h"
+#include "process/IncludeCache.h"
 #include "trace/TraceBuffer.h"
 #include "util/Files.h"
 #include "util/Util.h"
@@ -63,10 +65,11 @@ class VersionCommand : public Command {
 /** The main entry point of AAPT. */
 class MainCommand : public Command {
  public:
-  explicit MainCommand(text::Printer* printer, IDiagnostics* diagnostics)
+  explicit MainCommand(text::Printer* printer, IDiagnostics* diagnostics,
+                       IncludeCache* include_cache = nullptr)
       : Command("aapt2"), diagnostics_(diagnostics) {
     AddOptionalSubcommand(util::make_unique<CompileCommand>(diagnostics));
-    AddOptionalSubcommand(util::make_unique<LinkCommand>(diagnostics));
+    AddOptionalSubcommand(util::make_unique<LinkCommand>(diagnostics, include_cache));
     AddOptionalSubcommand(util::make_unique<DumpCommand>(printer, diagnostics));
     AddOptionalSubcommand(util::make_unique<DiffCommand>());
     AddOptionalSubcommand(util::make_unique<OptimizeCommand>());
@@ -103,6 +106,10 @@ class DaemonCommand : public Command {
         "command. The end of an invocation is signaled by providing an empty line.");
     AddOptionalFlag("--trace_folder", "Generate systrace json trace fragment to specified folder.",
                     &trace_folder_);
+    AddOptionalSwitch("--print-timings",
+        "Prints how long each command took, and how many included APKs it loaded or\n"
+            "reused from earlier commands.",
+        &print_timings_);
   }
 
   int Action(const std::vector<std::string>& arguments) override {
@@ -132,8 +139,19 @@ class DaemonCommand : public Command {
 
       std::vector<StringPiece> args;
       args.insert(args.end(), raw_args.begin(), raw_args.end());
-      int result = MainCommand(&printer, diagnostics_).Execute(args, &std::cerr);
+      const auto start = std::chrono::steady_clock::now();
+      const size_t hits = include_cache_.hits();
+      const size_t misses = include_cache_.misses();
+      int result = MainCommand(&printer, diagnostics_, &include_cache_).Execute(args, &std::cerr);
       out_->Flush();
+      if (print_timings_) {
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cerr << StringPrintf("%s took %lld ms (included APKs: %zu loaded, %zu reused)",
+                                  raw_args[0].c_str(), static_cast<long long>(elapsed.count()),
+                                  include_cache_.misses() - misses, include_cache_.hits() - hits)
+                  << std::endl;
+      }
       if (result != 0) {
         std::cerr << "Error" << std::endl;
       }
@@ -148,6 +166,10 @@ class DaemonCommand : public Command {
   io::FileOutputStream* out_;
   IDiagnostics* diagnostics_;
   Maybe<std::string> trace_folder_;
+  bool print_timings_ = false;
+
+  // Included APKs loaded by earlier commands, reused while their files are unchanged.
+  IncludeCache include_cache_;
 };
 
 }  // namespace aapt
@@ -17,6 +17,7 @@
 #include "ResourceTable.h"
 
 #include <algorithm>
+#include <iterator>
 #include <memory>
 #include <string>
 #include <tuple>
@@ -170,6 +171,44 @@ ResourceEntry* ResourceTableType::FindOrCreateEntry(const StringPiece& name,
   return entries.emplace(iter, std::move(new_entry))->get();
 }
 
+std::vector<ResourceEntry*> ResourceTableType::FindOrCreateEntries(
+    const std::vector<StringPiece>& names) {
+  std::vector<ResourceEntry*> results(names.size());
+
+  // The names of the missing entries, with their indices, sorted the way the entries are.
+  std::vector<std::pair<std::string, size_t>> missing;
+  for (size_t i = 0; i < names.size(); i++) {
+    results[i] = FindEntry(names[i]);
+    if (results[i] == nullptr) {
+      missing.emplace_back(names[i].to_string(), i);
+    }
+  }
+  if (missing.empty()) {
+    return results;
+  }
+
+  std::sort(missing.begin(), missing.end());
+  std::vector<std::unique_ptr<ResourceEntry>> new_entries;
+  for (const auto& name_and_index : missing) {
+    if (new_entries.empty() || name_and_index.first != new_entries.back()->name) {
+      new_entries.push_back(util::make_unique<ResourceEntry>(name_and_index.first));
+    }
+    results[name_and_index.second] = new_entries.back().get();
+  }
+
+  // None of the new entries has the name of an existing entry, so each goes where
+  // FindOrCreateEntry() would have inserted it.
+  std::vector<std::unique_ptr<ResourceEntry>> merged_entries;
+  merged_entries.reserve(entries.size() + new_entries.size());
+  std::merge(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()),
+             std::make_move_iterator(new_entries.begin()),
+             std::make_move_iterator(new_entries.end()), std::back_inserter(merged_entries),
+             [](const std::unique_ptr<ResourceEntry>& lhs,
+                const std::unique_ptr<ResourceEntry>& rhs) { return lhs->name < rhs->name; });
+  entries = std::move(merged_entries);
+  return results;
+}
+
 ResourceConfigValue* ResourceEntry::FindValue(const ConfigDescription& config) {
   return FindValue(config, StringPiece());
 }
@@ -172,6 +172,12 @@ class ResourceTableType {
   ResourceEntry* FindOrCreateEntry(const android::StringPiece& name,
                                    Maybe<uint16_t> id = Maybe<uint16_t>());
 
+  // Finds the entries with the given names, creating the entries that do not exist, and returns
+  // them in the order of the names. Unlike creating the entries one at a time, which moves the
+  // entries after each new entry, this moves the existing entries once. Use this to add many
+  // entries at once, such as when merging a library.
+  std::vector<ResourceEntry*> FindOrCreateEntries(const std::vector<android::StringPiece>& names);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(ResourceTableType);
 };
@@ -102,6 +102,27 @@ TEST(ResourceTableTest, AddMultipleResources) {
   EXPECT_THAT(test::GetValueForConfig<BinaryPrimitive>(&table, "android:string/ok", language_config), NotNull());
 }
 
+TEST(ResourceTableTest, FindOrCreateEntriesKeepsEntriesSorted) {
+  ResourceTableType type(ResourceType::kString);
+  ResourceEntry* b = type.FindOrCreateEntry("b");
+  ResourceEntry* d = type.FindOrCreateEntry("d");
+
+  std::vector<ResourceEntry*> entries =
+      type.FindOrCreateEntries({"e", "d", "a", "c", "a", "f", "b"});
+  ASSERT_THAT(entries.size(), Eq(7u));
+  EXPECT_THAT(entries[1], Eq(d));
+  EXPECT_THAT(entries[2], Eq(entries[4]));
+  EXPECT_THAT(entries[6], Eq(b));
+
+  std::vector<std::string> names;
+  for (const auto& entry : type.entries) {
+    names.push_back(entry->name);
+  }
+  EXPECT_THAT(names, Eq(std::vector<std::string>{"a", "b", "c", "d", "e", "f"}));
+  EXPECT_THAT(type.FindEntry("e"), Eq(entries[0]));
+  EXPECT_THAT(type.FindEntry("c"), Eq(entries[3]));
+}
+
 TEST(ResourceTableTest, OverrideWeakResourceValue) {
   ResourceTable table;
 
@@ -17,6 +17,7 @@
 #include "StringPool.h"
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 
@@ -25,12 +26,21 @@
 #include "androidfw/StringPiece.h"
 
 #include "util/BigBuffer.h"
+#include "util/ThreadPool.h"
 #include "util/Util.h"
 
 using ::android::StringPiece;
 
 namespace aapt {
 
+// Pools with fewer entries than this are sorted and flattened on the calling thread, whatever the
+// number of jobs, since starting the threads would cost more than they save.
+constexpr size_t kParallelThreshold = 1u << 14;
+
+// Large pools are sorted and encoded in chunks of this many entries. The chunks do not depend on
+// the number of threads, so that a pool is sorted the same way on every machine.
+constexpr size_t kChunkSize = 1u << 12;
+
 StringPool::Ref::Ref() : entry_(nullptr) {}
 
 StringPool::Ref::Ref(const StringPool::Ref& rhs) : entry_(rhs.entry_) {
@@ -295,14 +305,46 @@ void StringPool::Prune() {
   ReAssignIndices();
 }
 
+// Sorts large sets of entries by sorting chunks of them on a ThreadPool of `jobs` threads, and then
+// merging pairs of adjacent sorted runs in parallel until a single run is left.
+template <typename E, typename Compare>
+static void SortEntriesWith(std::vector<std::unique_ptr<E>>& entries, size_t jobs,
+                            const Compare& less) {
+  const size_t size = entries.size();
+  if (jobs == 1 || size < kParallelThreshold) {
+    std::sort(entries.begin(), entries.end(), less);
+    return;
+  }
+
+  const auto begin = entries.begin();
+  ThreadPool threads(jobs);
+  for (size_t start = 0; start < size; start += kChunkSize) {
+    threads.Schedule([begin, start, size, &less] {
+      std::sort(begin + start, begin + std::min(start + kChunkSize, size), less);
+    });
+  }
+  threads.Wait();
+
+  for (size_t run = kChunkSize; run < size; run *= 2) {
+    for (size_t start = 0; start + run < size; start += 2 * run) {
+      threads.Schedule([begin, start, run, size, &less] {
+        std::inplace_merge(begin + start, begin + start + run,
+                           begin + std::min(start + 2 * run, size), less);
+      });
+    }
+    threads.Wait();
+  }
+}
+
 template <typename E>
 static void SortEntries(
     std::vector<std::unique_ptr<E>>& entries,
-    const std::function<int(const StringPool::Context&, const StringPool::Context&)>& cmp) {
+    const std::function<int(const StringPool::Context&, const StringPool::Context&)>& cmp,
+    size_t jobs) {
   using UEntry = std::unique_ptr<E>;
 
   if (cmp != nullptr) {
-    std::sort(entries.begin(), entries.end(), [&cmp](const UEntry& a, const UEntry& b) -> bool {
+    SortEntriesWith(entries, jobs, [&cmp](const UEntry& a, const UEntry& b) -> bool {
       int r = cmp(a->context, b->context);
       if (r == 0) {
         r = a->value.compare(b->value);
@@ -310,14 +352,15 @@ static void SortEntries(
       return r < 0;
     });
   } else {
-    std::sort(entries.begin(), entries.end(),
-              [](const UEntry& a, const UEntry& b) -> bool { return a->value < b->value; });
+    SortEntriesWith(entries, jobs,
+                    [](const UEntry& a, const UEntry& b) -> bool { return a->value < b->value; });
   }
 }
 
-void StringPool::Sort(const std::function<int(const Context&, const Context&)>& cmp) {
-  SortEntries(styles_, cmp);
-  SortEntries(strings_, cmp);
+void StringPool::Sort(const std::function<int(const Context&, const Context&)>& cmp,
+                      size_t jobs) {
+  SortEntries(styles_, cmp, jobs);
+  SortEntries(strings_, cmp, jobs);
   ReAssignIndices();
 }
 
@@ -349,23 +392,11 @@ static size_t EncodeLengthMax() {
   return max;
 }
 
-/**
- * Returns the number of units (1 or 2) needed to encode the string length
- * before writing the string.
- */
-template <typename T>
-static size_t EncodedLengthUnits(size_t length) {
-  static_assert(std::is_integral<T>::value, "wat.");
-
-  constexpr size_t kMask = 1 << ((sizeof(T) * 8) - 1);
-  constexpr size_t kMaxSize = kMask - 1;
-  return length > kMaxSize ? 2 : 1;
-}
-
 const std::string kStringTooLarge = "STRING_TOO_LARGE";
 
-static bool EncodeString(const std::string& str, const bool utf8, BigBuffer* out,
-                         IDiagnostics* diag) {
+// Encodes a string the way ResStringPool stores it: its length, followed by the null-terminated
+// string. A string too long for the encoding is replaced by kStringTooLarge, and false is returned.
+static bool EncodeString(const std::string& str, const bool utf8, std::string* out) {
   if (utf8) {
     const std::string& encoded = util::Utf8ToModifiedUtf8(str);
     const ssize_t utf16_length = utf8_to_utf16_length(
@@ -376,63 +407,55 @@ static bool EncodeString(const std::string& str, const bool utf8, BigBuffer* out
     // can be encoded using chars
     if ((((size_t)encoded.size()) > EncodeLengthMax<char>())
         || (((size_t)utf16_length) > EncodeLengthMax<char>())) {
-
-      diag->Error(DiagMessage() << "string too large to encode using UTF-8 "
-          << "written instead as '" << kStringTooLarge << "'");
-
-      EncodeString(kStringTooLarge, utf8, out, diag);
+      EncodeString(kStringTooLarge, utf8, out);
       return false;
     }
 
-    const size_t total_size = EncodedLengthUnits<char>(utf16_length)
-        + EncodedLengthUnits<char>(encoded.size()) + encoded.size() + 1;
-
-    char* data = out->NextBlock<char>(total_size);
+    // First encode the UTF16 string length, and then the size of the real UTF8 string.
+    char lengths[4];
+    char* lengths_end = EncodeLength(lengths, utf16_length);
+    lengths_end = EncodeLength(lengths_end, encoded.size());
+    out->assign(lengths, lengths_end);
 
-    // First encode the UTF16 string length.
-    data = EncodeLength(data, utf16_length);
-
-    // Now encode the size of the real UTF8 string.
-    data = EncodeLength(data, encoded.size());
-    strncpy(data, encoded.data(), encoded.size());
+    // Like strncpy, stop at an embedded null character and pad the rest of the string with zeros.
+    out->append(encoded.c_str());
+    out->resize((lengths_end - lengths) + encoded.size() + 1, '\0');
 
   } else {
     const std::u16string encoded = util::Utf8ToUtf16(str);
-    const ssize_t utf16_length = encoded.size();
 
     // Make sure the length to be encoded does not exceed the maximum possible
     // length that can be encoded
-    if (((size_t)utf16_length) > EncodeLengthMax<char16_t>()) {
-      diag->Error(DiagMessage() << "string too large to encode using UTF-16 "
-          << "written instead as '" << kStringTooLarge << "'");
-
-      EncodeString(kStringTooLarge, utf8, out, diag);
+    if (encoded.size() > EncodeLengthMax<char16_t>()) {
+      EncodeString(kStringTooLarge, utf8, out);
       return false;
     }
 
-    // Total number of 16-bit words to write.
-    const size_t total_size = EncodedLengthUnits<char16_t>(utf16_length)
-        + encoded.size() + 1;
-
-    char16_t* data = out->NextBlock<char16_t>(total_size);
-
     // Encode the actual UTF16 string length.
-    data = EncodeLength(data, utf16_length);
-    const size_t byte_length = encoded.size() * sizeof(char16_t);
-
-    // NOTE: For some reason, strncpy16(data, entry->value.data(),
-    // entry->value.size()) truncates the string.
-    memcpy(data, encoded.data(), byte_length);
-
-    // The null-terminating character is already here due to the block of data
-    // being set to 0s on allocation.
+    char16_t length[2];
+    char16_t* length_end = EncodeLength(length, encoded.size());
+    out->assign(reinterpret_cast<const char*>(length), reinterpret_cast<const char*>(length_end));
+    out->append(reinterpret_cast<const char*>(encoded.data()),
+                encoded.size() * sizeof(char16_t));
+
+    // The null-terminating character.
+    out->append(sizeof(char16_t), '\0');
   }
 
   return true;
 }
 
+namespace {
+
+struct EncodedString {
+  std::string data;
+  bool fits = true;
+};
+
+}  // namespace
+
 bool StringPool::Flatten(BigBuffer* out, const StringPool& pool, bool utf8,
-                         IDiagnostics* diag) {
+                         IDiagnostics* diag, size_t jobs) {
   bool no_error = true;
   const size_t start_index = out->size();
   android::ResStringPool_header* header = out->NextBlock<android::ResStringPool_header>();
@@ -452,14 +475,50 @@ bool StringPool::Flatten(BigBuffer* out, const StringPool& pool, bool utf8,
   header->stringsStart = before_strings_index - start_index;
 
   // Styles always come first.
+  std::vector<const std::string*> values;
+  values.reserve(pool.size());
   for (const std::unique_ptr<StyleEntry>& entry : pool.styles_) {
-    *indices++ = out->size() - before_strings_index;
-    no_error = EncodeString(entry->value, utf8, out, diag) && no_error;
+    values.push_back(&entry->value);
   }
-
   for (const std::unique_ptr<Entry>& entry : pool.strings_) {
+    values.push_back(&entry->value);
+  }
+
+  // Encoding dominates the time spent flattening a large pool, so the strings of a large pool are
+  // encoded up front on several threads when there are several jobs. Otherwise strings are
+  // encoded one at a time.
+  std::vector<EncodedString> encoded;
+  if (jobs != 1 && values.size() >= kParallelThreshold) {
+    encoded.resize(values.size());
+    ThreadPool threads(jobs);
+    for (size_t start = 0; start < values.size(); start += kChunkSize) {
+      threads.Schedule([&values, &encoded, start, utf8] {
+        const size_t end = std::min(start + kChunkSize, values.size());
+        for (size_t i = start; i < end; i++) {
+          encoded[i].fits = EncodeString(*values[i], utf8, &encoded[i].data);
+        }
+      });
+    }
+    threads.Wait();
+  }
+
+  EncodedString scratch;
+  for (size_t i = 0; i < values.size(); i++) {
+    EncodedString* str = &scratch;
+    if (encoded.empty()) {
+      scratch.fits = EncodeString(*values[i], utf8, &scratch.data);
+    } else {
+      str = &encoded[i];
+    }
+
+    if (!str->fits) {
+      diag->Error(DiagMessage() << "string too large to encode using "
+          << (utf8 ? "UTF-8" : "UTF-16") << " written instead as '" << kStringTooLarge << "'");
+      no_error = false;
+    }
+
     *indices++ = out->size() - before_strings_index;
-    no_error = EncodeString(entry->value, utf8, out, diag) && no_error;
+    memcpy(out->NextBlock<char>(str->data.size()), str->data.data(), str->data.size());
   }
 
   out->Align4();
@@ -500,12 +559,14 @@ bool StringPool::Flatten(BigBuffer* out, const StringPool& pool, bool utf8,
   return no_error;
 }
 
-bool StringPool::FlattenUtf8(BigBuffer* out, const StringPool& pool, IDiagnostics* diag) {
-  return Flatten(out, pool, true, diag);
+bool StringPool::FlattenUtf8(BigBuffer* out, const StringPool& pool, IDiagnostics* diag,
+                             size_t jobs) {
+  return Flatten(out, pool, true, diag, jobs);
 }
 
-bool StringPool::FlattenUtf16(BigBuffer* out, const StringPool& pool, IDiagnostics* diag) {
-  return Flatten(out, pool, false, diag);
+bool StringPool::FlattenUtf16(BigBuffer* out, const StringPool& pool, IDiagnostics* diag,
+                              size_t jobs) {
+  return Flatten(out, pool, false, diag, jobs);
 }
 
 }  // namespace aapt
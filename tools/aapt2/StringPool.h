@@ -153,8 +153,11 @@ class StringPool {
     int ref_;
   };
 
-  static bool FlattenUtf8(BigBuffer* out, const StringPool& pool, IDiagnostics* diag);
-  static bool FlattenUtf16(BigBuffer* out, const StringPool& pool, IDiagnostics* diag);
+  // Large pools are encoded on `jobs` threads, or one per hardware thread if `jobs` is 0.
+  static bool FlattenUtf8(BigBuffer* out, const StringPool& pool, IDiagnostics* diag,
+                          size_t jobs = 1);
+  static bool FlattenUtf16(BigBuffer* out, const StringPool& pool, IDiagnostics* diag,
+                           size_t jobs = 1);
 
   StringPool() = default;
   StringPool(StringPool&&) = default;
@@ -200,7 +203,10 @@ class StringPool {
   // Sorts the strings according to their Context using some comparison function.
   // Equal Contexts are further sorted by string value, lexicographically.
   // If no comparison function is provided, values are only sorted lexicographically.
-  void Sort(const std::function<int(const Context&, const Context&)>& cmp = nullptr);
+  // Large pools are sorted on `jobs` threads, or one per hardware thread if `jobs` is 0, so cmp may
+  // be called concurrently unless `jobs` is 1.
+  void Sort(const std::function<int(const Context&, const Context&)>& cmp = nullptr,
+            size_t jobs = 1);
 
   // Removes any strings that have no references.
   void Prune();
@@ -208,7 +214,8 @@ class StringPool {
  private:
   DISALLOW_COPY_AND_ASSIGN(StringPool);
 
-  static bool Flatten(BigBuffer* out, const StringPool& pool, bool utf8, IDiagnostics* diag);
+  static bool Flatten(BigBuffer* out, const StringPool& pool, bool utf8, IDiagnostics* diag,
+                      size_t jobs);
 
   Ref MakeRefImpl(const android::StringPiece& str, const Context& context, bool unique);
   void ReAssignIndices();
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "StringPool.h"
+
+#include <random>
+#include <string>
+
+#include "android-base/macros.h"
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+
+#include "Diagnostics.h"
+#include "test/Common.h"
+
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+// Fills the pool with the kind of strings found in the value pool of an app: file paths and text,
+// in random order and spread over a few configurations.
+static void FillPool(size_t count, StringPool* pool) {
+  static const char* kConfigs[] = {"", "en", "fr", "ja", "land", "v21"};
+  std::mt19937 rng(42);
+  for (size_t i = 0; i < count; i++) {
+    const uint32_t n = rng();
+    StringPool::Context context(test::ParseConfigOrDie(kConfigs[n % arraysize(kConfigs)]));
+    if (n % 4 == 0) {
+      pool->MakeRef(StringPrintf("res/drawable-xhdpi-v4/icon_%08x.png", n), context);
+    } else {
+      pool->MakeRef(StringPrintf("Text number %u of the app, with some words é %zu", n, i),
+                    context);
+    }
+  }
+}
+
+// Sorts the pool the way TableFlattener sorts the value pool of a table, on state.range(1) threads.
+static void BM_SortStringPool(benchmark::State& state) {
+  for (auto _ : state) {
+    state.PauseTiming();
+    StringPool pool;
+    FillPool(state.range(0), &pool);
+    state.ResumeTiming();
+
+    pool.Sort([](const StringPool::Context& a, const StringPool::Context& b) -> int {
+      if (a.priority != b.priority) {
+        return a.priority < b.priority ? -1 : 1;
+      }
+      return a.config.compare(b.config);
+    }, state.range(1));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// Below and above the size from which pools are processed on several threads.
+BENCHMARK(BM_SortStringPool)->ArgPair(10000, 4)->ArgPair(100000, 1)->ArgPair(100000, 4)
+    ->ArgPair(500000, 1)->ArgPair(500000, 4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Flattens the pool as UTF-8 if state.range(1) is not 0, on state.range(2) threads.
+static void BM_FlattenStringPool(benchmark::State& state) {
+  StringPool pool;
+  FillPool(state.range(0), &pool);
+  const bool utf8 = state.range(1) != 0;
+  const size_t jobs = state.range(2);
+  StdErrDiagnostics diag;
+  for (auto _ : state) {
+    BigBuffer buffer(4096);
+    CHECK(utf8 ? StringPool::FlattenUtf8(&buffer, pool, &diag, jobs)
+               : StringPool::FlattenUtf16(&buffer, pool, &diag, jobs));
+    benchmark::DoNotOptimize(buffer.size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_FlattenStringPool)->Args({10000, 1, 4})->Args({500000, 1, 1})
+    ->Args({500000, 1, 4})->Args({10000, 0, 4})->Args({500000, 0, 1})->Args({500000, 0, 4})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+}  // namespace aapt
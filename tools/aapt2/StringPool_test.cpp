@@ -17,7 +17,9 @@
 #include "StringPool.h"
 
 #include <string>
+#include <vector>
 
+#include "android-base/stringprintf.h"
 #include "androidfw/StringPiece.h"
 
 #include "Diagnostics.h"
@@ -25,6 +27,7 @@
 #include "util/Util.h"
 
 using ::android::StringPiece;
+using ::android::base::StringPrintf;
 using ::android::StringPiece16;
 using ::testing::Eq;
 using ::testing::Ne;
@@ -139,6 +142,34 @@ TEST(StringPoolTest, SortAndMaintainIndexesInStringReferences) {
   EXPECT_THAT(ref_c.index(), Eq(1u));
 }
 
+TEST(StringPoolTest, SortLargePool) {
+  // Enough strings for the pool to be sorted on several threads.
+  constexpr size_t kCount = 100000u;
+  StringPool pool;
+  std::vector<StringPool::Ref> refs;
+  for (size_t i = 0; i < kCount; i++) {
+    const uint32_t priority = i % 3 == 0 ? StringPool::Context::kHighPriority
+                                         : StringPool::Context::kNormalPriority;
+    refs.push_back(pool.MakeRef(StringPrintf("%zu", (i * 7919u) % kCount),
+                                StringPool::Context(priority)));
+  }
+
+  pool.Sort([](const StringPool::Context& a, const StringPool::Context& b) -> int {
+    return a.priority < b.priority ? -1 : a.priority > b.priority ? 1 : 0;
+  }, 4u /* jobs */);
+
+  ASSERT_THAT(pool.strings().size(), Eq(kCount));
+  for (size_t i = 1; i < kCount; i++) {
+    const StringPool::Entry& prev = *pool.strings()[i - 1];
+    const StringPool::Entry& entry = *pool.strings()[i];
+    ASSERT_TRUE(prev.context.priority < entry.context.priority ||
+                (prev.context.priority == entry.context.priority && prev.value < entry.value));
+  }
+  for (const StringPool::Ref& ref : refs) {
+    ASSERT_THAT(pool.strings()[ref.index()]->value, Eq(*ref));
+  }
+}
+
 TEST(StringPoolTest, SortAndStillDedupe) {
   StringPool pool;
 
@@ -303,6 +334,44 @@ TEST(StringPoolTest, Flatten) {
   }
 }
 
+TEST(StringPoolTest, FlattenLargePool) {
+  using namespace android;  // For NO_ERROR on Windows.
+  StdErrDiagnostics diag;
+
+  // Enough strings for the pool to be encoded on several threads.
+  constexpr size_t kCount = 50000u;
+  StringPool pool;
+  for (size_t i = 0; i < kCount; i++) {
+    pool.MakeRef(i == 1234u ? std::string(50000, 'a') : StringPrintf("string %zu", i));
+  }
+
+  BigBuffer buffers[2] = {BigBuffer(1024), BigBuffer(1024)};
+  EXPECT_FALSE(StringPool::FlattenUtf8(&buffers[0], pool, &diag, 4u /* jobs */));
+  EXPECT_TRUE(StringPool::FlattenUtf16(&buffers[1], pool, &diag, 4u /* jobs */));
+
+  // Encoding on one thread writes the same pool.
+  BigBuffer serial_buffer(1024);
+  EXPECT_FALSE(StringPool::FlattenUtf8(&serial_buffer, pool, &diag));
+  EXPECT_THAT(serial_buffer.to_string(), Eq(buffers[0].to_string()));
+
+  for (const BigBuffer& buffer : buffers) {
+    std::unique_ptr<uint8_t[]> data = util::Copy(buffer);
+    ResStringPool test;
+    ASSERT_EQ(test.setTo(data.get(), buffer.size()), NO_ERROR);
+    ASSERT_THAT(test.size(), Eq(kCount));
+    for (size_t i = 0; i < kCount; i++) {
+      if (i != 1234u) {
+        ASSERT_THAT(util::GetString(test, i), Eq(StringPrintf("string %zu", i)));
+      }
+    }
+  }
+
+  std::unique_ptr<uint8_t[]> data = util::Copy(buffers[0]);
+  ResStringPool test;
+  ASSERT_EQ(test.setTo(data.get(), buffers[0].size()), NO_ERROR);
+  EXPECT_THAT(util::GetString(test, 1234u), Eq("STRING_TOO_LARGE"));
+}
+
 TEST(StringPoolTest, ModifiedUTF8) {
   using namespace android;  // For NO_ERROR on Windows.
   StdErrDiagnostics diag;
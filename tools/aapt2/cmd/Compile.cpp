@@ -17,6 +17,8 @@
 #include "Compile.h"
 
 #include <dirent.h>
+#include <condition_variable>
+#include <mutex>
 #include <string>
 
 #include "android-base/errors.h"
@@ -34,6 +36,7 @@
 #include "compile/IdAssigner.h"
 #include "compile/InlineXmlFormatParser.h"
 #include "compile/Png.h"
+#include "compile/PngCache.h"
 #include "compile/PseudolocaleGenerator.h"
 #include "compile/XmlIdCollector.h"
 #include "format/Archive.h"
@@ -48,6 +51,7 @@
 #include "trace/TraceBuffer.h"
 #include "util/Files.h"
 #include "util/Maybe.h"
+#include "util/ThreadPool.h"
 #include "util/Util.h"
 #include "xml/XmlDom.h"
 #include "xml/XmlPullParser.h"
@@ -453,6 +457,91 @@ static bool CompileXml(IAaptContext* context, const CompileOptions& options,
   return true;
 }
 
+// Crunches the PNG in content and appends the result to out_buffer. The crunched PNG is the
+// original with unimportant chunks removed if re-encoding does not make it smaller.
+static bool CrunchPng(IAaptContext* context, const ResourcePathData& path_data,
+                      const StringPiece& content, bool is_nine_patch, BigBuffer* out_buffer) {
+  BigBuffer crunched_png_buffer(4096);
+  io::BigBufferOutputStream crunched_png_buffer_out(&crunched_png_buffer);
+
+  // Ensure that we only keep the chunks we care about if we end up
+  // using the original PNG instead of the crunched one.
+  PngChunkFilter png_chunk_filter(content);
+  std::unique_ptr<Image> image = ReadPng(context, path_data.source, &png_chunk_filter);
+  if (!image) {
+    return false;
+  }
+
+  std::unique_ptr<NinePatch> nine_patch;
+  if (is_nine_patch) {
+    std::string err;
+    nine_patch = NinePatch::Create(image->rows.get(), image->width, image->height, &err);
+    if (!nine_patch) {
+      context->GetDiagnostics()->Error(DiagMessage() << err);
+      return false;
+    }
+
+    // Remove the 1px border around the NinePatch.
+    // Basically the row array is shifted up by 1, and the length is treated
+    // as height - 2.
+    // For each row, shift the array to the left by 1, and treat the length as
+    // width - 2.
+    image->width -= 2;
+    image->height -= 2;
+    memmove(image->rows.get(), image->rows.get() + 1, image->height * sizeof(uint8_t**));
+    for (int32_t h = 0; h < image->height; h++) {
+      memmove(image->rows[h], image->rows[h] + 4, image->width * 4);
+    }
+
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage(path_data.source) << "9-patch: "
+                                                                    << *nine_patch);
+    }
+  }
+
+  // Write the crunched PNG.
+  if (!WritePng(context, image.get(), nine_patch.get(), &crunched_png_buffer_out, {})) {
+    return false;
+  }
+
+  if (nine_patch != nullptr ||
+      crunched_png_buffer_out.ByteCount() <= png_chunk_filter.ByteCount()) {
+    // No matter what, we must use the re-encoded PNG, even if it is larger.
+    // 9-patch images must be re-encoded since their borders are stripped.
+    out_buffer->AppendBuffer(std::move(crunched_png_buffer));
+  } else {
+    // The re-encoded PNG is larger than the original, and there is
+    // no mandatory transformation. Use the original.
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage(path_data.source)
+                                      << "original PNG is smaller than crunched PNG"
+                                      << ", using original");
+    }
+
+    png_chunk_filter.Rewind();
+    BigBuffer filtered_png_buffer(4096);
+    io::BigBufferOutputStream filtered_png_buffer_out(&filtered_png_buffer);
+    io::Copy(&filtered_png_buffer_out, &png_chunk_filter);
+    out_buffer->AppendBuffer(std::move(filtered_png_buffer));
+  }
+
+  if (context->IsVerbose()) {
+    // For debugging only, use the legacy PNG cruncher and compare the resulting file sizes.
+    // This will help catch exotic cases where the new code may generate larger PNGs.
+    std::stringstream legacy_stream(content.to_string());
+    BigBuffer legacy_buffer(4096);
+    Png png(context->GetDiagnostics());
+    if (!png.process(path_data.source, &legacy_stream, &legacy_buffer, {})) {
+      return false;
+    }
+
+    context->GetDiagnostics()->Note(DiagMessage(path_data.source)
+                                    << "legacy=" << legacy_buffer.size()
+                                    << " new=" << out_buffer->size());
+  }
+  return true;
+}
+
 static bool CompilePng(IAaptContext* context, const CompileOptions& options,
                        const ResourcePathData& path_data, io::IFile* file, IArchiveWriter* writer,
                        const std::string& output_path) {
@@ -475,84 +564,26 @@ static bool CompilePng(IAaptContext* context, const CompileOptions& options,
       return false;
     }
 
-    BigBuffer crunched_png_buffer(4096);
-    io::BigBufferOutputStream crunched_png_buffer_out(&crunched_png_buffer);
-
-    // Ensure that we only keep the chunks we care about if we end up
-    // using the original PNG instead of the crunched one.
     const StringPiece content(reinterpret_cast<const char*>(data->data()), data->size());
-    PngChunkFilter png_chunk_filter(content);
-    std::unique_ptr<Image> image = ReadPng(context, path_data.source, &png_chunk_filter);
-    if (!image) {
-      return false;
-    }
-
-    std::unique_ptr<NinePatch> nine_patch;
-    if (path_data.extension == "9.png") {
-      std::string err;
-      nine_patch = NinePatch::Create(image->rows.get(), image->width, image->height, &err);
-      if (!nine_patch) {
-        context->GetDiagnostics()->Error(DiagMessage() << err);
-        return false;
-      }
-
-      // Remove the 1px border around the NinePatch.
-      // Basically the row array is shifted up by 1, and the length is treated
-      // as height - 2.
-      // For each row, shift the array to the left by 1, and treat the length as
-      // width - 2.
-      image->width -= 2;
-      image->height -= 2;
-      memmove(image->rows.get(), image->rows.get() + 1, image->height * sizeof(uint8_t**));
-      for (int32_t h = 0; h < image->height; h++) {
-        memmove(image->rows[h], image->rows[h] + 4, image->width * 4);
-      }
-
-      if (context->IsVerbose()) {
-        context->GetDiagnostics()->Note(DiagMessage(path_data.source) << "9-patch: "
-                                                                      << *nine_patch);
-      }
-    }
-
-    // Write the crunched PNG.
-    if (!WritePng(context, image.get(), nine_patch.get(), &crunched_png_buffer_out, {})) {
-      return false;
+    const bool is_nine_patch = path_data.extension == "9.png";
+    std::unique_ptr<PngCache> cache;
+    if (options.png_cache_dir) {
+      cache = util::make_unique<PngCache>(options.png_cache_dir.value(),
+                                          util::GetToolFingerprint());
     }
 
-    if (nine_patch != nullptr ||
-        crunched_png_buffer_out.ByteCount() <= png_chunk_filter.ByteCount()) {
-      // No matter what, we must use the re-encoded PNG, even if it is larger.
-      // 9-patch images must be re-encoded since their borders are stripped.
-      buffer.AppendBuffer(std::move(crunched_png_buffer));
-    } else {
-      // The re-encoded PNG is larger than the original, and there is
-      // no mandatory transformation. Use the original.
+    if (cache && cache->Find(content, is_nine_patch, &buffer)) {
       if (context->IsVerbose()) {
         context->GetDiagnostics()->Note(DiagMessage(path_data.source)
-                                        << "original PNG is smaller than crunched PNG"
-                                        << ", using original");
+                                        << "using crunched PNG from cache");
       }
-
-      png_chunk_filter.Rewind();
-      BigBuffer filtered_png_buffer(4096);
-      io::BigBufferOutputStream filtered_png_buffer_out(&filtered_png_buffer);
-      io::Copy(&filtered_png_buffer_out, &png_chunk_filter);
-      buffer.AppendBuffer(std::move(filtered_png_buffer));
-    }
-
-    if (context->IsVerbose()) {
-      // For debugging only, use the legacy PNG cruncher and compare the resulting file sizes.
-      // This will help catch exotic cases where the new code may generate larger PNGs.
-      std::stringstream legacy_stream(content.to_string());
-      BigBuffer legacy_buffer(4096);
-      Png png(context->GetDiagnostics());
-      if (!png.process(path_data.source, &legacy_stream, &legacy_buffer, {})) {
+    } else {
+      if (!CrunchPng(context, path_data, content, is_nine_patch, &buffer)) {
         return false;
       }
-
-      context->GetDiagnostics()->Note(DiagMessage(path_data.source)
-                                      << "legacy=" << legacy_buffer.size()
-                                      << " new=" << buffer.size());
+      if (cache) {
+        cache->Put(content, is_nine_patch, buffer);
+      }
     }
   }
 
@@ -643,76 +674,216 @@ class CompileContext : public IAaptContext {
   bool verbose_ = false;
 };
 
-int Compile(IAaptContext* context, io::IFileCollection* inputs, IArchiveWriter* output_writer,
-             CompileOptions& options) {
-  TRACE_CALL();
-  bool error = false;
+// Validates the path of file and compiles it to writer. Returns false if there was an error.
+static bool CompileResourceFile(IAaptContext* context, io::IFile* file, char dir_sep,
+                                const CompileOptions& options, IArchiveWriter* writer) {
+  std::string path = file->GetSource().path;
+  if (!options.res_zip && !IsValidFile(context, path)) {
+    return false;
+  }
 
-  // Iterate over the input files in a stable, platform-independent manner
-  auto file_iterator  = inputs->Iterator();
+  // Extract resource type information from the full path
+  std::string err_str;
+  ResourcePathData path_data;
+  if (auto maybe_path_data = ExtractResourcePathData(path, dir_sep, &err_str)) {
+    path_data = maybe_path_data.value();
+  } else {
+    context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << err_str);
+    return false;
+  }
+
+  // Determine how to compile the file based on its type.
+  auto compile_func = &CompileFile;
+  if (path_data.resource_dir == "values" && path_data.extension == "xml") {
+    compile_func = &CompileTable;
+    // We use a different extension (not necessary anymore, but avoids altering the existing
+    // build system logic).
+    path_data.extension = "arsc";
+
+  } else if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
+    if (*type != ResourceType::kRaw) {
+      if (*type == ResourceType::kXml || path_data.extension == "xml") {
+        compile_func = &CompileXml;
+      } else if ((!options.no_png_crunch && path_data.extension == "png")
+                 || path_data.extension == "9.png") {
+        compile_func = &CompilePng;
+      }
+    }
+  } else {
+    context->GetDiagnostics()->Error(DiagMessage()
+        << "invalid file path '" << path_data.source << "'");
+    return false;
+  }
+
+  // Treat periods as a reserved character that should not be present in a file name
+  // Legacy support for AAPT which did not reserve periods
+  if (compile_func != &CompileFile && !options.legacy_mode
+      && std::count(path_data.name.begin(), path_data.name.end(), '.') != 0) {
+    context->GetDiagnostics()->Error(DiagMessage(file->GetSource())
+                                                  << "file name cannot contain '.' other than for"
+                                                  << " specifying the extension");
+    return false;
+  }
+
+  const std::string out_path = BuildIntermediateContainerFilename(path_data);
+  if (!compile_func(context, options, path_data, file, writer, out_path)) {
+    context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << "file failed to compile");
+    return false;
+  }
+  return true;
+}
+
+// Compiles one file on a worker thread. Everything it produces is buffered, so that it can be
+// reported and written in input order by the thread that called Compile().
+class ParallelCompileTask : public IAaptContext {
+ public:
+  ParallelCompileTask(IAaptContext* context, io::IFile* file) : context_(context), file_(file) {
+  }
+
+  PackageType GetPackageType() override {
+    return context_->GetPackageType();
+  }
+
+  SymbolTable* GetExternalSymbols() override {
+    return context_->GetExternalSymbols();
+  }
+
+  IDiagnostics* GetDiagnostics() override {
+    return &diagnostics_;
+  }
+
+  const std::string& GetCompilationPackage() override {
+    return context_->GetCompilationPackage();
+  }
+
+  uint8_t GetPackageId() override {
+    return context_->GetPackageId();
+  }
+
+  NameMangler* GetNameMangler() override {
+    return context_->GetNameMangler();
+  }
+
+  bool IsVerbose() override {
+    return context_->IsVerbose();
+  }
+
+  int GetMinSdkVersion() override {
+    return context_->GetMinSdkVersion();
+  }
+
+  const std::set<std::string>& GetSplitNameDependencies() override {
+    return context_->GetSplitNameDependencies();
+  }
+
+  void Run(char dir_sep, const CompileOptions& options) {
+    success_ = CompileResourceFile(this, file_, dir_sep, options, &writer_);
+  }
+
+  // Reports the diagnostics of the task and writes the entries it finished to writer, like
+  // compiling the file directly to writer would have.
+  bool Finish(IArchiveWriter* writer) {
+    diagnostics_.FlushTo(context_->GetDiagnostics());
+    if (!writer_.WriteTo(writer)) {
+      context_->GetDiagnostics()->Error(DiagMessage(file_->GetSource())
+                                        << "failed to write compiled file: "
+                                        << writer->GetError());
+      return false;
+    }
+    return success_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ParallelCompileTask);
+
+  IAaptContext* context_;
+  io::IFile* file_;
+  BufferedDiagnostics diagnostics_;
+  BufferedArchiveWriter writer_;
+  bool success_ = false;
+};
+
+// Compiles the files on a pool of threads. The results of each file are reported and written as
+// soon as the files before it have been, so writing the archive overlaps with compiling. The
+// diagnostics and the archive are the same as when compiling the files one at a time.
+static int CompileInParallel(IAaptContext* context, io::IFileCollection* inputs,
+                             IArchiveWriter* output_writer, const CompileOptions& options) {
+  TRACE_CALL();
+  std::mutex open_mutex;
+  std::vector<std::unique_ptr<io::SerializedOpenFile>> serialized_files;
+  std::vector<std::unique_ptr<ParallelCompileTask>> tasks;
+  auto file_iterator = inputs->Iterator();
   while (file_iterator->HasNext()) {
-    auto file = file_iterator->Next();
-    std::string path = file->GetSource().path;
+    io::IFile* file = file_iterator->Next();
 
     // Skip hidden input files
-    if (file::IsHidden(path)) {
+    if (file::IsHidden(file->GetSource().path)) {
       continue;
     }
 
-    if (!options.res_zip && !IsValidFile(context, path)) {
-      error = true;
-      continue;
+    if (options.res_zip) {
+      serialized_files.push_back(util::make_unique<io::SerializedOpenFile>(file, &open_mutex));
+      file = serialized_files.back().get();
     }
+    tasks.push_back(util::make_unique<ParallelCompileTask>(context, file));
+  }
 
-    // Extract resource type information from the full path
-    std::string err_str;
-    ResourcePathData path_data;
-    if (auto maybe_path_data = ExtractResourcePathData(path, inputs->GetDirSeparator(), &err_str)) {
-      path_data = maybe_path_data.value();
-    } else {
-      context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << err_str);
-      error = true;
-      continue;
-    }
+  std::mutex done_mutex;
+  std::condition_variable task_done;
+  std::vector<bool> done(tasks.size(), false);
+  const char dir_sep = inputs->GetDirSeparator();
 
-    // Determine how to compile the file based on its type.
-    auto compile_func = &CompileFile;
-    if (path_data.resource_dir == "values" && path_data.extension == "xml") {
-      compile_func = &CompileTable;
-      // We use a different extension (not necessary anymore, but avoids altering the existing
-      // build system logic).
-      path_data.extension = "arsc";
-
-    } else if (const ResourceType* type = ParseResourceType(path_data.resource_dir)) {
-      if (*type != ResourceType::kRaw) {
-        if (*type == ResourceType::kXml || path_data.extension == "xml") {
-          compile_func = &CompileXml;
-        } else if ((!options.no_png_crunch && path_data.extension == "png")
-                   || path_data.extension == "9.png") {
-          compile_func = &CompilePng;
+  bool error = false;
+  {
+    ThreadPool pool(options.jobs);
+    for (size_t i = 0; i < tasks.size(); i++) {
+      pool.Schedule([&, i] {
+        tasks[i]->Run(dir_sep, options);
+        {
+          std::lock_guard<std::mutex> lock(done_mutex);
+          done[i] = true;
         }
+        task_done.notify_one();
+      });
+    }
+
+    for (size_t i = 0; i < tasks.size(); i++) {
+      {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        task_done.wait(lock, [&] { return done[i]; });
       }
-    } else {
-      context->GetDiagnostics()->Error(DiagMessage()
-          << "invalid file path '" << path_data.source << "'");
-      error = true;
-      continue;
+      if (!tasks[i]->Finish(output_writer)) {
+        error = true;
+      }
+      // Release the compiled file as soon as it is written.
+      tasks[i].reset();
     }
+  }
 
-    // Treat periods as a reserved character that should not be present in a file name
-    // Legacy support for AAPT which did not reserve periods
-    if (compile_func != &CompileFile && !options.legacy_mode
-        && std::count(path_data.name.begin(), path_data.name.end(), '.') != 0) {
-      error = true;
-      context->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                    << "file name cannot contain '.' other than for"
-                                                    << " specifying the extension");
+  return error ? 1 : 0;
+}
+
+int Compile(IAaptContext* context, io::IFileCollection* inputs, IArchiveWriter* output_writer,
+             CompileOptions& options) {
+  TRACE_CALL();
+  // Every compiled file overwrites the text symbols file, so the last file must be written last.
+  if (options.jobs != 1 && !options.generate_text_symbols_path) {
+    return CompileInParallel(context, inputs, output_writer, options);
+  }
+
+  bool error = false;
+
+  // Iterate over the input files in a stable, platform-independent manner
+  auto file_iterator  = inputs->Iterator();
+  while (file_iterator->HasNext()) {
+    auto file = file_iterator->Next();
+
+    // Skip hidden input files
+    if (file::IsHidden(file->GetSource().path)) {
       continue;
     }
 
-    const std::string out_path = BuildIntermediateContainerFilename(path_data);
-    if (!compile_func(context, options, path_data, file, output_writer, out_path)) {
-      context->GetDiagnostics()->Error(DiagMessage(file->GetSource()) << "file failed to compile");
+    if (!CompileResourceFile(context, file, inputs->GetDirSeparator(), options, output_writer)) {
       error = true;
     }
   }
@@ -740,6 +911,22 @@ int CompileCommand::Action(const std::vector<std::string>& args) {
     }
   }
 
+  if (jobs_) {
+    Maybe<size_t> jobs = ThreadPool::ParseThreadCount(jobs_.value());
+    if (!jobs) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid value for -j: '" << jobs_.value()
+                                                    << "'");
+      return 1;
+    }
+    options_.jobs = jobs.value();
+  }
+
+  if (options_.png_cache_dir && !file::mkdirs(options_.png_cache_dir.value())) {
+    context.GetDiagnostics()->Error(DiagMessage(options_.png_cache_dir.value())
+                                    << "failed to create PNG cache directory");
+    return 1;
+  }
+
   std::unique_ptr<io::IFileCollection> file_collection;
 
   // Collect the resources files to compile
@@ -801,7 +988,12 @@ int CompileCommand::Action(const std::vector<std::string>& args) {
     return 1;
   }
 
-  return Compile(&context, file_collection.get(), archive_writer.get(), options_);
+  const int result = Compile(&context, file_collection.get(), archive_writer.get(), options_);
+  if (options_.png_cache_dir) {
+    PngCache(options_.png_cache_dir.value(), util::GetToolFingerprint())
+        .Prune(PngCache::kDefaultMaxSizeBytes);
+  }
+  return result;
 }
 
 }  // namespace aapt
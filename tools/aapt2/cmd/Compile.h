@@ -34,10 +34,14 @@ struct CompileOptions {
   Maybe<Visibility::Level> visibility;
   bool pseudolocalize = false;
   bool no_png_crunch = false;
+  // Directory of crunched PNGs reused across builds. See aapt::PngCache.
+  Maybe<std::string> png_cache_dir;
   bool legacy_mode = false;
   // See comments on aapt::ResourceParserOptions.
   bool preserve_visibility_of_styleables = false;
   bool verbose = false;
+  // Number of files compiled at the same time. The output is the same for any value.
+  size_t jobs = 1;
 };
 
 /** Parses flags and compiles resources to be used in linking.  */
@@ -56,6 +60,11 @@ class CompileCommand : public Command {
     AddOptionalSwitch("--pseudo-localize", "Generate resources for pseudo-locales "
         "(en-XA and ar-XB)", &options_.pseudolocalize);
     AddOptionalSwitch("--no-crunch", "Disables PNG processing", &options_.no_png_crunch);
+    AddOptionalFlag("--png-cache-dir",
+        "Directory in which crunched PNGs are kept, so that unchanged PNGs\n"
+            "are not crunched again by later builds. The least recently used\n"
+            "PNGs are removed once the directory holds more than 512 MB.",
+        &options_.png_cache_dir, Command::kPath);
     AddOptionalSwitch("--legacy", "Treat errors that used to be valid in AAPT as warnings",
         &options_.legacy_mode);
     AddOptionalSwitch("--preserve-visibility-of-styleables",
@@ -67,6 +76,9 @@ class CompileCommand : public Command {
         "Sets the visibility of the compiled resources to the specified\n"
             "level. Accepted levels: public, private, default", &visibility_);
     AddOptionalSwitch("-v", "Enables verbose logging", &options_.verbose);
+    AddOptionalFlag("-j",
+        "Number of files to compile in parallel, or 0 for one per CPU. Defaults to 1.\n"
+            "Ignored with --output-text-symbols.", &jobs_);
     AddOptionalFlag("--trace-folder", "Generate systrace json trace fragment to specified folder.",
                     &trace_folder_);
   }
@@ -77,6 +89,7 @@ class CompileCommand : public Command {
   IDiagnostics* diagnostic_;
   CompileOptions options_;
   Maybe<std::string> visibility_;
+  Maybe<std::string> jobs_;
   Maybe<std::string> trace_folder_;
 };
 
@@ -140,6 +140,31 @@ TEST_F(CompilerTest, DirInput) {
   ASSERT_EQ(::android::base::utf8::unlink(kOutputFlata.c_str()), 0);
 }
 
+TEST_F(CompilerTest, ParallelCompileMatchesSerialCompile) {
+  StdErrDiagnostics diag;
+  const std::string kTestDir =
+      BuildPath({android::base::Dirname(android::base::GetExecutablePath()), "integration-tests",
+                 "CompileTest", "DirInput"});
+  const std::string kResDir = BuildPath({kTestDir, "res"});
+  const std::string kSerialFlata = BuildPath({kTestDir, "compiled_serial.flata"});
+  const std::string kParallelFlata = BuildPath({kTestDir, "compiled_parallel.flata"});
+
+  ASSERT_EQ(CompileCommand(&diag).Execute({"--dir", kResDir, "-o", kSerialFlata}, &std::cerr), 0);
+  ASSERT_EQ(CompileCommand(&diag).Execute({"--dir", kResDir, "-o", kParallelFlata, "-j", "4"},
+                                          &std::cerr),
+            0);
+
+  std::string serial;
+  std::string parallel;
+  ASSERT_TRUE(android::base::ReadFileToString(kSerialFlata, &serial));
+  ASSERT_TRUE(android::base::ReadFileToString(kParallelFlata, &parallel));
+  EXPECT_FALSE(serial.empty());
+  EXPECT_EQ(serial, parallel);
+
+  ASSERT_EQ(::android::base::utf8::unlink(kSerialFlata.c_str()), 0);
+  ASSERT_EQ(::android::base::utf8::unlink(kParallelFlata.c_str()), 0);
+}
+
 TEST_F(CompilerTest, ZipInput) {
   StdErrDiagnostics diag;
   std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
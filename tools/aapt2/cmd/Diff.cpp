@@ -16,12 +16,17 @@
 
 #include "Diff.h"
 
+#include <map>
+#include <sstream>
+
 #include "android-base/macros.h"
 
 #include "LoadedApk.h"
 #include "ValueVisitor.h"
+#include "io/ZipArchive.h"
 #include "process/IResourceTableConsumer.h"
 #include "process/SymbolTable.h"
+#include "util/ThreadPool.h"
 
 using ::android::StringPiece;
 
@@ -78,8 +83,8 @@ class DiffContext : public IAaptContext {
   SymbolTable symbol_table_;
 };
 
-static void EmitDiffLine(const Source& source, const StringPiece& message) {
-  std::cerr << source << ": " << message << "\n";
+static void EmitDiffLine(const Source& source, const StringPiece& message, std::ostream* out) {
+  *out << source << ": " << message << "\n";
 }
 
 static bool IsSymbolVisibilityDifferent(const Visibility& vis_a, const Visibility& vis_b) {
@@ -100,7 +105,7 @@ static bool EmitResourceConfigValueDiff(IAaptContext* context, LoadedApk* apk_a,
                                         ResourceEntry* entry_a, ResourceConfigValue* config_value_a,
                                         LoadedApk* apk_b, ResourceTablePackage* pkg_b,
                                         ResourceTableType* type_b, ResourceEntry* entry_b,
-                                        ResourceConfigValue* config_value_b) {
+                                        ResourceConfigValue* config_value_b, std::ostream* out) {
   Value* value_a = config_value_a->value.get();
   Value* value_b = config_value_b->value.get();
   if (!value_a->Equals(value_b)) {
@@ -110,7 +115,7 @@ static bool EmitResourceConfigValueDiff(IAaptContext* context, LoadedApk* apk_a,
     value_a->Print(&str_stream);
     str_stream << "\n vs \n";
     value_b->Print(&str_stream);
-    EmitDiffLine(apk_b->GetSource(), str_stream.str());
+    EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
     return true;
   }
   return false;
@@ -120,7 +125,7 @@ static bool EmitResourceEntryDiff(IAaptContext* context, LoadedApk* apk_a,
                                   ResourceTablePackage* pkg_a, ResourceTableType* type_a,
                                   ResourceEntry* entry_a, LoadedApk* apk_b,
                                   ResourceTablePackage* pkg_b, ResourceTableType* type_b,
-                                  ResourceEntry* entry_b) {
+                                  ResourceEntry* entry_b, std::ostream* out) {
   bool diff = false;
   for (std::unique_ptr<ResourceConfigValue>& config_value_a : entry_a->values) {
     ResourceConfigValue* config_value_b = entry_b->FindValue(config_value_a->config);
@@ -128,12 +133,12 @@ static bool EmitResourceEntryDiff(IAaptContext* context, LoadedApk* apk_a,
       std::stringstream str_stream;
       str_stream << "missing " << pkg_a->name << ":" << type_a->type << "/" << entry_a->name
                  << " config=" << config_value_a->config;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
       diff = true;
     } else {
       diff |=
           EmitResourceConfigValueDiff(context, apk_a, pkg_a, type_a, entry_a, config_value_a.get(),
-                                      apk_b, pkg_b, type_b, entry_b, config_value_b);
+                                      apk_b, pkg_b, type_b, entry_b, config_value_b, out);
     }
   }
 
@@ -144,24 +149,61 @@ static bool EmitResourceEntryDiff(IAaptContext* context, LoadedApk* apk_a,
       std::stringstream str_stream;
       str_stream << "new config " << pkg_b->name << ":" << type_b->type << "/" << entry_b->name
                  << " config=" << config_value_b->config;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
       diff = true;
     }
   }
-  return false;
+  return diff;
 }
 
 static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
                                  ResourceTablePackage* pkg_a, ResourceTableType* type_a,
                                  LoadedApk* apk_b, ResourceTablePackage* pkg_b,
-                                 ResourceTableType* type_b) {
+                                 ResourceTableType* type_b, std::ostream* out) {
   bool diff = false;
+  if (type_a->visibility_level != type_b->visibility_level) {
+    std::stringstream str_stream;
+    str_stream << pkg_a->name << ":" << type_a->type << " has different visibility (";
+    if (type_b->visibility_level == Visibility::Level::kPublic) {
+      str_stream << "PUBLIC";
+    } else {
+      str_stream << "PRIVATE";
+    }
+    str_stream << " vs ";
+    if (type_a->visibility_level == Visibility::Level::kPublic) {
+      str_stream << "PUBLIC";
+    } else {
+      str_stream << "PRIVATE";
+    }
+    str_stream << ")";
+    EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
+    diff = true;
+  } else if (IsIdDiff(type_a->visibility_level, type_a->id, type_b->visibility_level,
+                      type_b->id)) {
+    std::stringstream str_stream;
+    str_stream << pkg_a->name << ":" << type_a->type << " has different public ID (";
+    if (type_b->id) {
+      str_stream << "0x" << std::hex << type_b->id.value();
+    } else {
+      str_stream << "none";
+    }
+    str_stream << " vs ";
+    if (type_a->id) {
+      str_stream << "0x " << std::hex << type_a->id.value();
+    } else {
+      str_stream << "none";
+    }
+    str_stream << ")";
+    EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
+    diff = true;
+  }
+
   for (std::unique_ptr<ResourceEntry>& entry_a : type_a->entries) {
     ResourceEntry* entry_b = type_b->FindEntry(entry_a->name);
     if (!entry_b) {
       std::stringstream str_stream;
       str_stream << "missing " << pkg_a->name << ":" << type_a->type << "/" << entry_a->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
       diff = true;
     } else {
       if (IsSymbolVisibilityDifferent(entry_a->visibility, entry_b->visibility)) {
@@ -180,7 +222,7 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
           str_stream << "PRIVATE";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
         diff = true;
       } else if (IsIdDiff(entry_a->visibility.level, entry_a->id, entry_b->visibility.level,
                           entry_b->id)) {
@@ -199,11 +241,11 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
           str_stream << "none";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
         diff = true;
       }
       diff |= EmitResourceEntryDiff(context, apk_a, pkg_a, type_a, entry_a.get(), apk_b, pkg_b,
-                                    type_b, entry_b);
+                                    type_b, entry_b, out);
     }
   }
 
@@ -213,64 +255,56 @@ static bool EmitResourceTypeDiff(IAaptContext* context, LoadedApk* apk_a,
     if (!entry_a) {
       std::stringstream str_stream;
       str_stream << "new entry " << pkg_b->name << ":" << type_b->type << "/" << entry_b->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
       diff = true;
     }
   }
   return diff;
 }
 
+// The types are compared on the pool if there is one. The differences of each type are buffered,
+// so that they are printed in the order of the types whichever thread found them.
 static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
                                     ResourceTablePackage* pkg_a, LoadedApk* apk_b,
-                                    ResourceTablePackage* pkg_b) {
-  bool diff = false;
-  for (std::unique_ptr<ResourceTableType>& type_a : pkg_a->types) {
+                                    ResourceTablePackage* pkg_b, ThreadPool* pool,
+                                    std::ostream* out) {
+  struct TypeDiff {
+    std::stringstream out;
+    bool diff = false;
+  };
+
+  std::vector<TypeDiff> type_diffs(pkg_a->types.size());
+  for (size_t i = 0; i < pkg_a->types.size(); i++) {
+    ResourceTableType* type_a = pkg_a->types[i].get();
     ResourceTableType* type_b = pkg_b->FindType(type_a->type);
+    TypeDiff* type_diff = &type_diffs[i];
     if (!type_b) {
       std::stringstream str_stream;
       str_stream << "missing " << pkg_a->name << ":" << type_a->type;
-      EmitDiffLine(apk_a->GetSource(), str_stream.str());
-      diff = true;
+      EmitDiffLine(apk_a->GetSource(), str_stream.str(), &type_diff->out);
+      type_diff->diff = true;
+      continue;
+    }
+
+    auto compare = [=] {
+      type_diff->diff = EmitResourceTypeDiff(context, apk_a, pkg_a, type_a, apk_b, pkg_b, type_b,
+                                             &type_diff->out);
+    };
+    if (pool != nullptr) {
+      pool->Schedule(compare);
     } else {
-      if (type_a->visibility_level != type_b->visibility_level) {
-        std::stringstream str_stream;
-        str_stream << pkg_a->name << ":" << type_a->type << " has different visibility (";
-        if (type_b->visibility_level == Visibility::Level::kPublic) {
-          str_stream << "PUBLIC";
-        } else {
-          str_stream << "PRIVATE";
-        }
-        str_stream << " vs ";
-        if (type_a->visibility_level == Visibility::Level::kPublic) {
-          str_stream << "PUBLIC";
-        } else {
-          str_stream << "PRIVATE";
-        }
-        str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
-        diff = true;
-      } else if (IsIdDiff(type_a->visibility_level, type_a->id, type_b->visibility_level,
-                          type_b->id)) {
-        std::stringstream str_stream;
-        str_stream << pkg_a->name << ":" << type_a->type << " has different public ID (";
-        if (type_b->id) {
-          str_stream << "0x" << std::hex << type_b->id.value();
-        } else {
-          str_stream << "none";
-        }
-        str_stream << " vs ";
-        if (type_a->id) {
-          str_stream << "0x " << std::hex << type_a->id.value();
-        } else {
-          str_stream << "none";
-        }
-        str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
-        diff = true;
-      }
-      diff |= EmitResourceTypeDiff(context, apk_a, pkg_a, type_a.get(), apk_b, pkg_b, type_b);
+      compare();
     }
   }
+  if (pool != nullptr) {
+    pool->Wait();
+  }
+
+  bool diff = false;
+  for (TypeDiff& type_diff : type_diffs) {
+    *out << type_diff.out.str();
+    diff |= type_diff.diff;
+  }
 
   // Check for any newly added types.
   for (std::unique_ptr<ResourceTableType>& type_b : pkg_b->types) {
@@ -278,14 +312,15 @@ static bool EmitResourcePackageDiff(IAaptContext* context, LoadedApk* apk_a,
     if (!type_a) {
       std::stringstream str_stream;
       str_stream << "new type " << pkg_b->name << ":" << type_b->type;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
       diff = true;
     }
   }
   return diff;
 }
 
-static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, LoadedApk* apk_b) {
+static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, LoadedApk* apk_b,
+                                  ThreadPool* pool, std::ostream* out) {
   ResourceTable* table_a = apk_a->GetResourceTable();
   ResourceTable* table_b = apk_b->GetResourceTable();
 
@@ -295,7 +330,7 @@ static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, Loade
     if (!pkg_b) {
       std::stringstream str_stream;
       str_stream << "missing package " << pkg_a->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
       diff = true;
     } else {
       if (pkg_a->id != pkg_b->id) {
@@ -313,10 +348,10 @@ static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, Loade
           str_stream << "none";
         }
         str_stream << ")";
-        EmitDiffLine(apk_b->GetSource(), str_stream.str());
+        EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
         diff = true;
       }
-      diff |= EmitResourcePackageDiff(context, apk_a, pkg_a.get(), apk_b, pkg_b);
+      diff |= EmitResourcePackageDiff(context, apk_a, pkg_a.get(), apk_b, pkg_b, pool, out);
     }
   }
 
@@ -326,7 +361,67 @@ static bool EmitResourceTableDiff(IAaptContext* context, LoadedApk* apk_a, Loade
     if (!pkg_a) {
       std::stringstream str_stream;
       str_stream << "new package " << pkg_b->name;
-      EmitDiffLine(apk_b->GetSource(), str_stream.str());
+      EmitDiffLine(apk_b->GetSource(), str_stream.str(), out);
+      diff = true;
+    }
+  }
+  return diff;
+}
+
+// Returns the files of the APK by name, leaving out the resource table, which is compared resource
+// by resource.
+static std::map<std::string, io::ZipFile*> GetFilesByName(io::ZipFileCollection* collection) {
+  std::map<std::string, io::ZipFile*> files;
+  std::unique_ptr<io::IFileCollectionIterator> iter = collection->Iterator();
+  while (iter->HasNext()) {
+    // Every file of a ZipFileCollection is a ZipFile.
+    io::ZipFile* file = static_cast<io::ZipFile*>(iter->Next());
+    const std::string& name = file->GetSource().path;
+    if (name != kApkResourceTablePath && name != kProtoResourceTablePath) {
+      files[name] = file;
+    }
+  }
+  return files;
+}
+
+// Compares the files of the APKs, such as compiled XML files and assets, by the CRC-32 and size
+// that the ZIP central directory records for them, so that the files themselves are not read.
+// Returns true if the files differ or could not be listed.
+static bool EmitFileDiff(LoadedApk* apk_a, LoadedApk* apk_b, IDiagnostics* diag,
+                         std::ostream* out) {
+  std::string error;
+  std::unique_ptr<io::ZipFileCollection> collection_a =
+      io::ZipFileCollection::Create(apk_a->GetSource().path, &error);
+  if (collection_a == nullptr) {
+    diag->Error(DiagMessage(apk_a->GetSource()) << "failed to open APK: " << error);
+    return true;
+  }
+  std::unique_ptr<io::ZipFileCollection> collection_b =
+      io::ZipFileCollection::Create(apk_b->GetSource().path, &error);
+  if (collection_b == nullptr) {
+    diag->Error(DiagMessage(apk_b->GetSource()) << "failed to open APK: " << error);
+    return true;
+  }
+
+  const std::map<std::string, io::ZipFile*> files_a = GetFilesByName(collection_a.get());
+  const std::map<std::string, io::ZipFile*> files_b = GetFilesByName(collection_b.get());
+  bool diff = false;
+  for (const auto& [name, file_a] : files_a) {
+    auto iter = files_b.find(name);
+    if (iter == files_b.end()) {
+      EmitDiffLine(apk_b->GetSource(), "missing file " + name, out);
+      diff = true;
+    } else if (file_a->GetCrc32() != iter->second->GetCrc32() ||
+               file_a->GetUncompressedSize() != iter->second->GetUncompressedSize()) {
+      EmitDiffLine(apk_b->GetSource(), "file " + name + " does not match", out);
+      diff = true;
+    }
+  }
+
+  // Check for any newly added files.
+  for (const auto& [name, file_b] : files_b) {
+    if (files_a.find(name) == files_a.end()) {
+      EmitDiffLine(apk_b->GetSource(), "new file " + name, out);
       diff = true;
     }
   }
@@ -361,17 +456,54 @@ int DiffCommand::Action(const std::vector<std::string>& args) {
   }
 
   IDiagnostics* diag = context.GetDiagnostics();
-  std::unique_ptr<LoadedApk> apk_a = LoadedApk::LoadApkFromPath(args[0], diag);
-  std::unique_ptr<LoadedApk> apk_b = LoadedApk::LoadApkFromPath(args[1], diag);
-  if (!apk_a || !apk_b) {
+  size_t jobs = 1;
+  if (jobs_) {
+    Maybe<size_t> parsed_jobs = ThreadPool::ParseThreadCount(jobs_.value());
+    if (!parsed_jobs) {
+      diag->Error(DiagMessage() << "invalid value for -j: '" << jobs_.value() << "'");
+      return 1;
+    }
+    jobs = parsed_jobs.value();
+  }
+
+  std::unique_ptr<ThreadPool> pool;
+  if (jobs != 1) {
+    pool = util::make_unique<ThreadPool>(jobs);
+  }
+
+  // With a pool, both APKs are loaded at the same time. Their diagnostics are reported in the
+  // order of the arguments.
+  std::unique_ptr<LoadedApk> apks[2];
+  BufferedDiagnostics load_diagnostics[2];
+  for (size_t i = 0; i < 2; i++) {
+    auto load = [&, i] {
+      apks[i] = LoadedApk::LoadApkFromPath(args[i], &load_diagnostics[i]);
+      if (apks[i] != nullptr) {
+        // Zero out Application IDs in references.
+        ZeroOutAppReferences(apks[i]->GetResourceTable());
+      }
+    };
+    if (pool != nullptr) {
+      pool->Schedule(load);
+    } else {
+      load();
+    }
+  }
+  if (pool != nullptr) {
+    pool->Wait();
+  }
+  load_diagnostics[0].FlushTo(diag);
+  load_diagnostics[1].FlushTo(diag);
+  if (!apks[0] || !apks[1]) {
     return 1;
   }
 
-  // Zero out Application IDs in references.
-  ZeroOutAppReferences(apk_a->GetResourceTable());
-  ZeroOutAppReferences(apk_b->GetResourceTable());
+  bool diff = EmitResourceTableDiff(&context, apks[0].get(), apks[1].get(), pool.get(), &std::cerr);
+  if (compare_files_) {
+    diff |= EmitFileDiff(apks[0].get(), apks[1].get(), diag, &std::cerr);
+  }
 
-  if (EmitResourceTableDiff(&context, apk_a.get(), apk_b.get())) {
+  if (diff) {
     // We emitted a diff, so return 1 (failure).
     return 1;
   }
@@ -25,9 +25,21 @@ class DiffCommand : public Command {
  public:
   explicit DiffCommand() : Command("diff") {
     SetDescription("Prints the differences in resources of two apks.");
+    AddOptionalFlag("-j",
+        "Number of resource types to compare in parallel, or 0 for one per CPU.\n"
+            "Defaults to 1.",
+        &jobs_);
+    AddOptionalSwitch("--compare-files",
+        "Also compares the files of the apks other than their resource tables, such as\n"
+            "compiled XML files and assets, by the CRC-32 and size recorded in the apks.",
+        &compare_files_);
   }
 
   int Action(const std::vector<std::string>& args) override;
+
+ private:
+  Maybe<std::string> jobs_;
+  bool compare_files_ = false;
 };
 
 }// namespace aapt
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Diff.h"
+
+#include "test/Fixture.h"
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::HasSubstr;
+using ::testing::Lt;
+using ::testing::Ne;
+using ::testing::Not;
+
+namespace aapt {
+
+using DiffTest = CommandTestFixture;
+
+TEST_F(DiffTest, ParallelDiffIsOrderedAndComparesFiles) {
+  StdErrDiagnostics diag;
+  const std::string compiled_a = GetTestPath("compiled_a");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources>
+                               <string name="title">Title</string>
+                               <string name="subtitle">Subtitle</string>
+                               <dimen name="padding">8dp</dimen>
+                             </resources>)",
+                          compiled_a, &diag));
+  ASSERT_TRUE(CompileFile(GetTestPath("res/layout/main.xml"),
+                          R"(<View xmlns:android="http://schemas.android.com/apk/res/android"
+                                   android:padding="@dimen/padding"/>)",
+                          compiled_a, &diag));
+  const std::string apk_a = GetTestPath("a.apk");
+  ASSERT_TRUE(Link({"--manifest", GetDefaultManifest(), "-o", apk_a}, compiled_a, &diag));
+
+  const std::string compiled_b = GetTestPath("compiled_b");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources>
+                               <string name="title">New title</string>
+                               <string name="caption">Caption</string>
+                               <dimen name="padding">8dp</dimen>
+                             </resources>)",
+                          compiled_b, &diag));
+  ASSERT_TRUE(CompileFile(GetTestPath("res/layout/main.xml"),
+                          R"(<View xmlns:android="http://schemas.android.com/apk/res/android"
+                                   android:padding="@dimen/padding"
+                                   android:alpha="0.5"/>)",
+                          compiled_b, &diag));
+  const std::string apk_b = GetTestPath("b.apk");
+  ASSERT_TRUE(Link({"--manifest", GetDefaultManifest(), "-o", apk_b}, compiled_b, &diag));
+
+  auto diff = [&](const std::vector<std::string>& args, std::string* out_output) {
+    std::vector<android::StringPiece> diff_args;
+    for (const std::string& arg : args) {
+      diff_args.emplace_back(arg);
+    }
+    testing::internal::CaptureStderr();
+    const int result = DiffCommand().Execute(diff_args, &std::cerr);
+    *out_output = testing::internal::GetCapturedStderr();
+    return result;
+  };
+
+  std::string serial_output;
+  ASSERT_THAT(diff({apk_a, apk_b, "--compare-files"}, &serial_output), Eq(1));
+  const size_t title = serial_output.find("value com.aapt.command.test:string/title");
+  const size_t subtitle = serial_output.find("missing com.aapt.command.test:string/subtitle");
+  const size_t caption = serial_output.find("new entry com.aapt.command.test:string/caption");
+  const size_t layout = serial_output.find("file res/layout/main.xml does not match");
+  ASSERT_THAT(title, Ne(std::string::npos));
+  ASSERT_THAT(subtitle, Ne(std::string::npos));
+  ASSERT_THAT(caption, Ne(std::string::npos));
+  ASSERT_THAT(layout, Ne(std::string::npos));
+  EXPECT_THAT(title, Lt(caption));
+  EXPECT_THAT(subtitle, Lt(caption));
+  EXPECT_THAT(caption, Lt(layout));
+  EXPECT_THAT(serial_output, Not(HasSubstr("padding")));
+
+  std::string parallel_output;
+  ASSERT_THAT(diff({apk_a, apk_b, "--compare-files", "-j", "4"}, &parallel_output), Eq(1));
+  EXPECT_THAT(parallel_output, Eq(serial_output));
+
+  std::string same_output;
+  EXPECT_THAT(diff({apk_a, apk_a, "--compare-files", "-j", "4"}, &same_output), Eq(0));
+  EXPECT_THAT(same_output, Eq(""));
+}
+
+}  // namespace aapt
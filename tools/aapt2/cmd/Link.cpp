@@ -20,7 +20,9 @@
 #include <cinttypes>
 
 #include <algorithm>
-#include <queue>
+#include <condition_variable>
+#include <iterator>
+#include <mutex>
 #include <unordered_map>
 #include <vector>
 
@@ -50,11 +52,14 @@
 #include "io/BigBufferStream.h"
 #include "io/FileStream.h"
 #include "io/FileSystem.h"
+#include "io/StringStream.h"
 #include "io/Util.h"
 #include "io/ZipArchive.h"
+#include "java/ClassDefinition.h"
 #include "java/JavaClassGenerator.h"
 #include "java/ManifestClassGenerator.h"
 #include "java/ProguardRules.h"
+#include "link/LinkCache.h"
 #include "link/Linkers.h"
 #include "link/ManifestFixer.h"
 #include "link/NoDefaultResourceRemover.h"
@@ -65,10 +70,13 @@
 #include "optimize/ResourceDeduper.h"
 #include "optimize/VersionCollapser.h"
 #include "process/IResourceTableConsumer.h"
+#include "process/IncludeCache.h"
 #include "process/SymbolTable.h"
 #include "split/TableSplitter.h"
 #include "trace/TraceBuffer.h"
 #include "util/Files.h"
+#include "util/Fingerprint.h"
+#include "util/ThreadPool.h"
 #include "xml/XmlDom.h"
 
 using ::aapt::io::FileInputStream;
@@ -282,6 +290,7 @@ struct ResourceFileFlattenerOptions {
   OutputFormat output_format = OutputFormat::kApk;
   std::unordered_set<std::string> extensions_to_not_compress;
   Maybe<std::regex> regex_to_not_compress;
+  size_t jobs = 1;
 };
 
 // A sampling of public framework resource IDs.
@@ -326,14 +335,73 @@ uint32_t GetCompressionFlags(const StringPiece& str, T options) {
   return ArchiveEntry::kCompress;
 }
 
+// The context of an XML file linked on a worker thread, which reports its diagnostics to the
+// diagnostics of the file rather than those of the link.
+class FileFlattenerContext : public IAaptContext {
+ public:
+  FileFlattenerContext(IAaptContext* context, IDiagnostics* diagnostics)
+      : context_(context), diagnostics_(diagnostics) {
+  }
+
+  PackageType GetPackageType() override {
+    return context_->GetPackageType();
+  }
+
+  SymbolTable* GetExternalSymbols() override {
+    return context_->GetExternalSymbols();
+  }
+
+  IDiagnostics* GetDiagnostics() override {
+    return diagnostics_;
+  }
+
+  const std::string& GetCompilationPackage() override {
+    return context_->GetCompilationPackage();
+  }
+
+  uint8_t GetPackageId() override {
+    return context_->GetPackageId();
+  }
+
+  NameMangler* GetNameMangler() override {
+    return context_->GetNameMangler();
+  }
+
+  bool IsVerbose() override {
+    return context_->IsVerbose();
+  }
+
+  int GetMinSdkVersion() override {
+    return context_->GetMinSdkVersion();
+  }
+
+  const std::set<std::string>& GetSplitNameDependencies() override {
+    return context_->GetSplitNameDependencies();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FileFlattenerContext);
+
+  IAaptContext* context_;
+  IDiagnostics* diagnostics_;
+};
+
 class ResourceFileFlattener {
  public:
+  // Linked XML files are looked up in and added to the cache, unless it is null.
   ResourceFileFlattener(const ResourceFileFlattenerOptions& options, IAaptContext* context,
-                        proguard::KeepSet* keep_set);
+                        proguard::KeepSet* keep_set, LinkCache* cache);
 
   bool Flatten(ResourceTable* table, IArchiveWriter* archive_writer);
 
  private:
+  // A version of a file generated for a newer SDK level.
+  struct VersionedFile {
+    ResourceFile file;
+    ConfigDescription original_config;
+    std::string dst_path;
+  };
+
   struct FileOperation {
     ConfigDescription config;
 
@@ -343,25 +411,62 @@ class ResourceFileFlattener {
     // The file to copy as-is.
     io::IFile* file_to_copy;
 
+    // The compiled XML file to process and flatten, and its name, configuration and source.
+    std::unique_ptr<io::IData> xml_data;
+    ResourceFile::Type xml_type = ResourceFile::Type::kUnknown;
+    ResourceFile xml_file;
+
     // The XML to process and flatten.
     std::unique_ptr<xml::XmlResource> xml_to_flatten;
 
     // The destination to write this file to.
     std::string dst_path;
+
+    // What linking the XML file produced, which is reported and written once the files before
+    // it have been. The versions generated for newer SDK levels are added to the table once
+    // every file has been linked.
+    BufferedDiagnostics diagnostics;
+    BufferedArchiveWriter writer;
+    std::vector<VersionedFile> versioned_files;
+    bool success = false;
   };
 
-  std::vector<std::unique_ptr<xml::XmlResource>> LinkAndVersionXmlFile(ResourceTable* table,
+  // Inflates the compiled XML file and checks that its root element is supported by the SDK
+  // levels it is used on.
+  bool InflateXmlFile(IAaptContext* context, FileOperation* file_op);
+
+  std::vector<std::unique_ptr<xml::XmlResource>> LinkAndVersionXmlFile(IAaptContext* context,
                                                                        FileOperation* file_op);
 
+  // Links and versions the XML file, and flattens every version to the writer of the file
+  // operation. The configuration of each version is appended to out_configs, in the order the
+  // versions were written.
+  bool LinkAndFlattenXmlFile(IAaptContext* context, FileOperation* file_op,
+                             std::vector<ConfigDescription>* out_configs);
+
+  // Same as LinkAndFlattenXmlFile(), but reuses the files written for the same input by a
+  // previous link if there is a cache entry for it.
+  bool LinkAndFlattenXmlFileWithCache(IAaptContext* context, FileOperation* file_op);
+
+  // Links and flattens the XML file of the file operation. This does not modify the table, so
+  // several files may be flattened at the same time.
+  void FlattenXmlFile(FileOperation* file_op);
+
+  // Adds a reference to a version of a file generated for a newer SDK level.
+  bool AddVersionedFile(ResourceTable* table, const VersionedFile& versioned_file);
+
   ResourceFileFlattenerOptions options_;
   IAaptContext* context_;
   proguard::KeepSet* keep_set_;
+  std::mutex keep_set_mutex_;
+  LinkCache* cache_;
   XmlCompatVersioner::Rules rules_;
 };
 
 ResourceFileFlattener::ResourceFileFlattener(const ResourceFileFlattenerOptions& options,
-                                             IAaptContext* context, proguard::KeepSet* keep_set)
-    : options_(options), context_(context), keep_set_(keep_set) {
+                                             IAaptContext* context, proguard::KeepSet* keep_set,
+                                             LinkCache* cache)
+    : options_(options), context_(context), keep_set_(keep_set), cache_(cache) {
   SymbolTable* symm = context_->GetExternalSymbols();
 
   // Build up the rules for degrading newer attributes to older ones.
@@ -429,15 +534,77 @@ std::vector<T> make_singleton_vec(T&& val) {
   return vec;
 }
 
+ResourceFile::Type XmlFileTypeForOutputFormat(OutputFormat format) {
+  switch (format) {
+    case OutputFormat::kApk:
+      return ResourceFile::Type::kBinaryXml;
+    case OutputFormat::kProto:
+      return ResourceFile::Type::kProtoXml;
+  }
+  LOG_ALWAYS_FATAL("unreachable");
+  return ResourceFile::Type::kUnknown;
+}
+
+static auto kDrawableVersions = std::map<std::string, ApiVersion>{
+    { "adaptive-icon" , SDK_O },
+};
+
+bool ResourceFileFlattener::InflateXmlFile(IAaptContext* context, FileOperation* file_op) {
+  TRACE_CALL();
+  const io::IData* data = file_op->xml_data.get();
+  if (file_op->xml_type == ResourceFile::Type::kProtoXml) {
+    pb::XmlNode pb_xml_node;
+    if (!pb_xml_node.ParseFromArray(data->data(), static_cast<int>(data->size()))) {
+      context->GetDiagnostics()->Error(DiagMessage(file_op->file_to_copy->GetSource())
+                                       << "failed to parse proto XML");
+      return false;
+    }
+
+    std::string error;
+    file_op->xml_to_flatten = DeserializeXmlResourceFromPb(pb_xml_node, &error);
+    if (file_op->xml_to_flatten == nullptr) {
+      context->GetDiagnostics()->Error(DiagMessage(file_op->file_to_copy->GetSource())
+                                       << "failed to deserialize proto XML: " << error);
+      return false;
+    }
+  } else {
+    std::string error_str;
+    file_op->xml_to_flatten = xml::Inflate(data->data(), data->size(), &error_str);
+    if (file_op->xml_to_flatten == nullptr) {
+      context->GetDiagnostics()->Error(DiagMessage(file_op->file_to_copy->GetSource())
+                                       << "failed to parse binary XML: " << error_str);
+      return false;
+    }
+  }
+
+  file_op->xml_to_flatten->file.config = file_op->xml_file.config;
+  file_op->xml_to_flatten->file.source = file_op->xml_file.source;
+  file_op->xml_to_flatten->file.name = file_op->xml_file.name;
+
+  // Check minimum sdk versions supported for drawables
+  auto drawable_entry = kDrawableVersions.find(file_op->xml_to_flatten->root->name);
+  if (drawable_entry != kDrawableVersions.end()) {
+    if (drawable_entry->second > context->GetMinSdkVersion()
+        && drawable_entry->second > file_op->config.sdkVersion) {
+      context->GetDiagnostics()->Error(DiagMessage(file_op->xml_to_flatten->file.source)
+                                           << "<" << drawable_entry->first << "> elements "
+                                           << "require a sdk version of at least "
+                                           << (int16_t) drawable_entry->second);
+      return false;
+    }
+  }
+  return true;
+}
+
 std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVersionXmlFile(
-    ResourceTable* table, FileOperation* file_op) {
+    IAaptContext* context, FileOperation* file_op) {
   TRACE_CALL();
   xml::XmlResource* doc = file_op->xml_to_flatten.get();
   const Source& src = doc->file.source;
 
-  if (context_->IsVerbose()) {
-    context_->GetDiagnostics()->Note(DiagMessage()
-                                     << "linking " << src.path << " (" << doc->file.name << ")");
+  if (context->IsVerbose()) {
+    context->GetDiagnostics()->Note(DiagMessage()
+                                    << "linking " << src.path << " (" << doc->file.name << ")");
   }
 
   // First, strip out any tools namespace attributes. AAPT stripped them out early, which means
@@ -445,17 +612,20 @@ std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVer
   xml::StripAndroidStudioAttributes(doc->root.get());
 
   XmlReferenceLinker xml_linker;
-  if (!options_.do_not_fail_on_missing_resources && !xml_linker.Consume(context_, doc)) {
+  if (!options_.do_not_fail_on_missing_resources && !xml_linker.Consume(context, doc)) {
     return {};
   }
 
-  if (options_.update_proguard_spec && !proguard::CollectProguardRules(context_, doc, keep_set_)) {
-    return {};
+  if (options_.update_proguard_spec) {
+    std::lock_guard<std::mutex> lock(keep_set_mutex_);
+    if (!proguard::CollectProguardRules(context, doc, keep_set_)) {
+      return {};
+    }
   }
 
   if (options_.no_xml_namespaces) {
     XmlNamespaceRemover namespace_remover;
-    if (!namespace_remover.Consume(context_, doc)) {
+    if (!namespace_remover.Consume(context, doc)) {
       return {};
     }
   }
@@ -481,28 +651,148 @@ std::vector<std::unique_ptr<xml::XmlResource>> ResourceFileFlattener::LinkAndVer
   XmlCompatVersioner xml_compat_versioner(&rules_);
   const util::Range<ApiVersion> api_range{config.sdkVersion,
                                           FindNextApiVersionForConfig(entry, config)};
-  return xml_compat_versioner.Process(context_, doc, api_range);
+  return xml_compat_versioner.Process(context, doc, api_range);
 }
 
-ResourceFile::Type XmlFileTypeForOutputFormat(OutputFormat format) {
-  switch (format) {
-    case OutputFormat::kApk:
-      return ResourceFile::Type::kBinaryXml;
-    case OutputFormat::kProto:
-      return ResourceFile::Type::kProtoXml;
+bool ResourceFileFlattener::AddVersionedFile(ResourceTable* table,
+                                             const VersionedFile& versioned_file) {
+  const ResourceFile& file = versioned_file.file;
+  if (context_->IsVerbose()) {
+    context_->GetDiagnostics()->Note(DiagMessage(file.source)
+                                     << "auto-versioning resource from config '"
+                                     << versioned_file.original_config << "' -> '" << file.config
+                                     << "'");
+  }
+
+  std::unique_ptr<FileReference> file_ref =
+      util::make_unique<FileReference>(table->string_pool.MakeRef(versioned_file.dst_path));
+  file_ref->SetSource(file.source);
+  // Update the output format of this XML file.
+  file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
+  return table->AddResourceMangled(file.name, file.config, {}, std::move(file_ref),
+                                   context_->GetDiagnostics());
+}
+
+bool ResourceFileFlattener::LinkAndFlattenXmlFile(IAaptContext* context, FileOperation* file_op,
+                                                  std::vector<ConfigDescription>* out_configs) {
+  if (!InflateXmlFile(context, file_op)) {
+    return false;
   }
-  LOG_ALWAYS_FATAL("unreachable");
-  return ResourceFile::Type::kUnknown;
+
+  std::vector<std::unique_ptr<xml::XmlResource>> versioned_docs =
+      LinkAndVersionXmlFile(context, file_op);
+  if (versioned_docs.empty()) {
+    return false;
+  }
+
+  bool error = false;
+  for (std::unique_ptr<xml::XmlResource>& doc : versioned_docs) {
+    std::string dst_path = file_op->dst_path;
+    if (doc->file.config != file_op->config) {
+      // Only add the new versioned configurations.
+      dst_path = ResourceUtils::BuildResourceFileName(doc->file, context->GetNameMangler());
+      file_op->versioned_files.push_back(VersionedFile{doc->file, file_op->config, dst_path});
+    }
+
+    error |= !FlattenXml(context, *doc, dst_path, options_.keep_raw_values, false /*utf16*/,
+                         options_.output_format, &file_op->writer);
+    if (out_configs != nullptr) {
+      out_configs->push_back(doc->file.config);
+    }
+  }
+  return !error;
 }
 
-static auto kDrawableVersions = std::map<std::string, ApiVersion>{
-    { "adaptive-icon" , SDK_O },
-};
+bool ResourceFileFlattener::LinkAndFlattenXmlFileWithCache(IAaptContext* context,
+                                                           FileOperation* file_op) {
+  TRACE_CALL();
+  const StringPiece input(reinterpret_cast<const char*>(file_op->xml_data->data()),
+                          file_op->xml_data->size());
+  const ResourceFile& file = file_op->xml_file;
+
+  // The input identifies the contents of the file. Everything else it is linked with that is
+  // not part of the fingerprint of the cache is part of the key.
+  const std::string key = StringPrintf(
+      "%s\n%s\n%s\n%d", file.name.to_string().c_str(), file_op->config.to_string().c_str(),
+      file_op->dst_path.c_str(), FindNextApiVersionForConfig(file_op->entry, file_op->config));
+
+  std::vector<LinkedFile> linked_files;
+  if (cache_->Find(key, input, &linked_files)) {
+    if (context->IsVerbose()) {
+      context->GetDiagnostics()->Note(DiagMessage(file.source) << "using linked file from cache");
+    }
+
+    for (const LinkedFile& linked_file : linked_files) {
+      if (linked_file.config != file_op->config) {
+        ResourceFile versioned_file = file;
+        versioned_file.config = linked_file.config;
+        file_op->versioned_files.push_back(
+            VersionedFile{std::move(versioned_file), file_op->config, linked_file.path});
+      }
+
+      if (options_.output_format == OutputFormat::kProto) {
+        // FlattenXml writes proto XML as an entry rather than as a file, so do the same here.
+        BufferedArchiveWriter* writer = &file_op->writer;
+        if (!writer->StartEntry(linked_file.path, linked_file.compression_flags) ||
+            !writer->Write(linked_file.data.data(), static_cast<int>(linked_file.data.size())) ||
+            !writer->FinishEntry()) {
+          context->GetDiagnostics()->Error(DiagMessage() << "failed to write " << linked_file.path
+                                                         << " to archive");
+          return false;
+        }
+        continue;
+      }
+
+      io::StringInputStream in(linked_file.data);
+      if (!io::CopyInputStreamToArchive(context, &in, linked_file.path,
+                                        linked_file.compression_flags, &file_op->writer)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::vector<ConfigDescription> configs;
+  if (!LinkAndFlattenXmlFile(context, file_op, &configs)) {
+    return false;
+  }
+
+  const std::vector<std::unique_ptr<BufferedArchiveWriter::Entry>>& entries =
+      file_op->writer.entries();
+  CHECK(entries.size() == configs.size());
+  for (size_t i = 0; i < entries.size(); i++) {
+    LinkedFile linked_file;
+    linked_file.config = configs[i];
+    linked_file.path = entries[i]->path;
+    linked_file.compression_flags = entries[i]->flags;
+    linked_file.data = entries[i]->data.to_string();
+    linked_files.push_back(std::move(linked_file));
+  }
+  cache_->Put(key, input, linked_files);
+  return true;
+}
+
+void ResourceFileFlattener::FlattenXmlFile(FileOperation* file_op) {
+  TRACE_CALL();
+  FileFlattenerContext context(context_, &file_op->diagnostics);
+
+  // The proguard rules are collected from the linked XML, so it must always be linked when they
+  // are requested.
+  if (cache_ != nullptr && !options_.update_proguard_spec) {
+    file_op->success = LinkAndFlattenXmlFileWithCache(&context, file_op);
+  } else {
+    file_op->success = LinkAndFlattenXmlFile(&context, file_op, nullptr);
+  }
+}
 
 bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archive_writer) {
   TRACE_CALL();
   bool error = false;
-  std::map<std::pair<ConfigDescription, StringPiece>, FileOperation> config_sorted_files;
+  std::map<std::pair<ConfigDescription, StringPiece>, std::unique_ptr<FileOperation>>
+      config_sorted_files;
+
+  // The files of every type, in the order they are written to the archive.
+  std::vector<std::unique_ptr<FileOperation>> file_operations;
 
   proguard::CollectResourceReferences(context_, table, keep_set_);
 
@@ -512,7 +802,6 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
     for (auto& type : pkg->types) {
       // Sort by config and name, so that we get better locality in the zip file.
       config_sorted_files.clear();
-      std::queue<FileOperation> file_operations;
 
       // Populate the queue with all files in the ResourceTable.
       for (auto& entry : type->entries) {
@@ -532,53 +821,31 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
             return false;
           }
 
-          FileOperation file_op;
-          file_op.entry = entry.get();
-          file_op.dst_path = *file_ref->path;
-          file_op.config = config_value->config;
-          file_op.file_to_copy = file;
+          auto file_op = util::make_unique<FileOperation>();
+          file_op->entry = entry.get();
+          file_op->dst_path = *file_ref->path;
+          file_op->config = config_value->config;
+          file_op->file_to_copy = file;
 
           if (type->type != ResourceType::kRaw &&
               (file_ref->type == ResourceFile::Type::kBinaryXml ||
                file_ref->type == ResourceFile::Type::kProtoXml)) {
-            std::unique_ptr<io::IData> data = file->OpenAsData();
-            if (!data) {
+            // Files are opened here, as the file collections can not be read from several
+            // threads. They are inflated and linked on the thread that flattens them.
+            file_op->xml_data = file->OpenAsData();
+            if (!file_op->xml_data) {
               context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
                                                 << "failed to open file");
               return false;
             }
-
-            if (file_ref->type == ResourceFile::Type::kProtoXml) {
-              pb::XmlNode pb_xml_node;
-              if (!pb_xml_node.ParseFromArray(data->data(), static_cast<int>(data->size()))) {
-                context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                  << "failed to parse proto XML");
-                return false;
-              }
-
-              std::string error;
-              file_op.xml_to_flatten = DeserializeXmlResourceFromPb(pb_xml_node, &error);
-              if (file_op.xml_to_flatten == nullptr) {
-                context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                  << "failed to deserialize proto XML: " << error);
-                return false;
-              }
-            } else {
-              std::string error_str;
-              file_op.xml_to_flatten = xml::Inflate(data->data(), data->size(), &error_str);
-              if (file_op.xml_to_flatten == nullptr) {
-                context_->GetDiagnostics()->Error(DiagMessage(file->GetSource())
-                                                  << "failed to parse binary XML: " << error_str);
-                return false;
-              }
-            }
+            file_op->xml_type = file_ref->type;
 
             // Update the type that this file will be written as.
             file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
 
-            file_op.xml_to_flatten->file.config = config_value->config;
-            file_op.xml_to_flatten->file.source = file_ref->GetSource();
-            file_op.xml_to_flatten->file.name = ResourceName(pkg->name, type->type, entry->name);
+            file_op->xml_file.config = config_value->config;
+            file_op->xml_file.source = file_ref->GetSource();
+            file_op->xml_file.name = ResourceName(pkg->name, type->type, entry->name);
           }
 
           // NOTE(adamlesinski): Explicitly construct a StringPiece here, or
@@ -591,68 +858,77 @@ bool ResourceFileFlattener::Flatten(ResourceTable* table, IArchiveWriter* archiv
         }
       }
 
-      // Now flatten the sorted values.
       for (auto& map_entry : config_sorted_files) {
-        const ConfigDescription& config = map_entry.first.first;
-        FileOperation& file_op = map_entry.second;
-
-        if (file_op.xml_to_flatten) {
-          // Check minimum sdk versions supported for drawables
-          auto drawable_entry = kDrawableVersions.find(file_op.xml_to_flatten->root->name);
-          if (drawable_entry != kDrawableVersions.end()) {
-            if (drawable_entry->second > context_->GetMinSdkVersion()
-                && drawable_entry->second > config.sdkVersion) {
-              context_->GetDiagnostics()->Error(DiagMessage(file_op.xml_to_flatten->file.source)
-                                                    << "<" << drawable_entry->first << "> elements "
-                                                    << "require a sdk version of at least "
-                                                    << (int16_t) drawable_entry->second);
-              error = true;
-              continue;
-            }
-          }
+        file_operations.push_back(std::move(map_entry.second));
+      }
+    }
+  }
+
+  // Now flatten the sorted files. The XML files are linked on a pool of threads, and each file is
+  // reported and written as soon as the files before it have been, so the archive and the
+  // diagnostics are the same as when linking the files one at a time.
+  std::mutex done_mutex;
+  std::condition_variable file_done;
+  std::vector<bool> done(file_operations.size(), false);
+  std::vector<VersionedFile> versioned_files;
+  {
+    std::unique_ptr<ThreadPool> pool;
+    if (options_.jobs != 1) {
+      pool = util::make_unique<ThreadPool>(options_.jobs);
+      for (size_t i = 0; i < file_operations.size(); i++) {
+        FileOperation* file_op = file_operations[i].get();
+        if (!file_op->xml_data) {
+          continue;
+        }
 
-          std::vector<std::unique_ptr<xml::XmlResource>> versioned_docs =
-              LinkAndVersionXmlFile(table, &file_op);
-          if (versioned_docs.empty()) {
-            error = true;
-            continue;
+        pool->Schedule([&, i, file_op] {
+          FlattenXmlFile(file_op);
+          {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            done[i] = true;
           }
+          file_done.notify_one();
+        });
+      }
+    }
 
-          for (std::unique_ptr<xml::XmlResource>& doc : versioned_docs) {
-            std::string dst_path = file_op.dst_path;
-            if (doc->file.config != file_op.config) {
-              // Only add the new versioned configurations.
-              if (context_->IsVerbose()) {
-                context_->GetDiagnostics()->Note(DiagMessage(doc->file.source)
-                                                 << "auto-versioning resource from config '"
-                                                 << config << "' -> '" << doc->file.config << "'");
-              }
+    for (size_t i = 0; i < file_operations.size(); i++) {
+      FileOperation* file_op = file_operations[i].get();
+      if (!file_op->xml_data) {
+        error |= !io::CopyFileToArchive(context_, file_op->file_to_copy, file_op->dst_path,
+                                        GetCompressionFlags(file_op->dst_path, options_),
+                                        archive_writer);
+        continue;
+      }
 
-              const ResourceFile& file = doc->file;
-              dst_path = ResourceUtils::BuildResourceFileName(file, context_->GetNameMangler());
-
-              std::unique_ptr<FileReference> file_ref =
-                  util::make_unique<FileReference>(table->string_pool.MakeRef(dst_path));
-              file_ref->SetSource(doc->file.source);
-              // Update the output format of this XML file.
-              file_ref->type = XmlFileTypeForOutputFormat(options_.output_format);
-              if (!table->AddResourceMangled(file.name, file.config, {}, std::move(file_ref),
-                                             context_->GetDiagnostics())) {
-                return false;
-              }
-            }
+      if (pool == nullptr) {
+        FlattenXmlFile(file_op);
+      } else {
+        std::unique_lock<std::mutex> lock(done_mutex);
+        file_done.wait(lock, [&] { return done[i]; });
+      }
 
-            error |= !FlattenXml(context_, *doc, dst_path, options_.keep_raw_values,
-                                 false /*utf16*/, options_.output_format, archive_writer);
-          }
-        } else {
-          error |= !io::CopyFileToArchive(context_, file_op.file_to_copy, file_op.dst_path,
-                                          GetCompressionFlags(file_op.dst_path, options_),
-                                          archive_writer);
-        }
+      file_op->diagnostics.FlushTo(context_->GetDiagnostics());
+      if (!file_op->writer.WriteTo(archive_writer)) {
+        context_->GetDiagnostics()->Error(DiagMessage(file_op->xml_file.source)
+                                          << "failed to write linked file to archive: "
+                                          << archive_writer->GetError());
+        error = true;
       }
+      error |= !file_op->success;
+      std::move(file_op->versioned_files.begin(), file_op->versioned_files.end(),
+                std::back_inserter(versioned_files));
+
+      // Release the linked file as soon as it is written.
+      file_operations[i].reset();
     }
   }
+
+  // Linking does not modify the table, so that files can be linked at the same time. The versions
+  // generated for newer SDK levels are added once every file has been linked, in file order.
+  for (const VersionedFile& versioned_file : versioned_files) {
+    error |= !AddVersionedFile(table, versioned_file);
+  }
   return !error;
 }
 
@@ -730,6 +1006,23 @@ static bool LoadStableIdMap(IDiagnostics* diag, const std::string& path,
   return true;
 }
 
+// Writes contents to the file at path, unless the file already has these contents. An unchanged
+// file keeps its modification time, so that the build does not redo the work that depends on it.
+static bool WriteFileIfChanged(IDiagnostics* diag, const std::string& path,
+                               const std::string& contents) {
+  std::string current_contents;
+  if (android::base::ReadFileToString(path, &current_contents) && current_contents == contents) {
+    return true;
+  }
+
+  io::FileOutputStream fout(path);
+  if (fout.HadError() || !io::Copy(&fout, contents) || !fout.Flush()) {
+    diag->Error(DiagMessage() << "failed writing to '" << path << "': " << fout.GetError());
+    return false;
+  }
+  return true;
+}
+
 static android::ApkAssetsCookie FindFrameworkAssetManagerCookie(
     const android::AssetManager2& assets) {
   using namespace android;
@@ -748,9 +1041,10 @@ static android::ApkAssetsCookie FindFrameworkAssetManagerCookie(
 
 class Linker {
  public:
-  Linker(LinkContext* context, const LinkOptions& options)
+  Linker(LinkContext* context, const LinkOptions& options, IncludeCache* include_cache)
       : options_(options),
         context_(context),
+        include_cache_(include_cache),
         final_table_(),
         file_collection_(util::make_unique<io::FileCollection>()) {
   }
@@ -826,21 +1120,15 @@ class Linker {
         context_->GetDiagnostics()->Note(DiagMessage() << "including " << path);
       }
 
-      std::string error;
-      auto zip_collection = io::ZipFileCollection::Create(path, &error);
-      if (zip_collection == nullptr) {
-        context_->GetDiagnostics()->Error(DiagMessage() << "failed to open APK: " << error);
+      IncludedApk include;
+      const bool loaded = include_cache_ != nullptr
+                              ? include_cache_->Load(path, context_->GetDiagnostics(), &include)
+                              : LoadIncludedApk(path, context_->GetDiagnostics(), &include);
+      if (!loaded) {
         return false;
       }
 
-      if (zip_collection->FindFile(kProtoResourceTablePath) != nullptr) {
-        // Load this as a static library include.
-        std::unique_ptr<LoadedApk> static_apk = LoadedApk::LoadProtoApkFromFileCollection(
-            Source(path), std::move(zip_collection), context_->GetDiagnostics());
-        if (static_apk == nullptr) {
-          return false;
-        }
-
+      if (include.static_library != nullptr) {
         if (context_->GetPackageType() != PackageType::kStaticLib) {
           // Can't include static libraries when not building a static library (they have no IDs
           // assigned).
@@ -849,11 +1137,17 @@ class Linker {
           return false;
         }
 
-        ResourceTable* table = static_apk->GetResourceTable();
+        ResourceTable* table = include.static_library->GetResourceTable();
 
         // If we are using --no-static-lib-packages, we need to rename the package of this table to
         // our compilation package.
         if (options_.no_static_lib_packages) {
+          // A cached table is shared with other links, so rename a copy of it.
+          if (include_cache_ != nullptr) {
+            renamed_static_library_tables_.push_back(table->Clone());
+            table = renamed_static_library_tables_.back().get();
+          }
+
           // Since package names can differ, and multiple packages can exist in a ResourceTable,
           // we place the requirement that all static libraries are built with the package
           // ID 0x7f. So if one is not found, this is an error.
@@ -868,13 +1162,10 @@ class Linker {
 
         context_->GetExternalSymbols()->AppendSource(
             util::make_unique<ResourceTableSymbolSource>(table));
-        static_library_includes_.push_back(std::move(static_apk));
+        static_library_includes_.push_back(std::move(include.static_library));
       } else {
-        if (!asset_source->AddAssetPath(path)) {
-          context_->GetDiagnostics()->Error(DiagMessage()
-                                            << "failed to load include path " << path);
-          return false;
-        }
+        asset_source->AddApkAssets(std::move(include.apk_assets),
+                                   std::move(include.apk_assets_index));
       }
     }
 
@@ -1066,6 +1357,68 @@ class Linker {
     }
   }
 
+  // Fingerprints everything besides the compiled files that linking XML files depends on: the
+  // version of aapt2, the options, the included APKs and the symbols references can resolve to.
+  // Only the names, IDs, visibility and attribute definitions of resources are symbols, so
+  // changing the value of a resource does not change the fingerprint.
+  bool FingerprintLinkInputs(Fingerprint* out_fingerprint) {
+    TRACE_CALL();
+    Fingerprint& fingerprint = *out_fingerprint;
+    fingerprint.Update(util::GetToolFingerprint())
+        .Update(static_cast<uint64_t>(options_.output_format))
+        .Update(static_cast<uint64_t>(options_.keep_raw_values))
+        .Update(static_cast<uint64_t>(options_.no_auto_version))
+        .Update(static_cast<uint64_t>(options_.no_version_vectors))
+        .Update(static_cast<uint64_t>(options_.no_version_transitions))
+        .Update(static_cast<uint64_t>(options_.no_xml_namespaces))
+        .Update(static_cast<uint64_t>(options_.merge_only))
+        .Update(static_cast<uint64_t>(context_->GetPackageType()))
+        .Update(context_->GetCompilationPackage())
+        .Update(static_cast<uint64_t>(context_->GetPackageId()))
+        .Update(static_cast<uint64_t>(context_->GetMinSdkVersion()));
+
+    for (const std::string& path : options_.include_paths) {
+      uint64_t stamp;
+      std::string error;
+      if (!StampFile(path, &stamp, &error)) {
+        context_->GetDiagnostics()->Error(DiagMessage(path) << "failed to read: " << error);
+        return false;
+      }
+      fingerprint.Update(path).Update(stamp);
+    }
+
+    for (const auto& package : final_table_.packages) {
+      fingerprint.Update(package->name).Update(package->id.value_or_default(0u));
+      for (const auto& type : package->types) {
+        fingerprint.Update(to_string(type->type))
+            .Update(type->id.value_or_default(0u))
+            .Update(static_cast<uint64_t>(type->visibility_level));
+        for (const auto& entry : type->entries) {
+          fingerprint.Update(entry->name)
+              .Update(entry->id.value_or_default(0u))
+              .Update(static_cast<uint64_t>(entry->visibility.level));
+          for (const auto& config_value : entry->values) {
+            const Attribute* attr = ValueCast<Attribute>(config_value->value.get());
+            if (attr == nullptr) {
+              continue;
+            }
+            fingerprint.Update(config_value->config.to_string())
+                .Update(attr->type_mask)
+                .Update(static_cast<uint64_t>(attr->min_int))
+                .Update(static_cast<uint64_t>(attr->max_int));
+            for (const Attribute::Symbol& symbol : attr->symbols) {
+              fingerprint.Update(symbol.symbol.name ? symbol.symbol.name.value().to_string() : "")
+                  .Update(symbol.symbol.id ? symbol.symbol.id.value().id : 0u)
+                  .Update(symbol.value)
+                  .Update(symbol.type);
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
   bool FlattenTable(ResourceTable* table, OutputFormat format, IArchiveWriter* writer) {
     TRACE_CALL();
     switch (format) {
@@ -1093,6 +1446,33 @@ class Linker {
     return false;
   }
 
+  // Returns the path of the R.java file of out_package.
+  std::string GetRClassPath(const StringPiece& out_package) const {
+    std::string out_path = options_.generate_java_class_path.value();
+    file::AppendPath(&out_path, file::PackageToPath(out_package));
+    file::AppendPath(&out_path, "R.java");
+    return out_path;
+  }
+
+  // Writes the R class to the R.java file of out_package. The file is left untouched if it already
+  // has the same contents, so that the build does not compile it again.
+  bool WriteRClass(const ClassDefinition* r_class, const StringPiece& out_package, bool final,
+                   IDiagnostics* diag) {
+    const std::string out_path = GetRClassPath(out_package);
+    const std::string out_dir = file::GetStem(out_path).to_string();
+    if (!file::mkdirs(out_dir)) {
+      diag->Error(DiagMessage() << "failed to create directory '" << out_dir << "'");
+      return false;
+    }
+
+    std::string contents;
+    {
+      io::StringOutputStream out(&contents);
+      ClassDefinition::WriteJavaFile(r_class, out_package, final, &out);
+    }
+    return WriteFileIfChanged(diag, out_path, contents);
+  }
+
   bool WriteJavaFile(ResourceTable* table, const StringPiece& package_name_to_generate,
                      const StringPiece& out_package, const JavaClassGeneratorOptions& java_options,
                      const Maybe<std::string>& out_text_symbols_path = {}) {
@@ -1100,45 +1480,98 @@ class Linker {
       return true;
     }
 
-    std::string out_path;
-    std::unique_ptr<io::FileOutputStream> fout;
-    if (options_.generate_java_class_path) {
-      out_path = options_.generate_java_class_path.value();
-      file::AppendPath(&out_path, file::PackageToPath(out_package));
-      if (!file::mkdirs(out_path)) {
-        context_->GetDiagnostics()->Error(DiagMessage()
-                                          << "failed to create directory '" << out_path << "'");
+    // Errors are reported against the R.java file, or the R.txt file when only that is written.
+    const std::string out_path = options_.generate_java_class_path
+                                     ? GetRClassPath(out_package)
+                                     : out_text_symbols_path.value();
+    std::unique_ptr<ClassDefinition> r_class;
+    std::string r_txt;
+    {
+      io::StringOutputStream r_txt_out(&r_txt);
+      JavaClassGenerator generator(context_, table, java_options);
+      bool generated;
+      if (options_.generate_java_class_path) {
+        r_class = generator.GenerateClass(package_name_to_generate,
+                                          out_text_symbols_path ? &r_txt_out : nullptr);
+        generated = r_class != nullptr;
+      } else {
+        // Only the R.txt file is written, so the class definitions are not built.
+        generated = generator.Generate(package_name_to_generate, out_package, nullptr, &r_txt_out);
+      }
+      if (!generated) {
+        context_->GetDiagnostics()->Error(DiagMessage(out_path) << generator.GetError());
         return false;
       }
+    }
 
-      file::AppendPath(&out_path, "R.java");
+    if (r_class != nullptr &&
+        !WriteRClass(r_class.get(), out_package, java_options.use_final,
+                     context_->GetDiagnostics())) {
+      return false;
+    }
 
-      fout = util::make_unique<io::FileOutputStream>(out_path);
-      if (fout->HadError()) {
-        context_->GetDiagnostics()->Error(DiagMessage() << "failed writing to '" << out_path
-                                                        << "': " << fout->GetError());
-        return false;
-      }
+    if (out_text_symbols_path &&
+        !WriteFileIfChanged(context_->GetDiagnostics(), out_text_symbols_path.value(), r_txt)) {
+      return false;
     }
+    return true;
+  }
 
-    std::unique_ptr<io::FileOutputStream> fout_text;
-    if (out_text_symbols_path) {
-      fout_text = util::make_unique<io::FileOutputStream>(out_text_symbols_path.value());
-      if (fout_text->HadError()) {
-        context_->GetDiagnostics()->Error(DiagMessage()
-                                          << "failed writing to '" << out_text_symbols_path.value()
-                                          << "': " << fout_text->GetError());
-        return false;
-      }
+  // Same as WriteJavaFile() for every package of out_packages. The R classes of these packages
+  // only differ in their package name, so the class is generated once, and the files are written
+  // on a pool of threads when there is more than one job.
+  bool WriteJavaFiles(ResourceTable* table, const StringPiece& package_name_to_generate,
+                      const std::set<std::string>& out_packages,
+                      const JavaClassGeneratorOptions& java_options) {
+    TRACE_CALL();
+    if (!options_.generate_java_class_path || out_packages.empty()) {
+      return true;
     }
 
     JavaClassGenerator generator(context_, table, java_options);
-    if (!generator.Generate(package_name_to_generate, out_package, fout.get(), fout_text.get())) {
-      context_->GetDiagnostics()->Error(DiagMessage(out_path) << generator.GetError());
+    std::unique_ptr<ClassDefinition> r_class = generator.GenerateClass(package_name_to_generate);
+    if (r_class == nullptr) {
+      // Generating the class does not depend on the package, so report it against the first one.
+      context_->GetDiagnostics()->Error(DiagMessage(GetRClassPath(*out_packages.begin()))
+                                        << generator.GetError());
       return false;
     }
 
-    return true;
+    struct JavaFileOperation {
+      std::string package;
+      BufferedDiagnostics diagnostics;
+      bool success = false;
+    };
+
+    std::vector<JavaFileOperation> file_ops(out_packages.size());
+    {
+      std::unique_ptr<ThreadPool> pool;
+      if (options_.jobs != 1 && file_ops.size() > 1) {
+        pool = util::make_unique<ThreadPool>(std::min(options_.jobs, file_ops.size()));
+      }
+
+      auto file_op = file_ops.begin();
+      for (const std::string& package : out_packages) {
+        file_op->package = package;
+        auto write = [&, file_op] {
+          file_op->success = WriteRClass(r_class.get(), file_op->package, java_options.use_final,
+                                         &file_op->diagnostics);
+        };
+        if (pool != nullptr) {
+          pool->Schedule(write);
+        } else {
+          write();
+        }
+        ++file_op;
+      }
+    }
+
+    bool error = false;
+    for (JavaFileOperation& file_op : file_ops) {
+      file_op.diagnostics.FlushTo(context_->GetDiagnostics());
+      error |= !file_op.success;
+    }
+    return !error;
   }
 
   bool GenerateJavaClasses() {
@@ -1182,12 +1615,14 @@ class Linker {
 
     // Generate copies of the original package R class but with different package names.
     // This is to support non-namespaced builds.
-    for (const std::string& extra_package : options_.extra_java_packages) {
-      packages_to_callback.push_back(extra_package);
+    if (!options_.extra_java_packages.empty()) {
+      packages_to_callback.insert(packages_to_callback.end(),
+                                  options_.extra_java_packages.begin(),
+                                  options_.extra_java_packages.end());
 
       JavaClassGeneratorOptions options = template_options;
       options.types = JavaClassGeneratorOptions::SymbolTypes::kAll;
-      if (!WriteJavaFile(&final_table_, actual_package, extra_package, options)) {
+      if (!WriteJavaFiles(&final_table_, actual_package, options_.extra_java_packages, options)) {
         return false;
       }
     }
@@ -1354,8 +1789,9 @@ class Linker {
       return false;
     }
 
-    // Make sure to move the collection into the set of IFileCollections.
-    merged_apks_.push_back(std::move(apk));
+    // Keep the files of the library, which the merged table references, but free the rest of the
+    // library. Its values have been copied into the merged table.
+    collections_.push_back(apk->ReleaseFileCollection());
     return true;
   }
 
@@ -1472,20 +1908,23 @@ class Linker {
       }
     }
 
-    std::unique_ptr<io::InputStream> input_stream = file->OpenInputStream();
-    if (input_stream == nullptr) {
+    // Compiled files are mapped rather than read, so that the tables are parsed in place and the
+    // files embedded in the container are skipped without reading them. They are only read when
+    // they are written to the APK.
+    std::unique_ptr<io::IData> data = file->OpenAsData();
+    if (data == nullptr) {
       context_->GetDiagnostics()->Error(DiagMessage(src) << "failed to open file");
       return false;
     }
 
-    if (input_stream->HadError()) {
+    if (data->HadError()) {
       context_->GetDiagnostics()->Error(DiagMessage(src)
-                                        << "failed to open file: " << input_stream->GetError());
+                                        << "failed to open file: " << data->GetError());
       return false;
     }
 
     ContainerReaderEntry* entry;
-    ContainerReader reader(input_stream.get());
+    ContainerReader reader(data.get());
 
     if (reader.HadError()) {
       context_->GetDiagnostics()->Error(DiagMessage(src)
@@ -1496,19 +1935,22 @@ class Linker {
     while ((entry = reader.Next()) != nullptr) {
       if (entry->Type() == ContainerEntryType::kResTable) {
         TRACE_NAME(std::string("Process ResTable:") + file->GetSource().path);
-        pb::ResourceTable pb_table;
-        if (!entry->GetResTable(&pb_table)) {
-          context_->GetDiagnostics()->Error(DiagMessage(src) << "failed to read resource table: "
-                                                             << entry->GetError());
-          return false;
-        }
-
         ResourceTable table;
-        std::string error;
-        if (!DeserializeTableFromPb(pb_table, nullptr /*files*/, &table, &error)) {
-          context_->GetDiagnostics()->Error(DiagMessage(src)
-                                            << "failed to deserialize resource table: " << error);
-          return false;
+        {
+          // Free the parsed table before merging, so that only one copy of it is held at a time.
+          pb::ResourceTable pb_table;
+          if (!entry->GetResTable(&pb_table)) {
+            context_->GetDiagnostics()->Error(DiagMessage(src) << "failed to read resource table: "
+                                                               << entry->GetError());
+            return false;
+          }
+
+          std::string error;
+          if (!DeserializeTableFromPb(pb_table, nullptr /*files*/, &table, &error)) {
+            context_->GetDiagnostics()->Error(DiagMessage(src)
+                                              << "failed to deserialize resource table: " << error);
+            return false;
+          }
         }
 
         if (!table_merger_->Merge(src, &table, override)) {
@@ -1698,8 +2140,10 @@ class Linker {
         static_cast<bool>(options_.generate_proguard_rules_path);
     file_flattener_options.output_format = options_.output_format;
     file_flattener_options.do_not_fail_on_missing_resources = options_.merge_only;
+    file_flattener_options.jobs = options_.jobs;
 
-    ResourceFileFlattener file_flattener(file_flattener_options, context_, keep_set);
+    ResourceFileFlattener file_flattener(file_flattener_options, context_, keep_set,
+                                         link_cache_.get());
     if (!file_flattener.Flatten(table, writer)) {
       context_->GetDiagnostics()->Error(DiagMessage() << "failed linking file resources");
       return false;
@@ -2007,6 +2451,15 @@ class Linker {
       }
     }
 
+    if (options_.link_cache_dir) {
+      // The symbols are final at this point. Splitting the table below only moves values.
+      Fingerprint fingerprint;
+      if (!FingerprintLinkInputs(&fingerprint)) {
+        return 1;
+      }
+      link_cache_ = util::make_unique<LinkCache>(options_.link_cache_dir.value(), fingerprint);
+    }
+
     proguard::KeepSet proguard_keep_set =
         proguard::KeepSet(options_.generate_conditional_proguard_rules);
     proguard::KeepSet proguard_main_dex_keep_set;
@@ -2128,6 +2581,17 @@ class Linker {
       return 1;
     }
 
+    if (link_cache_) {
+      link_cache_->Prune(LinkCache::kDefaultMaxSizeBytes);
+      if (context_->IsVerbose()) {
+        const size_t lookups = link_cache_->hits() + link_cache_->misses();
+        context_->GetDiagnostics()->Note(
+            DiagMessage() << "link cache: reused " << link_cache_->hits() << " of " << lookups
+                          << " linked XML files ("
+                          << (lookups == 0 ? 0 : link_cache_->hits() * 100 / lookups) << "%)");
+      }
+    }
+
     if (!CopyAssetsDirsToApk(archive_writer.get())) {
       return 1;
     }
@@ -2152,6 +2616,7 @@ class Linker {
  private:
   LinkOptions options_;
   LinkContext* context_;
+  IncludeCache* include_cache_;
   ResourceTable final_table_;
 
   AppInfo app_info_;
@@ -2165,17 +2630,20 @@ class Linker {
   // collections.
   std::vector<std::unique_ptr<io::IFileCollection>> collections_;
 
-  // The set of merged APKs. This is mainly here to retain ownership of the APKs.
-  std::vector<std::unique_ptr<LoadedApk>> merged_apks_;
-
   // The set of included APKs (not merged). This is mainly here to retain ownership of the APKs.
-  std::vector<std::unique_ptr<LoadedApk>> static_library_includes_;
+  std::vector<std::shared_ptr<LoadedApk>> static_library_includes_;
+
+  // Copies of cached static library tables, renamed for --no-static-lib-packages.
+  std::vector<std::unique_ptr<ResourceTable>> renamed_static_library_tables_;
 
   // The set of shared libraries being used, mapping their assigned package ID to package name.
   std::map<size_t, std::string> shared_libs_;
 
   // The package name of the base application, if it is included.
   Maybe<std::string> included_feature_base_;
+
+  // Linked XML files of previous links, if --link-cache-dir is specified.
+  std::unique_ptr<LinkCache> link_cache_;
 };
 
 int LinkCommand::Action(const std::vector<std::string>& args) {
@@ -2340,6 +2808,23 @@ int LinkCommand::Action(const std::vector<std::string>& args) {
           ".imy",   ".xmf",  ".mp4",  ".m4a", ".m4v",  ".3gp",  ".3gpp", ".3g2",
           ".3gpp2", ".amr",  ".awb",  ".wma", ".wmv",  ".webm", ".mkv"});
 
+  if (jobs_) {
+    Maybe<size_t> jobs = ThreadPool::ParseThreadCount(jobs_.value());
+    if (!jobs) {
+      context.GetDiagnostics()->Error(DiagMessage() << "invalid value for -j: '" << jobs_.value()
+                                                    << "'");
+      return 1;
+    }
+    options_.jobs = jobs.value();
+    options_.table_flattener_options.jobs = jobs.value();
+  }
+
+  if (options_.link_cache_dir && !file::mkdirs(options_.link_cache_dir.value())) {
+    context.GetDiagnostics()->Error(DiagMessage(options_.link_cache_dir.value())
+                                    << "failed to create link cache directory");
+    return 1;
+  }
+
   // Turn off auto versioning for static-libs.
   if (context.GetPackageType() == PackageType::kStaticLib) {
     options_.no_auto_version = true;
@@ -2347,7 +2832,7 @@ int LinkCommand::Action(const std::vector<std::string>& args) {
     options_.no_version_transitions = true;
   }
 
-  Linker cmd(&context, options_);
+  Linker cmd(&context, options_, include_cache_);
   return cmd.Run(arg_list);
 }
 
@@ -26,6 +26,7 @@
 #include "format/binary/TableFlattener.h"
 #include "format/proto/ProtoSerialize.h"
 #include "link/ManifestFixer.h"
+#include "process/IncludeCache.h"
 #include "trace/TraceBuffer.h"
 
 namespace aapt {
@@ -107,12 +108,20 @@ struct LinkOptions {
 
   // Whether we should fail on definitions of a resource with conflicting visibility.
   bool strict_visibility = false;
+
+  // Directory of linked XML files reused across links.
+  Maybe<std::string> link_cache_dir;
+
+  // Number of XML files linked at the same time. The output is the same for any value.
+  size_t jobs = 1;
 };
 
 class LinkCommand : public Command {
  public:
-  explicit LinkCommand(IDiagnostics* diag) : Command("link", "l"),
-                                             diag_(diag) {
+  // When `include_cache` is set, the APKs passed with -I are loaded through it, so that they are
+  // shared with other links using the same cache.
+  explicit LinkCommand(IDiagnostics* diag, IncludeCache* include_cache = nullptr)
+      : Command("link", "l"), diag_(diag), include_cache_(include_cache) {
     SetDescription("Links resources into an apk.");
     AddRequiredFlag("-o", "Output path.", &options_.output_path, Command::kPath);
     AddRequiredFlag("--manifest", "Path to the Android manifest to build.",
@@ -307,6 +316,14 @@ class LinkCommand : public Command {
         "Only merge the resources, without verifying resource references. This flag\n"
             "should only be used together with the --static-lib flag.",
         &options_.merge_only);
+    AddOptionalFlag("--link-cache-dir",
+        "Directory in which linked XML files are kept, so that later links reuse\n"
+            "them while the XML file and the symbols it can reference are unchanged.\n"
+            "Not used with --proguard.",
+        &options_.link_cache_dir, Command::kPath);
+    AddOptionalFlag("-j",
+        "Number of XML files to link in parallel, or 0 for one per CPU. Defaults to 1.",
+        &jobs_);
     AddOptionalSwitch("-v", "Enables verbose logging.", &verbose_);
   }
 
@@ -314,6 +331,7 @@ class LinkCommand : public Command {
 
  private:
   IDiagnostics* diag_;
+  IncludeCache* include_cache_;
   LinkOptions options_;
 
   std::vector<std::string> overlay_arg_list_;
@@ -332,6 +350,7 @@ class LinkCommand : public Command {
   Maybe<std::string> stable_id_file_path_;
   std::vector<std::string> split_args_;
   Maybe<std::string> trace_folder_;
+  Maybe<std::string> jobs_;
 };
 
 }// namespace aapt
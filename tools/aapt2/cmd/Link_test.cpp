@@ -17,8 +17,14 @@
 #include "AppInfo.h"
 #include "Link.h"
 
+#include <sys/stat.h>
+#include <utime.h>
+
+#include "android-base/file.h"
+
 #include "LoadedApk.h"
 #include "test/Test.h"
+#include "util/Files.h"
 
 using testing::Eq;
 using testing::Ne;
@@ -317,4 +323,143 @@ TEST_F(LinkTest, AppInfoWithUsesSplit) {
   ASSERT_TRUE(Link(link_args, feature2_files_dir, &diag));
 }
 
+TEST_F(LinkTest, LinkCacheReusesLinkedXmlFiles) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="title">Title</string></resources>)",
+                          compiled_files_dir, &diag));
+  ASSERT_TRUE(CompileFile(GetTestPath("res/layout/main.xml"),
+                          R"(<View xmlns:android="http://schemas.android.com/apk/res/android"
+                                   android:contentDescription="@string/title"/>)",
+                          compiled_files_dir, &diag));
+
+  const std::string cache_dir = GetTestPath("cache");
+  auto link_to = [&](const std::string& out_apk) {
+    return Link({"--manifest", GetDefaultManifest(), "-o", out_apk, "--link-cache-dir", cache_dir},
+                compiled_files_dir, &diag);
+  };
+  auto read_layout = [&](const std::string& out_apk) {
+    std::unique_ptr<LoadedApk> apk = LoadedApk::LoadApkFromPath(out_apk, &diag);
+    std::unique_ptr<io::IData> data = OpenFileAsData(apk.get(), "res/layout/main.xml");
+    return data == nullptr
+               ? std::string()
+               : std::string(reinterpret_cast<const char*>(data->data()), data->size());
+  };
+
+  ASSERT_TRUE(link_to(GetTestPath("clean.apk")));
+  Maybe<std::vector<std::string>> entries = file::FindFiles(cache_dir, &diag);
+  ASSERT_TRUE(entries);
+  EXPECT_THAT(entries.value().size(), Eq(1u));
+
+  ASSERT_TRUE(link_to(GetTestPath("cached.apk")));
+  const std::string clean_layout = read_layout(GetTestPath("clean.apk"));
+  ASSERT_THAT(clean_layout, Ne(""));
+  EXPECT_THAT(read_layout(GetTestPath("cached.apk")), Eq(clean_layout));
+
+  // Changing the value of a string does not change the symbols the layout is linked against.
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="title">New title</string></resources>)",
+                          compiled_files_dir, &diag));
+  ASSERT_TRUE(link_to(GetTestPath("changed.apk")));
+  entries = file::FindFiles(cache_dir, &diag);
+  ASSERT_TRUE(entries);
+  EXPECT_THAT(entries.value().size(), Eq(1u));
+  EXPECT_THAT(read_layout(GetTestPath("changed.apk")), Eq(clean_layout));
+}
+
+TEST_F(LinkTest, ParallelLinkWritesSameApk) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="title">Title</string></resources>)",
+                          compiled_files_dir, &diag));
+  for (int i = 0; i < 20; i++) {
+    // paddingStart is versioned, so every layout is also written for a newer SDK level.
+    const std::string path = android::base::StringPrintf("res/layout/layout%d.xml", i);
+    ASSERT_TRUE(CompileFile(GetTestPath(path),
+                            R"(<View xmlns:android="http://schemas.android.com/apk/res/android"
+                                     android:paddingStart="1dp"
+                                     android:contentDescription="@string/title"/>)",
+                            compiled_files_dir, &diag));
+  }
+
+  const std::string serial_apk = GetTestPath("serial.apk");
+  ASSERT_TRUE(Link({"--manifest", GetDefaultManifest(), "-o", serial_apk, "--min-sdk-version",
+                    "14"}, compiled_files_dir, &diag));
+  const std::string parallel_apk = GetTestPath("parallel.apk");
+  ASSERT_TRUE(Link({"--manifest", GetDefaultManifest(), "-o", parallel_apk, "--min-sdk-version",
+                    "14", "-j", "4"}, compiled_files_dir, &diag));
+
+  std::string serial_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(serial_apk, &serial_contents));
+  std::string parallel_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(parallel_apk, &parallel_contents));
+  EXPECT_THAT(parallel_contents, Eq(serial_contents));
+
+  std::unique_ptr<LoadedApk> apk = LoadedApk::LoadApkFromPath(parallel_apk, &diag);
+  ASSERT_THAT(apk, Ne(nullptr));
+  EXPECT_THAT(OpenFileAsData(apk.get(), "res/layout-v17/layout0.xml"), Ne(nullptr));
+}
+
+TEST_F(LinkTest, ExtraPackagesShareRClassAndSkipUnchangedFiles) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="title">Title</string></resources>)",
+                          compiled_files_dir, &diag));
+
+  const std::string java_dir = GetTestPath("java");
+  const std::string r_txt = GetTestPath("R.txt");
+  const std::vector<std::string> link_args = {
+      "--manifest", GetDefaultManifest(), "-o", GetTestPath("out.apk"), "--java", java_dir,
+      "--output-text-symbols", r_txt, "--extra-packages", "com.example.one:com.example.two",
+      "-j", "4"};
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+
+  auto get_r_java_path = [&](const char* package) {
+    std::string path = java_dir;
+    file::AppendPath(&path, file::PackageToPath(package));
+    file::AppendPath(&path, "R.java");
+    return path;
+  };
+  auto read_r_java = [&](const char* package) {
+    std::string contents;
+    android::base::ReadFileToString(get_r_java_path(package), &contents);
+    return contents;
+  };
+  const std::string one = read_r_java("com.example.one");
+  ASSERT_THAT(one, Ne(""));
+  EXPECT_THAT(one.find("package com.example.one;"), Ne(std::string::npos));
+  EXPECT_THAT(one.find("public static final int title="), Ne(std::string::npos));
+  const std::string two_package_line = "package com.example.two;";
+  std::string two = read_r_java("com.example.two");
+  ASSERT_THAT(two.find(two_package_line), Ne(std::string::npos));
+  two.replace(two.find(two_package_line), two_package_line.size(), "package com.example.one;");
+  EXPECT_THAT(two, Eq(one));
+
+  // Linking the same resources again leaves the files as they were.
+  const std::string r_java = get_r_java_path("com.example.one");
+  struct utimbuf old_times = {1000000000, 1000000000};
+  ASSERT_THAT(utime(r_java.c_str(), &old_times), Eq(0));
+  ASSERT_THAT(utime(r_txt.c_str(), &old_times), Eq(0));
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+  struct stat r_java_stat;
+  ASSERT_THAT(stat(r_java.c_str(), &r_java_stat), Eq(0));
+  EXPECT_THAT(r_java_stat.st_mtime, Eq(old_times.modtime));
+  struct stat r_txt_stat;
+  ASSERT_THAT(stat(r_txt.c_str(), &r_txt_stat), Eq(0));
+  EXPECT_THAT(r_txt_stat.st_mtime, Eq(old_times.modtime));
+
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources>
+                               <string name="title">Title</string>
+                               <string name="subtitle">Subtitle</string>
+                             </resources>)",
+                          compiled_files_dir, &diag));
+  ASSERT_TRUE(Link(link_args, compiled_files_dir, &diag));
+  EXPECT_THAT(read_r_java("com.example.one").find("public static final int subtitle="),
+              Ne(std::string::npos));
+}
+
 }  // namespace aapt
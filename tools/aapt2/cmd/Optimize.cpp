@@ -45,6 +45,7 @@
 #include "optimize/VersionCollapser.h"
 #include "split/TableSplitter.h"
 #include "util/Files.h"
+#include "util/ThreadPool.h"
 #include "util/Util.h"
 
 using ::aapt::configuration::Abi;
@@ -209,7 +210,7 @@ class Optimizer {
       MultiApkGenerator generator{apk.get(), context_};
       MultiApkGeneratorOptions generator_options = {
           options_.output_dir.value(), options_.apk_artifacts.value(),
-          options_.table_flattener_options, options_.kept_artifacts};
+          options_.table_flattener_options, options_.kept_artifacts, options_.jobs};
       if (!generator.FromBaseApk(generator_options)) {
         return 1;
       }
@@ -378,6 +379,15 @@ int OptimizeCommand::Action(const std::vector<std::string>& args) {
   context.SetVerbose(verbose_);
   IDiagnostics* diag = context.GetDiagnostics();
 
+  if (jobs_) {
+    Maybe<size_t> jobs = ThreadPool::ParseThreadCount(jobs_.value());
+    if (!jobs) {
+      diag->Error(DiagMessage() << "invalid value for -j: '" << jobs_.value() << "'");
+      return 1;
+    }
+    options_.jobs = jobs.value();
+  }
+
   if (config_path_) {
     std::string& path = config_path_.value();
     Maybe<ConfigurationParser> for_path = ConfigurationParser::ForPath(path);
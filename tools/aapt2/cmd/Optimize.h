@@ -61,6 +61,9 @@ struct OptimizeOptions {
 
   // Path to the output map of original resource paths to shortened paths.
   Maybe<std::string> shortened_paths_map_path;
+
+  // The number of multi-APK artifacts to generate in parallel.
+  size_t jobs = 1;
 };
 
 class OptimizeCommand : public Command {
@@ -111,6 +114,10 @@ class OptimizeCommand : public Command {
     AddOptionalFlag("--resource-path-shortening-map",
         "Path to output the map of old resource paths to shortened paths.",
         &options_.shortened_paths_map_path);
+    AddOptionalFlag("-j",
+        "Number of artifacts to generate in parallel, or 0 for one per CPU. Defaults to 1.\n"
+            "Every artifact being generated holds a copy of the resource table.",
+        &jobs_);
     AddOptionalSwitch("-v", "Enables verbose logging", &verbose_);
   }
 
@@ -128,6 +135,7 @@ class OptimizeCommand : public Command {
   std::vector<std::string> configs_;
   std::vector<std::string> split_args_;
   std::unordered_set<std::string> kept_artifacts_;
+  Maybe<std::string> jobs_;
   bool print_only_ = false;
   bool verbose_ = false;
 };
@@ -16,11 +16,15 @@
 
 #include "Optimize.h"
 
+#include "android-base/file.h"
+#include "android-base/stringprintf.h"
+
 #include "AppInfo.h"
 #include "Diagnostics.h"
 #include "LoadedApk.h"
 #include "Resource.h"
 #include "test/Test.h"
+#include "util/Files.h"
 
 using testing::Contains;
 using testing::Eq;
@@ -65,4 +69,77 @@ dimen/bar#no_obfuscate
   EXPECT_THAT(name_collapse_exemptions, Contains(ResourceName({}, ResourceType::kDimen, "bar")));
 }
 
+TEST_F(OptimizeTest, ParallelArtifactsMatchSerialArtifacts) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  for (const char* locale : {"en", "fr", "de"}) {
+    const std::string path = android::base::StringPrintf("res/values-%s/values.xml", locale);
+    ASSERT_TRUE(CompileFile(GetTestPath(path),
+                            android::base::StringPrintf(
+                                R"(<resources><string name="title">%s</string></resources>)",
+                                locale),
+                            compiled_files_dir, &diag));
+  }
+  for (const char* density : {"mdpi", "hdpi", "xhdpi"}) {
+    const std::string path = android::base::StringPrintf("res/drawable-%s/icon.xml", density);
+    ASSERT_TRUE(CompileFile(
+        GetTestPath(path), R"(<shape xmlns:android="http://schemas.android.com/apk/res/android"/>)",
+        compiled_files_dir, &diag));
+  }
+
+  const std::string apk_path = GetTestPath("app.apk");
+  ASSERT_TRUE(Link({"--manifest", GetDefaultManifest(), "-o", apk_path, "--version-code", "1"},
+                   compiled_files_dir, &diag));
+
+  const std::string config_path = GetTestPath("config.xml");
+  WriteFile(config_path, R"(<?xml version="1.0" encoding="utf-8" ?>
+      <post-process xmlns="http://schemas.android.com/tools/aapt">
+        <screen-density-groups>
+          <screen-density-group label="low" version-code-order="1">
+            <screen-density>mdpi</screen-density>
+          </screen-density-group>
+          <screen-density-group label="high" version-code-order="2">
+            <screen-density>xhdpi</screen-density>
+          </screen-density-group>
+        </screen-density-groups>
+        <locale-groups>
+          <locale-group label="en" version-code-order="1"><locale>en</locale></locale-group>
+          <locale-group label="fr" version-code-order="2"><locale>fr</locale></locale-group>
+          <locale-group label="de" version-code-order="3"><locale>de</locale></locale-group>
+        </locale-groups>
+        <artifacts>
+          <artifact-format>${basename}.${density}.${locale}.apk</artifact-format>
+          <artifact screen-density-group="low" locale-group="en"/>
+          <artifact screen-density-group="low" locale-group="fr"/>
+          <artifact screen-density-group="low" locale-group="de"/>
+          <artifact screen-density-group="high" locale-group="en"/>
+          <artifact screen-density-group="high" locale-group="fr"/>
+          <artifact screen-density-group="high" locale-group="de"/>
+        </artifacts>
+      </post-process>)");
+
+  const std::string serial_dir = GetTestPath("serial");
+  ASSERT_THAT(OptimizeCommand().Execute({"-x", config_path, "-d", serial_dir, apk_path},
+                                        &std::cerr),
+              Eq(0));
+  const std::string parallel_dir = GetTestPath("parallel");
+  ASSERT_THAT(OptimizeCommand().Execute({"-x", config_path, "-d", parallel_dir, "-j", "4",
+                                         apk_path},
+                                        &std::cerr),
+              Eq(0));
+
+  for (const char* density : {"low", "high"}) {
+    for (const char* locale : {"en", "fr", "de"}) {
+      const std::string name = android::base::StringPrintf("app.%s.%s.apk", density, locale);
+      std::string serial_contents;
+      ASSERT_TRUE(android::base::ReadFileToString(file::BuildPath({serial_dir, name}),
+                                                  &serial_contents));
+      std::string parallel_contents;
+      ASSERT_TRUE(android::base::ReadFileToString(file::BuildPath({parallel_dir, name}),
+                                                  &parallel_contents));
+      EXPECT_THAT(parallel_contents, Eq(serial_contents)) << name;
+    }
+  }
+}
+
 }  // namespace aapt
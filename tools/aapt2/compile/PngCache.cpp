@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/PngCache.h"
+
+#include <unistd.h>
+#include <utime.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "android-base/file.h"
+#include "android-base/stringprintf.h"
+
+#include "trace/TraceBuffer.h"
+#include "util/Files.h"
+#include "util/Fingerprint.h"
+
+using ::android::StringPiece;
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+namespace {
+
+// Identifies the layout of an entry.
+constexpr char kEntryMagic[] = "AAPTPNG2";
+constexpr size_t kEntryMagicSize = sizeof(kEntryMagic) - 1;
+
+// Both ".png" and ".9.png" entries end with this.
+constexpr char kEntryExtension[] = ".png";
+
+// file::PruneCacheDirectory() deletes old temporary files with this extension.
+constexpr char kTempExtension[] = ".tmp";
+
+// An entry is the magic, a nine-patch flag byte, the size of the version as a uint64_t, the
+// version, the size of the input as a uint64_t, the input and then the crunched PNG.
+constexpr size_t kEntryHeaderSize = kEntryMagicSize + 1 + sizeof(uint64_t);
+
+}  // namespace
+
+std::string PngCache::GetEntryPath(const StringPiece& input, bool nine_patch) const {
+  std::string path = dir_;
+  const Fingerprint fingerprint =
+      Fingerprint().Update(version_).Update(input.data(), input.size());
+  file::AppendPath(&path, StringPrintf("%s-%zu%s", fingerprint.ToString().c_str(), input.size(),
+                                       nine_patch ? ".9.png" : kEntryExtension));
+  return path;
+}
+
+bool PngCache::Find(const StringPiece& input, bool nine_patch, BigBuffer* out_buffer) const {
+  const std::string entry_path = GetEntryPath(input, nine_patch);
+  std::string entry;
+  if (!android::base::ReadFileToString(entry_path, &entry)) {
+    return false;
+  }
+
+  const size_t input_offset = kEntryHeaderSize + version_.size() + sizeof(uint64_t);
+  if (entry.size() < input_offset + input.size()) {
+    return false;
+  }
+
+  const char* data = entry.data();
+  uint64_t version_size;
+  memcpy(&version_size, data + kEntryMagicSize + 1, sizeof(version_size));
+  if (memcmp(data, kEntryMagic, kEntryMagicSize) != 0 ||
+      data[kEntryMagicSize] != static_cast<char>(nine_patch) || version_size != version_.size() ||
+      memcmp(data + kEntryHeaderSize, version_.data(), version_.size()) != 0) {
+    return false;
+  }
+
+  uint64_t input_size;
+  memcpy(&input_size, data + kEntryHeaderSize + version_.size(), sizeof(input_size));
+  if (input_size != input.size() || memcmp(data + input_offset, input.data(), input.size()) != 0) {
+    return false;
+  }
+
+  const size_t crunched_offset = input_offset + input.size();
+  const size_t crunched_size = entry.size() - crunched_offset;
+  if (crunched_size == 0) {
+    return false;
+  }
+  memcpy(out_buffer->NextBlock<char>(crunched_size), data + crunched_offset, crunched_size);
+
+  // Marks the entry as recently used, so that Prune() keeps it.
+  utime(entry_path.c_str(), nullptr);
+  return true;
+}
+
+void PngCache::Put(const StringPiece& input, bool nine_patch, const BigBuffer& crunched) const {
+  static std::atomic<uint32_t> next_temp_id(0);
+
+  std::string entry;
+  entry.reserve(kEntryHeaderSize + version_.size() + sizeof(uint64_t) + input.size() +
+                crunched.size());
+  entry.append(kEntryMagic, kEntryMagicSize);
+  entry.push_back(static_cast<char>(nine_patch));
+  const uint64_t version_size = version_.size();
+  entry.append(reinterpret_cast<const char*>(&version_size), sizeof(version_size));
+  entry.append(version_);
+  const uint64_t input_size = input.size();
+  entry.append(reinterpret_cast<const char*>(&input_size), sizeof(input_size));
+  entry.append(input.data(), input.size());
+  entry.append(crunched.to_string());
+
+  const std::string path = GetEntryPath(input, nine_patch);
+  const std::string temp_path =
+      StringPrintf("%s.%d-%u%s", path.c_str(), getpid(), next_temp_id++, kTempExtension);
+  if (!android::base::WriteStringToFile(entry, temp_path)) {
+    return;
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+  }
+}
+
+void PngCache::Prune(size_t max_bytes) const {
+  TRACE_CALL();
+  file::PruneCacheDirectory(dir_, kEntryExtension, max_bytes);
+}
+
+}  // namespace aapt
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_COMPILE_PNGCACHE_H
+#define AAPT_COMPILE_PNGCACHE_H
+
+#include <string>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+
+#include "util/BigBuffer.h"
+
+namespace aapt {
+
+// A directory of crunched PNGs keyed by the contents of the original PNG and the version of the
+// tool that crunched it, so that images that did not change are not crunched again by the next
+// build, and an upgraded aapt2 does not reuse the output of an older one.
+//
+// Every entry stores the version and the complete original PNG, and is only used when both match
+// byte for byte, so a hash collision can never produce the wrong image. Entries are written to a
+// temporary file that is then renamed into place, so several aapt2 processes may share a cache
+// directory. Failing to read or write the cache is not an error; the PNG is crunched instead.
+class PngCache {
+ public:
+  // The size that Prune() keeps the entries of a directory to by default. An entry holds both the
+  // original and the crunched PNG.
+  static constexpr size_t kDefaultMaxSizeBytes = 512u * 1024u * 1024u;
+
+  // `version` identifies the crunched output, such as util::GetToolFingerprint().
+  PngCache(const std::string& dir, const std::string& version) : dir_(dir), version_(version) {
+  }
+
+  // Appends the crunched PNG cached for the input to out_buffer and returns true, or returns
+  // false if there is no such entry.
+  bool Find(const android::StringPiece& input, bool nine_patch, BigBuffer* out_buffer) const;
+
+  // Stores the crunched PNG produced from the input.
+  void Put(const android::StringPiece& input, bool nine_patch, const BigBuffer& crunched) const;
+
+  // Deletes the least recently used entries of the directory until the remaining ones take at
+  // most max_bytes, and the temporary files left behind by compiles that did not finish. Must not
+  // be called while PNGs are looked up or stored.
+  void Prune(size_t max_bytes) const;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(PngCache);
+
+  std::string GetEntryPath(const android::StringPiece& input, bool nine_patch) const;
+
+  std::string dir_;
+  std::string version_;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_COMPILE_PNGCACHE_H
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compile/PngCache.h"
+
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <cstring>
+#include <ctime>
+
+#include "test/Fixture.h"
+#include "test/Test.h"
+#include "util/Files.h"
+
+namespace aapt {
+
+using PngCacheTest = TestDirectoryFixture;
+
+static void AppendString(const std::string& str, BigBuffer* buffer) {
+  memcpy(buffer->NextBlock<char>(str.size()), str.data(), str.size());
+}
+
+TEST_F(PngCacheTest, FindsCrunchedPng) {
+  PngCache cache(GetTestDirectory().to_string(), "1.0");
+  const std::string input = "original png";
+
+  BigBuffer out(16);
+  EXPECT_FALSE(cache.Find(input, false /*nine_patch*/, &out));
+
+  BigBuffer crunched(16);
+  AppendString("crunched png", &crunched);
+  cache.Put(input, false /*nine_patch*/, crunched);
+
+  ASSERT_TRUE(cache.Find(input, false /*nine_patch*/, &out));
+  EXPECT_EQ("crunched png", out.to_string());
+
+  // A nine-patch is crunched differently from a PNG with the same contents.
+  BigBuffer nine_patch_out(16);
+  EXPECT_FALSE(cache.Find(input, true /*nine_patch*/, &nine_patch_out));
+}
+
+TEST_F(PngCacheTest, IgnoresEntryOfDifferentInput) {
+  PngCache cache(GetTestDirectory().to_string(), "1.0");
+
+  BigBuffer crunched(16);
+  AppendString("crunched png", &crunched);
+  cache.Put("original png", false /*nine_patch*/, crunched);
+
+  BigBuffer out(16);
+  EXPECT_FALSE(cache.Find("original pnh", false /*nine_patch*/, &out));
+  EXPECT_EQ(0u, out.size());
+}
+
+TEST_F(PngCacheTest, IgnoresCorruptEntry) {
+  PngCache cache(GetTestDirectory().to_string(), "1.0");
+  const std::string input = "original png";
+
+  BigBuffer crunched(16);
+  AppendString("crunched png", &crunched);
+  cache.Put(input, false /*nine_patch*/, crunched);
+
+  // Truncate every entry in the cache.
+  Maybe<std::vector<std::string>> entries =
+      file::FindFiles(GetTestDirectory(), test::GetDiagnostics());
+  ASSERT_TRUE(entries);
+  ASSERT_EQ(1u, entries.value().size());
+  WriteFile(GetTestPath(entries.value()[0]), "AAPTPNG2");
+
+  BigBuffer out(16);
+  EXPECT_FALSE(cache.Find(input, false /*nine_patch*/, &out));
+}
+
+TEST_F(PngCacheTest, IgnoresEntryOfOtherVersion) {
+  const std::string dir = GetTestDirectory().to_string();
+  const std::string input = "original png";
+
+  BigBuffer crunched(16);
+  AppendString("crunched png", &crunched);
+  PngCache(dir, "1.0").Put(input, false /*nine_patch*/, crunched);
+
+  // Another version of aapt2 may crunch the same PNG differently.
+  BigBuffer out(16);
+  EXPECT_FALSE(PngCache(dir, "2.0").Find(input, false /*nine_patch*/, &out));
+  EXPECT_EQ(0u, out.size());
+  EXPECT_TRUE(PngCache(dir, "1.0").Find(input, false /*nine_patch*/, &out));
+}
+
+TEST_F(PngCacheTest, PrunesLeastRecentlyUsedEntries) {
+  const std::string dir = GetTestDirectory().to_string();
+  PngCache cache(dir, "1.0");
+  BigBuffer crunched(16);
+  AppendString("crunched png", &crunched);
+  cache.Put("png a", false /*nine_patch*/, crunched);
+  cache.Put("png b", true /*nine_patch*/, crunched);
+
+  Maybe<std::vector<std::string>> entries = file::FindFiles(dir, test::GetDiagnostics());
+  ASSERT_TRUE(entries);
+  ASSERT_EQ(2u, entries.value().size());
+  std::vector<std::string> paths;
+  for (const std::string& entry : entries.value()) {
+    paths.push_back(GetTestPath(entry));
+  }
+  struct stat entry_stat;
+  ASSERT_EQ(0, stat(paths[0].c_str(), &entry_stat));
+
+  // Both entries were last used a day ago, and a compile that did not finish left a file behind.
+  const std::string temp_path = paths[0] + ".1-0.tmp";
+  WriteFile(temp_path, "partial entry");
+  const time_t day_ago = time(nullptr) - 24 * 60 * 60;
+  const struct utimbuf times = {day_ago, day_ago};
+  for (const std::string& path : {paths[0], paths[1], temp_path}) {
+    ASSERT_EQ(0, utime(path.c_str(), &times));
+  }
+
+  // Using png b makes png a the least recently used entry. Both entries have the same size.
+  BigBuffer out(16);
+  ASSERT_TRUE(cache.Find("png b", true /*nine_patch*/, &out));
+  cache.Prune(2 * entry_stat.st_size);
+  entries = file::FindFiles(dir, test::GetDiagnostics());
+  ASSERT_TRUE(entries);
+  EXPECT_EQ(2u, entries.value().size());
+
+  cache.Prune(entry_stat.st_size);
+  EXPECT_TRUE(cache.Find("png b", true /*nine_patch*/, &out));
+  EXPECT_FALSE(cache.Find("png a", false /*nine_patch*/, &out));
+}
+
+}  // namespace aapt
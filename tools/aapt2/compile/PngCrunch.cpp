@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "android-base/errors.h"
 #include "android-base/logging.h"
@@ -284,6 +285,149 @@ std::unique_ptr<Image> ReadPng(IAaptContext* context, const Source& source, io::
   return output_image;
 }
 
+// A set of RGBA colors that remembers the order in which the first colors were added.
+// The analysis of an image adds every pixel to a set, so this uses open addressing with a
+// multiplicative hash rather than a node-based std::unordered_set.
+class ColorSet {
+ public:
+  // Number of distinct colors whose insertion order is remembered. A palette holds at most 256.
+  static constexpr size_t kMaxOrderedColors = 256u;
+
+  ColorSet() : slots_(kInitialCapacity, 0u) {
+  }
+
+  void Insert(uint32_t color) {
+    // Zero marks an empty slot, so the color zero is tracked separately.
+    if (color == 0u) {
+      if (!has_zero_) {
+        has_zero_ = true;
+        Added(color);
+      }
+      return;
+    }
+
+    size_t mask = slots_.size() - 1;
+    size_t i = Hash(color) & mask;
+    while (slots_[i] != 0u) {
+      if (slots_[i] == color) {
+        return;
+      }
+      i = (i + 1) & mask;
+    }
+    slots_[i] = color;
+    Added(color);
+    if (++used_slots_ * 2 > slots_.size()) {
+      Grow();
+    }
+  }
+
+  size_t size() const {
+    return size_;
+  }
+
+  // The first kMaxOrderedColors colors added, in the order they were added.
+  const std::vector<uint32_t>& ordered_colors() const {
+    return ordered_colors_;
+  }
+
+ private:
+  static constexpr size_t kInitialCapacity = 1024u;
+
+  static size_t Hash(uint32_t color) {
+    return (color * 0x9e3779b1u) >> 7;
+  }
+
+  void Added(uint32_t color) {
+    if (size_++ < kMaxOrderedColors) {
+      ordered_colors_.push_back(color);
+    }
+  }
+
+  void Grow() {
+    std::vector<uint32_t> old_slots(slots_.size() * 2, 0u);
+    old_slots.swap(slots_);
+    const size_t mask = slots_.size() - 1;
+    for (uint32_t color : old_slots) {
+      if (color != 0u) {
+        size_t i = Hash(color) & mask;
+        while (slots_[i] != 0u) {
+          i = (i + 1) & mask;
+        }
+        slots_[i] = color;
+      }
+    }
+  }
+
+  std::vector<uint32_t> slots_;
+  size_t used_slots_ = 0u;
+  bool has_zero_ = false;
+  size_t size_ = 0u;
+  std::vector<uint32_t> ordered_colors_;
+};
+
+// What the encoder needs to know about the pixels of an image.
+struct PixelAnalysis {
+  // Distinct colors, and distinct colors that are not opaque. Fully transparent pixels count as
+  // transparent black.
+  ColorSet colors;
+  ColorSet alpha_colors;
+  bool needs_to_zero_rgb_channels_of_transparent_pixels = false;
+  int max_gray_deviation = 0;
+};
+
+// Scans the entire image and determines:
+// 1. Whether every pixel has R == G == B (grayscale), which is when max_gray_deviation is 0.
+// 2. Whether every pixel has A == 255 (opaque).
+// 3. Whether there are no more than 256 distinct RGBA colors (palette).
+static void AnalyzePixels(const Image* image, PixelAnalysis* out_analysis) {
+  TRACE_CALL();
+  bool needs_zeroing = false;
+  int max_gray_deviation = 0;
+  for (int32_t y = 0; y < image->height; y++) {
+    const uint8_t* row = image->rows[y];
+
+    // The gray deviation and transparency checks are branch-free so that the compiler can
+    // vectorize this loop.
+    int row_deviation = 0;
+    int row_needs_zeroing = 0;
+    for (int32_t x = 0; x < image->width; x++) {
+      const int alpha = row[x * 4 + 3];
+      const int keep = alpha != 0 ? 0xff : 0;
+      const int red = row[x * 4] & keep;
+      const int green = row[x * 4 + 1] & keep;
+      const int blue = row[x * 4 + 2] & keep;
+      row_needs_zeroing |= (row[x * 4] | row[x * 4 + 1] | row[x * 4 + 2]) & ~keep;
+      row_deviation = std::max(row_deviation, std::abs(red - green));
+      row_deviation = std::max(row_deviation, std::abs(green - blue));
+      row_deviation = std::max(row_deviation, std::abs(blue - red));
+    }
+    max_gray_deviation = std::max(max_gray_deviation, row_deviation);
+    needs_zeroing = needs_zeroing || row_needs_zeroing != 0;
+
+    // Drawables are mostly runs of identical pixels, so only look up a color when it changes.
+    uint32_t previous_color = 0u;
+    for (int32_t x = 0; x < image->width; x++) {
+      const uint32_t alpha = row[x * 4 + 3];
+      uint32_t color = alpha;
+      if (alpha != 0) {
+        color |= uint32_t(row[x * 4]) << 24 | uint32_t(row[x * 4 + 1]) << 16 |
+                 uint32_t(row[x * 4 + 2]) << 8;
+      }
+      if (x > 0 && color == previous_color) {
+        continue;
+      }
+      previous_color = color;
+
+      out_analysis->colors.Insert(color);
+      if (alpha != 0xff) {
+        out_analysis->alpha_colors.Insert(color);
+      }
+    }
+  }
+  out_analysis->needs_to_zero_rgb_channels_of_transparent_pixels = needs_zeroing;
+  out_analysis->max_gray_deviation = max_gray_deviation;
+}
+
 // Experimentally chosen constant to be added to the overhead of using color type
 // PNG_COLOR_TYPE_PALETTE to account for the uncompressability of the palette chunk.
 // Without this, many small PNGs encoded with palettes are larger after compression than
@@ -521,63 +665,17 @@ bool WritePng(IAaptContext* context, const Image* image,
   png_set_compression_level(write_ptr, Z_BEST_COMPRESSION);
 
   // Begin analysis of the image data.
-  // Scan the entire image and determine if:
-  // 1. Every pixel has R == G == B (grayscale)
-  // 2. Every pixel has A == 255 (opaque)
-  // 3. There are no more than 256 distinct RGBA colors (palette).
-  std::unordered_map<uint32_t, int> color_palette;
-  std::unordered_set<uint32_t> alpha_palette;
-  bool needs_to_zero_rgb_channels_of_transparent_pixels = false;
-  bool grayscale = true;
-  int max_gray_deviation = 0;
-
-  for (int32_t y = 0; y < image->height; y++) {
-    const uint8_t* row = image->rows[y];
-    for (int32_t x = 0; x < image->width; x++) {
-      int red = *row++;
-      int green = *row++;
-      int blue = *row++;
-      int alpha = *row++;
-
-      if (alpha == 0) {
-        // The color is completely transparent.
-        // For purposes of palettes and grayscale optimization,
-        // treat all channels as 0x00.
-        needs_to_zero_rgb_channels_of_transparent_pixels =
-            needs_to_zero_rgb_channels_of_transparent_pixels ||
-            (red != 0 || green != 0 || blue != 0);
-        red = green = blue = 0;
-      }
-
-      // Insert the color into the color palette.
-      const uint32_t color = red << 24 | green << 16 | blue << 8 | alpha;
-      color_palette[color] = -1;
-
-      // If the pixel has non-opaque alpha, insert it into the
-      // alpha palette.
-      if (alpha != 0xff) {
-        alpha_palette.insert(color);
-      }
-
-      // Check if the image is indeed grayscale.
-      if (grayscale) {
-        if (red != green || red != blue) {
-          grayscale = false;
-        }
-      }
-
-      // Calculate the gray scale deviation so that it can be compared
-      // with the threshold.
-      max_gray_deviation = std::max(std::abs(red - green), max_gray_deviation);
-      max_gray_deviation = std::max(std::abs(green - blue), max_gray_deviation);
-      max_gray_deviation = std::max(std::abs(blue - red), max_gray_deviation);
-    }
-  }
+  PixelAnalysis analysis;
+  AnalyzePixels(image, &analysis);
+  const bool needs_to_zero_rgb_channels_of_transparent_pixels =
+      analysis.needs_to_zero_rgb_channels_of_transparent_pixels;
+  const bool grayscale = analysis.max_gray_deviation == 0;
+  const int max_gray_deviation = analysis.max_gray_deviation;
 
   if (context->IsVerbose()) {
     DiagMessage msg;
-    msg << " paletteSize=" << color_palette.size()
-        << " alphaPaletteSize=" << alpha_palette.size()
+    msg << " paletteSize=" << analysis.colors.size()
+        << " alphaPaletteSize=" << analysis.alpha_colors.size()
         << " maxGrayDeviation=" << max_gray_deviation
         << " grayScale=" << (grayscale ? "true" : "false");
     context->GetDiagnostics()->Note(msg);
@@ -587,7 +685,7 @@ bool WritePng(IAaptContext* context, const Image* image,
 
   const int new_color_type = PickColorType(
       image->width, image->height, grayscale, convertible_to_grayscale,
-      nine_patch != nullptr, color_palette.size(), alpha_palette.size());
+      nine_patch != nullptr, analysis.colors.size(), analysis.alpha_colors.size());
 
   if (context->IsVerbose()) {
     DiagMessage msg;
@@ -622,7 +720,18 @@ bool WritePng(IAaptContext* context, const Image* image,
                new_color_type, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
                PNG_FILTER_TYPE_DEFAULT);
 
+  std::unordered_map<uint32_t, int> color_palette;
   if (new_color_type & PNG_COLOR_MASK_PALETTE) {
+    // Adding the colors in the order they first appear in the image keeps the indices assigned
+    // by WritePalette, and so the encoded image, stable.
+    std::unordered_set<uint32_t> alpha_palette;
+    for (uint32_t color : analysis.colors.ordered_colors()) {
+      color_palette[color] = -1;
+    }
+    for (uint32_t color : analysis.alpha_colors.ordered_colors()) {
+      alpha_palette.insert(color);
+    }
+
     // Assigns indices to the palette, and writes the encoded palette to the
     // libpng writePtr.
     WritePalette(write_ptr, write_info_ptr, &color_palette, &alpha_palette);
@@ -645,6 +754,8 @@ bool WritePng(IAaptContext* context, const Image* image,
 
     for (int32_t y = 0; y < image->height; y++) {
       png_const_bytep in_row = image->rows[y];
+      uint32_t previous_color = 0u;
+      int idx = -1;
       for (int32_t x = 0; x < image->width; x++) {
         int rr = *in_row++;
         int gg = *in_row++;
@@ -656,7 +767,10 @@ bool WritePng(IAaptContext* context, const Image* image,
         }
 
         const uint32_t color = rr << 24 | gg << 16 | bb << 8 | aa;
-        const int idx = color_palette[color];
+        if (x == 0 || color != previous_color) {
+          idx = color_palette[color];
+          previous_color = color;
+        }
         CHECK(idx != -1);
         out_row[x] = static_cast<png_byte>(idx);
       }
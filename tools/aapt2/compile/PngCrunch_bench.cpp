@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "android-base/file.h"
+#include "benchmark/benchmark.h"
+
+#include "compile/Image.h"
+#include "compile/Png.h"
+#include "compile/PngCache.h"
+#include "io/BigBufferStream.h"
+#include "test/Context.h"
+#include "util/ThreadPool.h"
+
+namespace aapt {
+
+// Roughly the number of drawables of a large app.
+constexpr size_t kCorpusSize = 2000u;
+
+struct CorpusPng {
+  std::string data;
+  bool nine_patch;
+};
+
+static std::unique_ptr<Image> CreateImage(int32_t width, int32_t height) {
+  auto image = util::make_unique<Image>();
+  image->width = width;
+  image->height = height;
+  image->data = std::unique_ptr<uint8_t[]>(new uint8_t[width * height * 4]());
+  image->rows = std::unique_ptr<uint8_t* []>(new uint8_t*[height]);
+  for (int32_t y = 0; y < height; y++) {
+    image->rows[y] = image->data.get() + y * width * 4;
+  }
+  return image;
+}
+
+static void SetPixel(Image* image, int32_t x, int32_t y, uint32_t rgba) {
+  uint8_t* pixel = image->rows[y] + x * 4;
+  pixel[0] = rgba >> 24;
+  pixel[1] = rgba >> 16;
+  pixel[2] = rgba >> 8;
+  pixel[3] = rgba;
+}
+
+// Draws one of the kinds of drawables found in apps: flat icons with antialiased edges,
+// gradients, grayscale masks and photos, which are mostly noise to the encoder.
+static void DrawImage(size_t kind, std::mt19937* rng, Image* image) {
+  const uint32_t color = (*rng)() | 0xffu;
+  for (int32_t y = 0; y < image->height; y++) {
+    for (int32_t x = 0; x < image->width; x++) {
+      uint32_t rgba;
+      switch (kind) {
+        case 0: {
+          const int32_t dx = x - image->width / 2;
+          const int32_t dy = y - image->height / 2;
+          const int32_t r = image->width / 3;
+          const int32_t d = dx * dx + dy * dy - r * r;
+          rgba = d < 0 ? color : d < r ? (color & 0xffffff00u) | 0x80u : 0u;
+          break;
+        }
+        case 1:
+          rgba = ((x * 255 / image->width) << 24) | ((y * 255 / image->height) << 16) | 0x40ffu;
+          break;
+        case 2: {
+          const uint32_t gray = (x ^ y) & 0xffu;
+          rgba = gray << 24 | gray << 16 | gray << 8 | 0xffu;
+          break;
+        }
+        default:
+          rgba = (*rng)() | 0xffu;
+          break;
+      }
+      SetPixel(image, x, y, rgba);
+    }
+  }
+}
+
+// Marks the stretch and padding regions along the 1px border of a nine-patch.
+static void DrawNinePatchBorder(Image* image) {
+  for (int32_t x = 0; x < image->width; x++) {
+    SetPixel(image, x, 0, 0u);
+    SetPixel(image, x, image->height - 1, 0u);
+  }
+  for (int32_t y = 0; y < image->height; y++) {
+    SetPixel(image, 0, y, 0u);
+    SetPixel(image, image->width - 1, y, 0u);
+  }
+  for (int32_t x = image->width / 3; x < image->width * 2 / 3; x++) {
+    SetPixel(image, x, 0, 0x000000ffu);
+    SetPixel(image, x, image->height - 1, 0x000000ffu);
+  }
+  for (int32_t y = image->height / 3; y < image->height * 2 / 3; y++) {
+    SetPixel(image, 0, y, 0x000000ffu);
+    SetPixel(image, image->width - 1, y, 0x000000ffu);
+  }
+}
+
+static const std::vector<CorpusPng>& GetCorpus() {
+  static const std::vector<CorpusPng> corpus = [] {
+    static const int32_t kSizes[] = {24, 36, 48, 72, 96, 144, 192};
+    // Mostly flat icons, and few photos.
+    static const size_t kKinds[] = {0, 0, 0, 1, 1, 2, 2, 3};
+    test::Context context;
+    std::mt19937 rng(42);
+    std::vector<CorpusPng> pngs;
+    for (size_t i = 0; i < kCorpusSize; i++) {
+      const int32_t size = kSizes[i % arraysize(kSizes)];
+      const bool nine_patch = i % 10 == 9;
+      std::unique_ptr<Image> image = CreateImage(size, size);
+      DrawImage(kKinds[i % arraysize(kKinds)], &rng, image.get());
+      if (nine_patch) {
+        DrawNinePatchBorder(image.get());
+      }
+
+      BigBuffer buffer(4096);
+      io::BigBufferOutputStream out(&buffer);
+      CHECK(WritePng(&context, image.get(), nullptr, &out, {}));
+      pngs.push_back(CorpusPng{buffer.to_string(), nine_patch});
+    }
+    return pngs;
+  }();
+  return corpus;
+}
+
+// Decodes, analyzes and re-encodes a PNG the way aapt2 compile does.
+static void CrunchPng(IAaptContext* context, const CorpusPng& png, BigBuffer* out_buffer) {
+  PngChunkFilter filter(png.data);
+  std::unique_ptr<Image> image = ReadPng(context, Source("bench.png"), &filter);
+  CHECK(image);
+
+  std::unique_ptr<NinePatch> nine_patch;
+  if (png.nine_patch) {
+    std::string err;
+    nine_patch = NinePatch::Create(image->rows.get(), image->width, image->height, &err);
+    CHECK(nine_patch) << err;
+    image->width -= 2;
+    image->height -= 2;
+    memmove(image->rows.get(), image->rows.get() + 1, image->height * sizeof(uint8_t**));
+    for (int32_t h = 0; h < image->height; h++) {
+      memmove(image->rows[h], image->rows[h] + 4, image->width * 4);
+    }
+  }
+
+  io::BigBufferOutputStream out(out_buffer);
+  CHECK(WritePng(context, image.get(), nine_patch.get(), &out, {}));
+}
+
+static void SetCorpusCounters(benchmark::State& state) {
+  size_t bytes = 0;
+  for (const CorpusPng& png : GetCorpus()) {
+    bytes += png.data.size();
+  }
+  state.SetItemsProcessed(state.iterations() * GetCorpus().size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+static void BM_CrunchCorpus(benchmark::State& state) {
+  const std::vector<CorpusPng>& corpus = GetCorpus();
+  test::Context context;
+  for (auto _ : state) {
+    for (const CorpusPng& png : corpus) {
+      BigBuffer buffer(4096);
+      CrunchPng(&context, png, &buffer);
+      benchmark::DoNotOptimize(buffer.size());
+    }
+  }
+  SetCorpusCounters(state);
+}
+BENCHMARK(BM_CrunchCorpus)->Unit(benchmark::kMillisecond);
+
+// Crunches the images on a pool of the given number of threads, as aapt2 compile -j does.
+static void BM_CrunchCorpusParallel(benchmark::State& state) {
+  const std::vector<CorpusPng>& corpus = GetCorpus();
+  test::Context context;
+  ThreadPool pool(state.range(0));
+  for (auto _ : state) {
+    for (const CorpusPng& png : corpus) {
+      pool.Schedule([&context, &png] {
+        BigBuffer buffer(4096);
+        CrunchPng(&context, png, &buffer);
+        benchmark::DoNotOptimize(buffer.size());
+      });
+    }
+    pool.Wait();
+  }
+  SetCorpusCounters(state);
+}
+BENCHMARK(BM_CrunchCorpusParallel)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// An incremental build in which none of the images changed.
+static void BM_CrunchCorpusCached(benchmark::State& state) {
+  const std::vector<CorpusPng>& corpus = GetCorpus();
+  test::Context context;
+  TemporaryDir cache_dir;
+  PngCache cache(cache_dir.path);
+  for (const CorpusPng& png : corpus) {
+    BigBuffer buffer(4096);
+    CrunchPng(&context, png, &buffer);
+    cache.Put(png.data, png.nine_patch, buffer);
+  }
+
+  for (auto _ : state) {
+    for (const CorpusPng& png : corpus) {
+      BigBuffer buffer(4096);
+      CHECK(cache.Find(png.data, png.nine_patch, &buffer));
+      benchmark::DoNotOptimize(buffer.size());
+    }
+  }
+  SetCorpusCounters(state);
+}
+BENCHMARK(BM_CrunchCorpusCached)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
+
+BENCHMARK_MAIN();
@@ -16,17 +16,22 @@
 
 #include "format/Archive.h"
 
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include <zlib.h>
+
 #include "android-base/errors.h"
 #include "android-base/macros.h"
 #include "android-base/utf8.h"
 #include "androidfw/StringPiece.h"
 #include "ziparchive/zip_writer.h"
 
+#include "io/BigBufferStream.h"
 #include "util/Files.h"
 
 using ::android::StringPiece;
@@ -128,6 +133,83 @@ class DirectoryWriter : public IArchiveWriter {
   std::string error_;
 };
 
+// Computes the size that data deflates to the way ZipWriter deflates it, without keeping the
+// deflated data.
+class DeflatedSizeCounter {
+ public:
+  explicit DeflatedSizeCounter(int level) : level_(level) {
+  }
+
+  ~DeflatedSizeCounter() {
+    if (initialized_) {
+      deflateEnd(&stream_);
+    }
+  }
+
+  // Starts counting the deflated size of new data.
+  bool Reset() {
+    if (initialized_) {
+      return deflateReset(&stream_) == Z_OK;
+    }
+    memset(&stream_, 0, sizeof(stream_));
+    initialized_ =
+        deflateInit2(&stream_, level_, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    return initialized_;
+  }
+
+  bool Update(const void* data, size_t len) {
+    const Bytef* next = static_cast<const Bytef*>(data);
+    while (len > 0) {
+      const uInt chunk = static_cast<uInt>(std::min<size_t>(len, 1u << 30));
+      if (!Deflate(next, chunk, Z_NO_FLUSH)) {
+        return false;
+      }
+      next += chunk;
+      len -= chunk;
+    }
+    return true;
+  }
+
+  // Flushes the remaining data, after which size() is the deflated size of all of the data.
+  bool Finish() {
+    return Deflate(nullptr, 0u, Z_FINISH);
+  }
+
+  uint64_t size() const {
+    return stream_.total_out;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(DeflatedSizeCounter);
+
+  bool Deflate(const Bytef* data, uInt len, int flush) {
+    stream_.next_in = const_cast<Bytef*>(data);
+    stream_.avail_in = len;
+    while (true) {
+      stream_.next_out = buffer_;
+      stream_.avail_out = sizeof(buffer_);
+      const int result = deflate(&stream_, flush);
+      if (result == Z_STREAM_ERROR) {
+        return false;
+      }
+      if (flush == Z_FINISH ? result == Z_STREAM_END
+                            : stream_.avail_in == 0 && stream_.avail_out != 0) {
+        return true;
+      }
+    }
+  }
+
+  int level_;
+  bool initialized_ = false;
+  z_stream stream_;
+  Bytef buffer_[16384];
+};
+
+// Whether deflating saved enough to store a file compressed. This is preserving behavior of AAPT.
+static bool IsCompressedEnough(uint64_t compressed_size, uint64_t uncompressed_size) {
+  return compressed_size + (compressed_size / 10) <= uncompressed_size;
+}
+
 class ZipFileWriter : public IArchiveWriter {
  public:
   ZipFileWriter() = default;
@@ -183,53 +265,22 @@ class ZipFileWriter : public IArchiveWriter {
   }
 
   bool WriteFile(const StringPiece& path, uint32_t flags, io::InputStream* in) override {
-    while (true) {
-      if (!StartEntry(path, flags)) {
-        return false;
-      }
-
-      const void* data = nullptr;
-      size_t len = 0;
-      while (in->Next(&data, &len)) {
-        if (!Write(data, static_cast<int>(len))) {
-          return false;
-        }
-      }
-
-      if (in->HadError()) {
-        error_ = in->GetError();
-        return false;
-      }
-
-      if (!FinishEntry()) {
-        return false;
-      }
+    // A file that can not be rewritten is kept compressed however well it compressed.
+    if ((flags & ArchiveEntry::kCompress) == 0 || !in->CanRewind()) {
+      return WriteEntry(path, flags, {}, in, nullptr);
+    }
 
-      // Check to see if the file was compressed enough. This is preserving behavior of AAPT.
-      if ((flags & ArchiveEntry::kCompress) != 0 && in->CanRewind()) {
-        ZipWriter::FileEntry last_entry;
-        int32_t result = writer_->GetLastEntry(&last_entry);
-        CHECK(result == 0);
-        if (last_entry.compressed_size + (last_entry.compressed_size / 10) >
-            last_entry.uncompressed_size) {
-          // The file was not compressed enough, rewind and store it uncompressed.
-          if (!in->Rewind()) {
-            // Well we tried, may as well keep what we had.
-            return true;
-          }
-
-          int32_t result = writer_->DiscardLastEntry();
-          if (result != 0) {
-            error_ = ZipWriter::ErrorCodeString(result);
-            return false;
-          }
-          flags &= ~ArchiveEntry::kCompress;
-
-          continue;
-        }
-      }
-      return true;
+    // Deflating the start of a large file quickly tells whether the file is likely to compress
+    // enough, so that it is usually written only once, the way it is kept. Whether it did compress
+    // enough is known once it is written, and the rare file that was guessed wrong is rewritten.
+    std::string sample;
+    if (!ReadSample(in, &sample)) {
+      return false;
+    }
+    if (sample.size() < kSampleSize || IsLikelyCompressedEnough(sample)) {
+      return WriteCompressedEntry(path, flags, sample, in);
     }
+    return WriteStoredEntry(path, flags, sample, in);
   }
 
   bool HadError() const override {
@@ -249,13 +300,232 @@ class ZipFileWriter : public IArchiveWriter {
  private:
   DISALLOW_COPY_AND_ASSIGN(ZipFileWriter);
 
+  // The number of bytes at the start of a file from which it is guessed how well it compresses.
+  static constexpr size_t kSampleSize = 64u * 1024u;
+
+  bool ReadSample(io::InputStream* in, std::string* out_sample) {
+    const void* data = nullptr;
+    size_t len = 0;
+    while (out_sample->size() < kSampleSize && in->Next(&data, &len)) {
+      const size_t used = std::min(len, kSampleSize - out_sample->size());
+      out_sample->append(static_cast<const char*>(data), used);
+      if (used < len) {
+        in->BackUp(len - used);
+      }
+    }
+
+    if (in->HadError()) {
+      error_ = in->GetError();
+      return false;
+    }
+    return true;
+  }
+
+  bool IsLikelyCompressedEnough(const std::string& sample) {
+    // The fastest level deflates a little worse than ZipWriter does, which errs on the side of
+    // storing files, the cheaper of the two to get wrong.
+    if (sample_counter_ == nullptr) {
+      sample_counter_ = util::make_unique<DeflatedSizeCounter>(Z_BEST_SPEED);
+    }
+    if (!sample_counter_->Reset() || !sample_counter_->Update(sample.data(), sample.size()) ||
+        !sample_counter_->Finish()) {
+      return true;
+    }
+    return IsCompressedEnough(sample_counter_->size(), sample.size());
+  }
+
+  // Writes the prefix followed by the rest of the input as an entry, and counts the deflated size
+  // of what it wrote if counter is not null.
+  bool WriteEntry(const StringPiece& path, uint32_t flags, const std::string& prefix,
+                  io::InputStream* in, DeflatedSizeCounter* counter) {
+    if (!StartEntry(path, flags)) {
+      return false;
+    }
+
+    if (!prefix.empty() && !WriteAndCount(prefix.data(), prefix.size(), counter)) {
+      return false;
+    }
+
+    const void* data = nullptr;
+    size_t len = 0;
+    while (in->Next(&data, &len)) {
+      if (!WriteAndCount(data, len, counter)) {
+        return false;
+      }
+    }
+
+    if (in->HadError()) {
+      error_ = in->GetError();
+      return false;
+    }
+
+    return FinishEntry();
+  }
+
+  bool WriteAndCount(const void* data, size_t len, DeflatedSizeCounter* counter) {
+    if (counter != nullptr && !counter->Update(data, len)) {
+      error_ = "failed to deflate";
+      return false;
+    }
+    return Write(data, static_cast<int>(len));
+  }
+
+  bool WriteCompressedEntry(const StringPiece& path, uint32_t flags, const std::string& sample,
+                            io::InputStream* in) {
+    if (!WriteEntry(path, flags, sample, in, nullptr)) {
+      return false;
+    }
+
+    ZipWriter::FileEntry last_entry;
+    int32_t result = writer_->GetLastEntry(&last_entry);
+    CHECK(result == 0);
+    if (IsCompressedEnough(last_entry.compressed_size, last_entry.uncompressed_size)) {
+      return true;
+    }
+
+    // The file was not compressed enough, rewind and store it uncompressed.
+    return RewriteLastEntry(path, flags & ~ArchiveEntry::kCompress, in);
+  }
+
+  bool WriteStoredEntry(const StringPiece& path, uint32_t flags, const std::string& sample,
+                        io::InputStream* in) {
+    // The file is deflated the way ZipWriter would alongside storing it, so that it is read once.
+    if (stored_counter_ == nullptr) {
+      stored_counter_ = util::make_unique<DeflatedSizeCounter>(Z_BEST_COMPRESSION);
+    }
+    if (!stored_counter_->Reset()) {
+      return WriteCompressedEntry(path, flags, sample, in);
+    }
+
+    if (!WriteEntry(path, flags & ~ArchiveEntry::kCompress, sample, in, stored_counter_.get())) {
+      return false;
+    }
+    if (!stored_counter_->Finish()) {
+      error_ = "failed to deflate";
+      return false;
+    }
+
+    ZipWriter::FileEntry last_entry;
+    int32_t result = writer_->GetLastEntry(&last_entry);
+    CHECK(result == 0);
+    if (!IsCompressedEnough(stored_counter_->size(), last_entry.uncompressed_size)) {
+      return true;
+    }
+
+    // The file compressed enough after all, rewind and store it compressed.
+    return RewriteLastEntry(path, flags, in);
+  }
+
+  bool RewriteLastEntry(const StringPiece& path, uint32_t flags, io::InputStream* in) {
+    if (!in->Rewind()) {
+      // Well we tried, may as well keep what we had.
+      return true;
+    }
+
+    int32_t result = writer_->DiscardLastEntry();
+    if (result != 0) {
+      error_ = ZipWriter::ErrorCodeString(result);
+      return false;
+    }
+    return WriteEntry(path, flags, {}, in, nullptr);
+  }
+
   std::unique_ptr<FILE, decltype(fclose)*> file_ = {nullptr, fclose};
   std::unique_ptr<ZipWriter> writer_;
   std::string error_;
+
+  // Reused across files, as setting up a deflater is costly compared to deflating small files.
+  std::unique_ptr<DeflatedSizeCounter> sample_counter_;
+  std::unique_ptr<DeflatedSizeCounter> stored_counter_;
 };
 
 }  // namespace
 
+bool BufferedArchiveWriter::StartEntry(const StringPiece& path, uint32_t flags) {
+  if (current_entry_) {
+    return false;
+  }
+  current_entry_.reset(new Entry{path.to_string(), flags, BigBuffer(4096), false});
+  return true;
+}
+
+bool BufferedArchiveWriter::Write(const void* data, int len) {
+  if (!current_entry_) {
+    return false;
+  }
+  if (len > 0) {
+    memcpy(current_entry_->data.NextBlock<uint8_t>(len), data, len);
+  }
+  return true;
+}
+
+bool BufferedArchiveWriter::FinishEntry() {
+  if (!current_entry_) {
+    return false;
+  }
+  entries_.push_back(std::move(current_entry_));
+  return true;
+}
+
+bool BufferedArchiveWriter::WriteFile(const StringPiece& path, uint32_t flags,
+                                      io::InputStream* in) {
+  if (!StartEntry(path, flags)) {
+    return false;
+  }
+  current_entry_->whole_file = true;
+
+  const void* data = nullptr;
+  size_t len = 0;
+  while (in->Next(&data, &len)) {
+    if (!Write(data, static_cast<int>(len))) {
+      return false;
+    }
+  }
+
+  if (in->HadError()) {
+    error_ = in->GetError();
+    current_entry_.reset();
+    return false;
+  }
+
+  return FinishEntry();
+}
+
+bool BufferedArchiveWriter::HadError() const {
+  return !error_.empty();
+}
+
+std::string BufferedArchiveWriter::GetError() const {
+  return error_;
+}
+
+bool BufferedArchiveWriter::WriteTo(IArchiveWriter* writer) const {
+  for (const std::unique_ptr<Entry>& entry : entries_) {
+    if (entry->whole_file) {
+      // The data can be rewound, so the writer may still store the entry uncompressed when
+      // deflating it saves too little.
+      io::BigBufferInputStream in(&entry->data);
+      if (!writer->WriteFile(entry->path, entry->flags, &in)) {
+        return false;
+      }
+      continue;
+    }
+
+    if (!writer->StartEntry(entry->path, entry->flags)) {
+      return false;
+    }
+    for (const BigBuffer::Block& block : entry->data) {
+      if (block.size > 0 && !writer->Write(block.buffer.get(), static_cast<int>(block.size))) {
+        return false;
+      }
+    }
+    if (!writer->FinishEntry()) {
+      return false;
+    }
+  }
+  return true;
+}
+
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
                                                              const StringPiece& path) {
   std::unique_ptr<DirectoryWriter> writer = util::make_unique<DirectoryWriter>();
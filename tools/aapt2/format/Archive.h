@@ -70,6 +70,44 @@ class IArchiveWriter : public ::google::protobuf::io::CopyingOutputStream {
   virtual std::string GetError() const = 0;
 };
 
+// Keeps the written entries in memory, so that they can be produced on one thread and copied to
+// the real archive, in order, on another.
+class BufferedArchiveWriter : public IArchiveWriter {
+ public:
+  BufferedArchiveWriter() = default;
+
+  bool WriteFile(const android::StringPiece& path, uint32_t flags, io::InputStream* in) override;
+  bool StartEntry(const android::StringPiece& path, uint32_t flags) override;
+  bool FinishEntry() override;
+  bool Write(const void* buffer, int size) override;
+  bool HadError() const override;
+  std::string GetError() const override;
+
+  // Writes the finished entries to writer, in the order they were written here. Entries written
+  // with WriteFile are written with WriteFile again, so that writer decides how to store them.
+  bool WriteTo(IArchiveWriter* writer) const;
+
+  struct Entry {
+    std::string path;
+    uint32_t flags;
+    BigBuffer data;
+    // Whether the entry was written with WriteFile rather than StartEntry.
+    bool whole_file;
+  };
+
+  // The finished entries, in the order they were written.
+  const std::vector<std::unique_ptr<Entry>>& entries() const {
+    return entries_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(BufferedArchiveWriter);
+
+  std::vector<std::unique_ptr<Entry>> entries_;
+  std::unique_ptr<Entry> current_entry_;
+  std::string error_;
+};
+
 std::unique_ptr<IArchiveWriter> CreateDirectoryArchiveWriter(IDiagnostics* diag,
                                                              const android::StringPiece& path);
 
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "format/Archive.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "android-base/file.h"
+#include "benchmark/benchmark.h"
+
+#include "Diagnostics.h"
+#include "io/Data.h"
+#include "util/Util.h"
+
+namespace aapt {
+
+// Large raw assets, such as media, which deflate barely or not at all.
+constexpr size_t kAssetCount = 16u;
+constexpr size_t kAssetSize = 4u * 1024u * 1024u;
+
+static std::unique_ptr<io::IData> MakeAsset(std::mt19937* rng, bool compressible) {
+  auto buffer = std::unique_ptr<uint8_t[]>(new uint8_t[kAssetSize]);
+  for (size_t i = 0; i < kAssetSize; i++) {
+    buffer[i] = compressible ? static_cast<uint8_t>('a' + (i / 64) % 16)
+                             : static_cast<uint8_t>((*rng)());
+  }
+  return util::make_unique<io::MallocData>(std::move(buffer), kAssetSize);
+}
+
+// Writes the assets to an APK, asking for each to be compressed like aapt2 link does for
+// extensions it does not know to be compressed already.
+static void WriteAssets(benchmark::State& state, bool compressible) {
+  std::mt19937 rng(42);
+  std::vector<std::unique_ptr<io::IData>> assets;
+  for (size_t i = 0; i < kAssetCount; i++) {
+    assets.push_back(MakeAsset(&rng, compressible));
+  }
+
+  TemporaryDir dir;
+  const std::string path = std::string(dir.path) + "/assets.apk";
+  StdErrDiagnostics diag;
+  for (auto _ : state) {
+    std::unique_ptr<IArchiveWriter> writer = CreateZipFileArchiveWriter(&diag, path);
+    CHECK(writer != nullptr);
+    for (size_t i = 0; i < assets.size(); i++) {
+      assets[i]->Rewind();
+      CHECK(writer->WriteFile("assets/" + std::to_string(i), ArchiveEntry::kCompress,
+                              assets[i].get()));
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * kAssetCount * kAssetSize);
+}
+
+static void BM_WriteIncompressibleAssets(benchmark::State& state) {
+  WriteAssets(state, false /*compressible*/);
+}
+BENCHMARK(BM_WriteIncompressibleAssets)->Unit(benchmark::kMillisecond);
+
+static void BM_WriteCompressibleAssets(benchmark::State& state) {
+  WriteAssets(state, true /*compressible*/);
+}
+BENCHMARK(BM_WriteCompressibleAssets)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "android-base/file.h"
+
 #include "test/Test.h"
 
 namespace aapt {
@@ -206,4 +208,104 @@ TEST_F(ArchiveTest, ZipFileWriteFileError) {
   ASSERT_EQ("ZipFileWriteFileError", writer->GetError());
 }
 
+static std::string MakeRandomString(size_t size) {
+  std::string str(size, '\0');
+  for (char& c : str) {
+    c = static_cast<char>(rand());
+  }
+  return str;
+}
+
+static std::unique_ptr<io::IData> MakeData(const std::string& contents) {
+  auto buffer = std::make_unique<uint8_t[]>(contents.size());
+  std::copy(contents.begin(), contents.end(), buffer.get());
+  return util::make_unique<io::MallocData>(std::move(buffer), contents.size());
+}
+
+TEST_F(ArchiveTest, ZipFileWriteFileOnlyCompressesWhenItSavesEnough) {
+  const std::string compressible(256 * 1024, 'a');
+  const std::string incompressible = MakeRandomString(256 * 1024);
+
+  // The start of a file is deflated to guess how well the file compresses. These guess wrong.
+  const std::string compressible_end =
+      MakeRandomString(64 * 1024) + std::string(1024 * 1024, 'a');
+  const std::string incompressible_end =
+      std::string(64 * 1024, 'a') + MakeRandomString(1024 * 1024);
+
+  const std::vector<std::pair<std::string, std::string>> files = {
+      {"compressible", compressible},
+      {"incompressible", incompressible},
+      {"compressible_end", compressible_end},
+      {"incompressible_end", incompressible_end},
+  };
+
+  std::string output_path = GetTestPath("output.apk");
+  std::unique_ptr<IArchiveWriter> writer = MakeZipFileWriter(output_path);
+  for (const auto& file : files) {
+    std::unique_ptr<io::IData> data = MakeData(file.second);
+    ASSERT_TRUE(writer->WriteFile(file.first, ArchiveEntry::kCompress, data.get()));
+  }
+  writer.reset();
+
+  std::unique_ptr<io::ZipFileCollection> zip = io::ZipFileCollection::Create(output_path, nullptr);
+  ASSERT_NE(nullptr, zip);
+  for (const auto& file : files) {
+    io::IFile* zip_file = zip->FindFile(file.first);
+    ASSERT_NE(nullptr, zip_file);
+    std::unique_ptr<io::IData> data = zip_file->OpenAsData();
+    ASSERT_NE(nullptr, data);
+    EXPECT_EQ(file.second,
+              std::string(reinterpret_cast<const char*>(data->data()), data->size()));
+  }
+  EXPECT_TRUE(zip->FindFile("compressible")->WasCompressed());
+  EXPECT_FALSE(zip->FindFile("incompressible")->WasCompressed());
+  EXPECT_TRUE(zip->FindFile("compressible_end")->WasCompressed());
+  EXPECT_FALSE(zip->FindFile("incompressible_end")->WasCompressed());
+}
+
+TEST_F(ArchiveTest, BufferedWriterOnlyCompressesWhenItSavesEnough) {
+  // A small flattened XML file, which deflate barely shrinks, and a file that deflates well.
+  const std::vector<std::pair<std::string, std::string>> files = {
+      {"res/layout/main.xml", std::string("\x03\x00\x08\x00", 4) + MakeRandomString(300)},
+      {"compressible", std::string(16 * 1024, 'a')},
+  };
+
+  // Written as ResourceFileFlattener writes flattened XML files when linking in parallel.
+  BufferedArchiveWriter buffered_writer;
+  for (const auto& file : files) {
+    std::unique_ptr<io::IData> data = MakeData(file.second);
+    ASSERT_TRUE(buffered_writer.WriteFile(file.first, ArchiveEntry::kCompress, data.get()));
+  }
+  const std::string buffered_path = GetTestPath("buffered.apk");
+  std::unique_ptr<IArchiveWriter> writer = MakeZipFileWriter(buffered_path);
+  ASSERT_TRUE(buffered_writer.WriteTo(writer.get()));
+  writer.reset();
+
+  const std::string direct_path = GetTestPath("direct.apk");
+  writer = MakeZipFileWriter(direct_path);
+  for (const auto& file : files) {
+    std::unique_ptr<io::IData> data = MakeData(file.second);
+    ASSERT_TRUE(writer->WriteFile(file.first, ArchiveEntry::kCompress, data.get()));
+  }
+  writer.reset();
+
+  std::unique_ptr<io::ZipFileCollection> zip =
+      io::ZipFileCollection::Create(buffered_path, nullptr);
+  ASSERT_NE(nullptr, zip);
+  io::IFile* xml_file = zip->FindFile("res/layout/main.xml");
+  ASSERT_NE(nullptr, xml_file);
+  std::unique_ptr<io::IData> data = xml_file->OpenAsData();
+  ASSERT_NE(nullptr, data);
+  EXPECT_EQ(files[0].second,
+            std::string(reinterpret_cast<const char*>(data->data()), data->size()));
+  EXPECT_FALSE(xml_file->WasCompressed());
+  EXPECT_TRUE(zip->FindFile("compressible")->WasCompressed());
+
+  std::string buffered_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(buffered_path, &buffered_contents));
+  std::string direct_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(direct_path, &direct_contents));
+  EXPECT_EQ(direct_contents, buffered_contents);
+}
+
 }  // namespace aapt
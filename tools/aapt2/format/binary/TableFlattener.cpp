@@ -719,7 +719,7 @@ bool TableFlattener::Consume(IAaptContext* context, ResourceTable* table) {
       diff = a.config.compare(b.config);
     }
     return diff;
-  });
+  }, options_.jobs);
 
   // Write the ResTable header.
   ChunkWriter table_writer(buffer_);
@@ -728,7 +728,7 @@ bool TableFlattener::Consume(IAaptContext* context, ResourceTable* table) {
 
   // Flatten the values string pool.
   StringPool::FlattenUtf8(table_writer.buffer(), table->string_pool,
-      context->GetDiagnostics());
+      context->GetDiagnostics(), options_.jobs);
 
   BigBuffer package_buffer(1024);
 
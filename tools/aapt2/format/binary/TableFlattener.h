@@ -47,6 +47,10 @@ struct TableFlattenerOptions {
 
   // Map from original resource paths to shortened resource paths.
   std::map<std::string, std::string> shortened_path_map;
+
+  // Number of threads a large values string pool is sorted and encoded on, or 0 for one per
+  // hardware thread.
+  size_t jobs = 1;
 };
 
 class TableFlattener : public IResourceTableConsumer {
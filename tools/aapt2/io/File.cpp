@@ -43,5 +43,15 @@ std::unique_ptr<io::InputStream> FileSegment::OpenInputStream() {
   return OpenAsData();
 }
 
+std::unique_ptr<IData> SerializedOpenFile::OpenAsData() {
+  std::lock_guard<std::mutex> lock(*mutex_);
+  return file_->OpenAsData();
+}
+
+std::unique_ptr<io::InputStream> SerializedOpenFile::OpenInputStream() {
+  std::lock_guard<std::mutex> lock(*mutex_);
+  return file_->OpenInputStream();
+}
+
 }  // namespace io
 }  // namespace aapt
@@ -19,6 +19,7 @@
 
 #include <list>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "android-base/macros.h"
@@ -88,6 +89,32 @@ class FileSegment : public IFile {
   size_t len_;
 };
 
+// Serializes opening the files of a collection that cannot be read from several threads at once,
+// such as the entries of a zip archive, which share one archive handle. The data of an opened
+// file is independent of the collection, so it may be read without holding the mutex.
+class SerializedOpenFile : public IFile {
+ public:
+  SerializedOpenFile(IFile* file, std::mutex* mutex) : file_(file), mutex_(mutex) {
+  }
+
+  std::unique_ptr<IData> OpenAsData() override;
+  std::unique_ptr<io::InputStream> OpenInputStream() override;
+
+  const Source& GetSource() const override {
+    return file_->GetSource();
+  }
+
+  bool WasCompressed() override {
+    return file_->WasCompressed();
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SerializedOpenFile);
+
+  IFile* file_;
+  std::mutex* mutex_;
+};
+
 class IFileCollectionIterator {
  public:
   virtual ~IFileCollectionIterator() = default;
@@ -76,6 +76,14 @@ bool ZipFile::WasCompressed() {
   return zip_entry_.method != kCompressStored;
 }
 
+uint32_t ZipFile::GetCrc32() const {
+  return zip_entry_.crc32;
+}
+
+size_t ZipFile::GetUncompressedSize() const {
+  return zip_entry_.uncompressed_length;
+}
+
 ZipFileCollectionIterator::ZipFileCollectionIterator(
     ZipFileCollection* collection)
     : current_(collection->files_.begin()), end_(collection->files_.end()) {}
@@ -39,6 +39,12 @@ class ZipFile : public IFile {
   const Source& GetSource() const override;
   bool WasCompressed() override;
 
+  // Returns the CRC-32 of the uncompressed contents of the file, as recorded in the archive.
+  uint32_t GetCrc32() const;
+
+  // Returns the size of the uncompressed contents of the file.
+  size_t GetUncompressedSize() const;
+
  private:
   ::ZipArchiveHandle zip_handle_;
   ::ZipEntry zip_entry_;
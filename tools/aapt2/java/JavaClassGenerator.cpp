@@ -585,15 +585,43 @@ static void AppendJavaDocAnnotations(const std::vector<std::string>& annotations
 bool JavaClassGenerator::Generate(const StringPiece& package_name_to_generate,
                                   const StringPiece& out_package_name, OutputStream* out,
                                   OutputStream* out_r_txt) {
+  std::unique_ptr<Printer> r_txt_printer;
+  if (out_r_txt != nullptr) {
+    r_txt_printer = util::make_unique<Printer>(out_r_txt);
+  }
+
   ClassDefinition r_class("R", ClassQualifier::kNone, true);
-  std::unique_ptr<MethodDefinition> rewrite_method;
+  if (!ProcessTable(package_name_to_generate, out != nullptr ? &r_class : nullptr,
+                    r_txt_printer.get())) {
+    return false;
+  }
 
+  if (out != nullptr) {
+    ClassDefinition::WriteJavaFile(&r_class, out_package_name, options_.use_final, out);
+  }
+  return true;
+}
+
+std::unique_ptr<ClassDefinition> JavaClassGenerator::GenerateClass(
+    const StringPiece& package_name_to_generate, OutputStream* out_r_txt) {
   std::unique_ptr<Printer> r_txt_printer;
   if (out_r_txt != nullptr) {
     r_txt_printer = util::make_unique<Printer>(out_r_txt);
   }
+
+  auto r_class = util::make_unique<ClassDefinition>("R", ClassQualifier::kNone, true);
+  if (!ProcessTable(package_name_to_generate, r_class.get(), r_txt_printer.get())) {
+    return {};
+  }
+  return r_class;
+}
+
+bool JavaClassGenerator::ProcessTable(const StringPiece& package_name_to_generate,
+                                      ClassDefinition* out_r_class_def, Printer* r_txt_printer) {
+  std::unique_ptr<MethodDefinition> rewrite_method;
+
   // Generate an onResourcesLoaded() callback if requested.
-  if (out != nullptr && options_.rewrite_callback_options) {
+  if (out_r_class_def != nullptr && options_.rewrite_callback_options) {
     rewrite_method =
         util::make_unique<MethodDefinition>("public static void onResourcesLoaded(int p)");
     for (const std::string& package_to_callback :
@@ -616,13 +644,13 @@ bool JavaClassGenerator::Generate(const StringPiece& package_name_to_generate,
           (options_.types == JavaClassGeneratorOptions::SymbolTypes::kPublic);
 
       std::unique_ptr<ClassDefinition> class_def;
-      if (out != nullptr) {
+      if (out_r_class_def != nullptr) {
         class_def = util::make_unique<ClassDefinition>(
             to_string(type->type), ClassQualifier::kStatic, force_creation_if_empty);
       }
 
       if (!ProcessType(package_name_to_generate, *package, *type, class_def.get(),
-                       rewrite_method.get(), r_txt_printer.get())) {
+                       rewrite_method.get(), r_txt_printer)) {
         return false;
       }
 
@@ -631,33 +659,32 @@ bool JavaClassGenerator::Generate(const StringPiece& package_name_to_generate,
         const ResourceTableType* priv_type = package->FindType(ResourceType::kAttrPrivate);
         if (priv_type) {
           if (!ProcessType(package_name_to_generate, *package, *priv_type, class_def.get(),
-                           rewrite_method.get(), r_txt_printer.get())) {
+                           rewrite_method.get(), r_txt_printer)) {
             return false;
           }
         }
       }
 
-      if (out != nullptr && type->type == ResourceType::kStyleable &&
+      if (out_r_class_def != nullptr && type->type == ResourceType::kStyleable &&
           options_.types == JavaClassGeneratorOptions::SymbolTypes::kPublic) {
         // When generating a public R class, we don't want Styleable to be part
         // of the API. It is only emitted for documentation purposes.
         class_def->GetCommentBuilder()->AppendComment("@doconly");
       }
 
-      if (out != nullptr) {
+      if (out_r_class_def != nullptr) {
         AppendJavaDocAnnotations(options_.javadoc_annotations, class_def->GetCommentBuilder());
-        r_class.AddMember(std::move(class_def));
+        out_r_class_def->AddMember(std::move(class_def));
       }
     }
   }
 
   if (rewrite_method != nullptr) {
-    r_class.AddMember(std::move(rewrite_method));
+    out_r_class_def->AddMember(std::move(rewrite_method));
   }
 
-  if (out != nullptr) {
-    AppendJavaDocAnnotations(options_.javadoc_annotations, r_class.GetCommentBuilder());
-    ClassDefinition::WriteJavaFile(&r_class, out_package_name, options_.use_final, out);
+  if (out_r_class_def != nullptr) {
+    AppendJavaDocAnnotations(options_.javadoc_annotations, out_r_class_def->GetCommentBuilder());
   }
   return true;
 }
@@ -17,6 +17,7 @@
 #ifndef AAPT_JAVA_CLASS_GENERATOR_H
 #define AAPT_JAVA_CLASS_GENERATOR_H
 
+#include <memory>
 #include <string>
 
 #include "androidfw/StringPiece.h"
@@ -77,6 +78,13 @@ class JavaClassGenerator {
                 const android::StringPiece& output_package_name, io::OutputStream* out,
                 io::OutputStream* out_r_txt = nullptr);
 
+  // Builds the R class of `package_name_to_generate`, and writes the R.txt file to `out_r_txt`
+  // if it is not null. The class can be written for any number of Java packages with
+  // ClassDefinition::WriteJavaFile(), which does not modify it. Returns nullptr on error.
+  std::unique_ptr<ClassDefinition> GenerateClass(
+      const android::StringPiece& package_name_to_generate,
+      io::OutputStream* out_r_txt = nullptr);
+
   const std::string& GetError() const;
 
   static std::string TransformToFieldName(const android::StringPiece& symbol);
@@ -91,6 +99,11 @@ class JavaClassGenerator {
                                       const android::StringPiece& package_name_to_generate,
                                       const ResourceEntry& entry);
 
+  // Adds the symbols of every type to `out_r_class_def`, if it is not null, and prints them to
+  // `r_txt_printer`, if it is not null.
+  bool ProcessTable(const android::StringPiece& package_name_to_generate,
+                    ClassDefinition* out_r_class_def, text::Printer* r_txt_printer);
+
   bool ProcessType(const android::StringPiece& package_name_to_generate,
                    const ResourceTablePackage& package, const ResourceTableType& type,
                    ClassDefinition* out_type_class_def, MethodDefinition* out_rewrite_method_def,
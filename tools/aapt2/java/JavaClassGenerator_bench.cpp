@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "java/JavaClassGenerator.h"
+
+#include <string>
+#include <vector>
+
+#include "android-base/logging.h"
+#include "android-base/macros.h"
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+
+#include "io/StringStream.h"
+#include "java/ClassDefinition.h"
+#include "test/Builders.h"
+#include "test/Context.h"
+#include "util/ThreadPool.h"
+
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+// A non-namespaced app whose R class is copied to the packages of its 200 libraries.
+constexpr size_t kExtraPackageCount = 200u;
+constexpr size_t kEntriesPerType = 2500u;
+constexpr const char* kTypes[] = {"drawable", "id", "layout", "string"};
+
+static ResourceTable* GetTable() {
+  static std::unique_ptr<ResourceTable> table = [] {
+    test::ResourceTableBuilder builder;
+    for (size_t type = 0; type < arraysize(kTypes); type++) {
+      for (size_t i = 0; i < kEntriesPerType; i++) {
+        builder.AddSimple(StringPrintf("com.app:%s/res_%04zu", kTypes[type], i),
+                          ResourceId(0x7f, type + 1, i));
+      }
+    }
+    return builder.Build();
+  }();
+  return table.get();
+}
+
+static const std::vector<std::string>& GetExtraPackages() {
+  static const std::vector<std::string> packages = [] {
+    std::vector<std::string> packages;
+    for (size_t i = 0; i < kExtraPackageCount; i++) {
+      packages.push_back(StringPrintf("com.lib%zu", i));
+    }
+    return packages;
+  }();
+  return packages;
+}
+
+// Generates the R class again for every package, as aapt2 link did.
+static void BM_GenerateRClassPerPackage(benchmark::State& state) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  for (auto _ : state) {
+    for (const std::string& package : GetExtraPackages()) {
+      std::string output;
+      io::StringOutputStream out(&output);
+      JavaClassGenerator generator(context.get(), GetTable(), {});
+      CHECK(generator.Generate("com.app", package, &out));
+      out.Flush();
+      benchmark::DoNotOptimize(output.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kExtraPackageCount);
+}
+BENCHMARK(BM_GenerateRClassPerPackage)->Unit(benchmark::kMillisecond);
+
+// Generates the R class once, and writes it for every package on state.range(0) threads.
+static void BM_GenerateRClassOnce(benchmark::State& state) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  std::vector<std::string> outputs(kExtraPackageCount);
+  for (auto _ : state) {
+    JavaClassGenerator generator(context.get(), GetTable(), {});
+    std::unique_ptr<ClassDefinition> r_class = generator.GenerateClass("com.app");
+    CHECK(r_class != nullptr);
+
+    ThreadPool pool(state.range(0));
+    for (size_t i = 0; i < kExtraPackageCount; i++) {
+      pool.Schedule([&, i] {
+        outputs[i].clear();
+        io::StringOutputStream out(&outputs[i]);
+        ClassDefinition::WriteJavaFile(r_class.get(), GetExtraPackages()[i], true, &out);
+      });
+    }
+    pool.Wait();
+    benchmark::DoNotOptimize(outputs.data());
+  }
+  state.SetItemsProcessed(state.iterations() * kExtraPackageCount);
+}
+BENCHMARK(BM_GenerateRClassOnce)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
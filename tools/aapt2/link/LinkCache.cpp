@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/LinkCache.h"
+
+#include <unistd.h>
+#include <utime.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "android-base/file.h"
+#include "android-base/stringprintf.h"
+
+#include "trace/TraceBuffer.h"
+#include "util/Files.h"
+
+using ::android::ConfigDescription;
+using ::android::ResTable_config;
+using ::android::StringPiece;
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+namespace {
+
+// Identifies the layout of an entry.
+constexpr char kEntryMagic[] = "AAPTLNK2";
+constexpr size_t kEntryMagicSize = sizeof(kEntryMagic) - 1;
+
+constexpr char kEntryExtension[] = ".lnk";
+
+// file::PruneCacheDirectory() deletes old temporary files with this extension.
+constexpr char kTempExtension[] = ".tmp";
+
+// An entry is the magic, the fingerprint of the cache as a uint64_t, the key and the input as
+// strings, and then the number of linked files followed by the files. A file is its configuration
+// as a raw ResTable_config, its path as a string, its compression flags and its data as a string.
+// Strings are prefixed by their uint64_t length.
+class EntryWriter {
+ public:
+  void Write(const void* data, size_t len) {
+    entry_.append(reinterpret_cast<const char*>(data), len);
+  }
+
+  template <typename T>
+  void Write(const T& value) {
+    Write(&value, sizeof(value));
+  }
+
+  void WriteString(const StringPiece& str) {
+    Write(static_cast<uint64_t>(str.size()));
+    Write(str.data(), str.size());
+  }
+
+  const std::string& entry() const {
+    return entry_;
+  }
+
+ private:
+  std::string entry_;
+};
+
+class EntryReader {
+ public:
+  explicit EntryReader(const StringPiece& entry) : entry_(entry) {
+  }
+
+  bool Read(void* out_data, size_t len) {
+    if (len > entry_.size() - offset_) {
+      return false;
+    }
+    memcpy(out_data, entry_.data() + offset_, len);
+    offset_ += len;
+    return true;
+  }
+
+  template <typename T>
+  bool Read(T* out_value) {
+    return Read(out_value, sizeof(*out_value));
+  }
+
+  bool ReadString(StringPiece* out_str) {
+    uint64_t len;
+    if (!Read(&len) || len > entry_.size() - offset_) {
+      return false;
+    }
+    *out_str = entry_.substr(offset_, len);
+    offset_ += len;
+    return true;
+  }
+
+  bool AtEnd() const {
+    return offset_ == entry_.size();
+  }
+
+ private:
+  StringPiece entry_;
+  size_t offset_ = 0u;
+};
+
+}  // namespace
+
+std::string LinkCache::GetEntryPath(const StringPiece& key, const StringPiece& input) const {
+  const Fingerprint fingerprint =
+      Fingerprint().Update(fingerprint_.value()).Update(key).Update(input);
+  std::string path = dir_;
+  file::AppendPath(&path, fingerprint.ToString() + kEntryExtension);
+  return path;
+}
+
+bool LinkCache::Find(const StringPiece& key, const StringPiece& input,
+                     std::vector<LinkedFile>* out_files) {
+  const std::string entry_path = GetEntryPath(key, input);
+  std::string entry;
+  if (!android::base::ReadFileToString(entry_path, &entry)) {
+    misses_++;
+    return false;
+  }
+
+  EntryReader reader(entry);
+  char magic[kEntryMagicSize];
+  uint64_t cached_fingerprint;
+  StringPiece cached_key;
+  StringPiece cached_input;
+  uint64_t file_count;
+  if (!reader.Read(magic, kEntryMagicSize) || memcmp(magic, kEntryMagic, kEntryMagicSize) != 0 ||
+      !reader.Read(&cached_fingerprint) || cached_fingerprint != fingerprint_.value() ||
+      !reader.ReadString(&cached_key) || cached_key != key || !reader.ReadString(&cached_input) ||
+      cached_input != input || !reader.Read(&file_count)) {
+    misses_++;
+    return false;
+  }
+
+  std::vector<LinkedFile> files;
+  for (uint64_t i = 0; i < file_count; i++) {
+    LinkedFile file;
+    ResTable_config config;
+    StringPiece path;
+    StringPiece data;
+    if (!reader.Read(&config) || !reader.ReadString(&path) ||
+        !reader.Read(&file.compression_flags) || !reader.ReadString(&data)) {
+      misses_++;
+      return false;
+    }
+    file.config = ConfigDescription(config);
+    file.path = path.to_string();
+    file.data = data.to_string();
+    files.push_back(std::move(file));
+  }
+
+  if (!reader.AtEnd()) {
+    misses_++;
+    return false;
+  }
+
+  // Prune() removes the entries that were used least recently first.
+  utime(entry_path.c_str(), nullptr);
+
+  hits_++;
+  *out_files = std::move(files);
+  return true;
+}
+
+void LinkCache::Put(const StringPiece& key, const StringPiece& input,
+                    const std::vector<LinkedFile>& files) {
+  static std::atomic<uint32_t> next_temp_id(0);
+
+  EntryWriter writer;
+  writer.Write(kEntryMagic, kEntryMagicSize);
+  writer.Write(fingerprint_.value());
+  writer.WriteString(key);
+  writer.WriteString(input);
+  writer.Write(static_cast<uint64_t>(files.size()));
+  for (const LinkedFile& file : files) {
+    writer.Write(static_cast<const ResTable_config&>(file.config));
+    writer.WriteString(file.path);
+    writer.Write(file.compression_flags);
+    writer.WriteString(file.data);
+  }
+
+  const std::string path = GetEntryPath(key, input);
+  const std::string temp_path =
+      StringPrintf("%s.%d-%u%s", path.c_str(), getpid(), next_temp_id++, kTempExtension);
+  if (!android::base::WriteStringToFile(writer.entry(), temp_path)) {
+    return;
+  }
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    unlink(temp_path.c_str());
+  }
+}
+
+void LinkCache::Prune(size_t max_bytes) {
+  TRACE_CALL();
+  file::PruneCacheDirectory(dir_, kEntryExtension, max_bytes);
+}
+
+}  // namespace aapt
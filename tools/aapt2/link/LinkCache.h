@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_LINK_LINKCACHE_H
+#define AAPT_LINK_LINKCACHE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "androidfw/ConfigDescription.h"
+#include "androidfw/StringPiece.h"
+
+#include "util/Fingerprint.h"
+
+namespace aapt {
+
+// A file that linking a compiled XML file writes to the APK. Auto-versioning can produce several
+// of them for one compiled file.
+struct LinkedFile {
+  android::ConfigDescription config;
+  std::string path;
+  uint32_t compression_flags = 0u;
+  std::string data;
+};
+
+// A directory of the files produced by linking compiled XML files in previous runs of aapt2 link,
+// so that a link in which few files changed does not have to link and flatten them all again.
+//
+// The cache is created with a fingerprint of everything besides the compiled file that linking
+// depends on: the version of aapt2, the options, the included APKs and the symbols of the
+// resource table. An entry is named after a hash of that fingerprint, the key of the file and the
+// complete compiled file. It holds all three, and they have to match for the entry to be used, so
+// entries whose names collide are never confused. Entries are renamed into place once written, so
+// several links may share a directory.
+//
+// Files may be looked up and stored from several threads at once.
+class LinkCache {
+ public:
+  // The size that Prune() keeps the entries of a directory to by default.
+  static constexpr size_t kDefaultMaxSizeBytes = 256u * 1024u * 1024u;
+
+  LinkCache(const std::string& dir, const Fingerprint& fingerprint)
+      : dir_(dir), fingerprint_(fingerprint) {
+  }
+
+  // Finds the files linked from the input. `key` identifies everything besides the input and the
+  // fingerprint of the cache that linking the file depends on.
+  bool Find(const android::StringPiece& key, const android::StringPiece& input,
+            std::vector<LinkedFile>* out_files);
+
+  // Stores the files linked from the input.
+  void Put(const android::StringPiece& key, const android::StringPiece& input,
+           const std::vector<LinkedFile>& files);
+
+  // Deletes the least recently used entries of the directory until the remaining ones take at
+  // most max_bytes, and the temporary files left behind by links that did not finish. Must not
+  // be called while files are looked up or stored.
+  void Prune(size_t max_bytes);
+
+  size_t hits() const {
+    return hits_;
+  }
+
+  size_t misses() const {
+    return misses_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(LinkCache);
+
+  std::string GetEntryPath(const android::StringPiece& key,
+                           const android::StringPiece& input) const;
+
+  std::string dir_;
+  Fingerprint fingerprint_;
+  std::atomic<size_t> hits_{0u};
+  std::atomic<size_t> misses_{0u};
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_LINK_LINKCACHE_H
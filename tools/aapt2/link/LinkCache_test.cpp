@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/LinkCache.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+#include <ctime>
+
+#include "android-base/file.h"
+
+#include "test/Fixture.h"
+#include "test/Test.h"
+
+using ::testing::Eq;
+using ::testing::SizeIs;
+
+namespace aapt {
+
+using LinkCacheTest = TestDirectoryFixture;
+
+static std::vector<LinkedFile> MakeLinkedFiles() {
+  std::vector<LinkedFile> files(2);
+  files[0].path = "res/layout/main.xml";
+  files[0].compression_flags = 1u;
+  files[0].data = "layout";
+  files[1].config = test::ParseConfigOrDie("v21");
+  files[1].path = "res/layout-v21/main.xml";
+  files[1].data = std::string("layout\0v21", 10);
+  return files;
+}
+
+// Returns the paths of the files in dir with the extension.
+static std::vector<std::string> ListFiles(const std::string& dir, const std::string& extension) {
+  std::vector<std::string> paths;
+  std::unique_ptr<DIR, decltype(closedir)*> d(opendir(dir.c_str()), closedir);
+  while (struct dirent* entry = readdir(d.get())) {
+    if (util::EndsWith(entry->d_name, extension)) {
+      std::string path = dir;
+      file::AppendPath(&path, entry->d_name);
+      paths.push_back(std::move(path));
+    }
+  }
+  return paths;
+}
+
+TEST_F(LinkCacheTest, FindsLinkedFiles) {
+  LinkCache cache(GetTestDirectory().to_string(), Fingerprint().Update("symbols"));
+  const std::string key = "layout/main";
+
+  std::vector<LinkedFile> files;
+  EXPECT_FALSE(cache.Find(key, "compiled xml", &files));
+  cache.Put(key, "compiled xml", MakeLinkedFiles());
+
+  ASSERT_TRUE(cache.Find(key, "compiled xml", &files));
+  ASSERT_THAT(files, SizeIs(2u));
+  EXPECT_THAT(files[0].config, Eq(android::ConfigDescription::DefaultConfig()));
+  EXPECT_THAT(files[0].path, Eq("res/layout/main.xml"));
+  EXPECT_THAT(files[0].compression_flags, Eq(1u));
+  EXPECT_THAT(files[0].data, Eq("layout"));
+  EXPECT_THAT(files[1].config, Eq(test::ParseConfigOrDie("v21")));
+  EXPECT_THAT(files[1].path, Eq("res/layout-v21/main.xml"));
+  EXPECT_THAT(files[1].compression_flags, Eq(0u));
+  EXPECT_THAT(files[1].data, Eq(std::string("layout\0v21", 10)));
+
+  EXPECT_THAT(cache.hits(), Eq(1u));
+  EXPECT_THAT(cache.misses(), Eq(1u));
+}
+
+TEST_F(LinkCacheTest, IgnoresEntriesOfOtherInputs) {
+  LinkCache cache(GetTestDirectory().to_string(), Fingerprint().Update("symbols"));
+  const std::string key = "layout/main";
+  cache.Put(key, "compiled xml", MakeLinkedFiles());
+
+  std::vector<LinkedFile> files;
+  EXPECT_FALSE(cache.Find(key, "compiled xmm", &files));
+  EXPECT_FALSE(cache.Find("layout/other", "compiled xml", &files));
+
+  // A change to the symbols invalidates every entry.
+  LinkCache changed_cache(GetTestDirectory().to_string(), Fingerprint().Update("symbols2"));
+  EXPECT_FALSE(changed_cache.Find(key, "compiled xml", &files));
+  EXPECT_THAT(files, SizeIs(0u));
+}
+
+TEST_F(LinkCacheTest, RejectsEntriesOfOtherKeys) {
+  const std::string dir = GetTestDirectory().to_string();
+  LinkCache cache(dir, Fingerprint().Update("symbols"));
+  cache.Put("layout/a", "compiled xml", MakeLinkedFiles());
+  std::vector<std::string> paths = ListFiles(dir, ".lnk");
+  ASSERT_THAT(paths, SizeIs(1u));
+  std::string entry_a;
+  ASSERT_TRUE(android::base::ReadFileToString(paths[0], &entry_a));
+
+  // Make the entry of layout/b hold the one of layout/a, as if their names collided.
+  cache.Put("layout/b", "compiled xml", MakeLinkedFiles());
+  paths = ListFiles(dir, ".lnk");
+  ASSERT_THAT(paths, SizeIs(2u));
+  for (const std::string& path : paths) {
+    ASSERT_TRUE(android::base::WriteStringToFile(entry_a, path));
+  }
+
+  std::vector<LinkedFile> files;
+  EXPECT_TRUE(cache.Find("layout/a", "compiled xml", &files));
+  EXPECT_FALSE(cache.Find("layout/b", "compiled xml", &files));
+}
+
+TEST_F(LinkCacheTest, PrunesLeastRecentlyUsedEntries) {
+  const std::string dir = GetTestDirectory().to_string();
+  LinkCache cache(dir, Fingerprint().Update("symbols"));
+  cache.Put("layout/a", "compiled xml", MakeLinkedFiles());
+  cache.Put("layout/b", "compiled xml", MakeLinkedFiles());
+  std::vector<std::string> paths = ListFiles(dir, ".lnk");
+  ASSERT_THAT(paths, SizeIs(2u));
+  struct stat entry_stat;
+  ASSERT_THAT(stat(paths[0].c_str(), &entry_stat), Eq(0));
+
+  // Both entries were last used a day ago, and a link that did not finish left a file behind.
+  const std::string temp_path = paths[0] + ".1-0.tmp";
+  ASSERT_TRUE(android::base::WriteStringToFile("partial entry", temp_path));
+  const time_t day_ago = time(nullptr) - 24 * 60 * 60;
+  const struct utimbuf times = {day_ago, day_ago};
+  for (const std::string& path : {paths[0], paths[1], temp_path}) {
+    ASSERT_THAT(utime(path.c_str(), &times), Eq(0));
+  }
+
+  // Using layout/b makes layout/a the least recently used entry.
+  std::vector<LinkedFile> files;
+  ASSERT_TRUE(cache.Find("layout/b", "compiled xml", &files));
+  cache.Prune(2 * entry_stat.st_size);
+  EXPECT_THAT(ListFiles(dir, ".lnk"), SizeIs(2u));
+  EXPECT_THAT(ListFiles(dir, ".tmp"), SizeIs(0u));
+
+  cache.Prune(entry_stat.st_size);
+  EXPECT_THAT(ListFiles(dir, ".lnk"), SizeIs(1u));
+  EXPECT_TRUE(cache.Find("layout/b", "compiled xml", &files));
+  EXPECT_FALSE(cache.Find("layout/a", "compiled xml", &files));
+}
+
+}  // namespace aapt
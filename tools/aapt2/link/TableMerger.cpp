@@ -241,17 +241,34 @@ bool TableMerger::DoMerge(const Source& src, ResourceTablePackage* src_package,
       continue;
     }
 
+    std::vector<std::string> entry_names;
+    entry_names.reserve(src_type->entries.size());
     for (auto& src_entry : src_type->entries) {
-      std::string entry_name = src_entry->name;
       if (mangle_package) {
-        entry_name = NameMangler::MangleEntry(src_package->name, src_entry->name);
+        entry_names.push_back(NameMangler::MangleEntry(src_package->name, src_entry->name));
+      } else {
+        entry_names.push_back(src_entry->name);
       }
+    }
+
+    // Create the new entries all at once, as a library may add thousands of entries to a type
+    // that already has thousands.
+    std::vector<StringPiece> new_entry_names;
+    for (size_t i = 0; i < src_type->entries.size(); i++) {
+      if (allow_new_resources || src_type->entries[i]->allow_new) {
+        new_entry_names.push_back(entry_names[i]);
+      }
+    }
+    std::vector<ResourceEntry*> new_entries = dst_type->FindOrCreateEntries(new_entry_names);
+    auto new_entry_iter = new_entries.begin();
 
+    for (size_t i = 0; i < src_type->entries.size(); i++) {
+      const std::unique_ptr<ResourceEntry>& src_entry = src_type->entries[i];
       ResourceEntry* dst_entry;
       if (allow_new_resources || src_entry->allow_new) {
-        dst_entry = dst_type->FindOrCreateEntry(entry_name);
+        dst_entry = *new_entry_iter++;
       } else {
-        dst_entry = dst_type->FindEntry(entry_name);
+        dst_entry = dst_type->FindEntry(entry_names[i]);
       }
 
       const ResourceNameRef res_name(src_package->name, src_type->type, src_entry->name);
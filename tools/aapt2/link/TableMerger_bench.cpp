@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "link/TableMerger.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+
+#include "test/Builders.h"
+#include "test/Context.h"
+
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+// The libraries of a large app, which together define 200k resources.
+constexpr size_t kLibraryCount = 100u;
+constexpr size_t kEntriesPerType = 500u;
+constexpr const char* kTypes[] = {"drawable", "id", "layout", "string"};
+
+// The libraries use similar names, so their entries are interleaved in the merged table.
+static const std::vector<std::unique_ptr<ResourceTable>>& GetLibraries(
+    const std::string& package) {
+  static std::map<std::string, std::vector<std::unique_ptr<ResourceTable>>> libraries;
+  std::vector<std::unique_ptr<ResourceTable>>& tables = libraries[package];
+  if (tables.empty()) {
+    for (size_t lib = 0; lib < kLibraryCount; lib++) {
+      const std::string lib_package =
+          package.empty() ? StringPrintf("com.lib%zu", lib) : package;
+      test::ResourceTableBuilder builder;
+      for (const char* type : kTypes) {
+        for (size_t i = 0; i < kEntriesPerType; i++) {
+          builder.AddSimple(
+              StringPrintf("%s:%s/res_%04zu_lib%03zu", lib_package.c_str(), type, i, lib));
+        }
+      }
+      tables.push_back(builder.Build());
+    }
+  }
+  return tables;
+}
+
+// Libraries compiled into the package of the app, as most are.
+static void BM_MergeLibraries(benchmark::State& state) {
+  const std::vector<std::unique_ptr<ResourceTable>>& libraries = GetLibraries("com.app");
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app").SetPackageId(0x7f).Build();
+  for (auto _ : state) {
+    ResourceTable table;
+    TableMerger merger(context.get(), &table, TableMergerOptions{});
+    for (const std::unique_ptr<ResourceTable>& library : libraries) {
+      CHECK(merger.Merge({}, library.get(), false /*overlay*/));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kLibraryCount * arraysize(kTypes) *
+                          kEntriesPerType);
+}
+BENCHMARK(BM_MergeLibraries)->Unit(benchmark::kMillisecond);
+
+// Libraries with packages of their own, whose entries are mangled into the package of the app.
+static void BM_MergeAndMangleLibraries(benchmark::State& state) {
+  const std::vector<std::unique_ptr<ResourceTable>>& libraries = GetLibraries("");
+  std::unique_ptr<IAaptContext> context =
+      test::ContextBuilder().SetCompilationPackage("com.app").SetPackageId(0x7f).Build();
+  for (auto _ : state) {
+    ResourceTable table;
+    TableMerger merger(context.get(), &table, TableMergerOptions{});
+    for (size_t lib = 0; lib < libraries.size(); lib++) {
+      CHECK(merger.MergeAndMangle({}, StringPrintf("com.lib%zu", lib), libraries[lib].get()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kLibraryCount * arraysize(kTypes) *
+                          kEntriesPerType);
+}
+BENCHMARK(BM_MergeAndMangleLibraries)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
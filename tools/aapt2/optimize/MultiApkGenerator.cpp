@@ -17,6 +17,7 @@
 #include "MultiApkGenerator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <regex>
 #include <string>
 
@@ -36,6 +37,7 @@
 #include "process/IResourceTableConsumer.h"
 #include "split/TableSplitter.h"
 #include "util/Files.h"
+#include "util/ThreadPool.h"
 #include "xml/XmlDom.h"
 #include "xml/XmlUtil.h"
 
@@ -54,7 +56,9 @@ using ::android::StringPiece;
 class ContextWrapper : public IAaptContext {
  public:
   explicit ContextWrapper(IAaptContext* context)
-      : context_(context), min_sdk_(context_->GetMinSdkVersion()) {
+      : context_(context),
+        diag_(context->GetDiagnostics()),
+        min_sdk_(context_->GetMinSdkVersion()) {
   }
 
   PackageType GetPackageType() override {
@@ -69,7 +73,7 @@ class ContextWrapper : public IAaptContext {
     if (source_diag_) {
       return source_diag_.get();
     }
-    return context_->GetDiagnostics();
+    return diag_;
   }
 
   const std::string& GetCompilationPackage() override {
@@ -96,9 +100,13 @@ class ContextWrapper : public IAaptContext {
     min_sdk_ = min_sdk;
   }
 
+  // Logs to diag instead of the diagnostics of the wrapped context.
+  void SetDiagnostics(IDiagnostics* diag) {
+    diag_ = diag;
+  }
+
   void SetSource(const std::string& source) {
-    source_diag_ =
-        util::make_unique<SourcePathDiagnostics>(Source{source}, context_->GetDiagnostics());
+    source_diag_ = util::make_unique<SourcePathDiagnostics>(Source{source}, diag_);
   }
 
   const std::set<std::string>& GetSplitNameDependencies() override {
@@ -107,6 +115,7 @@ class ContextWrapper : public IAaptContext {
 
  private:
   IAaptContext* context_;
+  IDiagnostics* diag_;
   std::unique_ptr<SourcePathDiagnostics> source_diag_;
 
   int min_sdk_ = -1;
@@ -130,14 +139,9 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
   std::unordered_set<std::string> artifacts_to_keep = options.kept_artifacts;
   std::unordered_set<std::string> filtered_artifacts;
   std::unordered_set<std::string> kept_artifacts;
+  std::vector<const OutputArtifact*> artifacts;
 
-  // For now, just write out the stripped APK since ABI splitting doesn't modify anything else.
   for (const OutputArtifact& artifact : options.apk_artifacts) {
-    FilterChain filters;
-
-    ContextWrapper wrapped_context{context_};
-    wrapped_context.SetSource(artifact.name);
-
     if (!options.kept_artifacts.empty()) {
       const auto& it = artifacts_to_keep.find(artifact.name);
       if (it == artifacts_to_keep.end()) {
@@ -151,40 +155,53 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
         kept_artifacts.insert(artifact.name);
       }
     }
+    artifacts.push_back(&artifact);
+  }
 
-    std::unique_ptr<ResourceTable> table =
-        FilterTable(context_, artifact, *apk_->GetResourceTable(), &filters);
-    if (!table) {
-      return false;
-    }
-
-    IDiagnostics* diag = wrapped_context.GetDiagnostics();
-
-    std::unique_ptr<XmlResource> manifest;
-    if (!UpdateManifest(artifact, &manifest, diag)) {
-      diag->Error(DiagMessage() << "could not update AndroidManifest.xml for output artifact");
-      return false;
-    }
+  if (!artifacts.empty() && !file::mkdirs(options.out_dir)) {
+    context_->GetDiagnostics()->Warn(DiagMessage() << "could not create out dir: "
+                                                   << options.out_dir);
+  }
 
-    std::string out = options.out_dir;
-    if (!file::mkdirs(out)) {
-      diag->Warn(DiagMessage() << "could not create out dir: " << out);
+  if (options.jobs == 1 || artifacts.size() <= 1) {
+    for (const OutputArtifact* artifact : artifacts) {
+      if (!GenerateArtifact(*artifact, options, context_->GetDiagnostics())) {
+        return false;
+      }
     }
-    file::AppendPath(&out, artifact.name);
-
-    if (context_->IsVerbose()) {
-      diag->Note(DiagMessage() << "Generating split: " << out);
+  } else {
+    // Every artifact is filtered from its own copy of the base table and written to its own APK,
+    // so the artifacts are generated concurrently. They copy the entries of the one base APK,
+    // which LoadedApk opens one at a time. Each artifact in progress holds a copy of the table,
+    // so the number of jobs also bounds the memory used. The diagnostics of each artifact
+    // are logged in the order of the artifacts once all of them are done.
+    struct ArtifactResult {
+      BufferedDiagnostics diag;
+      bool success = false;
+    };
+    std::vector<ArtifactResult> results(artifacts.size());
+    std::atomic<bool> failed(false);
+    {
+      ThreadPool pool(std::min(options.jobs, artifacts.size()));
+      for (size_t i = 0; i < artifacts.size(); i++) {
+        pool.Schedule([this, &options, &artifacts, &results, &failed, i] {
+          // Do not start new artifacts once one has failed, as the serial path would stop.
+          if (failed) {
+            return;
+          }
+          results[i].success = GenerateArtifact(*artifacts[i], options, &results[i].diag);
+          if (!results[i].success) {
+            failed = true;
+          }
+        });
+      }
+      pool.Wait();
     }
 
-    std::unique_ptr<IArchiveWriter> writer = CreateZipFileArchiveWriter(diag, out);
-
-    if (context_->IsVerbose()) {
-      diag->Note(DiagMessage() << "Writing output: " << out);
+    for (ArtifactResult& result : results) {
+      result.diag.FlushTo(context_->GetDiagnostics());
     }
-
-    filters.AddFilter(util::make_unique<SignatureFilter>());
-    if (!apk_->WriteToArchive(&wrapped_context, table.get(), options.table_flattener_options,
-                              &filters, writer.get(), manifest.get())) {
+    if (failed) {
       return false;
     }
   }
@@ -216,6 +233,50 @@ bool MultiApkGenerator::FromBaseApk(const MultiApkGeneratorOptions& options) {
   return true;
 }
 
+bool MultiApkGenerator::GenerateArtifact(const OutputArtifact& artifact,
+                                         const MultiApkGeneratorOptions& options,
+                                         IDiagnostics* diag) {
+  FilterChain filters;
+
+  ContextWrapper artifact_context{context_};
+  artifact_context.SetDiagnostics(diag);
+
+  ContextWrapper wrapped_context{&artifact_context};
+  wrapped_context.SetSource(artifact.name);
+
+  std::unique_ptr<ResourceTable> table =
+      FilterTable(&artifact_context, artifact, *apk_->GetResourceTable(), &filters);
+  if (!table) {
+    return false;
+  }
+
+  IDiagnostics* artifact_diag = wrapped_context.GetDiagnostics();
+
+  std::unique_ptr<XmlResource> manifest;
+  if (!UpdateManifest(artifact, &manifest, artifact_diag)) {
+    artifact_diag->Error(DiagMessage()
+                         << "could not update AndroidManifest.xml for output artifact");
+    return false;
+  }
+
+  std::string out = options.out_dir;
+  file::AppendPath(&out, artifact.name);
+
+  if (context_->IsVerbose()) {
+    artifact_diag->Note(DiagMessage() << "Generating split: " << out);
+  }
+
+  std::unique_ptr<IArchiveWriter> writer = CreateZipFileArchiveWriter(artifact_diag, out);
+
+  if (context_->IsVerbose()) {
+    artifact_diag->Note(DiagMessage() << "Writing output: " << out);
+  }
+
+  filters.AddFilter(util::make_unique<SignatureFilter>());
+  return apk_->WriteToArchive(&wrapped_context, table.get(), options.table_flattener_options,
+                              &filters, writer.get(), manifest.get());
+}
+
 std::unique_ptr<ResourceTable> MultiApkGenerator::FilterTable(IAaptContext* context,
                                                               const OutputArtifact& artifact,
                                                               const ResourceTable& old_table,
@@ -35,6 +35,9 @@ struct MultiApkGeneratorOptions {
   std::vector<configuration::OutputArtifact> apk_artifacts;
   TableFlattenerOptions table_flattener_options;
   std::unordered_set<std::string> kept_artifacts;
+
+  // The number of artifacts to generate at once.
+  size_t jobs = 1;
 };
 
 /**
@@ -62,6 +65,12 @@ class MultiApkGenerator {
     return context_->GetDiagnostics();
   }
 
+  /**
+   * Filters the base APK for the artifact and writes it to the output directory, logging to diag.
+   */
+  bool GenerateArtifact(const configuration::OutputArtifact& artifact,
+                        const MultiApkGeneratorOptions& options, IDiagnostics* diag);
+
   bool UpdateManifest(const configuration::OutputArtifact& artifact,
                       std::unique_ptr<xml::XmlResource>* updated_manifest, IDiagnostics* diag);
 
@@ -17,10 +17,13 @@
 #include "optimize/ResourceDeduper.h"
 
 #include <algorithm>
+#include <unordered_map>
 
 #include "DominatorTree.h"
 #include "ResourceTable.h"
+#include "ValueVisitor.h"
 #include "trace/TraceBuffer.h"
+#include "util/Fingerprint.h"
 
 using android::ConfigDescription;
 
@@ -28,6 +31,142 @@ namespace aapt {
 
 namespace {
 
+/**
+ * Computes a hash of a value such that values that are Equals() have the same hash. Parts of a
+ * value that are expensive to hash, and that rarely tell values apart, are left out.
+ */
+class ValueHasher : public ConstValueVisitor {
+ public:
+  static uint64_t Hash(const Value* value) {
+    ValueHasher hasher;
+    value->Accept(&hasher);
+    return hasher.fingerprint_.value();
+  }
+
+  void Visit(const Reference* ref) override {
+    Tag(kReference);
+    HashReference(*ref);
+  }
+
+  void Visit(const RawString* str) override {
+    Tag(kRawString);
+    fingerprint_.Update(*str->value);
+  }
+
+  void Visit(const String* str) override {
+    Tag(kString);
+    fingerprint_.Update(*str->value);
+  }
+
+  void Visit(const StyledString* str) override {
+    Tag(kStyledString);
+    fingerprint_.Update(str->value->value);
+  }
+
+  void Visit(const FileReference* file) override {
+    Tag(kFileReference);
+    fingerprint_.Update(*file->path);
+  }
+
+  void Visit(const Id* /*id*/) override {
+    Tag(kId);
+  }
+
+  void Visit(const BinaryPrimitive* prim) override {
+    Tag(kBinaryPrimitive);
+    fingerprint_.Update(prim->value.dataType);
+    fingerprint_.Update(prim->value.data);
+  }
+
+  void Visit(const Attribute* attr) override {
+    Tag(kAttribute);
+    fingerprint_.Update(attr->type_mask);
+    fingerprint_.Update(static_cast<uint64_t>(attr->min_int));
+    fingerprint_.Update(static_cast<uint64_t>(attr->max_int));
+    fingerprint_.Update(attr->symbols.size());
+  }
+
+  void Visit(const Style* style) override {
+    Tag(kStyle);
+    if (style->parent) {
+      HashReference(style->parent.value());
+    }
+
+    // Styles are equal regardless of the order of their entries, so their hashes are summed.
+    uint64_t entries = 0;
+    for (const Style::Entry& entry : style->entries) {
+      entries += Fingerprint().Update(Hash(&entry.key)).Update(Hash(entry.value.get())).value();
+    }
+    fingerprint_.Update(style->entries.size());
+    fingerprint_.Update(entries);
+  }
+
+  void Visit(const Array* array) override {
+    Tag(kArray);
+    fingerprint_.Update(array->elements.size());
+    for (const std::unique_ptr<Item>& element : array->elements) {
+      element->Accept(this);
+    }
+  }
+
+  void Visit(const Plural* plural) override {
+    Tag(kPlural);
+    for (const std::unique_ptr<Item>& item : plural->values) {
+      if (item) {
+        item->Accept(this);
+      } else {
+        Tag(kNone);
+      }
+    }
+  }
+
+  void Visit(const Styleable* styleable) override {
+    Tag(kStyleable);
+    fingerprint_.Update(styleable->entries.size());
+    for (const Reference& ref : styleable->entries) {
+      HashReference(ref);
+    }
+  }
+
+ private:
+  enum Kind : uint64_t {
+    kNone,
+    kReference,
+    kRawString,
+    kString,
+    kStyledString,
+    kFileReference,
+    kId,
+    kBinaryPrimitive,
+    kAttribute,
+    kStyle,
+    kArray,
+    kPlural,
+    kStyleable,
+  };
+
+  void Tag(Kind kind) {
+    fingerprint_.Update(kind);
+  }
+
+  void HashReference(const Reference& ref) {
+    fingerprint_.Update(static_cast<uint64_t>(ref.reference_type));
+    fingerprint_.Update(ref.private_reference);
+    if (ref.id) {
+      fingerprint_.Update(ref.id.value().id);
+    } else {
+      Tag(kNone);
+    }
+    if (ref.name) {
+      fingerprint_.Update(std::hash<ResourceName>()(ref.name.value()));
+    } else {
+      Tag(kNone);
+    }
+  }
+
+  Fingerprint fingerprint_;
+};
+
 /**
  * Remove duplicated key-value entries from dominated resources.
  *
@@ -44,7 +183,14 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
   using Node = DominatorTree::Node;
 
   explicit DominatedKeyValueRemover(IAaptContext* context, ResourceEntry* entry)
-      : context_(context), entry_(entry) {}
+      : context_(context), entry_(entry) {
+    hashes_.reserve(entry->values.size());
+    for (const std::unique_ptr<ResourceConfigValue>& config_value : entry->values) {
+      if (config_value->value) {
+        hashes_[config_value.get()] = ValueHasher::Hash(config_value->value.get());
+      }
+    }
+  }
 
   void VisitConfig(Node* node) {
     Node* parent = node->parent();
@@ -56,7 +202,7 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
     if (!node_value || !parent_value) {
       return;
     }
-    if (!node_value->value->Equals(parent_value->value.get())) {
+    if (!ValuesEqual(node_value, parent_value)) {
       return;
     }
 
@@ -70,7 +216,7 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
         continue;
       }
       if (node_configuration.IsCompatibleWith(sibling_value->config) &&
-          !node_value->value->Equals(sibling_value->value.get())) {
+          !ValuesEqual(node_value, sibling_value)) {
         // The configurations are compatible, but the value is
         // different, so we can't remove this value.
         return;
@@ -90,8 +236,15 @@ class DominatedKeyValueRemover : public DominatorTree::BottomUpVisitor {
  private:
   DISALLOW_COPY_AND_ASSIGN(DominatedKeyValueRemover);
 
+  // Most values of an entry differ, and differing values almost always have different hashes, so
+  // the values are only compared when their hashes match.
+  bool ValuesEqual(ResourceConfigValue* a, ResourceConfigValue* b) {
+    return hashes_[a] == hashes_[b] && a->value->Equals(b->value.get());
+  }
+
   IAaptContext* context_;
   ResourceEntry* entry_;
+  std::unordered_map<const ResourceConfigValue*, uint64_t> hashes_;
 };
 
 static void DedupeEntry(IAaptContext* context, ResourceEntry* entry) {
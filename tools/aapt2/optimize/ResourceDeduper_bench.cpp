@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "optimize/ResourceDeduper.h"
+
+#include <string>
+#include <vector>
+
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+
+#include "test/Builders.h"
+#include "test/Context.h"
+
+using ::android::ConfigDescription;
+using ::android::base::StringPrintf;
+
+namespace aapt {
+
+// The strings of a heavily localized app.
+constexpr size_t kStringCount = 20000u;
+constexpr size_t kLocaleCount = 100u;
+
+// Every tenth locale also has a -v21 variant, which repeats the translation and is deduped.
+constexpr size_t kVersionedLocaleStride = 10u;
+
+static const ResourceTable& GetTable() {
+  static const std::unique_ptr<ResourceTable> table = [] {
+    std::vector<ConfigDescription> locales;
+    std::vector<ConfigDescription> versioned_locales;
+    for (size_t i = 0; i < kLocaleCount; i++) {
+      const std::string language = StringPrintf("%c%c", 'b' + static_cast<char>(i / 26),
+                                                'a' + static_cast<char>(i % 26));
+      locales.push_back(test::ParseConfigOrDie(language));
+      versioned_locales.push_back(test::ParseConfigOrDie(language + "-v21"));
+    }
+
+    test::ResourceTableBuilder builder;
+    for (size_t i = 0; i < kStringCount; i++) {
+      const std::string name = StringPrintf("android:string/string_%05zu", i);
+      builder.AddString(name, ResourceId{}, {}, StringPrintf("String %zu", i));
+      for (size_t l = 0; l < kLocaleCount; l++) {
+        const std::string translation = StringPrintf("String %zu in locale %zu", i, l);
+        builder.AddString(name, ResourceId{}, locales[l], translation);
+        if (l % kVersionedLocaleStride == 0) {
+          builder.AddString(name, ResourceId{}, versioned_locales[l], translation);
+        }
+      }
+    }
+    return builder.Build();
+  }();
+  return *table;
+}
+
+static void BM_DedupeLocalizedStrings(benchmark::State& state) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  for (auto _ : state) {
+    state.PauseTiming();
+    std::unique_ptr<ResourceTable> table = GetTable().Clone();
+    state.ResumeTiming();
+
+    CHECK(ResourceDeduper().Consume(context.get(), table.get()));
+
+    state.PauseTiming();
+    table.reset();
+    state.ResumeTiming();
+  }
+  state.SetItemsProcessed(state.iterations() * kStringCount);
+}
+BENCHMARK(BM_DedupeLocalizedStrings)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
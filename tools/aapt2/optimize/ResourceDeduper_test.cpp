@@ -17,6 +17,7 @@
 #include "optimize/ResourceDeduper.h"
 
 #include "ResourceTable.h"
+#include "ResourceUtils.h"
 #include "test/Test.h"
 
 using ::aapt::test::HasValue;
@@ -151,4 +152,40 @@ TEST(ResourceDeduperTest, LocalesValuesAreKept) {
   EXPECT_THAT(table, HasValue("android:string/keep", fr_rCA_config));
 }
 
+TEST(ResourceDeduperTest, StylesWithEntriesInAnotherOrderAreDeduped) {
+  std::unique_ptr<IAaptContext> context = test::ContextBuilder().Build();
+  const ConfigDescription default_config = {};
+  const ConfigDescription ldrtl_config = test::ParseConfigOrDie("ldrtl");
+
+  std::unique_ptr<ResourceTable> table =
+      test::ResourceTableBuilder()
+          .AddValue("android:style/Dedupe", default_config, ResourceId{},
+                    test::StyleBuilder()
+                        .AddItem("android:attr/bar", ResourceUtils::TryParseInt("2"))
+                        .AddItem("android:attr/foo", ResourceUtils::TryParseInt("1"))
+                        .Build())
+          .AddValue("android:style/Dedupe", ldrtl_config, ResourceId{},
+                    test::StyleBuilder()
+                        .AddItem("android:attr/foo", ResourceUtils::TryParseInt("1"))
+                        .AddItem("android:attr/bar", ResourceUtils::TryParseInt("2"))
+                        .Build())
+          .AddValue("android:style/Keep", default_config, ResourceId{},
+                    test::StyleBuilder()
+                        .AddItem("android:attr/bar", ResourceUtils::TryParseInt("2"))
+                        .AddItem("android:attr/foo", ResourceUtils::TryParseInt("1"))
+                        .Build())
+          .AddValue("android:style/Keep", ldrtl_config, ResourceId{},
+                    test::StyleBuilder()
+                        .AddItem("android:attr/bar", ResourceUtils::TryParseInt("1"))
+                        .AddItem("android:attr/foo", ResourceUtils::TryParseInt("2"))
+                        .Build())
+          .Build();
+
+  ASSERT_TRUE(ResourceDeduper().Consume(context.get(), table.get()));
+  EXPECT_THAT(table, HasValue("android:style/Dedupe", default_config));
+  EXPECT_THAT(table, Not(HasValue("android:style/Dedupe", ldrtl_config)));
+  EXPECT_THAT(table, HasValue("android:style/Keep", default_config));
+  EXPECT_THAT(table, HasValue("android:style/Keep", ldrtl_config));
+}
+
 }  // namespace aapt
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "process/IncludeCache.h"
+
+#include <algorithm>
+
+#include "io/ZipArchive.h"
+#include "trace/TraceBuffer.h"
+#include "util/Files.h"
+#include "util/Fingerprint.h"
+
+using ::android::ApkAssets;
+
+namespace aapt {
+
+namespace {
+
+// The end of central directory record of a ZIP file.
+constexpr uint32_t kEocdSignature = 0x06054b50u;
+constexpr size_t kEocdSize = 22u;
+constexpr size_t kMaxCommentSize = 0xffffu;
+
+uint32_t ReadLe32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) | static_cast<uint32_t>(data[1]) << 8 |
+         static_cast<uint32_t>(data[2]) << 16 | static_cast<uint32_t>(data[3]) << 24;
+}
+
+}  // namespace
+
+bool StampFile(const std::string& path, uint64_t* out_stamp, std::string* out_error) {
+  Maybe<android::FileMap> map = file::MmapPath(path, out_error);
+  if (!map) {
+    return false;
+  }
+
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(map.value().getDataPtr());
+  const size_t size = map.value().getDataLength();
+  Fingerprint fingerprint;
+  fingerprint.Update(static_cast<uint64_t>(size));
+
+  if (size >= kEocdSize) {
+    const size_t min_eocd = size - kEocdSize - std::min(size - kEocdSize, kMaxCommentSize);
+    for (size_t eocd = size - kEocdSize + 1; eocd-- > min_eocd;) {
+      if (ReadLe32(data + eocd) != kEocdSignature) {
+        continue;
+      }
+      const size_t cd_size = ReadLe32(data + eocd + 12);
+      const size_t cd_offset = ReadLe32(data + eocd + 16);
+      if (cd_offset <= eocd && cd_size <= eocd - cd_offset) {
+        fingerprint.Update(data + cd_offset, cd_size).Update(data + eocd, size - eocd);
+        *out_stamp = fingerprint.value();
+        return true;
+      }
+    }
+  }
+
+  // Not a ZIP file we can read the central directory of, so use all of it.
+  fingerprint.Update(data, size);
+  *out_stamp = fingerprint.value();
+  return true;
+}
+
+bool LoadIncludedApk(const std::string& path, IDiagnostics* diag, IncludedApk* out_apk) {
+  TRACE_CALL();
+  std::string error;
+  auto zip_collection = io::ZipFileCollection::Create(path, &error);
+  if (zip_collection == nullptr) {
+    diag->Error(DiagMessage() << "failed to open APK: " << error);
+    return false;
+  }
+
+  if (zip_collection->FindFile(kProtoResourceTablePath) != nullptr) {
+    // Load this as a static library include.
+    std::unique_ptr<LoadedApk> static_apk = LoadedApk::LoadProtoApkFromFileCollection(
+        Source(path), std::move(zip_collection), diag);
+    if (static_apk == nullptr) {
+      return false;
+    }
+    out_apk->static_library = std::move(static_apk);
+    out_apk->apk_assets = {};
+    out_apk->apk_assets_index = {};
+    return true;
+  }
+
+  std::unique_ptr<const ApkAssets> apk_assets = ApkAssets::Load(path);
+  if (apk_assets == nullptr) {
+    diag->Error(DiagMessage() << "failed to load include path " << path);
+    return false;
+  }
+  out_apk->static_library = {};
+  out_apk->apk_assets = std::move(apk_assets);
+  out_apk->apk_assets_index = {};
+  return true;
+}
+
+bool IncludeCache::Load(const std::string& path, IDiagnostics* diag, IncludedApk* out_apk) {
+  TRACE_CALL();
+  uint64_t stamp;
+  std::string error;
+  if (!StampFile(path, &stamp, &error)) {
+    diag->Error(DiagMessage(path) << "failed to read: " << error);
+    return false;
+  }
+
+  auto iter = entries_.find(path);
+  if (iter != entries_.end() && iter->second.stamp == stamp) {
+    hits_++;
+    *out_apk = iter->second.apk;
+    return true;
+  }
+
+  misses_++;
+  if (iter != entries_.end()) {
+    entries_.erase(iter);
+  }
+  if (!LoadIncludedApk(path, diag, out_apk)) {
+    return false;
+  }
+  if (out_apk->apk_assets != nullptr) {
+    // Built once here, so that every link including the APK shares the index.
+    out_apk->apk_assets_index = ApkAssetsIndex::Create(*out_apk->apk_assets);
+  }
+  entries_[path] = Entry{stamp, *out_apk};
+  return true;
+}
+
+}  // namespace aapt
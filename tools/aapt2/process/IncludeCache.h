@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_PROCESS_INCLUDECACHE_H
+#define AAPT_PROCESS_INCLUDECACHE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "android-base/macros.h"
+#include "androidfw/ApkAssets.h"
+
+#include "Diagnostics.h"
+#include "LoadedApk.h"
+#include "process/SymbolTable.h"
+
+namespace aapt {
+
+// An APK passed to aapt2 link with -I.
+struct IncludedApk {
+  // Set when the APK is a static library. Its resource table must not be modified, since it may
+  // be shared with other links.
+  std::shared_ptr<LoadedApk> static_library;
+
+  // Set otherwise.
+  std::shared_ptr<const android::ApkAssets> apk_assets;
+
+  // The index of `apk_assets` when it is shared with other links, or null if it is built by the
+  // symbol source that the APK assets are added to.
+  std::shared_ptr<const ApkAssetsIndex> apk_assets_index;
+};
+
+// Identifies the contents of the file at `path`. For a ZIP file, this only reads its size and
+// central directory, which holds the size and CRC-32 of every entry.
+bool StampFile(const std::string& path, uint64_t* out_stamp, std::string* out_error);
+
+// Loads the APK at `path` as a static library if it contains a proto resource table, or as
+// ApkAssets otherwise.
+bool LoadIncludedApk(const std::string& path, IDiagnostics* diag, IncludedApk* out_apk);
+
+// Keeps included APKs loaded between the links run by one process, such as aapt2 daemon, along
+// with the symbol index of the APK assets. An APK is loaded again when the size or the central
+// directory of the file changes, which holds the size and CRC-32 of every entry.
+class IncludeCache {
+ public:
+  IncludeCache() = default;
+
+  // Loads the APK at `path`, or returns the one loaded by an earlier call if the file is unchanged.
+  bool Load(const std::string& path, IDiagnostics* diag, IncludedApk* out_apk);
+
+  size_t hits() const {
+    return hits_;
+  }
+
+  size_t misses() const {
+    return misses_;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(IncludeCache);
+
+  struct Entry {
+    uint64_t stamp;
+    IncludedApk apk;
+  };
+
+  std::unordered_map<std::string, Entry> entries_;
+  size_t hits_ = 0;
+  size_t misses_ = 0;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_PROCESS_INCLUDECACHE_H
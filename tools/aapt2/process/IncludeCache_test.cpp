@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "process/IncludeCache.h"
+
+#include "android-base/file.h"
+
+#include "cmd/Link.h"
+#include "test/Fixture.h"
+#include "test/Test.h"
+#include "util/Files.h"
+
+using ::testing::Eq;
+using ::testing::IsNull;
+using ::testing::NotNull;
+
+namespace aapt {
+
+using IncludeCacheTest = CommandTestFixture;
+
+static std::string ReadAndroidJar() {
+  std::string contents;
+  CHECK(android::base::ReadFileToString(
+      file::BuildPath({android::base::GetExecutableDirectory(), "integration-tests",
+                       "CommandTests", "android-28.jar"}),
+      &contents));
+  return contents;
+}
+
+TEST_F(IncludeCacheTest, ReusesUnchangedApk) {
+  const std::string include_path = GetTestPath("android.jar");
+  WriteFile(include_path, ReadAndroidJar());
+
+  IncludeCache cache;
+  IncludedApk first;
+  ASSERT_TRUE(cache.Load(include_path, test::GetDiagnostics(), &first));
+  ASSERT_THAT(first.apk_assets, NotNull());
+  EXPECT_THAT(first.static_library, IsNull());
+
+  IncludedApk second;
+  ASSERT_TRUE(cache.Load(include_path, test::GetDiagnostics(), &second));
+  EXPECT_THAT(second.apk_assets.get(), Eq(first.apk_assets.get()));
+  ASSERT_THAT(first.apk_assets_index, NotNull());
+  EXPECT_THAT(second.apk_assets_index.get(), Eq(first.apk_assets_index.get()));
+  EXPECT_THAT(cache.hits(), Eq(1u));
+  EXPECT_THAT(cache.misses(), Eq(1u));
+
+  // Symbol sources sharing the index find the same symbols.
+  AssetManagerSymbolSource sources[2];
+  sources[0].AddApkAssets(first.apk_assets, first.apk_assets_index);
+  sources[1].AddApkAssets(second.apk_assets, second.apk_assets_index);
+  for (AssetManagerSymbolSource& source : sources) {
+    std::unique_ptr<SymbolTable::Symbol> symbol =
+        source.FindByName(test::ParseNameOrDie("android:attr/layout_width"));
+    ASSERT_THAT(symbol, NotNull());
+    EXPECT_THAT(symbol->id, Eq(Maybe<ResourceId>(ResourceId(0x010100f4))));
+    EXPECT_TRUE(symbol->is_public);
+    EXPECT_THAT(source.FindById(ResourceId(0x0104000a)), NotNull());
+  }
+}
+
+TEST_F(IncludeCacheTest, ReloadsChangedApk) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/values/values.xml"),
+                          R"(<resources><string name="title">Title</string></resources>)",
+                          compiled_files_dir, &diag));
+  const std::string static_lib = GetTestPath("static.apk");
+  ASSERT_TRUE(Link({"--manifest", GetDefaultManifest(), "-o", static_lib, "--static-lib"},
+                   compiled_files_dir, &diag));
+  std::string static_lib_contents;
+  ASSERT_TRUE(android::base::ReadFileToString(static_lib, &static_lib_contents));
+
+  const std::string include_path = GetTestPath("include.apk");
+  WriteFile(include_path, ReadAndroidJar());
+  IncludeCache cache;
+  IncludedApk apk;
+  ASSERT_TRUE(cache.Load(include_path, &diag, &apk));
+  ASSERT_THAT(apk.apk_assets, NotNull());
+
+  // The file is replaced in place, as a build does when the included library is rebuilt.
+  WriteFile(include_path, static_lib_contents);
+  ASSERT_TRUE(cache.Load(include_path, &diag, &apk));
+  EXPECT_THAT(apk.static_library, NotNull());
+  EXPECT_THAT(apk.apk_assets, IsNull());
+  EXPECT_THAT(cache.hits(), Eq(0u));
+  EXPECT_THAT(cache.misses(), Eq(2u));
+}
+
+TEST_F(IncludeCacheTest, LinksWithSharedCache) {
+  StdErrDiagnostics diag;
+  const std::string compiled_files_dir = GetTestPath("compiled");
+  ASSERT_TRUE(CompileFile(GetTestPath("res/layout/main.xml"),
+                          R"(<View xmlns:android="http://schemas.android.com/apk/res/android"
+                                   android:paddingStart="1dp"/>)",
+                          compiled_files_dir, &diag));
+  const std::string compiled_file = GetTestPath("compiled/layout_main.xml.flat");
+  const std::string android_jar = file::BuildPath({android::base::GetExecutableDirectory(),
+                                                   "integration-tests", "CommandTests",
+                                                   "android-28.jar"});
+
+  IncludeCache cache;
+  std::string outputs[2];
+  for (int i = 0; i < 2; i++) {
+    const std::string out_apk = GetTestPath(i == 0 ? "cold.apk" : "warm.apk");
+    ASSERT_THAT(LinkCommand(&diag, &cache)
+                    .Execute({"--manifest", GetDefaultManifest(), "-o", out_apk, "-I",
+                              android_jar, compiled_file},
+                             &std::cerr),
+                Eq(0));
+    ASSERT_TRUE(android::base::ReadFileToString(out_apk, &outputs[i]));
+  }
+
+  EXPECT_THAT(outputs[1], Eq(outputs[0]));
+  EXPECT_THAT(cache.hits(), Eq(1u));
+  EXPECT_THAT(cache.misses(), Eq(1u));
+}
+
+}  // namespace aapt
@@ -23,6 +23,7 @@
 #include "androidfw/Asset.h"
 #include "androidfw/AssetManager2.h"
 #include "androidfw/ConfigDescription.h"
+#include "androidfw/LoadedArsc.h"
 #include "androidfw/ResourceTypes.h"
 #include "androidfw/ResourceUtils.h"
 
@@ -41,10 +42,7 @@ using ::android::StringPiece16;
 namespace aapt {
 
 SymbolTable::SymbolTable(NameMangler* mangler)
-    : mangler_(mangler),
-      delegate_(util::make_unique<DefaultSymbolTableDelegate>()),
-      cache_(200),
-      id_cache_(200) {
+    : mangler_(mangler), delegate_(util::make_unique<DefaultSymbolTableDelegate>()) {
 }
 
 void SymbolTable::SetDelegate(std::unique_ptr<ISymbolTableDelegate> delegate) {
@@ -53,6 +51,7 @@ void SymbolTable::SetDelegate(std::unique_ptr<ISymbolTableDelegate> delegate) {
 
   // Clear the cache in case this delegate changes the order of lookup.
   cache_.clear();
+  id_cache_.clear();
 }
 
 void SymbolTable::AppendSource(std::unique_ptr<ISymbolSource> source) {
@@ -68,6 +67,7 @@ void SymbolTable::PrependSource(std::unique_ptr<ISymbolSource> source) {
   // We must clear the cache in case we did a lookup before adding this
   // resource.
   cache_.clear();
+  id_cache_.clear();
 }
 
 const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
@@ -83,8 +83,20 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
   }
 
   // We store the name unmangled in the cache, so look it up as-is.
-  if (const std::shared_ptr<Symbol>& s = cache_.get(*name_with_package)) {
-    return s.get();
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    auto iter = cache_.find(*name_with_package);
+    if (iter != cache_.end()) {
+      return iter->second.get();
+    }
+  }
+
+  std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+
+  // Another thread may have found the symbol while we waited for the lock.
+  auto iter = cache_.find(*name_with_package);
+  if (iter != cache_.end()) {
+    return iter->second.get();
   }
 
   // The name was not found in the cache. Mangle it (if necessary) and find it in our sources.
@@ -101,27 +113,34 @@ const SymbolTable::Symbol* SymbolTable::FindByName(const ResourceName& name) {
     return nullptr;
   }
 
-  // Take ownership of the symbol into a shared_ptr. We do this because
-  // LruCache doesn't support unique_ptr.
+  // The symbol is shared between the name and ID caches.
   std::shared_ptr<Symbol> shared_symbol(std::move(symbol));
 
   // Since we look in the cache with the unmangled, but package prefixed
   // name, we must put the same name into the cache.
-  cache_.put(*name_with_package, shared_symbol);
+  cache_.emplace(*name_with_package, shared_symbol);
 
   if (shared_symbol->id) {
-    // The symbol has an ID, so we can also cache this!
-    id_cache_.put(shared_symbol->id.value(), shared_symbol);
+    // The symbol has an ID, so we can also cache this! A symbol already cached for the ID is
+    // kept, as it may be in use by another thread.
+    id_cache_.emplace(shared_symbol->id.value(), shared_symbol);
   }
-
-  // Returns the raw pointer. Callers are not expected to hold on to this
-  // between calls to Find*.
   return shared_symbol.get();
 }
 
 const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
-  if (const std::shared_ptr<Symbol>& s = id_cache_.get(id)) {
-    return s.get();
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    auto iter = id_cache_.find(id);
+    if (iter != id_cache_.end()) {
+      return iter->second.get();
+    }
+  }
+
+  std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+  auto iter = id_cache_.find(id);
+  if (iter != id_cache_.end()) {
+    return iter->second.get();
   }
 
   // We did not find it in the cache, so look through the sources.
@@ -130,13 +149,8 @@ const SymbolTable::Symbol* SymbolTable::FindById(const ResourceId& id) {
     return nullptr;
   }
 
-  // Take ownership of the symbol into a shared_ptr. We do this because LruCache
-  // doesn't support unique_ptr.
   std::shared_ptr<Symbol> shared_symbol(std::move(symbol));
-  id_cache_.put(id, shared_symbol);
-
-  // Returns the raw pointer. Callers are not expected to hold on to this
-  // between calls to Find*.
+  id_cache_.emplace(id, shared_symbol);
   return shared_symbol.get();
 }
 
@@ -220,20 +234,27 @@ std::unique_ptr<SymbolTable::Symbol> ResourceTableSymbolSource::FindByName(
 bool AssetManagerSymbolSource::AddAssetPath(const StringPiece& path) {
   TRACE_CALL();
   if (std::unique_ptr<const ApkAssets> apk = ApkAssets::Load(path.data())) {
-    apk_assets_.push_back(std::move(apk));
-
-    std::vector<const ApkAssets*> apk_assets;
-    for (const std::unique_ptr<const ApkAssets>& apk_asset : apk_assets_) {
-      apk_assets.push_back(apk_asset.get());
-    }
-
-    asset_manager_.SetApkAssets(apk_assets, true /* invalidate_caches */,
-                                false /* filter_incompatible_configs */);
+    AddApkAssets(std::move(apk));
     return true;
   }
   return false;
 }
 
+void AssetManagerSymbolSource::AddApkAssets(std::shared_ptr<const ApkAssets> apk_assets,
+                                            std::shared_ptr<const ApkAssetsIndex> index) {
+  apk_assets_.push_back(std::move(apk_assets));
+  apk_assets_indices_.push_back(std::move(index));
+  index_built_ = false;
+
+  std::vector<const ApkAssets*> apk_assets_ptrs;
+  for (const std::shared_ptr<const ApkAssets>& apk_asset : apk_assets_) {
+    apk_assets_ptrs.push_back(apk_asset.get());
+  }
+
+  asset_manager_.SetApkAssets(apk_assets_ptrs, true /* invalidate_caches */,
+                              false /* filter_incompatible_configs */);
+}
+
 std::map<size_t, std::string> AssetManagerSymbolSource::GetAssignedPackageIds() const {
   TRACE_CALL();
   std::map<size_t, std::string> package_map;
@@ -251,7 +272,7 @@ bool AssetManagerSymbolSource::IsPackageDynamic(uint32_t packageId,
     return true;
   }
 
-  for (const std::unique_ptr<const ApkAssets>& assets : apk_assets_) {
+  for (const std::shared_ptr<const ApkAssets>& assets : apk_assets_) {
     for (const std::unique_ptr<const android::LoadedPackage>& loaded_package
          : assets->GetLoadedArsc()->GetPackages()) {
       if (package_name == loaded_package->GetPackageName() && loaded_package->IsDynamic()) {
@@ -322,99 +343,196 @@ static std::unique_ptr<SymbolTable::Symbol> LookupAttributeInTable(
   return s;
 }
 
-std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByName(
-    const ResourceName& name) {
-  const std::string mangled_entry = NameMangler::MangleEntry(name.package, name.entry);
-
-  bool found = false;
-  ResourceId res_id = 0;
-  uint32_t type_spec_flags;
-  ResourceName real_name;
+const ApkAssetsIndex::Entry* ApkAssetsIndex::Package::FindByName(
+    const ResourceName& name) const {
+  auto iter = entries_by_name.find(name);
+  if (iter != entries_by_name.end()) {
+    return &entries[iter->second];
+  }
 
-  // There can be mangled resources embedded within other packages. Here we will
-  // look into each package and look-up the mangled name until we find the resource.
-  asset_manager_.ForEachPackage([&](const std::string& package_name, uint8_t id) -> bool {
-    real_name = ResourceName(name.package, name.type, name.entry);
-    if (package_name != name.package) {
-      real_name.entry = mangled_entry;
-      real_name.package = package_name;
+  if (name.type == ResourceType::kAttr) {
+    // Private attributes in libraries (such as the framework) are sometimes encoded under the
+    // type '^attr-private' in order to leave the ID space of public 'attr' free for future
+    // additions.
+    iter = entries_by_name.find(ResourceName(name.package, ResourceType::kAttrPrivate,
+                                             name.entry));
+    if (iter != entries_by_name.end()) {
+      return &entries[iter->second];
     }
+  }
+  return nullptr;
+}
 
-    res_id = asset_manager_.GetResourceId(real_name.to_string());
-    if (res_id.is_valid_static() && asset_manager_.GetResourceFlags(res_id.id, &type_spec_flags)) {
-      found = true;
-      return false;
-    }
+const ApkAssetsIndex::Entry* ApkAssetsIndex::Package::FindById(uint8_t type_id,
+                                                               uint16_t entry_id) const {
+  auto iter = entries_by_id.find(static_cast<uint32_t>(type_id) << 16 | entry_id);
+  return iter != entries_by_id.end() ? &entries[iter->second] : nullptr;
+}
+
+std::unique_ptr<const ApkAssetsIndex> ApkAssetsIndex::Create(const ApkAssets& apk_assets) {
+  TRACE_CALL();
+  std::unique_ptr<ApkAssetsIndex> index(new ApkAssetsIndex());
+  for (const std::unique_ptr<const android::LoadedPackage>& loaded_package
+       : apk_assets.GetLoadedArsc()->GetPackages()) {
+    index->packages_.emplace_back();
+    Package& package = index->packages_.back();
+    package.loaded_package = loaded_package.get();
+    loaded_package->ForEachTypeSpec([&](const android::TypeSpec* type_spec, uint8_t) {
+      const uint8_t type_spec_id = type_spec->type_spec->id;
+      const ResourceType* type = ParseResourceType(
+          util::GetString(*loaded_package->GetTypeStringPool(), type_spec_id - 1));
+      if (type == nullptr) {
+        return;
+      }
 
+      const uint8_t type_id = type_spec_id + loaded_package->GetTypeIdOffset();
+      const size_t entry_count = dtohl(type_spec->type_spec->entryCount);
+      for (size_t entry_index = 0; entry_index < entry_count; entry_index++) {
+        // An entry has the same name in every configuration it is defined in.
+        const android::ResTable_entry* entry = nullptr;
+        for (size_t i = 0; i < type_spec->type_count && entry == nullptr; i++) {
+          entry = android::LoadedPackage::GetEntry(type_spec->types[i], entry_index);
+        }
+        if (entry == nullptr) {
+          continue;
+        }
+
+        const uint16_t entry_id = static_cast<uint16_t>(entry_index);
+        ResourceName name(loaded_package->GetPackageName(), *type,
+                          util::GetString(*loaded_package->GetKeyStringPool(),
+                                          dtohl(entry->key.index)));
+        package.entries_by_id.emplace(static_cast<uint32_t>(type_id) << 16 | entry_id,
+                                      package.entries.size());
+        package.entries_by_name.emplace(name, package.entries.size());
+        package.entries.push_back(Entry{std::move(name), type_id, entry_id,
+                                        type_spec->GetFlagsForEntryIndex(entry_index)});
+      }
+    });
+  }
+  return std::move(index);
+}
+
+void AssetManagerSymbolSource::BuildIndex() {
+  if (index_built_) {
+    return;
+  }
+
+  TRACE_CALL();
+  index_built_ = true;
+  package_names_.clear();
+  packages_.clear();
+  attributes_.clear();
+
+  // Packages are searched by name in the order the AssetManager lists them.
+  asset_manager_.ForEachPackage([&](const std::string& package_name, uint8_t) -> bool {
+    package_names_.push_back(package_name);
     return true;
   });
 
-  if (!found) {
-    return {};
+  for (size_t i = 0; i < apk_assets_.size(); i++) {
+    if (apk_assets_indices_[i] == nullptr) {
+      apk_assets_indices_[i] = ApkAssetsIndex::Create(*apk_assets_[i]);
+    }
+    for (const ApkAssetsIndex::Package& package : apk_assets_indices_[i]->packages()) {
+      const uint8_t package_id = asset_manager_.GetAssignedPackageId(package.loaded_package);
+      if (package_id == 0u) {
+        continue;
+      }
+      packages_.push_back(AssignedPackage{
+          &package, package_id,
+          IsPackageDynamic(package_id, package.loaded_package->GetPackageName())});
+    }
   }
+}
 
+const ApkAssetsIndex::Entry* AssetManagerSymbolSource::FindGroupEntry(
+    ResourceId id, bool* out_is_dynamic, uint32_t* out_type_spec_flags) const {
+  const ApkAssetsIndex::Entry* first_entry = nullptr;
+  *out_is_dynamic = false;
+  *out_type_spec_flags = 0u;
+  for (const AssignedPackage& package : packages_) {
+    if (package.package_id != id.package_id()) {
+      continue;
+    }
+    // Packages sharing an ID form a group, which has the flags of all of its packages.
+    if (const ApkAssetsIndex::Entry* entry = package.index->FindById(id.type_id(),
+                                                                      id.entry_id())) {
+      *out_type_spec_flags |= entry->type_spec_flags;
+      if (first_entry == nullptr) {
+        first_entry = entry;
+        *out_is_dynamic = package.is_dynamic;
+      }
+    }
+  }
+  return first_entry;
+}
+
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::CreateSymbol(
+    ResourceId id, bool is_attribute, bool is_dynamic, uint32_t type_spec_flags) {
   std::unique_ptr<SymbolTable::Symbol> s;
-  if (real_name.type == ResourceType::kAttr) {
-    s = LookupAttributeInTable(asset_manager_, res_id);
+  if (is_attribute) {
+    auto iter = attributes_.find(id);
+    if (iter == attributes_.end()) {
+      iter = attributes_.emplace(id, LookupAttributeInTable(asset_manager_, id)).first;
+    }
+    if (iter->second == nullptr) {
+      return {};
+    }
+    s = util::make_unique<SymbolTable::Symbol>(*iter->second);
   } else {
     s = util::make_unique<SymbolTable::Symbol>();
-    s->id = res_id;
-    s->is_dynamic = IsPackageDynamic(ResourceId(res_id).package_id(), real_name.package);
+    s->id = id;
+    s->is_dynamic = is_dynamic;
   }
 
-  if (s) {
-    s->is_public = (type_spec_flags & android::ResTable_typeSpec::SPEC_PUBLIC) != 0;
-    return s;
-  }
-  return {};
+  s->is_public = (type_spec_flags & android::ResTable_typeSpec::SPEC_PUBLIC) != 0;
+  return s;
 }
 
-static Maybe<ResourceName> GetResourceName(android::AssetManager2& am,
-                                           ResourceId id) {
-  android::AssetManager2::ResourceName name;
-  if (!am.GetResourceName(id.id, &name)) {
-    return {};
+std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByName(
+    const ResourceName& name) {
+  BuildIndex();
+  const std::string mangled_entry = NameMangler::MangleEntry(name.package, name.entry);
+
+  // There can be mangled resources embedded within other packages. Here we will
+  // look into each package and look-up the mangled name until we find the resource.
+  for (const std::string& package_name : package_names_) {
+    ResourceName real_name(name.package, name.type, name.entry);
+    if (package_name != name.package) {
+      real_name.entry = mangled_entry;
+      real_name.package = package_name;
+    }
+
+    for (const AssignedPackage& package : packages_) {
+      if (package.index->loaded_package->GetPackageName() != real_name.package) {
+        continue;
+      }
+      if (const ApkAssetsIndex::Entry* entry = package.index->FindByName(real_name)) {
+        const ResourceId id(package.package_id, entry->type_id, entry->entry_id);
+        bool is_dynamic;
+        uint32_t type_spec_flags;
+        FindGroupEntry(id, &is_dynamic, &type_spec_flags);
+        return CreateSymbol(id, name.type == ResourceType::kAttr, is_dynamic, type_spec_flags);
+      }
+    }
   }
-  return ResourceUtils::ToResourceName(name);
+  return {};
 }
 
 std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindById(
     ResourceId id) {
   if (!id.is_valid_static()) {
-    // Exit early and avoid the error logs from AssetManager.
-    return {};
-  }
-
-  if (apk_assets_.empty()) {
-    return {};
-  }
-
-  Maybe<ResourceName> maybe_name = GetResourceName(asset_manager_, id);
-  if (!maybe_name) {
     return {};
   }
 
-
-  uint32_t type_spec_flags = 0;
-  if (!asset_manager_.GetResourceFlags(id.id, &type_spec_flags)) {
+  BuildIndex();
+  bool is_dynamic;
+  uint32_t type_spec_flags;
+  const ApkAssetsIndex::Entry* entry = FindGroupEntry(id, &is_dynamic, &type_spec_flags);
+  if (entry == nullptr) {
     return {};
   }
-
-  ResourceName& name = maybe_name.value();
-  std::unique_ptr<SymbolTable::Symbol> s;
-  if (name.type == ResourceType::kAttr) {
-    s = LookupAttributeInTable(asset_manager_, id);
-  } else {
-    s = util::make_unique<SymbolTable::Symbol>();
-    s->id = id;
-    s->is_dynamic = IsPackageDynamic(ResourceId(id).package_id(), name.package);
-  }
-
-  if (s) {
-    s->is_public = (type_spec_flags & android::ResTable_typeSpec::SPEC_PUBLIC) != 0;
-    return s;
-  }
-  return {};
+  return CreateSymbol(id, entry->name.type == ResourceType::kAttr, is_dynamic, type_spec_flags);
 }
 
 std::unique_ptr<SymbolTable::Symbol> AssetManagerSymbolSource::FindByReference(
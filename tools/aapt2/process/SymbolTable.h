@@ -19,13 +19,13 @@
 
 #include <algorithm>
 #include <memory>
+#include <shared_mutex>
+#include <unordered_map>
 #include <vector>
 
 #include "android-base/macros.h"
 #include "androidfw/Asset.h"
 #include "androidfw/AssetManager2.h"
-#include "utils/JenkinsHash.h"
-#include "utils/LruCache.h"
 
 #include "Resource.h"
 #include "ResourceTable.h"
@@ -34,23 +34,16 @@
 
 namespace aapt {
 
-inline android::hash_t hash_type(const ResourceName& name) {
-  std::hash<std::string> str_hash;
-  android::hash_t hash = 0;
-  hash = android::JenkinsHashMix(hash, (uint32_t)str_hash(name.package));
-  hash = android::JenkinsHashMix(hash, (uint32_t)name.type);
-  hash = android::JenkinsHashMix(hash, (uint32_t)str_hash(name.entry));
-  return hash;
-}
-
-inline android::hash_t hash_type(const ResourceId& id) {
-  return android::hash_type(id.id);
-}
-
 class ISymbolSource;
 class ISymbolTableDelegate;
 class NameMangler;
 
+// Looks up symbols in a list of sources and caches them.
+//
+// The Find* methods may be called from several threads at once. Symbols that are already cached
+// are found under a shared lock. The sources are only searched under an exclusive lock, as they
+// are not thread-safe themselves. Adding sources or setting the delegate must not happen
+// concurrently with lookups.
 class SymbolTable {
  public:
   struct Symbol {
@@ -86,18 +79,18 @@ class SymbolTable {
   // cause the existing cache to be cleared.
   void PrependSource(std::unique_ptr<ISymbolSource> source);
 
-  // NOTE: Never hold on to the result between calls to FindByXXX. The
-  // results are stored in a cache which may evict entries on subsequent calls.
+  // The result stays valid until a source is prepended or the delegate is replaced, which
+  // clears the cache.
   const Symbol* FindByName(const ResourceName& name);
 
-  // NOTE: Never hold on to the result between calls to FindByXXX. The
-  // results are stored in a cache which may evict entries on subsequent calls.
+  // The result stays valid until a source is prepended or the delegate is replaced, which
+  // clears the cache.
   const Symbol* FindById(const ResourceId& id);
 
   // Let's the ISymbolSource decide whether looking up by name or ID is faster,
   // if both are available.
-  // NOTE: Never hold on to the result between calls to FindByXXX. The
-  // results are stored in a cache which may evict entries on subsequent calls.
+  // The result stays valid until a source is prepended or the delegate is replaced, which
+  // clears the cache.
   const Symbol* FindByReference(const Reference& ref);
 
  private:
@@ -105,10 +98,13 @@ class SymbolTable {
   std::unique_ptr<ISymbolTableDelegate> delegate_;
   std::vector<std::unique_ptr<ISymbolSource>> sources_;
 
-  // We use shared_ptr because unique_ptr is not supported and
-  // we need automatic deletion.
-  android::LruCache<ResourceName, std::shared_ptr<Symbol>> cache_;
-  android::LruCache<ResourceId, std::shared_ptr<Symbol>> id_cache_;
+  // Guards the caches, and the sources while they are searched.
+  std::shared_timed_mutex mutex_;
+
+  // Symbols are never evicted, so that a symbol found by one thread is not freed by a lookup on
+  // another. A symbol found by name is shared with the ID cache.
+  std::unordered_map<ResourceName, std::shared_ptr<Symbol>> cache_;
+  std::unordered_map<ResourceId, std::shared_ptr<Symbol>> id_cache_;
 
   DISALLOW_COPY_AND_ASSIGN(SymbolTable);
 };
@@ -188,11 +184,58 @@ class ResourceTableSymbolSource : public ISymbolSource {
   DISALLOW_COPY_AND_ASSIGN(ResourceTableSymbolSource);
 };
 
+// The names and IDs of the resources of one APK. It does not depend on the package IDs that an
+// AssetManager assigns to the packages of the APK, so one index can be shared read-only by every
+// AssetManagerSymbolSource that the APK is added to.
+class ApkAssetsIndex {
+ public:
+  struct Entry {
+    ResourceName name;
+    uint8_t type_id;
+    uint16_t entry_id;
+    uint32_t type_spec_flags;
+  };
+
+  struct Package {
+    const android::LoadedPackage* loaded_package;
+    std::vector<Entry> entries;
+    std::unordered_map<ResourceName, size_t> entries_by_name;
+    // Keyed by the type ID and the entry ID of the resource.
+    std::unordered_map<uint32_t, size_t> entries_by_id;
+
+    const Entry* FindByName(const ResourceName& name) const;
+    const Entry* FindById(uint8_t type_id, uint16_t entry_id) const;
+  };
+
+  // Indexes every package of `apk_assets`, which must outlive the index.
+  static std::unique_ptr<const ApkAssetsIndex> Create(const android::ApkAssets& apk_assets);
+
+  const std::vector<Package>& packages() const {
+    return packages_;
+  }
+
+ private:
+  ApkAssetsIndex() = default;
+
+  DISALLOW_COPY_AND_ASSIGN(ApkAssetsIndex);
+
+  std::vector<Package> packages_;
+};
+
+// Exposes the resources of APKs loaded with an AssetManager as symbols for SymbolTable.
+// Lookups are served by an ApkAssetsIndex of each APK, which is built on the first lookup unless
+// one is passed in with the APK.
 class AssetManagerSymbolSource : public ISymbolSource {
  public:
   AssetManagerSymbolSource() = default;
 
   bool AddAssetPath(const android::StringPiece& path);
+
+  // Adds APK assets that may be shared with other symbol sources, along with their index if it
+  // was already built.
+  void AddApkAssets(std::shared_ptr<const android::ApkAssets> apk_assets,
+                    std::shared_ptr<const ApkAssetsIndex> index = {});
+
   std::map<size_t, std::string> GetAssignedPackageIds() const;
   bool IsPackageDynamic(uint32_t packageId, const std::string& package_name) const;
 
@@ -207,8 +250,36 @@ class AssetManagerSymbolSource : public ISymbolSource {
   }
 
  private:
+  // A package of an added APK, with the ID that the AssetManager assigned to it.
+  struct AssignedPackage {
+    const ApkAssetsIndex::Package* index;
+    uint8_t package_id;
+    bool is_dynamic;
+  };
+
+  // Indexes the APKs that were added without an index, and finds the IDs assigned to their
+  // packages, unless this was done since APK assets were last added.
+  void BuildIndex();
+
+  // Returns the entry with `id` in the first package that has it, along with the flags of the
+  // entry in all packages sharing the package ID.
+  const ApkAssetsIndex::Entry* FindGroupEntry(ResourceId id, bool* out_is_dynamic,
+                                              uint32_t* out_type_spec_flags) const;
+
+  std::unique_ptr<SymbolTable::Symbol> CreateSymbol(ResourceId id, bool is_attribute,
+                                                    bool is_dynamic, uint32_t type_spec_flags);
+
   android::AssetManager2 asset_manager_;
-  std::vector<std::unique_ptr<const android::ApkAssets>> apk_assets_;
+  std::vector<std::shared_ptr<const android::ApkAssets>> apk_assets_;
+  std::vector<std::shared_ptr<const ApkAssetsIndex>> apk_assets_indices_;
+
+  // Cleared when APK assets are added, as the package IDs assigned to them may change.
+  bool index_built_ = false;
+  std::vector<std::string> package_names_;
+  std::vector<AssignedPackage> packages_;
+
+  // Attribute symbols read from the bags of the attributes, or null if the bag was not readable.
+  std::unordered_map<ResourceId, std::unique_ptr<SymbolTable::Symbol>> attributes_;
 
   DISALLOW_COPY_AND_ASSIGN(AssetManagerSymbolSource);
 };
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <memory>
+#include <vector>
+
+#include "android-base/file.h"
+#include "android-base/logging.h"
+#include "androidfw/ApkAssets.h"
+#include "benchmark/benchmark.h"
+
+#include "ResourceUtils.h"
+#include "process/SymbolTable.h"
+#include "util/Files.h"
+
+using ::android::ApkAssets;
+
+namespace aapt {
+
+// The framework APK that apps link against.
+static std::shared_ptr<const ApkAssets> GetFramework() {
+  static const std::shared_ptr<const ApkAssets> framework = ApkAssets::Load(
+      file::BuildPath({android::base::GetExecutableDirectory(), "integration-tests",
+                       "CommandTests", "android-28.jar"}));
+  CHECK(framework != nullptr);
+  return framework;
+}
+
+struct FrameworkResource {
+  ResourceName name;
+  ResourceId id;
+};
+
+// Every resource of the framework, as referenced by the apps linking against it.
+static const std::vector<FrameworkResource>& GetFrameworkResources() {
+  static const std::vector<FrameworkResource> resources = [] {
+    AssetManagerSymbolSource source;
+    source.AddApkAssets(GetFramework());
+    std::vector<FrameworkResource> resources;
+    for (uint32_t type_id = 1u; type_id <= 0xffu; type_id++) {
+      for (uint32_t entry_id = 0u; entry_id <= 0xffffu; entry_id++) {
+        const ResourceId id(0x01u, type_id, entry_id);
+        android::AssetManager2::ResourceName name;
+        if (!source.GetAssetManager()->GetResourceName(id.id, &name)) {
+          break;
+        }
+        Maybe<ResourceName> parsed_name = ResourceUtils::ToResourceName(name);
+        if (parsed_name) {
+          resources.push_back(FrameworkResource{parsed_name.value(), id});
+        }
+      }
+    }
+    return resources;
+  }();
+  return resources;
+}
+
+// Each link creates its own symbol source, so the cost of indexing is part of every iteration.
+static void BM_FindFrameworkSymbolsByName(benchmark::State& state) {
+  const std::vector<FrameworkResource>& resources = GetFrameworkResources();
+  for (auto _ : state) {
+    AssetManagerSymbolSource source;
+    source.AddApkAssets(GetFramework());
+    for (const FrameworkResource& resource : resources) {
+      benchmark::DoNotOptimize(source.FindByName(resource.name));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * resources.size());
+}
+BENCHMARK(BM_FindFrameworkSymbolsByName)->Unit(benchmark::kMillisecond);
+
+static void BM_FindFrameworkSymbolsById(benchmark::State& state) {
+  const std::vector<FrameworkResource>& resources = GetFrameworkResources();
+  for (auto _ : state) {
+    AssetManagerSymbolSource source;
+    source.AddApkAssets(GetFramework());
+    for (const FrameworkResource& resource : resources) {
+      benchmark::DoNotOptimize(source.FindById(resource.id));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * resources.size());
+}
+BENCHMARK(BM_FindFrameworkSymbolsById)->Unit(benchmark::kMillisecond);
+
+// Names that are not in the framework, as looked up for the resources of the app itself.
+static void BM_FindMissingSymbolsByName(benchmark::State& state) {
+  const std::vector<FrameworkResource>& resources = GetFrameworkResources();
+  for (auto _ : state) {
+    AssetManagerSymbolSource source;
+    source.AddApkAssets(GetFramework());
+    for (const FrameworkResource& resource : resources) {
+      benchmark::DoNotOptimize(source.FindByName(
+          ResourceName("com.example.app", resource.name.type, resource.name.entry)));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * resources.size());
+}
+BENCHMARK(BM_FindMissingSymbolsByName)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
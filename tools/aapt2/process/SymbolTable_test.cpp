@@ -16,11 +16,18 @@
 
 #include "process/SymbolTable.h"
 
+#include <thread>
+
+#include "android-base/file.h"
+#include "android-base/stringprintf.h"
+
 #include "SdkConstants.h"
 #include "format/binary/TableFlattener.h"
 #include "test/Test.h"
 #include "util/BigBuffer.h"
+#include "util/Files.h"
 
+using ::android::base::StringPrintf;
 using ::testing::Eq;
 using ::testing::IsNull;
 using ::testing::Ne;
@@ -76,6 +83,76 @@ TEST(SymbolTableTest, FindByName) {
   EXPECT_THAT(symbol_table.FindByName(test::ParseNameOrDie("com.android.lib:id/foo")), NotNull());
 }
 
+TEST(SymbolTableTest, FindByNameFromSeveralThreads) {
+  test::ResourceTableBuilder builder;
+  for (int i = 0; i < 100; i++) {
+    builder.AddSimple(StringPrintf("com.android.app:id/foo%d", i), ResourceId(0x7f020000 + i));
+  }
+  std::unique_ptr<ResourceTable> table = builder.Build();
+
+  NameMangler mangler(NameManglerPolicy{"com.android.app"});
+  SymbolTable symbol_table(&mangler);
+  symbol_table.AppendSource(util::make_unique<ResourceTableSymbolSource>(table.get()));
+
+  // Every thread finds the same symbols, which stay valid while the other threads look up more.
+  std::vector<std::vector<const SymbolTable::Symbol*>> found(4);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < found.size(); t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < 100; i++) {
+        found[t].push_back(symbol_table.FindByName(
+            test::ParseNameOrDie(StringPrintf("com.android.app:id/foo%d", i))));
+        found[t].push_back(symbol_table.FindById(ResourceId(0x7f020000 + i)));
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  for (size_t i = 0; i < found[0].size(); i++) {
+    ASSERT_THAT(found[0][i], NotNull());
+    ASSERT_TRUE(found[0][i]->id);
+    EXPECT_THAT(found[0][i]->id.value(), Eq(ResourceId(0x7f020000 + i / 2)));
+    for (size_t t = 1; t < found.size(); t++) {
+      EXPECT_THAT(found[t][i], Eq(found[0][i]));
+    }
+  }
+}
+
+TEST(AssetManagerSymbolSourceTest, FindFrameworkSymbols) {
+  AssetManagerSymbolSource source;
+  ASSERT_TRUE(source.AddAssetPath(file::BuildPath({android::base::GetExecutableDirectory(),
+                                                   "integration-tests", "CommandTests",
+                                                   "android-28.jar"})));
+
+  std::unique_ptr<SymbolTable::Symbol> by_name =
+      source.FindByName(test::ParseNameOrDie("android:attr/layout_width"));
+  ASSERT_THAT(by_name, NotNull());
+  ASSERT_TRUE(by_name->id);
+  EXPECT_THAT(by_name->id.value(), Eq(ResourceId(0x010100f4)));
+  EXPECT_TRUE(by_name->is_public);
+  ASSERT_THAT(by_name->attribute, NotNull());
+  EXPECT_THAT(by_name->attribute->symbols.size(), Ne(0u));
+
+  std::unique_ptr<SymbolTable::Symbol> by_id = source.FindById(ResourceId(0x010100f4));
+  ASSERT_THAT(by_id, NotNull());
+  ASSERT_THAT(by_id->attribute, NotNull());
+  EXPECT_THAT(by_id->attribute->symbols.size(), Eq(by_name->attribute->symbols.size()));
+
+  std::unique_ptr<SymbolTable::Symbol> ok = source.FindByName(
+      test::ParseNameOrDie("android:string/ok"));
+  ASSERT_THAT(ok, NotNull());
+  ASSERT_TRUE(ok->id);
+  EXPECT_THAT(ok->id.value(), Eq(ResourceId(0x0104000a)));
+  EXPECT_THAT(ok->attribute, IsNull());
+  EXPECT_THAT(source.FindById(ResourceId(0x0104000a)), NotNull());
+
+  EXPECT_THAT(source.FindByName(test::ParseNameOrDie("android:string/not_a_string")), IsNull());
+  EXPECT_THAT(source.FindByName(test::ParseNameOrDie("com.android.app:string/ok")), IsNull());
+  EXPECT_THAT(source.FindById(ResourceId(0x0104fffe)), IsNull());
+}
+
 using SymbolTableTestFixture = CommandTestFixture;
 TEST_F(SymbolTableTestFixture, FindByNameWhenSymbolIsMangledInResTable) {
   using namespace android;
@@ -16,7 +16,9 @@
 
 #include "TraceBuffer.h"
 
+#include <atomic>
 #include <chrono>
+#include <mutex>
 #include <sstream>
 #include <unistd.h>
 #include <vector>
@@ -36,14 +38,24 @@ constexpr char kBegin = 'B';
 constexpr char kEnd = 'E';
 
 struct TracePoint {
-  pid_t tid;
+  pid_t pid;
+  int tid;
   int64_t time;
   std::string tag;
   char type;
 };
 
+std::mutex traces_mutex;
 std::vector<TracePoint> traces;
 
+// Small sequential ids, so that the first thread to trace (the main thread) is thread 0.
+std::atomic<int> next_thread_id(0);
+
+int GetThreadId() noexcept {
+  thread_local int thread_id = next_thread_id++;
+  return thread_id;
+}
+
 int64_t GetTime() noexcept {
   auto now = std::chrono::steady_clock::now();
   return std::chrono::duration_cast<std::chrono::microseconds>(now.time_since_epoch()).count();
@@ -52,7 +64,8 @@ int64_t GetTime() noexcept {
 } // namespace anonymous
 
 void AddWithTime(const std::string& tag, char type, int64_t time) noexcept {
-  TracePoint t = {getpid(), time, tag, type};
+  TracePoint t = {getpid(), GetThreadId(), time, tag, type};
+  std::lock_guard<std::mutex> lock(traces_mutex);
   traces.emplace_back(t);
 }
 
@@ -76,9 +89,11 @@ void Flush(const std::string& basePath) {
     return;
   }
 
+  std::lock_guard<std::mutex> lock(traces_mutex);
   for(const TracePoint& trace : traces) {
     fprintf(f, "{\"ts\" : \"%" PRIu64 "\", \"ph\" : \"%c\", \"tid\" : \"%d\" , \"pid\" : \"%d\", "
-            "\"name\" : \"%s\" },\n", trace.time, trace.type, 0, trace.tid, trace.tag.c_str());
+            "\"name\" : \"%s\" },\n", trace.time, trace.type, trace.tid, trace.pid,
+            trace.tag.c_str());
   }
   fclose(f);
   traces.clear();
@@ -22,6 +22,7 @@
 #include <algorithm>
 #include <cerrno>
 #include <cstdio>
+#include <ctime>
 #include <string>
 
 #include "android-base/errors.h"
@@ -396,5 +397,64 @@ Maybe<std::vector<std::string>> FindFiles(const android::StringPiece& path, IDia
   return files;
 }
 
+void PruneCacheDirectory(const std::string& dir, const StringPiece& entry_extension,
+                         size_t max_bytes) {
+  // A temporary file is renamed into place as soon as it is written, so one that is older than
+  // this was left behind by a process that did not finish.
+  constexpr time_t kMaxTempFileAgeSec = 60 * 60;
+
+  std::unique_ptr<DIR, decltype(closedir)*> d(opendir(dir.c_str()), closedir);
+  if (!d) {
+    return;
+  }
+
+  struct CachedEntry {
+    time_t last_used;
+    size_t size;
+    std::string path;
+  };
+  std::vector<CachedEntry> entries;
+  size_t total_bytes = 0u;
+  const time_t now = time(nullptr);
+  while (struct dirent* dir_entry = readdir(d.get())) {
+    const StringPiece name(dir_entry->d_name);
+    const bool is_temp = util::EndsWith(name, ".tmp");
+    if (!is_temp && !util::EndsWith(name, entry_extension)) {
+      continue;
+    }
+
+    std::string path = dir;
+    AppendPath(&path, name);
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) != 0) {
+      continue;
+    }
+    if (is_temp) {
+      if (now - file_stat.st_mtime > kMaxTempFileAgeSec) {
+        remove(path.c_str());
+      }
+      continue;
+    }
+    total_bytes += file_stat.st_size;
+    entries.push_back(
+        CachedEntry{file_stat.st_mtime, static_cast<size_t>(file_stat.st_size), std::move(path)});
+  }
+
+  if (total_bytes <= max_bytes) {
+    return;
+  }
+  std::sort(entries.begin(), entries.end(), [](const CachedEntry& a, const CachedEntry& b) {
+    return a.last_used < b.last_used;
+  });
+  for (const CachedEntry& entry : entries) {
+    if (total_bytes <= max_bytes) {
+      break;
+    }
+    if (remove(entry.path.c_str()) == 0) {
+      total_bytes -= entry.size;
+    }
+  }
+}
+
 }  // namespace file
 }  // namespace aapt
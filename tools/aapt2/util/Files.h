@@ -122,6 +122,13 @@ class FileFilter {
   std::vector<std::string> pattern_tokens_;
 };
 
+// Deletes the least recently modified files of the cache directory `dir` whose names end in
+// `entry_extension`, until the remaining ones take at most max_bytes. Also deletes the files ending
+// in ".tmp" that are more than an hour old, which were left behind by processes that did not
+// finish writing an entry.
+void PruneCacheDirectory(const std::string& dir, const android::StringPiece& entry_extension,
+                         size_t max_bytes);
+
 // Returns a list of files relative to the directory identified by `path`.
 // An optional FileFilter filters out any files that don't pass.
 Maybe<std::vector<std::string>> FindFiles(const android::StringPiece& path, IDiagnostics* diag,
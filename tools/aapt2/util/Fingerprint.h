@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UTIL_FINGERPRINT_H
+#define AAPT_UTIL_FINGERPRINT_H
+
+#include <cstdint>
+#include <string>
+
+#include "android-base/stringprintf.h"
+#include "androidfw/StringPiece.h"
+
+namespace aapt {
+
+// A 64-bit FNV-1a hash of a sequence of values, used to name the entries of on-disk caches.
+// Not suitable where an adversary chooses the inputs.
+class Fingerprint {
+ public:
+  // Adds raw bytes.
+  Fingerprint& Update(const void* data, size_t len) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+      hash_ = (hash_ ^ bytes[i]) * kPrime;
+    }
+    return *this;
+  }
+
+  // Adds a string along with its length, so that consecutive strings cannot run into each other.
+  Fingerprint& Update(const android::StringPiece& str) {
+    Update(static_cast<uint64_t>(str.size()));
+    return Update(str.data(), str.size());
+  }
+
+  Fingerprint& Update(uint64_t value) {
+    return Update(&value, sizeof(value));
+  }
+
+  uint64_t value() const {
+    return hash_;
+  }
+
+  std::string ToString() const {
+    return android::base::StringPrintf("%016llx", static_cast<unsigned long long>(hash_));
+  }
+
+ private:
+  static constexpr uint64_t kPrime = 0x100000001b3ull;
+
+  uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_UTIL_FINGERPRINT_H
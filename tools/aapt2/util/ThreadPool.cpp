@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/ThreadPool.h"
+
+#include <algorithm>
+
+#include "util/Util.h"
+
+namespace aapt {
+
+ThreadPool::ThreadPool(size_t num_threads) {
+  if (num_threads == 0) {
+    num_threads = GetDefaultThreadCount();
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    queues_.push_back(util::make_unique<TaskQueue>());
+  }
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back([this, i] { RunWorker(i); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  Wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  task_scheduled_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::GetDefaultThreadCount() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+Maybe<size_t> ThreadPool::ParseThreadCount(const android::StringPiece& str) {
+  const android::StringPiece trimmed = util::TrimWhitespace(str);
+  if (trimmed.empty()) {
+    return {};
+  }
+  const size_t max_count = kMaxThreadCount;
+  size_t count = 0;
+  for (const char c : trimmed) {
+    if (c < '0' || c > '9') {
+      return {};
+    }
+    // Stop accumulating once over the cap, so that long inputs can not overflow.
+    count = std::min(count * 10 + (c - '0'), max_count + 1);
+  }
+  return count == 0 ? GetDefaultThreadCount() : std::min(count, max_count);
+}
+
+void ThreadPool::Schedule(std::function<void()> task) {
+  size_t queue;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue = next_queue_;
+    next_queue_ = (next_queue_ + 1) % queues_.size();
+    unfinished_tasks_++;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(queues_[queue]->mutex);
+    queues_[queue]->tasks.push_back(std::move(task));
+  }
+
+  // Only announce the task once it is in a queue, so that a worker claiming it always finds it.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    unclaimed_tasks_++;
+  }
+  task_scheduled_.notify_one();
+}
+
+void ThreadPool::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  tasks_finished_.wait(lock, [this] { return unfinished_tasks_ == 0; });
+}
+
+bool ThreadPool::TakeTask(size_t worker, std::function<void()>* out_task) {
+  {
+    TaskQueue* own = queues_[worker].get();
+    std::lock_guard<std::mutex> lock(own->mutex);
+    if (!own->tasks.empty()) {
+      *out_task = std::move(own->tasks.front());
+      own->tasks.pop_front();
+      return true;
+    }
+  }
+
+  for (size_t i = 1; i < queues_.size(); i++) {
+    TaskQueue* victim = queues_[(worker + i) % queues_.size()].get();
+    std::lock_guard<std::mutex> lock(victim->mutex);
+    if (!victim->tasks.empty()) {
+      *out_task = std::move(victim->tasks.back());
+      victim->tasks.pop_back();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::RunWorker(size_t worker) {
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      task_scheduled_.wait(lock, [this] { return unclaimed_tasks_ > 0 || stopping_; });
+      if (unclaimed_tasks_ == 0) {
+        return;
+      }
+      unclaimed_tasks_--;
+    }
+
+    // A task was claimed, so one of the queues holds a task for this worker. Another claiming
+    // worker may take it first while we scan, in which case another task is left for us.
+    std::function<void()> task;
+    while (!TakeTask(worker, &task)) {
+      std::this_thread::yield();
+    }
+    task();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--unfinished_tasks_ == 0) {
+      tasks_finished_.notify_all();
+    }
+  }
+}
+
+}  // namespace aapt
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef AAPT_UTIL_THREADPOOL_H
+#define AAPT_UTIL_THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "android-base/macros.h"
+#include "androidfw/StringPiece.h"
+
+#include "util/Maybe.h"
+
+namespace aapt {
+
+// A fixed set of worker threads running scheduled tasks.
+//
+// Every worker owns a queue of tasks, and tasks are handed out to the queues in turn. A worker
+// runs the tasks of its own queue in order, and once its queue is empty it steals the most
+// recently scheduled task of another queue, so that a few slow tasks do not leave the other
+// workers idle.
+class ThreadPool {
+ public:
+  // Starts num_threads workers, or one per hardware thread if num_threads is 0.
+  explicit ThreadPool(size_t num_threads = 0);
+
+  // Waits for the scheduled tasks to finish and stops the workers.
+  ~ThreadPool();
+
+  // Schedules task to run on one of the workers. May be called from a running task.
+  void Schedule(std::function<void()> task);
+
+  // Blocks until every task scheduled so far has finished running.
+  void Wait();
+
+  size_t size() const {
+    return workers_.size();
+  }
+
+  // Returns the number of hardware threads, or 1 if it cannot be determined.
+  static size_t GetDefaultThreadCount();
+
+  // The largest number of threads a -j flag may ask for.
+  static constexpr size_t kMaxThreadCount = 256u;
+
+  // Parses the value of a -j flag: a decimal number of threads, or 0 for one per hardware thread.
+  // An explicit count is used as given, even above the number of hardware threads, but is lowered
+  // to kMaxThreadCount. Returns an empty Maybe if str is not a non-negative decimal number.
+  static Maybe<size_t> ParseThreadCount(const android::StringPiece& str);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  void RunWorker(size_t worker);
+
+  // Takes a task from the queue of the worker, or steals one from another queue.
+  bool TakeTask(size_t worker, std::function<void()>* out_task);
+
+  std::vector<std::unique_ptr<TaskQueue>> queues_;
+  std::vector<std::thread> workers_;
+
+  // Guards the fields below.
+  std::mutex mutex_;
+  std::condition_variable task_scheduled_;
+  std::condition_variable tasks_finished_;
+
+  // Number of tasks sitting in the queues that no worker has claimed yet.
+  size_t unclaimed_tasks_ = 0;
+
+  // Number of tasks scheduled that have not finished running.
+  size_t unfinished_tasks_ = 0;
+
+  size_t next_queue_ = 0;
+  bool stopping_ = false;
+};
+
+}  // namespace aapt
+
+#endif  // AAPT_UTIL_THREADPOOL_H
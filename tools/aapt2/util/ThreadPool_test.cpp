@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "util/ThreadPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+#include "test/Test.h"
+
+using ::testing::Each;
+using ::testing::Eq;
+
+namespace aapt {
+
+TEST(ThreadPoolTest, RunsEveryTaskOnce) {
+  std::vector<int> runs(1000, 0);
+  {
+    ThreadPool pool(4);
+    EXPECT_EQ(4u, pool.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+      pool.Schedule([&runs, i] { runs[i]++; });
+    }
+    pool.Wait();
+    EXPECT_THAT(runs, Each(Eq(1)));
+
+    // The pool can be reused after waiting.
+    for (size_t i = 0; i < runs.size(); i++) {
+      pool.Schedule([&runs, i] { runs[i]++; });
+    }
+  }
+  EXPECT_THAT(runs, Each(Eq(2)));
+}
+
+TEST(ThreadPoolTest, IdleWorkersStealFromBusyWorkers) {
+  ThreadPool pool(2);
+  std::atomic<int> finished(0);
+
+  // The first task blocks its worker, so the tasks queued behind it must be stolen.
+  std::atomic<bool> release(false);
+  pool.Schedule([&] {
+    while (!release) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    finished++;
+  });
+  for (int i = 0; i < 10; i++) {
+    pool.Schedule([&] { finished++; });
+  }
+
+  while (finished < 10) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  release = true;
+  pool.Wait();
+  EXPECT_EQ(11, finished);
+}
+
+TEST(ThreadPoolTest, TasksCanScheduleTasks) {
+  ThreadPool pool(3);
+  std::atomic<int> finished(0);
+  for (int i = 0; i < 10; i++) {
+    pool.Schedule([&] {
+      pool.Schedule([&] { finished++; });
+      finished++;
+    });
+  }
+  pool.Wait();
+  EXPECT_EQ(20, finished);
+}
+
+TEST(ThreadPoolTest, ParsesThreadCount) {
+  EXPECT_THAT(ThreadPool::ParseThreadCount("1"), Eq(Maybe<size_t>(1u)));
+  EXPECT_THAT(ThreadPool::ParseThreadCount(" 1 "), Eq(Maybe<size_t>(1u)));
+  EXPECT_THAT(ThreadPool::ParseThreadCount("0"),
+              Eq(Maybe<size_t>(ThreadPool::GetDefaultThreadCount())));
+
+  // Explicit counts are not lowered to the number of hardware threads.
+  EXPECT_THAT(ThreadPool::ParseThreadCount("4"), Eq(Maybe<size_t>(4u)));
+  EXPECT_THAT(ThreadPool::ParseThreadCount("100000000000000000000"),
+              Eq(Maybe<size_t>(ThreadPool::kMaxThreadCount)));
+
+  EXPECT_FALSE(ThreadPool::ParseThreadCount(""));
+  EXPECT_FALSE(ThreadPool::ParseThreadCount("-1"));
+  EXPECT_FALSE(ThreadPool::ParseThreadCount("0x10"));
+  EXPECT_FALSE(ThreadPool::ParseThreadCount("four"));
+}
+
+}  // namespace aapt
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
@@ -39,7 +40,7 @@ XmlPullParser::XmlPullParser(InputStream* in) : in_(in), empty_(), depth_(0) {
   XML_SetCharacterDataHandler(parser_, CharacterDataHandler);
   XML_SetCommentHandler(parser_, CommentDataHandler);
   XML_SetCdataSectionHandler(parser_, StartCdataSectionHandler, EndCdataSectionHandler);
-  event_queue_.push(EventData{Event::kStartDocument, 0, depth_++});
+  PushEvent(Event::kStartDocument, 0, depth_++);
 }
 
 XmlPullParser::~XmlPullParser() {
@@ -52,15 +53,19 @@ XmlPullParser::Event XmlPullParser::Next() {
     return currentEvent;
   }
 
-  event_queue_.pop();
-  while (event_queue_.empty()) {
+  if (++front_ == event_count_) {
+    front_ = 0;
+    event_count_ = 0;
+  }
+
+  while (event_count_ == 0) {
     const char* buffer = nullptr;
     size_t buffer_size = 0;
     bool done = false;
     if (!in_->Next(reinterpret_cast<const void**>(&buffer), &buffer_size)) {
       if (in_->HadError()) {
         error_ = in_->GetError();
-        event_queue_.push(EventData{Event::kBadDocument});
+        PushEvent(Event::kBadDocument, 0, 0);
         break;
       }
 
@@ -69,12 +74,12 @@ XmlPullParser::Event XmlPullParser::Next() {
 
     if (XML_Parse(parser_, buffer, buffer_size, done) == XML_STATUS_ERROR) {
       error_ = XML_ErrorString(XML_GetErrorCode(parser_));
-      event_queue_.push(EventData{Event::kBadDocument});
+      PushEvent(Event::kBadDocument, 0, 0);
       break;
     }
 
     if (done) {
-      event_queue_.push(EventData{Event::kEndDocument, 0, 0});
+      PushEvent(Event::kEndDocument, 0, 0);
     }
   }
 
@@ -101,27 +106,43 @@ XmlPullParser::Event XmlPullParser::Next() {
   return next_event;
 }
 
+XmlPullParser::EventData* XmlPullParser::PushEvent(Event event, size_t line_number,
+                                                   size_t depth) {
+  if (event_count_ == events_.size()) {
+    events_.emplace_back();
+  }
+
+  EventData* data = &events_[event_count_++];
+  data->event = event;
+  data->line_number = line_number;
+  data->depth = depth;
+  data->data1.clear();
+  data->data2.clear();
+  data->attribute_count = 0;
+  return data;
+}
+
 XmlPullParser::Event XmlPullParser::event() const {
-  return event_queue_.front().event;
+  return front().event;
 }
 
 const std::string& XmlPullParser::error() const { return error_; }
 
 const std::string& XmlPullParser::comment() const {
-  return event_queue_.front().data1;
+  return front().data1;
 }
 
 size_t XmlPullParser::line_number() const {
-  return event_queue_.front().line_number;
+  return front().line_number;
 }
 
-size_t XmlPullParser::depth() const { return event_queue_.front().depth; }
+size_t XmlPullParser::depth() const { return front().depth; }
 
 const std::string& XmlPullParser::text() const {
   if (event() != Event::kText) {
     return empty_;
   }
-  return event_queue_.front().data1;
+  return front().data1;
 }
 
 const std::string& XmlPullParser::namespace_prefix() const {
@@ -130,7 +151,7 @@ const std::string& XmlPullParser::namespace_prefix() const {
       current_event != Event::kEndNamespace) {
     return empty_;
   }
-  return event_queue_.front().data1;
+  return front().data1;
 }
 
 const std::string& XmlPullParser::namespace_uri() const {
@@ -139,7 +160,7 @@ const std::string& XmlPullParser::namespace_uri() const {
       current_event != Event::kEndNamespace) {
     return empty_;
   }
-  return event_queue_.front().data2;
+  return front().data2;
 }
 
 Maybe<ExtractedPackage> XmlPullParser::TransformPackageAlias(const StringPiece& alias) const {
@@ -165,7 +186,7 @@ const std::string& XmlPullParser::element_namespace() const {
       current_event != Event::kEndElement) {
     return empty_;
   }
-  return event_queue_.front().data1;
+  return front().data1;
 }
 
 const std::string& XmlPullParser::element_name() const {
@@ -174,22 +195,22 @@ const std::string& XmlPullParser::element_name() const {
       current_event != Event::kEndElement) {
     return empty_;
   }
-  return event_queue_.front().data2;
+  return front().data2;
 }
 
 XmlPullParser::const_iterator XmlPullParser::begin_attributes() const {
-  return event_queue_.front().attributes.begin();
+  return front().attributes.begin();
 }
 
 XmlPullParser::const_iterator XmlPullParser::end_attributes() const {
-  return event_queue_.front().attributes.end();
+  return front().attributes.begin() + front().attribute_count;
 }
 
 size_t XmlPullParser::attribute_count() const {
   if (event() != Event::kStartElement) {
     return 0;
   }
-  return event_queue_.front().attributes.size();
+  return front().attribute_count;
 }
 
 /**
@@ -215,11 +236,13 @@ void XMLCALL XmlPullParser::StartNamespaceHandler(void* user_data,
                                                   const char* uri) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
   std::string namespace_uri = uri != nullptr ? uri : std::string();
-  parser->namespace_uris_.push(namespace_uri);
-  parser->event_queue_.push(
-      EventData{Event::kStartNamespace,
-                XML_GetCurrentLineNumber(parser->parser_), parser->depth_++,
-                prefix != nullptr ? prefix : std::string(), namespace_uri});
+  EventData* data = parser->PushEvent(Event::kStartNamespace,
+                                      XML_GetCurrentLineNumber(parser->parser_), parser->depth_++);
+  if (prefix != nullptr) {
+    data->data1.assign(prefix);
+  }
+  data->data2.assign(namespace_uri);
+  parser->namespace_uris_.push(std::move(namespace_uri));
 }
 
 void XMLCALL XmlPullParser::StartElementHandler(void* user_data,
@@ -227,55 +250,53 @@ void XMLCALL XmlPullParser::StartElementHandler(void* user_data,
                                                 const char** attrs) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  EventData data = {Event::kStartElement,
-                    XML_GetCurrentLineNumber(parser->parser_),
-                    parser->depth_++};
-  SplitName(name, &data.data1, &data.data2);
-
-  while (*attrs) {
-    Attribute attribute;
-    SplitName(*attrs++, &attribute.namespace_uri, &attribute.name);
-    attribute.value = *attrs++;
+  EventData* data = parser->PushEvent(Event::kStartElement,
+                                      XML_GetCurrentLineNumber(parser->parser_), parser->depth_++);
+  SplitName(name, &data->data1, &data->data2);
 
-    // Insert in sorted order.
-    auto iter = std::lower_bound(data.attributes.begin(), data.attributes.end(),
-                                 attribute);
-    data.attributes.insert(iter, std::move(attribute));
+  for (; *attrs; attrs += 2) {
+    if (data->attribute_count == data->attributes.size()) {
+      data->attributes.emplace_back();
+    }
+    Attribute& attribute = data->attributes[data->attribute_count++];
+    SplitName(attrs[0], &attribute.namespace_uri, &attribute.name);
+    attribute.value.assign(attrs[1]);
   }
 
-  // Move the structure into the queue (no copy).
-  parser->event_queue_.push(std::move(data));
+  // Expat rejects duplicate attributes, so the order of equal attributes does not matter.
+  std::sort(data->attributes.begin(), data->attributes.begin() + data->attribute_count);
 }
 
 void XMLCALL XmlPullParser::CharacterDataHandler(void* user_data, const char* s,
                                                  int len) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(EventData{Event::kText, XML_GetCurrentLineNumber(parser->parser_),
-                                      parser->depth_, std::string(s, len)});
+  EventData* data = parser->PushEvent(Event::kText, XML_GetCurrentLineNumber(parser->parser_),
+                                      parser->depth_);
+  data->data1.assign(s, len);
 }
 
 void XMLCALL XmlPullParser::EndElementHandler(void* user_data,
                                               const char* name) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  EventData data = {Event::kEndElement,
-                    XML_GetCurrentLineNumber(parser->parser_),
-                    --(parser->depth_)};
-  SplitName(name, &data.data1, &data.data2);
-
-  // Move the data into the queue (no copy).
-  parser->event_queue_.push(std::move(data));
+  EventData* data = parser->PushEvent(Event::kEndElement,
+                                      XML_GetCurrentLineNumber(parser->parser_),
+                                      --(parser->depth_));
+  SplitName(name, &data->data1, &data->data2);
 }
 
 void XMLCALL XmlPullParser::EndNamespaceHandler(void* user_data,
                                                 const char* prefix) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(
-      EventData{Event::kEndNamespace, XML_GetCurrentLineNumber(parser->parser_),
-                --(parser->depth_), prefix != nullptr ? prefix : std::string(),
-                parser->namespace_uris_.top()});
+  EventData* data = parser->PushEvent(Event::kEndNamespace,
+                                      XML_GetCurrentLineNumber(parser->parser_),
+                                      --(parser->depth_));
+  if (prefix != nullptr) {
+    data->data1.assign(prefix);
+  }
+  data->data2 = std::move(parser->namespace_uris_.top());
   parser->namespace_uris_.pop();
 }
 
@@ -283,25 +304,23 @@ void XMLCALL XmlPullParser::CommentDataHandler(void* user_data,
                                                const char* comment) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(EventData{Event::kComment,
-                                      XML_GetCurrentLineNumber(parser->parser_),
-                                      parser->depth_, comment});
+  EventData* data = parser->PushEvent(Event::kComment,
+                                      XML_GetCurrentLineNumber(parser->parser_), parser->depth_);
+  data->data1.assign(comment);
 }
 
 void XMLCALL XmlPullParser::StartCdataSectionHandler(void* user_data) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(EventData{Event::kCdataStart,
-                                      XML_GetCurrentLineNumber(parser->parser_),
-                                      parser->depth_ });
+  parser->PushEvent(Event::kCdataStart, XML_GetCurrentLineNumber(parser->parser_),
+                    parser->depth_);
 }
 
 void XMLCALL XmlPullParser::EndCdataSectionHandler(void* user_data) {
   XmlPullParser* parser = reinterpret_cast<XmlPullParser*>(user_data);
 
-  parser->event_queue_.push(EventData{Event::kCdataEnd,
-                                      XML_GetCurrentLineNumber(parser->parser_),
-                                      parser->depth_ });
+  parser->PushEvent(Event::kCdataEnd, XML_GetCurrentLineNumber(parser->parser_),
+                    parser->depth_);
 }
 
 Maybe<StringPiece> FindAttribute(const XmlPullParser* parser,
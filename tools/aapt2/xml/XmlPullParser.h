@@ -22,7 +22,6 @@
 #include <algorithm>
 #include <istream>
 #include <ostream>
-#include <queue>
 #include <stack>
 #include <string>
 #include <vector>
@@ -170,12 +169,28 @@ class XmlPullParser : public IPackageDeclStack {
     size_t depth;
     std::string data1;
     std::string data2;
+
+    // Only the first `attribute_count` attributes belong to the event. The rest are left over from
+    // earlier events, and kept so that their strings can be reused.
     std::vector<Attribute> attributes;
+    size_t attribute_count;
   };
 
+  // Appends an event to the queue, in a slot whose strings keep the storage of a consumed event.
+  EventData* PushEvent(Event event, size_t line_number, size_t depth);
+
+  const EventData& front() const {
+    return events_[front_];
+  }
+
   io::InputStream* in_;
   XML_Parser parser_;
-  std::queue<EventData> event_queue_;
+
+  // The queued events are events_[front_, event_count_). The queue is only refilled once it is
+  // empty, so it always starts at the first slot.
+  std::vector<EventData> events_;
+  size_t front_ = 0;
+  size_t event_count_ = 0;
   std::string error_;
   const std::string empty_;
   size_t depth_;
@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string>
+#include <vector>
+
+#include "android-base/logging.h"
+#include "android-base/stringprintf.h"
+#include "benchmark/benchmark.h"
+
+#include "io/StringStream.h"
+#include "test/Context.h"
+#include "xml/XmlDom.h"
+#include "xml/XmlPullParser.h"
+
+using ::android::base::StringAppendF;
+
+namespace aapt {
+
+// Roughly the number of layouts of a large app.
+constexpr size_t kCorpusSize = 2000u;
+
+// Writes a layout of nested views, with the attributes usually set on them.
+static std::string CreateLayout(size_t index) {
+  std::string layout = R"(<?xml version="1.0" encoding="utf-8"?>
+<!-- A layout of the corpus. -->
+<androidx.constraintlayout.widget.ConstraintLayout
+    xmlns:android="http://schemas.android.com/apk/res/android"
+    xmlns:app="http://schemas.android.com/apk/res-auto"
+    xmlns:tools="http://schemas.android.com/tools"
+    android:layout_width="match_parent"
+    android:layout_height="match_parent"
+    tools:context=".MainActivity">
+)";
+  const size_t view_count = 10 + index % 30;
+  for (size_t i = 0; i < view_count; i++) {
+    StringAppendF(&layout, R"(
+    <TextView
+        android:id="@+id/text%zu"
+        android:layout_width="0dp"
+        android:layout_height="wrap_content"
+        android:layout_marginTop="8dp"
+        android:padding="@dimen/padding"
+        android:text="@string/text%zu"
+        android:textAppearance="?attr/textAppearanceBody1"
+        app:layout_constraintStart_toStartOf="parent"
+        app:layout_constraintEnd_toEndOf="parent"
+        app:layout_constraintTop_toBottomOf="@id/text%zu" />
+)",
+                  i, (index + i) % 500, i == 0 ? 0 : i - 1);
+    if (i % 5 == 4) {
+      StringAppendF(&layout, R"(
+    <LinearLayout
+        android:layout_width="match_parent"
+        android:layout_height="wrap_content"
+        android:orientation="horizontal">
+        <ImageView
+            android:layout_width="24dp"
+            android:layout_height="24dp"
+            android:contentDescription="@null"
+            app:srcCompat="@drawable/ic_item%zu" />
+        <Button
+            style="?attr/borderlessButtonStyle"
+            android:layout_width="wrap_content"
+            android:layout_height="wrap_content"
+            android:text="@string/action%zu" />
+    </LinearLayout>
+)",
+                    i, i);
+    }
+  }
+  layout += "</androidx.constraintlayout.widget.ConstraintLayout>\n";
+  return layout;
+}
+
+static const std::vector<std::string>& GetCorpus() {
+  static const std::vector<std::string> corpus = [] {
+    std::vector<std::string> layouts;
+    for (size_t i = 0; i < kCorpusSize; i++) {
+      layouts.push_back(CreateLayout(i));
+    }
+    return layouts;
+  }();
+  return corpus;
+}
+
+static void SetCorpusCounters(benchmark::State& state) {
+  size_t bytes = 0;
+  for (const std::string& layout : GetCorpus()) {
+    bytes += layout.size();
+  }
+  state.SetItemsProcessed(state.iterations() * GetCorpus().size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+// Parses the layouts into an XmlResource, as aapt2 compile does. xml::Inflate has its own expat
+// handlers and does not use XmlPullParser, so this is the baseline for the layout path.
+static void BM_InflateLayouts(benchmark::State& state) {
+  const std::vector<std::string>& corpus = GetCorpus();
+  test::Context context;
+  for (auto _ : state) {
+    for (const std::string& layout : corpus) {
+      io::StringInputStream in(layout);
+      std::unique_ptr<xml::XmlResource> doc =
+          xml::Inflate(&in, context.GetDiagnostics(), Source("layout.xml"));
+      CHECK(doc != nullptr);
+      benchmark::DoNotOptimize(doc.get());
+    }
+  }
+  SetCorpusCounters(state);
+}
+BENCHMARK(BM_InflateLayouts)->Unit(benchmark::kMillisecond);
+
+// Reads every event and attribute of the layouts, as ResourceParser does for values files.
+static void BM_PullParseLayouts(benchmark::State& state) {
+  const std::vector<std::string>& corpus = GetCorpus();
+  for (auto _ : state) {
+    for (const std::string& layout : corpus) {
+      io::StringInputStream in(layout);
+      xml::XmlPullParser parser(&in);
+      size_t attributes = 0;
+      while (xml::XmlPullParser::IsGoodEvent(parser.Next())) {
+        if (parser.event() == xml::XmlPullParser::Event::kStartElement) {
+          benchmark::DoNotOptimize(parser.element_name().size());
+          for (auto iter = parser.begin_attributes(); iter != parser.end_attributes(); ++iter) {
+            attributes += iter->value.size();
+          }
+        }
+      }
+      CHECK(parser.event() == xml::XmlPullParser::Event::kEndDocument) << parser.error();
+      benchmark::DoNotOptimize(attributes);
+    }
+  }
+  SetCorpusCounters(state);
+}
+BENCHMARK(BM_PullParseLayouts)->Unit(benchmark::kMillisecond);
+
+}  // namespace aapt
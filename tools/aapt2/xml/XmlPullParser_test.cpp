@@ -62,5 +62,86 @@ TEST(XmlPullParserTest, NextChildNodeTraversesCorrectly) {
   EXPECT_THAT(parser.event(), Eq(XmlPullParser::Event::kEndDocument));
 }
 
+// Hands out one byte at a time, so that the parser queues at most a few events at once.
+class ByteInputStream : public io::InputStream {
+ public:
+  explicit ByteInputStream(const std::string& str) : str_(str) {
+  }
+
+  bool Next(const void** data, size_t* size) override {
+    if (offset_ == str_.size()) {
+      return false;
+    }
+    *data = str_.data() + offset_++;
+    *size = 1u;
+    return true;
+  }
+
+  void BackUp(size_t count) override {
+    offset_ -= count;
+  }
+
+  size_t ByteCount() const override {
+    return offset_;
+  }
+
+  bool HadError() const override {
+    return false;
+  }
+
+ private:
+  const std::string& str_;
+  size_t offset_ = 0u;
+};
+
+TEST(XmlPullParserTest, EventsDoNotKeepDataOfEarlierEvents) {
+  const std::string str =
+      R"(<a xmlns:android="http://schemas.android.com/apk/res/android"
+            android:z="1" y="2" android:x="3"><!-- comment --><b c="4"/><d/></a>)";
+  ByteInputStream input(str);
+  XmlPullParser parser(&input);
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kStartNamespace));
+  EXPECT_THAT(parser.namespace_prefix(), StrEq("android"));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kStartElement));
+  EXPECT_THAT(parser.element_name(), StrEq("a"));
+  ASSERT_THAT(parser.attribute_count(), Eq(3u));
+  auto iter = parser.begin_attributes();
+  EXPECT_THAT(iter->name, StrEq("y"));
+  ++iter;
+  EXPECT_THAT(iter->name, StrEq("x"));
+  EXPECT_THAT(iter->value, StrEq("3"));
+  ++iter;
+  EXPECT_THAT(iter->name, StrEq("z"));
+  EXPECT_THAT(++iter, Eq(parser.end_attributes()));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kComment));
+  EXPECT_THAT(parser.comment(), StrEq(" comment "));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kStartElement));
+  EXPECT_THAT(parser.element_namespace(), StrEq(""));
+  EXPECT_THAT(parser.element_name(), StrEq("b"));
+  ASSERT_THAT(parser.attribute_count(), Eq(1u));
+  EXPECT_THAT(parser.begin_attributes()->value, StrEq("4"));
+  EXPECT_THAT(parser.begin_attributes() + 1, Eq(parser.end_attributes()));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kEndElement));
+  EXPECT_THAT(parser.element_name(), StrEq("b"));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kStartElement));
+  EXPECT_THAT(parser.element_name(), StrEq("d"));
+  EXPECT_THAT(parser.attribute_count(), Eq(0u));
+  EXPECT_THAT(parser.begin_attributes(), Eq(parser.end_attributes()));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kEndElement));
+  ASSERT_THAT(parser.Next(), Eq(Event::kEndElement));
+  EXPECT_THAT(parser.element_name(), StrEq("a"));
+
+  ASSERT_THAT(parser.Next(), Eq(Event::kEndNamespace));
+  EXPECT_THAT(parser.namespace_uri(), StrEq("http://schemas.android.com/apk/res/android"));
+  EXPECT_THAT(parser.Next(), Eq(Event::kEndDocument));
+}
+
 }  // namespace xml
 }  // namespace aapt